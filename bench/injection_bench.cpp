@@ -0,0 +1,212 @@
+/**
+ * @file injection_bench.cpp
+ * @brief How long injection::Execute() holds a child process stopped, per way of loading, on Linux.
+ *
+ * Standalone, it is not part of the application project. Build from the repository root:
+ *
+ *   g++ -std=c++20 -O2 -Isrc bench/injection_bench.cpp src/injection/agent_channel.cpp src/injection/agent_channel_linux.cpp
+ *       src/injection/injection_job.cpp src/injection/injection_linux.cpp src/injection/injection_metrics.cpp
+ *       src/injection/latency_histogram.cpp src/injection/mapped_file_linux.cpp src/injection/payload_cache.cpp
+ *       src/injection/payload_graph.cpp src/injection/payload_graph_linux.cpp src/injection/pe_image.cpp
+ *       src/injection/remote_arena.cpp src/injection/remote_memory.cpp src/injection/remote_memory_linux.cpp
+ *       src/injection/symbol_resolver.cpp src/injection/symbol_resolver_linux.cpp src/process/module_list.cpp
+ *       src/process/module_list_linux.cpp src/process/name_pool.cpp src/process/process_details_linux.cpp
+ *       src/process/process_snapshot.cpp src/process/process_snapshot_linux.cpp src/process/sort_keys.cpp
+ *       src/process/string_arena.cpp -o injection_bench -pthread -ldl
+ *
+ *   ./injection_bench payload.so [more.so ...] [--hang slow.so]
+ *
+ * Any shared object will do as a payload, e.g. one built from an empty C file with
+ * gcc -shared -fPIC. The bench forks a child that sleeps in pause() and injects the payloads
+ * into it over and over; a repeated dlopen only takes another reference. ptrace must be
+ * allowed on own children (kernel.yama.ptrace_scope 0 or 1). For every way of loading the
+ * medians and 99th percentiles of targetStopped and of the whole job are printed:
+ *  - loader thread: the default, the target is stopped to start a thread that loads;
+ *  - minimal stop: a sleeping thread is stopped, the block is written beforehand;
+ *  - agent: the first job starts the agent, the repeats load through it without a stop;
+ *  - skip unchanged: the repeats find the payloads loaded and do not touch the target.
+ * With --hang, a payload whose constructor does not return in time (e.g. sleep(3)) is
+ * injected with a 500 ms timeout, which must end TimedOut after about 500 ms.
+ */
+
+#include "injection/injection_job.h"
+#include "process/process_snapshot.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	constexpr std::size_t Repetitions = 200;
+
+	const char* StateName(injection::JobState state) noexcept
+	{
+		switch (state) {
+		case injection::JobState::Succeeded: return "Succeeded";
+		case injection::JobState::Failed: return "Failed";
+		case injection::JobState::Cancelled: return "Cancelled";
+		case injection::JobState::TimedOut: return "TimedOut";
+		case injection::JobState::Running: return "Running";
+		default: return "Queued";
+		}
+	}
+
+	/**
+	* @brief Runs one job the way a worker of InjectionQueue does.
+	* @param elapsed Receives the time Execute() took.
+	*/
+	injection::InjectionResult RunJob(const injection::InjectionRequest& request, std::chrono::nanoseconds& elapsed)
+	{
+		injection::InjectionJob job(1, request);
+		job.Begin();
+		std::string error;
+		if (!job.Plan(error)) {
+			injection::InjectionResult result;
+			result.state = injection::JobState::Failed;
+			result.error = error;
+			return result;
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+		injection::InjectionResult result = injection::Execute(job);
+		elapsed = std::chrono::steady_clock::now() - start;
+		return result;
+	}
+
+	double Percentile(std::vector<double> values, double fraction)
+	{
+		std::sort(values.begin(), values.end());
+		return values[static_cast<std::size_t>(fraction * (values.size() - 1))];
+	}
+
+	/**
+	* @brief Injects the request repeatedly and prints the stop and job times.
+	* @return False if a job did not succeed.
+	*/
+	bool Measure(const char* name, const injection::InjectionRequest& request)
+	{
+		std::vector<double> stopped, total;
+		stopped.reserve(Repetitions);
+		total.reserve(Repetitions);
+
+		for (std::size_t i = 0; i < Repetitions; i++) {
+			std::chrono::nanoseconds elapsed{ };
+			const injection::InjectionResult result = RunJob(request, elapsed);
+			if (result.state != injection::JobState::Succeeded) {
+				std::printf("%-16s %s: %s\n", name, StateName(result.state), result.error.c_str());
+				return false;
+			}
+			stopped.push_back(result.targetStopped.count() / 1e3);
+			total.push_back(elapsed.count() / 1e3);
+		}
+
+		std::printf("%-16s %9.1f %9.1f   %9.1f %9.1f\n", name,
+			Percentile(stopped, 0.5), Percentile(stopped, 0.99), Percentile(total, 0.5), Percentile(total, 0.99));
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+#ifndef __linux__
+	(void)argc;
+	(void)argv;
+	std::fprintf(stderr, "targetStopped is only measured on Linux\n");
+	return 1;
+#else
+	std::vector<std::string> payloads;
+	const char* hang = nullptr;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--hang") == 0 && i + 1 < argc)
+			hang = argv[++i];
+		else
+			payloads.push_back(argv[i]);
+	}
+	if (payloads.empty()) {
+		std::fprintf(stderr, "usage: %s payload.so [more.so ...] [--hang slow.so]\n", argv[0]);
+		return 1;
+	}
+
+	const pid_t pid = fork();
+	if (pid < 0) {
+		std::fprintf(stderr, "Could not fork the target\n");
+		return 1;
+	}
+	if (pid == 0) {
+		for (;;)
+			pause();
+	}
+
+	// the job names its target by pid and start time, as the snapshot reports them
+	injection::InjectionRequest request;
+	process::ProcessEnumerator enumerator;
+	process::ProcessSnapshot snapshot;
+	for (int attempt = 0; attempt < 50 && !request.target.pid; attempt++) {
+		if (enumerator.Enumerate(snapshot)) {
+			for (const process::ProcessInfo& info : snapshot.processes) {
+				if (info.pid == static_cast<std::uint32_t>(pid))
+					request.target = info.Key();
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	bool ok = request.target.pid != 0;
+	if (!ok)
+		std::fprintf(stderr, "The target is not in the process snapshot\n");
+
+	request.libraries = payloads;
+	request.timeout = std::chrono::seconds(5);
+
+	if (ok) {
+		std::printf("%zu payload(s), %zu jobs each, in microseconds\n", payloads.size(), Repetitions);
+		std::printf("%-16s %9s %9s   %9s %9s\n", "", "stop p50", "stop p99", "job p50", "job p99");
+
+		ok = Measure("loader thread", request);
+
+		injection::InjectionRequest minimal = request;
+		minimal.minimalStop = true;
+		ok = ok && Measure("minimal stop", minimal);
+
+		injection::InjectionRequest agent = request;
+		agent.useAgent = true;
+		std::chrono::nanoseconds elapsed{ };
+		const injection::InjectionResult first = RunJob(agent, elapsed);
+		std::printf("%-16s %9.1f %9s   %9.1f %9s  (%s)\n", "agent start", first.targetStopped.count() / 1e3, "",
+			elapsed.count() / 1e3, "", first.warning.empty() ? StateName(first.state) : first.warning.c_str());
+		ok = ok && first.state == injection::JobState::Succeeded && Measure("agent", agent);
+
+		injection::InjectionRequest skip = request;
+		skip.skipUnchanged = true;
+		ok = ok && Measure("skip unchanged", skip);
+	}
+
+	if (ok && hang) {
+		injection::InjectionRequest slow = request;
+		slow.libraries = { hang };
+		slow.timeout = std::chrono::milliseconds(500);
+
+		std::chrono::nanoseconds elapsed{ };
+		const injection::InjectionResult result = RunJob(slow, elapsed);
+		std::printf("hang, 500 ms timeout: %s after %.0f ms, stopped %.1f us\n", StateName(result.state),
+			elapsed.count() / 1e6, result.targetStopped.count() / 1e3);
+		ok = result.state == injection::JobState::TimedOut;
+	}
+
+	injection::ReleaseAllTargets();
+	kill(pid, SIGKILL);
+	waitpid(pid, nullptr, 0);
+	return ok ? 0 : 1;
+#endif
+}
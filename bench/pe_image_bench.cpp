@@ -0,0 +1,235 @@
+/**
+ * @file pe_image_bench.cpp
+ * @brief injection::PeImage run over a corpus of PE files and over truncated and byte-flipped copies of them.
+ *
+ * Standalone, it is not part of the application project. Build from the repository root:
+ *
+ *   Linux:   g++ -std=c++20 -O2 -Isrc bench/pe_image_bench.cpp src/injection/pe_image.cpp src/injection/mapped_file_linux.cpp -o pe_image_bench
+ *   Windows: cl /std:c++20 /O2 /EHsc /Isrc bench\pe_image_bench.cpp src\injection\pe_image.cpp src\injection\mapped_file_win.cpp
+ *
+ * For the mutated copies build a second time with -O1 -g -fsanitize=address,undefined
+ * (/fsanitize=address with cl); every copy is an allocation of its exact size, so a read past
+ * its end is reported.
+ *
+ *   ./pe_image_bench [--copies N] directory...
+ *
+ * Every regular file below the directories that starts with "MZ" is part of the corpus, e.g.
+ * C:\Windows\System32 or the shared frameworks of a .NET SDK on Linux. Printed are:
+ *  - how many files were accepted as DLLs, per machine type, and how many were rejected, per
+ *    error;
+ *  - Parse() alone per file, with the file mapped, and map + Parse() + unmap, p50 and p99
+ *    over the corpus on a warm cache;
+ *  - N copies of every file (default 6), cut at a random length or with a few random bytes of
+ *    the headers flipped, and how many of them still parsed. Every accessor is called on
+ *    those, which must neither crash nor read outside the copy.
+ */
+
+#include "injection/mapped_file.h"
+#include "injection/pe_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// headers and section table of almost every image lie in the first 4 KB
+	constexpr std::size_t HeaderBytes = 4096;
+
+	/**
+	* @brief xorshift64*, the copies are the same on every run.
+	*/
+	struct Random
+	{
+		std::uint64_t state = 0x9E3779B97F4A7C15ull;
+
+		std::uint64_t Next() noexcept
+		{
+			state ^= state >> 12;
+			state ^= state << 25;
+			state ^= state >> 27;
+			return state * 0x2545F4914F6CDD1Dull;
+		}
+
+		std::size_t Below(std::size_t bound) noexcept { return bound ? static_cast<std::size_t>(Next() % bound) : 0; }
+	};
+
+	bool StartsWithMz(const std::filesystem::path& path)
+	{
+		char magic[2] = { };
+		std::ifstream file(path, std::ios::binary);
+		return file.read(magic, sizeof(magic)) && magic[0] == 'M' && magic[1] == 'Z';
+	}
+
+	/**
+	* @brief Collects the PE files below the directories.
+	*/
+	std::vector<std::string> FindCorpus(const std::vector<std::string>& roots)
+	{
+		std::vector<std::string> files;
+		for (const std::string& root : roots) {
+			std::error_code error;
+			std::filesystem::recursive_directory_iterator it(root, std::filesystem::directory_options::skip_permission_denied, error);
+			for (const std::filesystem::recursive_directory_iterator end; !error && it != end; it.increment(error)) {
+				if (it->is_regular_file(error) && !it->is_symlink(error) && StartsWithMz(it->path()))
+					files.push_back(it->path().string());
+			}
+		}
+		std::sort(files.begin(), files.end());
+		return files;
+	}
+
+	/**
+	* @brief Calls every accessor of a parsed image, the way a caller walking it would.
+	* @return A value depending on everything read, so nothing is optimized away.
+	*/
+	std::uint64_t Walk(const injection::PeImage& image) noexcept
+	{
+		std::uint64_t sum = image.Machine() + image.Characteristics() + image.DllCharacteristics() + image.IsDll() + image.SizeOfImage() + image.EntryPoint();
+
+		for (std::uint32_t i = 0; i < image.SectionCount(); i++) {
+			const injection::PeSection section = image.Section(i);
+			sum += section.name.size() + section.virtualAddress + section.characteristics;
+			sum += image.At(section.virtualAddress, section.rawSize).size();
+			sum += image.String(section.virtualAddress).size();
+		}
+
+		for (std::uint32_t i = 0; i < static_cast<std::uint32_t>(injection::PeDirectoryIndex::Count); i++) {
+			const injection::PeDirectory directory = image.Directory(static_cast<injection::PeDirectoryIndex>(i));
+			const std::span<const unsigned char> bytes = image.At(directory.rva, directory.size);
+			if (!bytes.empty())
+				sum += bytes.front() + bytes.back();
+			sum += image.String(directory.rva).size();
+		}
+
+		// import descriptors name their DLLs by RVA, the way ReadImports() walks them
+		const injection::PeDirectory imports = image.Directory(injection::PeDirectoryIndex::Import);
+		for (std::uint32_t offset = 0; offset + 20 <= imports.size; offset += 20) {
+			const std::span<const unsigned char> descriptor = image.At(imports.rva + offset, 20);
+			if (descriptor.empty())
+				break;
+			std::uint32_t name = 0;
+			std::memcpy(&name, descriptor.data() + 12, sizeof(name));
+			if (!name)
+				break;
+			sum += image.String(name).size();
+		}
+		return sum;
+	}
+
+	double Percentile(std::vector<double> values, double fraction)
+	{
+		if (values.empty())
+			return 0;
+		std::sort(values.begin(), values.end());
+		return values[static_cast<std::size_t>(fraction * (values.size() - 1))];
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::size_t copies = 6;
+	std::vector<std::string> roots;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--copies") == 0 && i + 1 < argc)
+			copies = static_cast<std::size_t>(std::strtoul(argv[++i], nullptr, 10));
+		else
+			roots.push_back(argv[i]);
+	}
+	if (roots.empty()) {
+		std::fprintf(stderr, "usage: %s [--copies N] directory...\n", argv[0]);
+		return 1;
+	}
+
+	const std::vector<std::string> files = FindCorpus(roots);
+	std::printf("%zu PE files\n", files.size());
+	if (files.empty())
+		return 1;
+
+	std::map<std::uint16_t, std::size_t> accepted;
+	std::map<std::string, std::size_t> rejected;
+	std::vector<double> parseTimes, openTimes;
+	std::uint64_t sink = 0;
+
+	for (const std::string& path : files) {
+		injection::MappedFile file;
+		if (const char* error = file.Open(path)) {
+			++rejected[error];
+			continue;
+		}
+
+		injection::PeImage image;
+		const char* error = image.Parse(file.Data());
+		if (error)
+			++rejected[error];
+		else if (!image.IsDll())
+			++rejected["not a DLL"];
+		else
+			++accepted[image.Machine()];
+
+		// the pages were faulted in above, repeating the parse times the parser alone
+		constexpr int Repeats = 16;
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < Repeats; i++)
+			sink += image.Parse(file.Data()) == nullptr;
+		parseTimes.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / Repeats);
+		file.Close();
+
+		const auto open = std::chrono::steady_clock::now();
+		injection::MappedFile again;
+		if (!again.Open(path))
+			sink += image.Parse(again.Data()) == nullptr;
+		again.Close();
+		openTimes.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - open).count());
+	}
+
+	for (const auto& [machine, count] : accepted)
+		std::printf("  %6zu accepted as DLLs, machine 0x%04x\n", count, machine);
+	for (const auto& [error, count] : rejected)
+		std::printf("  %6zu rejected: %s\n", count, error.c_str());
+	std::printf("parse alone:               p50 %6.2f us  p99 %6.2f us\n", Percentile(parseTimes, 0.5), Percentile(parseTimes, 0.99));
+	std::printf("map + parse + unmap, warm: p50 %6.2f us  p99 %6.2f us\n", Percentile(openTimes, 0.5), Percentile(openTimes, 0.99));
+
+	Random random;
+	std::size_t made = 0, parsed = 0;
+	std::vector<unsigned char> original;
+	for (const std::string& path : files) {
+		injection::MappedFile file;
+		if (file.Open(path) || file.Data().empty())
+			continue;
+		original.assign(file.Data().begin(), file.Data().end());
+		file.Close();
+
+		for (std::size_t i = 0; i < copies; i++) {
+			// half are cut short, mostly inside the headers; the rest get up to eight header bytes flipped
+			std::size_t size = original.size();
+			if (i % 2 == 0)
+				size = random.Below(2) ? random.Below(std::min(size, HeaderBytes)) : random.Below(size);
+
+			std::vector<unsigned char> copy(original.begin(), original.begin() + size);
+			if (i % 2 == 1) {
+				const std::size_t flips = 1 + random.Below(8);
+				for (std::size_t flip = 0; flip < flips && !copy.empty(); flip++)
+					copy[random.Below(std::min(copy.size(), HeaderBytes))] ^= static_cast<unsigned char>(1 + random.Below(255));
+			}
+
+			++made;
+			injection::PeImage image;
+			if (image.Parse(copy) == nullptr) {
+				++parsed;
+				sink += Walk(image);
+			}
+		}
+	}
+	std::printf("%zu mutated copies, %zu still parsed and were walked\n", made, parsed);
+
+	return sink == 0xFFFFFFFFFFFFFFFFull ? 2 : 0;
+}
@@ -0,0 +1,196 @@
+/**
+ * @file remote_memory_bench.cpp
+ * @brief Read and write throughput of injection::RemoteMemory into a child process, from 4 KB to 16 MB.
+ *
+ * Standalone, it is not part of the application project. Build from the repository root:
+ *
+ *   Linux:   g++ -std=c++20 -O2 -Isrc bench/remote_memory_bench.cpp src/injection/remote_memory.cpp src/injection/remote_memory_linux.cpp -o remote_memory_bench
+ *   Windows: cl /std:c++20 /O2 /EHsc /Isrc bench\remote_memory_bench.cpp src\injection\remote_memory.cpp src\injection\remote_memory_win.cpp
+ *
+ * For every total size three layouts are measured in both directions, in MB/s:
+ *  - contiguous: one buffer of the total size, a single call either way;
+ *  - scattered, per buffer: 4 KB buffers on every other remote page, one Write()/Read() each;
+ *  - scattered, batched: the same buffers queued and carried out with one Flush().
+ * Each figure is the median of several repetitions that move at least 64 MB together.
+ */
+
+#include "injection/remote_memory.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <csignal>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	constexpr std::size_t Page = 4096;
+	constexpr std::size_t MaxSize = 16 * 1024 * 1024;
+
+	// room for the largest scattered layout, which uses every other page
+	constexpr std::size_t RegionSize = 2 * MaxSize;
+
+	/**
+	* @brief A child process with a region the benchmark reads and writes.
+	*/
+	struct Target
+	{
+		injection::RemoteProcess process = { };
+		std::uint64_t region = 0;
+
+#ifdef _WIN32
+		PROCESS_INFORMATION information = { };
+#else
+		pid_t pid = 0;
+#endif
+
+		/**
+		* @brief Starts the child.
+		* @return Null on success, otherwise the error.
+		* @remarks Windows starts this executable suspended and reserves the region in it, Linux
+		*  maps the region before forking so the child has it at the same address.
+		*/
+		const char* Start()
+		{
+#ifdef _WIN32
+			char path[MAX_PATH];
+			STARTUPINFOA startup = { sizeof(startup) };
+			if (!GetModuleFileNameA(NULL, path, MAX_PATH) ||
+				!CreateProcessA(path, NULL, NULL, NULL, FALSE, CREATE_SUSPENDED, NULL, NULL, &startup, &information))
+				return "Could not start the target";
+
+			void* remote = VirtualAllocEx(information.hProcess, NULL, RegionSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+			if (!remote)
+				return "Could not allocate memory in the target";
+			process = information.hProcess;
+			region = reinterpret_cast<std::uint64_t>(remote);
+#else
+			void* mapped = mmap(nullptr, RegionSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (mapped == MAP_FAILED)
+				return "Could not map the region";
+
+			pid = fork();
+			if (pid < 0)
+				return "Could not fork the target";
+			if (pid == 0) {
+				for (;;)
+					pause();
+			}
+			process = pid;
+			region = reinterpret_cast<std::uint64_t>(mapped);
+#endif
+			return nullptr;
+		}
+
+		~Target()
+		{
+#ifdef _WIN32
+			if (information.hProcess) {
+				TerminateProcess(information.hProcess, 0);
+				CloseHandle(information.hThread);
+				CloseHandle(information.hProcess);
+			}
+#else
+			if (pid > 0) {
+				kill(pid, SIGKILL);
+				waitpid(pid, nullptr, 0);
+			}
+#endif
+		}
+	};
+
+	enum class Layout
+	{
+		Contiguous,
+		PerBuffer,
+		Batched,
+	};
+
+	/**
+	* @brief Moves size bytes once in the given layout.
+	* @return False if the transfer failed.
+	*/
+	bool Transfer(injection::RemoteMemory& memory, const Target& target, std::vector<unsigned char>& local, std::size_t size, Layout layout, bool write)
+	{
+		if (layout == Layout::Contiguous)
+			return write ? memory.Write(target.region, local.data(), size) : memory.Read(target.region, local.data(), size);
+
+		for (std::size_t offset = 0; offset < size; offset += Page) {
+			const std::uint64_t remote = target.region + 2 * offset;
+			if (write)
+				memory.QueueWrite(remote, local.data() + offset, Page);
+			else
+				memory.QueueRead(remote, local.data() + offset, Page);
+
+			if (layout == Layout::PerBuffer && !memory.Flush())
+				return false;
+		}
+		return memory.Flush();
+	}
+
+	/**
+	* @brief Measures one layout and direction.
+	* @return The median throughput in MB/s, negative if a transfer failed.
+	*/
+	double Measure(const Target& target, std::vector<unsigned char>& local, std::size_t size, Layout layout, bool write)
+	{
+		injection::RemoteMemory memory(target.process);
+		const std::size_t repetitions = std::clamp<std::size_t>(64 * 1024 * 1024 / size, 5, 2000);
+
+		// the first pass faults the remote pages in
+		if (!Transfer(memory, target, local, size, layout, write))
+			return -1;
+
+		std::vector<double> rates;
+		rates.reserve(repetitions);
+		for (std::size_t i = 0; i < repetitions; i++) {
+			const auto start = std::chrono::steady_clock::now();
+			if (!Transfer(memory, target, local, size, layout, write))
+				return -1;
+			const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			rates.push_back(size / elapsed.count() / 1e6);
+		}
+
+		std::nth_element(rates.begin(), rates.begin() + rates.size() / 2, rates.end());
+		return rates[rates.size() / 2];
+	}
+}
+
+int main()
+{
+	Target target;
+	if (const char* error = target.Start()) {
+		std::fprintf(stderr, "%s\n", error);
+		return 1;
+	}
+
+	std::vector<unsigned char> local(MaxSize);
+	for (std::size_t i = 0; i < local.size(); i++)
+		local[i] = static_cast<unsigned char>(i * 131);
+
+	std::printf("MB/s, write / read\n");
+	std::printf("%8s  %17s  %17s  %17s\n", "size", "contiguous", "4 KB per buffer", "4 KB batched");
+	for (std::size_t size = Page; size <= MaxSize; size *= 4) {
+		std::printf("%6zu K", size / 1024);
+		for (Layout layout : { Layout::Contiguous, Layout::PerBuffer, Layout::Batched }) {
+			const double write = Measure(target, local, size, layout, true);
+			const double read = Measure(target, local, size, layout, false);
+			if (write < 0 || read < 0) {
+				std::printf("\nThe transfer failed\n");
+				return 1;
+			}
+			std::printf("  %8.0f / %6.0f", write, read);
+		}
+		std::printf("\n");
+	}
+	return 0;
+}
@@ -5,23 +5,33 @@
 */
 
 #pragma once
+#include <chrono>
 #include <vector>
 #include <string>
 
+#include "injection/injection_queue.h"
+#include "injection/process_watch.h"
+#include "injection/target_selector.h"
+#include "process/module_list.h"
+#include "process/snapshot_service.h"
+
 namespace globals {
 	/**
-	* @brief Index of the currently selected process in the process list.
+	* @brief Identity (pid and start time) of the currently selected process.
+	* @remarks Unlike a list index or a name this stays valid while the list is re-sorted and
+	*  never matches a different process that later reuses the pid.
 	*/
-	inline int selectedProcessIndex = -1;
+	inline process::ProcessKey selectedProcess;
+
 	/**
- * @brief Process ID of the currently selected process in the process list.
- */
-	inline int selectedProcessID = 0;
+	 * @brief Name of the currently selected process in the process list, interned in process::NamePool::Shared().
+	 */
+	inline process::NameId selected_process_name = 0;
 
 	/**
-	 * @brief Name of the currently selected process in the process list.
+	 * @brief The processes an injection goes to: the selected ones, the children of the selected one or all matching a name.
 	 */
-	inline std::string selected_process_name;
+	inline injection::TargetSelector targets;
 
 	/**
 	 * @brief Whether a DLL file has been selected for injection.
@@ -34,17 +44,42 @@ namespace globals {
 	inline std::vector<std::string> dll_paths;
 
 	/**
-	 * @brief Name of the last injected DLL file.
+	 * @brief Time budget of one injection job.
+	 */
+	inline std::chrono::milliseconds injectionTimeout = std::chrono::seconds(10);
+
+	/**
+	 * @brief Whether all selected DLLs are loaded by a single remote thread.
+	 */
+	inline bool batchInjection = true;
+
+	/**
+	 * @brief Whether DLLs are loaded through a resident agent kept in each target.
+	 */
+	inline bool agentInjection = false;
+
+	/**
+	 * @brief Whether DLLs a target has already loaded from the same file content are skipped, see injection::PayloadCache.
+	 */
+	inline bool skipUnchanged = true;
+
+	/**
+	 * @brief Background worker publishing the list of running processes.
+	 */
+	inline process::SnapshotService processSnapshots;
+
+	/**
+	 * @brief Modules of the selected process, scanned on the snapshot worker while the UI shows them.
 	 */
-	inline std::string lastInjected;
+	inline process::ModuleWatch selectedModules;
 
 	/**
-	 * @brief Whether a DLL file has been successfully injected.
+	 * @brief Workers executing injection jobs, so the UI never waits for a target process.
 	 */
-	inline bool isDllInjected = false;
+	inline injection::InjectionQueue injectionQueue;
 
 	/**
-	 * @brief Error message generated during DLL injection process.
+	 * @brief Watch rules, injecting into matching processes as soon as they start.
 	 */
-	inline std::string error_msg;
+	inline injection::ProcessWatch processWatch{ processSnapshots, injectionQueue };
 }
\ No newline at end of file
@@ -4,8 +4,11 @@
  */
 
 #include "gui.h"
+#include "process_list.h"
 #include "../globals.h"
 #include "../injector.h"
+#include "../injection/injection_metrics.h"
+#include "../process/module_list.h"
 #include "../../resource.h"
 
 #include <algorithm>
@@ -329,17 +332,204 @@ void gui::EndRender() noexcept
 }
 
 /**
-* @brief A function that compares two strings in a case-insensitive manner.
-* @param str1 The first string to be compared.
-* @param str2 The second string to be compared.
-* @return A boolean value indicating whether the first string is less than the second string in lexicographical order.
+* @brief Gets the short display name of an architecture.
+* @param architecture The architecture of a process.
+* @return A static string for the process table.
 */
-bool compareStringsIgnoreCase(const std::string& str1, const std::string& str2) {
-	std::string str1Lower = str1;
-	std::transform(str1Lower.begin(), str1Lower.end(), str1Lower.begin(), ::tolower);
-	std::string str2Lower = str2;
-	std::transform(str2Lower.begin(), str2Lower.end(), str2Lower.begin(), ::tolower);
-	return str1Lower < str2Lower;
+const char* ArchitectureName(process::Architecture architecture) {
+	switch (architecture) {
+	case process::Architecture::X86: return "x86";
+	case process::Architecture::X64: return "x64";
+	case process::Architecture::Arm64: return "ARM64";
+	default: return "?";
+	}
+}
+
+/**
+* @brief Checks whether a process is part of the explicit target list.
+* @param info The process.
+* @return True if the process has been selected in the table.
+*/
+bool IsTarget(const process::ProcessInfo& info) {
+	const auto& targets = globals::targets.targets;
+	return std::find(targets.begin(), targets.end(), info.Key()) != targets.end();
+}
+
+/**
+* @brief Describes the state of an injection job for the job list.
+* @param job The job to be described.
+* @return A static string.
+*/
+const char* JobStateText(const injection::InjectionJob& job) {
+	const bool unload = !job.Request().unload.empty();
+	switch (job.State()) {
+	case injection::JobState::Queued: return "queued";
+	case injection::JobState::Succeeded: return unload ? "unloaded" : "injected";
+	case injection::JobState::Failed: return "failed";
+	case injection::JobState::TimedOut: return "timed out";
+	case injection::JobState::Cancelled: return "cancelled";
+	default: break;
+	}
+
+	switch (job.Phase()) {
+	case injection::JobPhase::OpeningProcess: return "opening process";
+	case injection::JobPhase::WritingPath: return "writing path";
+	case injection::JobPhase::Loading: return unload ? "unloading" : "loading";
+	default: return "running";
+	}
+}
+
+/**
+* @brief Draws the status line of one injection job.
+* @param job The job to be shown.
+*/
+void JobLine(injection::InjectionJob& job) {
+	const injection::InjectionRequest& request = job.Request();
+	const injection::JobState state = job.State();
+	const char* target = process::NamePool::Shared().View(request.targetName).data();
+
+	ImVec4 color(1.0f, 1.0f, 0.0f, 1.0f);
+	if (state == injection::JobState::Succeeded)
+		color = ImVec4(0.0f, 1.0f, 0.0f, 1.0f);
+	else if (state == injection::JobState::Failed || state == injection::JobState::TimedOut)
+		color = ImVec4(1.0f, 0.0f, 0.0f, 1.0f);
+	else if (state == injection::JobState::Cancelled)
+		color = ImVec4(0.6f, 0.6f, 0.6f, 1.0f);
+
+	ImGui::PushID(static_cast<int>(job.Id()));
+	ImGui::TextColored(color, "%s (%u): %s %zu/%zu", target, request.target.pid, JobStateText(job),
+		(std::min)(job.Progress() + (state == injection::JobState::Running ? 1 : 0), request.libraries.size()), request.libraries.size());
+
+	const bool finished = state != injection::JobState::Queued && state != injection::JobState::Running;
+	if (finished && ImGui::IsItemHovered()) {
+		const injection::InjectionResult& result = job.Result().get();
+		ImGui::SetTooltip("%zu remote allocation(s), %zu bytes written, %zu unchanged, %zu reloaded", result.remoteAllocations, result.bytesWritten, result.unchanged, result.reloaded);
+	}
+	if (finished && !job.Result().get().warning.empty()) {
+		ImGui::SameLine();
+		ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.0f, 1.0f), "%s", job.Result().get().warning.c_str());
+	}
+
+	if (state == injection::JobState::Queued || state == injection::JobState::Running) {
+		ImGui::SameLine();
+		if (ImGui::SmallButton("Cancel"))
+			job.Cancel();
+	}
+	else if (state == injection::JobState::Succeeded && request.useAgent && request.unload.empty()) {
+		// the agent that loaded the DLLs can unload them again, in reverse order, as a job of its
+		// own since the agent is busy while another job runs on the target
+		ImGui::SameLine();
+		if (ImGui::SmallButton("Unload")) {
+			injection::InjectionRequest unload;
+			unload.target = request.target;
+			unload.targetName = request.targetName;
+			unload.timeout = globals::injectionTimeout;
+			unload.useAgent = true;
+			// the results are in load order
+			const auto& libraries = job.Result().get().libraries;
+			const auto& planned = job.Planned().libraries;
+			for (std::size_t i = 0; i < libraries.size() && i < planned.size(); i++) {
+				unload.libraries.push_back(planned[i]);
+				unload.unload.push_back(libraries[i].module);
+			}
+			globals::injectionQueue.Submit(std::move(unload));
+		}
+	}
+	else if (state != injection::JobState::Succeeded && state != injection::JobState::Cancelled) {
+		// the result is ready once the state left Running, kept on one line for the clipper
+		ImGui::SameLine();
+		ImGui::TextUnformatted(job.Result().get().error.c_str());
+	}
+	ImGui::PopID();
+}
+
+/**
+* @brief Draws the per-phase latency table of all injections so far.
+*/
+void LatencyTable() {
+	const ImGuiTableFlags tableFlags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp;
+	if (!ImGui::BeginTable("Latency", 6, tableFlags))
+		return;
+
+	ImGui::TableSetupColumn("Phase");
+	ImGui::TableSetupColumn("Count");
+	ImGui::TableSetupColumn("p50 (ms)");
+	ImGui::TableSetupColumn("p99 (ms)");
+	ImGui::TableSetupColumn("Max (ms)");
+	ImGui::TableSetupColumn("Mean (ms)");
+	ImGui::TableHeadersRow();
+
+	const auto& metrics = injection::InjectionMetrics::Shared();
+	for (std::size_t i = 0; i < static_cast<std::size_t>(injection::InjectionPhase::Count); i++) {
+		const auto phase = static_cast<injection::InjectionPhase>(i);
+		const injection::LatencySummary summary = metrics.Histogram(phase).Summarize();
+
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted(injection::PhaseName(phase));
+		ImGui::TableNextColumn();
+		ImGui::Text("%llu", static_cast<unsigned long long>(summary.count));
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", summary.p50 / 1e6);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", summary.p99 / 1e6);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", summary.max / 1e6);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", summary.mean / 1e6);
+	}
+	ImGui::EndTable();
+}
+
+/**
+* @brief Draws the modules loaded in a process.
+* @param target The process.
+* @remarks Only reads what globals::selectedModules published, the snapshot worker scans the
+*  process about once a second and only while the section is open. A scan that finds the
+*  modules unchanged costs one read of the raw listing.
+*/
+void ModuleTable(const process::ProcessKey& target) {
+	// a new process is scanned right away instead of on the next tick
+	if (globals::selectedModules.Watch(target))
+		globals::processSnapshots.RequestRefresh();
+
+	const auto published = globals::selectedModules.Latest();
+	if (!published || published->key != target) {
+		ImGui::TextDisabled("Reading the modules of the process...");
+		return;
+	}
+	const std::shared_ptr<const process::ModuleList>& list = published->list;
+	if (!list) {
+		ImGui::TextDisabled("The modules of the process cannot be read");
+		return;
+	}
+	ImGui::Text("%zu modules", list->modules.size());
+
+	const ImGuiTableFlags tableFlags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersOuter | ImGuiTableFlags_Resizable;
+	if (!ImGui::BeginTable("Modules", 3, tableFlags, ImVec2(0, 160)))
+		return;
+
+	ImGui::TableSetupScrollFreeze(0, 1);
+	ImGui::TableSetupColumn("Base", ImGuiTableColumnFlags_WidthFixed);
+	ImGui::TableSetupColumn("Size", ImGuiTableColumnFlags_WidthFixed);
+	ImGui::TableSetupColumn("Path", ImGuiTableColumnFlags_WidthStretch);
+	ImGui::TableHeadersRow();
+
+	ImGuiListClipper clipper;
+	clipper.Begin(static_cast<int>(list->modules.size()));
+	while (clipper.Step()) {
+		for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+			const process::ModuleInfo& module = list->modules[row];
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Text("%016llx", static_cast<unsigned long long>(module.base));
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu KB", static_cast<unsigned long long>(module.size / 1024));
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(process::NamePool::Shared().View(module.path).data());
+		}
+	}
+	ImGui::EndTable();
 }
 
 /**
@@ -394,38 +584,130 @@ void gui::Render() noexcept
 
 	/* Select Process */
 
-	std::vector<DWORD> processIds = GetAllProcessIds();
-	std::vector<std::string> processNames;
-	for (DWORD processId : processIds) {
-		std::string processName = GetProcessName(processId);
-		if (processName.find("Error") == 0) {
-			continue;
+	// the process list is enumerated by the snapshot worker, the table only applies its changes
+	static gui::ProcessList processes;
+
+	processes.Update(globals::processSnapshots.Latest());
+
+	// look the selection up by identity, it is gone if the process exited
+	const process::ProcessInfo* selected = processes.Find(globals::selectedProcess);
+
+	if (selected) {
+		ImGui::Text("Target: %s (%u)", selected->name.data(), selected->pid);
+	}
+	else {
+		ImGui::Text("Select a process");
+	}
+
+	// which processes an injection goes to, resolved again whenever a new snapshot arrives
+	static std::vector<std::uint32_t> targetIndices;
+	static std::uint64_t targetGeneration = 0;
+	static char targetPattern[128] = { 0 };
+
+	int targetMode = static_cast<int>(globals::targets.mode);
+	bool targetsChanged = false;
+	targetsChanged |= ImGui::RadioButton("Selected", &targetMode, static_cast<int>(injection::TargetMode::Explicit));
+	ImGui::SameLine();
+	targetsChanged |= ImGui::RadioButton("Children", &targetMode, static_cast<int>(injection::TargetMode::Children));
+	ImGui::SameLine();
+	targetsChanged |= ImGui::RadioButton("Name", &targetMode, static_cast<int>(injection::TargetMode::NamePattern));
+	globals::targets.mode = static_cast<injection::TargetMode>(targetMode);
+
+	if (globals::targets.mode == injection::TargetMode::NamePattern) {
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(-1.0f);
+		if (ImGui::InputTextWithHint("##Pattern", "worker*.exe", targetPattern, sizeof(targetPattern))) {
+			globals::targets.pattern = targetPattern;
+			targetsChanged = true;
 		}
-		processNames.push_back(processName);
+	}
+	if (globals::targets.parent != globals::selectedProcess) {
+		globals::targets.parent = globals::selectedProcess;
+		targetsChanged = true;
+	}
+
+	// the explicit list changes with every click and is cheap to resolve
+	const auto latest = globals::processSnapshots.Latest();
+	if (targetsChanged || latest->generation != targetGeneration || globals::targets.mode == injection::TargetMode::Explicit) {
+		injection::SelectTargets(*latest, globals::targets, targetIndices);
+		targetGeneration = latest->generation;
 	}
 
-	// sort
-	std::sort(processNames.begin(), processNames.end(), compareStringsIgnoreCase);
+	// filter by name fragment, backed by the trigram index of the list
+	static char filter[128] = { 0 };
+	ImGui::SetNextItemWidth(-1.0f);
+	if (ImGui::InputTextWithHint("##Filter", "Filter processes", filter, sizeof(filter))) {
+		processes.SetFilter(filter);
+	}
 
-	// get all processes in dropdown
-	if (ImGui::BeginCombo("", globals::selectedProcessIndex >= 0 ? processNames[globals::selectedProcessIndex].c_str() : "Select a process")) {
-		for (int i = 0; i < processNames.size(); i++) {
-			bool isSelected = globals::selectedProcessIndex == i;
-			if (ImGui::Selectable(processNames[i].c_str(), isSelected)) {
-				globals::selectedProcessIndex = i;
+	// sortable table of all processes, only the visible rows are submitted
+	const ImGuiTableFlags tableFlags =
+		ImGuiTableFlags_Sortable |
+		ImGuiTableFlags_ScrollY |
+		ImGuiTableFlags_RowBg |
+		ImGuiTableFlags_BordersOuter |
+		ImGuiTableFlags_Resizable;
+
+	if (ImGui::BeginTable("Processes", 5, tableFlags, ImVec2(0, 200))) {
+		ImGui::TableSetupScrollFreeze(0, 1); // keep the header visible
+		ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_WidthStretch, 0.0f, static_cast<ImGuiID>(gui::ProcessColumn::Name));
+		ImGui::TableSetupColumn("PID", ImGuiTableColumnFlags_WidthFixed, 0.0f, static_cast<ImGuiID>(gui::ProcessColumn::Pid));
+		ImGui::TableSetupColumn("Parent", ImGuiTableColumnFlags_WidthFixed, 0.0f, static_cast<ImGuiID>(gui::ProcessColumn::Parent));
+		ImGui::TableSetupColumn("Arch", ImGuiTableColumnFlags_WidthFixed, 0.0f, static_cast<ImGuiID>(gui::ProcessColumn::Architecture));
+		ImGui::TableSetupColumn("Memory", ImGuiTableColumnFlags_WidthFixed, 0.0f, static_cast<ImGuiID>(gui::ProcessColumn::Memory));
+		ImGui::TableHeadersRow();
+
+		// the list only re-sorts when the spec actually changed
+		if (ImGuiTableSortSpecs* sortSpecs = ImGui::TableGetSortSpecs(); sortSpecs && sortSpecs->SpecsDirty) {
+			if (sortSpecs->SpecsCount > 0) {
+				const ImGuiTableColumnSortSpecs& spec = sortSpecs->Specs[0];
+				processes.SetSort(static_cast<gui::ProcessColumn>(spec.ColumnUserID), spec.SortDirection == ImGuiSortDirection_Descending);
 			}
-			if (isSelected) {
-				ImGui::SetItemDefaultFocus();
+			sortSpecs->SpecsDirty = false;
+		}
+
+		ImGuiListClipper clipper;
+		clipper.Begin(static_cast<int>(processes.Size()));
+		while (clipper.Step()) {
+			for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+				const process::ProcessInfo& entry = processes[row];
+
+				ImGui::PushID(static_cast<int>(entry.pid));
+				ImGui::TableNextRow();
+
+				ImGui::TableNextColumn();
+				if (ImGui::Selectable(entry.name.data(), IsTarget(entry), ImGuiSelectableFlags_SpanAllColumns)) {
+					// ctrl+click builds an explicit list of targets
+					auto& targets = globals::targets.targets;
+					const auto found = std::find(targets.begin(), targets.end(), entry.Key());
+					if (!ImGui::GetIO().KeyCtrl)
+						targets.assign(1, entry.Key());
+					else if (found != targets.end())
+						targets.erase(found);
+					else
+						targets.push_back(entry.Key());
+
+					globals::selectedProcess = entry.Key();
+					globals::selected_process_name = entry.nameId;
+					selected = &entry;
+				}
+
+				ImGui::TableNextColumn();
+				ImGui::Text("%u", entry.pid);
+				ImGui::TableNextColumn();
+				ImGui::Text("%u", entry.parentPid);
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(ArchitectureName(entry.architecture));
+				ImGui::TableNextColumn();
+				ImGui::Text("%.1f MB", static_cast<double>(entry.workingSet) / (1024.0 * 1024.0));
+
+				ImGui::PopID();
 			}
 		}
-		ImGui::EndCombo();
-	}	
 
-	if (globals::selectedProcessIndex >= 0 && globals::selectedProcessIndex < processNames.size()) {
-		globals::selected_process_name = processNames[globals::selectedProcessIndex];
-		globals::selectedProcessID = GetProcessIdByName(globals::selected_process_name);
+		ImGui::EndTable();
 	}
-	
+
 	ImGui::PushStyleColor(ImGuiCol_Separator, ImVec4(0.5f, 0.5f, 0.5f, 1.0f)); // Change the separator color to gray
 	ImGui::Separator();
 
@@ -476,21 +758,148 @@ void gui::Render() noexcept
 
 	/* Inject */
 
-	if (globals::selectedProcessIndex >= 0 && globals::isFileSelected) {
+	ImGui::Text("%zu target(s)", targetIndices.size());
+	ImGui::SameLine();
+
+	static int concurrency = static_cast<int>(globals::injectionQueue.GetConcurrency());
+	ImGui::SetNextItemWidth(100.0f);
+	if (ImGui::SliderInt("Parallel", &concurrency, 1, 8))
+		globals::injectionQueue.SetConcurrency(static_cast<std::size_t>(concurrency));
+
+	static int timeoutSeconds = static_cast<int>(std::chrono::duration_cast<std::chrono::seconds>(globals::injectionTimeout).count());
+	ImGui::SetNextItemWidth(120.0f);
+	if (ImGui::SliderInt("Timeout (s)", &timeoutSeconds, 1, 120))
+		globals::injectionTimeout = std::chrono::seconds(timeoutSeconds);
+
+	ImGui::SameLine();
+	ImGui::Checkbox("Batch", &globals::batchInjection);
+	ImGui::SameLine();
+	ImGui::Checkbox("Agent", &globals::agentInjection);
+	if (ImGui::IsItemHovered())
+		ImGui::SetTooltip("Keep a resident agent in each target, repeated injections then need no new thread");
+	ImGui::SameLine();
+	ImGui::Checkbox("Skip loaded", &globals::skipUnchanged);
+	if (ImGui::IsItemHovered())
+		ImGui::SetTooltip("Do not load DLLs again that a target already has, loaded by itself or from the same file content by us; reload changed ones");
+
+	if (!targetIndices.empty() && globals::isFileSelected) {
+		ImGui::SameLine();
 		if (ImGui::Button("Inject")) {
 			inject_dll();
 		}
 	}
 
-	/* messages */
-	
-	if (globals::isDllInjected) {
-		ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "DLL (%s) injected \nsuccessfully to '%s' ",globals::lastInjected.c_str(), processNames[globals::selectedProcessIndex].c_str());
+	/* modules of the selected process, what a job with "Skip loaded" would not load again */
+
+	if (selected && ImGui::CollapsingHeader("Modules")) {
+		ModuleTable(globals::selectedProcess);
+	}
+	else {
+		globals::selectedModules.Watch({ });
 	}
-	else if (!globals::error_msg.empty()) {
-		ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "DLL injection failed:\n%s", globals::error_msg.c_str());
+
+	/* watch rules, the selected DLLs go into every new process matching a pattern */
+
+	if (ImGui::CollapsingHeader("Watch")) {
+		static char watchPattern[128] = { 0 };
+		ImGui::SetNextItemWidth(200.0f);
+		ImGui::InputTextWithHint("##WatchPattern", "worker*.exe", watchPattern, sizeof(watchPattern));
+
+		if (watchPattern[0] != '\0' && globals::isFileSelected) {
+			ImGui::SameLine();
+			if (ImGui::SmallButton("Watch")) {
+				injection::WatchRule rule;
+				rule.pattern = watchPattern;
+				rule.timeout = globals::injectionTimeout;
+				rule.batched = globals::batchInjection;
+				for (const std::string& path : globals::dll_paths) {
+					if (!path.empty())
+						rule.libraries.push_back(path);
+				}
+				globals::processWatch.AddRule(std::move(rule));
+			}
+		}
+
+		ImGui::SameLine();
+		ImGui::TextDisabled("source: %s", process::SpawnSourceName(globals::processWatch.Source()));
+
+		static std::vector<injection::WatchRule> rules;
+		globals::processWatch.Rules(rules);
+		for (const injection::WatchRule& rule : rules) {
+			ImGui::PushID(static_cast<int>(rule.id));
+			ImGui::Text("%s: %zu DLL(s), %llu match(es)", rule.pattern.c_str(), rule.libraries.size(), static_cast<unsigned long long>(rule.matched));
+			ImGui::SameLine();
+			if (ImGui::SmallButton("Remove"))
+				globals::processWatch.RemoveRule(rule.id);
+			ImGui::PopID();
+		}
+
+		// spawn to injected, the rest of the phases are in the latency table
+		const injection::LatencySummary spawn = injection::InjectionMetrics::Shared().Histogram(injection::InjectionPhase::Spawn).Summarize();
+		if (spawn.count != 0)
+			ImGui::Text("Spawn to injected: p50 %.2f ms, p99 %.2f ms over %llu", spawn.p50 / 1e6, spawn.p99 / 1e6, static_cast<unsigned long long>(spawn.count));
 	}
 
+	/* latency of every injection phase, recorded by the workers */
+
+	if (ImGui::CollapsingHeader("Latency")) {
+		static std::string dumpStatus;
+		if (ImGui::SmallButton("Dump")) {
+			const char* dumpPath = "injectify_latency.txt";
+			dumpStatus = injection::InjectionMetrics::Shared().DumpToFile(dumpPath) ? std::string("Written to ") + dumpPath : std::string("Could not write ") + dumpPath;
+		}
+		ImGui::SameLine();
+		if (ImGui::SmallButton("Reset")) {
+			injection::InjectionMetrics::Shared().Reset();
+			dumpStatus.clear();
+		}
+		if (!dumpStatus.empty()) {
+			ImGui::SameLine();
+			ImGui::TextUnformatted(dumpStatus.c_str());
+		}
+
+		LatencyTable();
+	}
+
+	/* jobs, updated by the injection workers while they run */
+
+	static std::vector<std::shared_ptr<injection::InjectionGroup>> groups;
+	globals::injectionQueue.RecentGroups(groups);
+
+	ImGui::BeginChild("Jobs", ImVec2(0, 0), true);
+
+	for (const auto& group : groups) {
+		const auto& jobs = group->Jobs();
+		if (jobs.size() == 1) {
+			JobLine(*jobs.front());
+			continue;
+		}
+
+		const injection::GroupStats stats = group->Stats();
+
+		ImGui::PushID(static_cast<int>(group->Id()) | 0x40000000);
+		const bool open = ImGui::TreeNode("Group", "%zu targets: %zu ok, %zu failed, %zu left | %.1f/s, p50 %.0f ms, p95 %.0f ms",
+			stats.total, stats.succeeded, stats.failed, stats.queued + stats.running, stats.throughput, stats.latencyP50Ms, stats.latencyP95Ms);
+
+		if (!group->Finished()) {
+			ImGui::SameLine();
+			if (ImGui::SmallButton("Cancel all"))
+				group->Cancel();
+		}
+
+		if (open) {
+			ImGuiListClipper clipper;
+			clipper.Begin(static_cast<int>(jobs.size()));
+			while (clipper.Step()) {
+				for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+					JobLine(*jobs[i]);
+			}
+			ImGui::TreePop();
+		}
+		ImGui::PopID();
+	}
+	ImGui::EndChild();
+
 
 	ImGui::End();
 }
@@ -10,8 +10,8 @@
 namespace gui
 {
 	// constant window size
-	constexpr int WIDTH = 350;
-	constexpr int HEIGHT = 370;
+	constexpr int WIDTH = 420;
+	constexpr int HEIGHT = 560;
 
 	// variable to keep track of whether the GUI is running
 	inline bool isRunning = true;
@@ -0,0 +1,220 @@
+/**
+ * @file process_list.cpp
+ * @brief Implements the incrementally updated process list.
+ */
+
+#include "process_list.h"
+#include "../process/snapshot_diff.h"
+
+#include <algorithm>
+
+/**
+* @brief Brings the list up to date with the latest snapshot.
+* @param latest The latest published snapshot.
+* @return True if the rows changed, false if latest is the snapshot the list already shows.
+*/
+bool gui::ProcessList::Update(std::shared_ptr<const process::ProcessSnapshot> latest)
+{
+	if (latest == snapshot)
+		return false;
+
+	const auto previous = std::move(snapshot);
+	snapshot = std::move(latest);
+
+	if (!previous || snapshot->generation != previous->generation + 1 || !ApplyChanges(*previous))
+		Rebuild();
+
+	searchIndex.Update(snapshot);
+	ApplyFilter();
+	return true;
+}
+
+/**
+* @brief Changes the column and direction the rows are sorted by.
+* @param column The sort column.
+* @param descending Whether to sort from largest to smallest.
+*/
+void gui::ProcessList::SetSort(ProcessColumn column, bool descending)
+{
+	if (column == sortColumn && descending == sortDescending)
+		return;
+
+	sortColumn = column;
+	sortDescending = descending;
+
+	if (snapshot) {
+		Rebuild();
+		ApplyFilter();
+	}
+}
+
+/**
+* @brief Restricts the list to processes whose name contains a text.
+* @param text The text to search for, case is ignored. Empty shows every process.
+*/
+void gui::ProcessList::SetFilter(std::string_view text)
+{
+	if (text == filter)
+		return;
+
+	filter = text;
+	ApplyFilter();
+}
+
+/**
+* @brief Finds a listed process by identity.
+* @param key The pid and start time of the process.
+* @return The entry, or nullptr if the process exited or is not shown.
+*/
+const process::ProcessInfo* gui::ProcessList::Find(const process::ProcessKey& key) const noexcept
+{
+	if (!snapshot)
+		return nullptr;
+
+	const process::ProcessInfo* info = snapshot->Find(key);
+	return info && info->accessible ? info : nullptr;
+}
+
+/**
+* @brief Rebuilds and sorts all rows from scratch.
+*/
+void gui::ProcessList::Rebuild()
+{
+	rows.clear();
+	rows.reserve(snapshot->processes.size());
+	for (std::uint32_t i = 0; i < snapshot->processes.size(); i++) {
+		// hide processes we could not open, they cannot be injected into
+		if (snapshot->processes[i].accessible)
+			rows.push_back(i);
+	}
+
+	// sort
+	std::sort(rows.begin(), rows.end(), [this](std::uint32_t a, std::uint32_t b) { return Less(a, b); });
+}
+
+/**
+* @brief Applies the diff of the current snapshot to rows built from the previous one.
+* @param previous The snapshot rows currently refers to.
+* @return False if there are so many changes that a rebuild is cheaper, rows is untouched in that case.
+* @remarks Surviving rows keep their relative order, so they are only re-indexed. Added processes,
+*  and changed ones whose sort key or accessibility differs, are inserted at their sorted position.
+*/
+bool gui::ProcessList::ApplyChanges(const process::ProcessSnapshot& previous)
+{
+	// memory changes without producing events, the order has to be recomputed
+	if (sortColumn == ProcessColumn::Memory)
+		return false;
+
+	const auto& events = snapshot->changes;
+	if (events.size() > rows.size() / 4 + 16)
+		return false;
+
+	process::BuildIndexRemap(previous.processes.size(), events, remap);
+
+	pending.clear();
+	for (const process::ProcessEvent& event : events) {
+		if (event.type == process::ProcessEventType::Removed)
+			continue;
+
+		const process::ProcessInfo& after = snapshot->processes[event.currentIndex];
+		if (event.type == process::ProcessEventType::Changed) {
+			const process::ProcessInfo& before = previous.processes[event.previousIndex];
+			if (SameSortKey(before, after) && before.accessible == after.accessible)
+				continue;
+
+			// drop the old row, it is re-inserted below if still visible
+			remap[event.previousIndex] = process::ProcessEvent::npos;
+		}
+
+		if (after.accessible)
+			pending.push_back(event.currentIndex);
+	}
+
+	std::size_t kept = 0;
+	for (std::uint32_t row : rows) {
+		const std::uint32_t index = remap[row];
+		if (index != process::ProcessEvent::npos)
+			rows[kept++] = index;
+	}
+	rows.resize(kept);
+
+	for (std::uint32_t index : pending) {
+		const auto position = std::upper_bound(rows.begin(), rows.end(), index, [this](std::uint32_t a, std::uint32_t b) { return Less(a, b); });
+		rows.insert(position, index);
+	}
+
+	return true;
+}
+
+/**
+* @brief Recomputes the filtered rows from the search index.
+* @remarks The index returns the matching snapshot entries, a pass over the sorted rows then
+*  keeps the display order. Both steps are linear at most, so this fits in a frame.
+*/
+void gui::ProcessList::ApplyFilter()
+{
+	if (filter.empty() || !snapshot)
+		return;
+
+	searchIndex.Search(filter, matches);
+
+	matchMask.assign(snapshot->processes.size(), 0);
+	for (std::uint32_t index : matches)
+		matchMask[index] = 1;
+
+	filtered.clear();
+	for (std::uint32_t index : rows) {
+		if (matchMask[index])
+			filtered.push_back(index);
+	}
+}
+
+/**
+* @brief Display order: the sort column, then pid so equal keys have a stable order.
+*/
+bool gui::ProcessList::Less(std::uint32_t a, std::uint32_t b) const noexcept
+{
+	const process::ProcessInfo& left = sortDescending ? snapshot->processes[b] : snapshot->processes[a];
+	const process::ProcessInfo& right = sortDescending ? snapshot->processes[a] : snapshot->processes[b];
+
+	switch (sortColumn) {
+	case ProcessColumn::Name:
+		// keys are folded once per snapshot, so this is a plain memcmp
+		// equal handles are equal names, the compare is only needed for different ones
+		if (left.nameId != right.nameId) {
+			if (const int order = left.sortKey.compare(right.sortKey); order != 0)
+				return order < 0;
+		}
+		break;
+	case ProcessColumn::Pid:
+		break;
+	case ProcessColumn::Parent:
+		if (left.parentPid != right.parentPid)
+			return left.parentPid < right.parentPid;
+		break;
+	case ProcessColumn::Architecture:
+		if (left.architecture != right.architecture)
+			return left.architecture < right.architecture;
+		break;
+	case ProcessColumn::Memory:
+		if (left.workingSet != right.workingSet)
+			return left.workingSet < right.workingSet;
+		break;
+	}
+	return left.pid < right.pid;
+}
+
+/**
+* @brief Checks whether two entries of the same process sort to the same position.
+*/
+bool gui::ProcessList::SameSortKey(const process::ProcessInfo& a, const process::ProcessInfo& b) const noexcept
+{
+	switch (sortColumn) {
+	case ProcessColumn::Name: return a.nameId == b.nameId;
+	case ProcessColumn::Pid: return true;
+	case ProcessColumn::Parent: return a.parentPid == b.parentPid;
+	case ProcessColumn::Architecture: return a.architecture == b.architecture;
+	case ProcessColumn::Memory: return a.workingSet == b.workingSet;
+	}
+	return false;
+}
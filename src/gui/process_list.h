@@ -0,0 +1,82 @@
+/**
+
+@file process_list.h
+@brief Sorted view of the latest process snapshot, kept up to date incrementally.
+*/
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../process/process_snapshot.h"
+#include "../process/search_index.h"
+
+namespace gui
+{
+	/**
+	* @brief Columns the process table can be sorted by, also used as the ImGui column user ids.
+	*/
+	enum class ProcessColumn : int
+	{
+		Name,
+		Pid,
+		Parent,
+		Architecture,
+		Memory,
+	};
+
+	/**
+	* @brief The injectable processes of a snapshot in display order.
+	* @remarks The order is only recomputed when the sort spec or the snapshot changes. When a
+	*  snapshot directly follows the one the list was built from, its diff is applied instead
+	*  of rebuilding and re-sorting the whole list.
+	*/
+	class ProcessList
+	{
+	public:
+		// brings the list up to date, returns true if the snapshot changed
+		bool Update(std::shared_ptr<const process::ProcessSnapshot> latest);
+
+		// changes the sort order, re-sorts only if it differs from the current one
+		void SetSort(ProcessColumn column, bool descending);
+
+		// only shows processes whose name contains text, ignoring case, empty shows all
+		void SetFilter(std::string_view text);
+
+		std::size_t Size() const noexcept { return Visible().size(); }
+		const process::ProcessInfo& operator[](std::size_t row) const noexcept { return snapshot->processes[Visible()[row]]; }
+
+		// O(1) lookup of a listed process by identity, nullptr if it exited or is hidden
+		const process::ProcessInfo* Find(const process::ProcessKey& key) const noexcept;
+
+	private:
+		void Rebuild();
+		bool ApplyChanges(const process::ProcessSnapshot& previous);
+		bool Less(std::uint32_t a, std::uint32_t b) const noexcept;
+		bool SameSortKey(const process::ProcessInfo& a, const process::ProcessInfo& b) const noexcept;
+		void ApplyFilter();
+		const std::vector<std::uint32_t>& Visible() const noexcept { return filter.empty() ? rows : filtered; }
+
+		std::shared_ptr<const process::ProcessSnapshot> snapshot;
+
+		ProcessColumn sortColumn = ProcessColumn::Name;
+		bool sortDescending = false;
+
+		// indices into snapshot->processes in display order
+		std::vector<std::uint32_t> rows;
+
+		// rows matching the filter, in display order
+		std::string filter;
+		std::vector<std::uint32_t> filtered;
+		process::NameSearchIndex searchIndex;
+
+		// scratch buffers kept between updates
+		std::vector<std::uint32_t> remap;
+		std::vector<std::uint32_t> pending;
+		std::vector<std::uint32_t> matches;
+		std::vector<std::uint8_t> matchMask;
+	};
+}
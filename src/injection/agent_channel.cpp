@@ -0,0 +1,371 @@
+/**
+ * @file agent_channel.cpp
+ * @brief Platform independent parts of the agent ring.
+ */
+
+#include "agent_channel.h"
+
+#include "injection_metrics.h"
+#include "payload_graph.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h> // _mm_pause
+#endif
+
+namespace
+{
+	// completions are polled this long before sleeping, most commands that do not load anything finish within it
+	constexpr std::chrono::microseconds SpinTime(20);
+
+	std::uint32_t Load(const std::uint32_t& field) noexcept
+	{
+		return std::atomic_ref<std::uint32_t>(const_cast<std::uint32_t&>(field)).load(std::memory_order_acquire);
+	}
+
+	void Store(std::uint32_t& field, std::uint32_t value) noexcept
+	{
+		std::atomic_ref<std::uint32_t>(field).store(value, std::memory_order_release);
+	}
+
+	// whether command ticket is done with tail at the given value, correct across wrap around
+	bool Completed(std::uint32_t tail, std::uint32_t ticket) noexcept
+	{
+		return static_cast<std::int32_t>(tail - ticket) > 0;
+	}
+
+	/**
+	* @brief Ends a job with an error.
+	*/
+	injection::InjectionResult Fail(injection::InjectionResult& result, injection::JobState state, const char* error)
+	{
+		result.state = state;
+		result.error = error ? error : "";
+		return std::move(result);
+	}
+
+	/**
+	* @brief Ends a job with an error about one of its payloads, named by its file name.
+	*/
+	injection::InjectionResult FailPayload(injection::InjectionResult& result, const std::string& library, const char* error)
+	{
+		const std::size_t name = library.find_last_of("\\/");
+		result.state = injection::JobState::Failed;
+		result.error = (name == std::string::npos ? library : library.substr(name + 1)) + ": " + error;
+		return std::move(result);
+	}
+}
+
+/**
+* @brief Unmaps the region, the agent keeps its own view.
+*/
+injection::AgentChannel::~AgentChannel()
+{
+	Close();
+}
+
+/**
+* @brief Counts the slots the agent is done with.
+*/
+std::uint32_t injection::AgentChannel::Free() const noexcept
+{
+	return AgentSlotCount - (pushed - Load(reinterpret_cast<const AgentControl*>(view)->tail));
+}
+
+/**
+* @brief Fills the next slot.
+* @param command What to do.
+* @param argument Module or function.
+* @param parameter Argument of the function.
+* @param path Library to load.
+* @param ticket Receives the number of the command.
+* @return False if the ring is full or the path does not fit.
+*/
+bool injection::AgentChannel::Push(AgentCommand command, std::uint64_t argument, std::uint64_t parameter, std::string_view path, std::uint32_t& ticket) noexcept
+{
+	AgentSlot& slot = SlotAt(pushed);
+	if (Free() == 0 || path.size() >= sizeof(slot.path))
+		return false;
+
+	slot.command = command;
+	slot.argument = argument;
+	slot.parameter = parameter;
+	slot.value = 0;
+	slot.error = 0;
+	std::memcpy(slot.path, path.data(), path.size());
+	slot.path[path.size()] = '\0';
+
+	ticket = pushed++;
+	return true;
+}
+
+/**
+* @brief Publishes the pushed commands, then wakes the agent.
+* @remarks The agent checks head before it sleeps and the futex or event remembers a wake up
+*  that comes in between, so none is lost.
+*/
+void injection::AgentChannel::Ring() noexcept
+{
+	Store(Control().head, pushed);
+	Wake();
+}
+
+/**
+* @brief Waits for the agent to complete a command.
+* @param ticket From Push().
+* @param deadline When to give up, the command may still run afterwards.
+* @return False on timeout or if the agent exited.
+*/
+bool injection::AgentChannel::Wait(std::uint32_t ticket, std::chrono::steady_clock::time_point deadline) noexcept
+{
+	const AgentControl& control = Control();
+	const auto spinUntil = std::chrono::steady_clock::now() + SpinTime;
+
+	for (;;) {
+		const std::uint32_t tail = Load(control.tail);
+		if (Completed(tail, ticket))
+			return true;
+		if (Load(control.exited))
+			return false;
+
+		const auto now = std::chrono::steady_clock::now();
+		if (now >= deadline)
+			return false;
+
+		if (now < spinUntil) {
+#if defined(_M_X64) || defined(__x86_64__)
+			_mm_pause();
+#endif
+			continue;
+		}
+		Sleep(tail, deadline);
+	}
+}
+
+/**
+* @brief Gets the slot of a command.
+*/
+const injection::AgentSlot& injection::AgentChannel::Slot(std::uint32_t ticket) const noexcept
+{
+	return SlotAt(ticket);
+}
+
+/**
+* @brief Waits for the agent to free a slot.
+* @param deadline When to give up.
+* @return False on timeout or if the agent exited.
+*/
+bool injection::AgentChannel::WaitFree(std::chrono::steady_clock::time_point deadline) noexcept
+{
+	return Free() > 0 || Wait(pushed - AgentSlotCount, deadline);
+}
+
+/**
+* @brief Runs one command to completion.
+* @param command What to do.
+* @param argument Module or function.
+* @param parameter Argument of the function.
+* @param deadline When to give up, the command may still run afterwards.
+* @param value Receives the result.
+* @return Null on success, otherwise the error.
+*/
+const char* injection::AgentChannel::Run(AgentCommand command, std::uint64_t argument, std::uint64_t parameter, std::chrono::steady_clock::time_point deadline, std::uint64_t& value) noexcept
+{
+	if (Exited())
+		return "No agent runs in the process";
+
+	std::uint32_t ticket = 0;
+	if (!WaitFree(deadline) || !Push(command, argument, parameter, { }, ticket))
+		return "The agent is still busy with earlier commands";
+	Ring();
+
+	if (!Wait(ticket, deadline))
+		return Exited() ? "The agent has exited" : "The agent did not answer before the deadline";
+
+	value = Slot(ticket).value;
+	return nullptr;
+}
+
+/**
+* @brief Asks the agent to exit, without waiting for it.
+*/
+void injection::AgentChannel::RequestStop() noexcept
+{
+	if (!view)
+		return;
+
+	Store(Control().stop, 1);
+	Wake();
+}
+
+/**
+* @brief Checks whether the agent thread has returned.
+*/
+bool injection::AgentChannel::Exited() const noexcept
+{
+	return !view || Load(reinterpret_cast<const AgentControl*>(view)->exited) != 0;
+}
+
+injection::AgentSlot& injection::AgentChannel::SlotAt(std::uint32_t ticket) const noexcept
+{
+	return reinterpret_cast<AgentSlot*>(view + AgentSlotsOffset)[ticket & (AgentSlotCount - 1)];
+}
+
+/**
+* @brief Loads every library of a job through the agent.
+* @param job The job, Begin() must have been called.
+* @param channel The ring of the target's agent.
+* @param result Receives the outcome.
+* @return The outcome of the job.
+* @remarks The agent takes the commands in the order they are pushed, so libraries load in the
+*  order of the request, which puts every payload after the payloads it imports.
+*/
+injection::InjectionResult injection::LoadThroughAgent(InjectionJob& job, AgentChannel& channel, InjectionResult& result)
+{
+	const InjectionRequest& request = job.Planned();
+	const std::size_t count = request.libraries.size();
+	result.libraries.resize(count);
+
+	for (const std::string& library : request.libraries) {
+		if (library.size() >= sizeof(AgentSlot::path))
+			return Fail(result, JobState::Failed, "A library path is too long for the agent");
+	}
+
+	std::vector<std::uint32_t> tickets;
+	std::string firstError;
+
+	for (std::size_t next = 0; next < count;) {
+		if (job.CancelRequested())
+			return Fail(result, JobState::Cancelled, nullptr);
+
+		// the agent loads in ring order, unbatched it is rung once per wave of independent payloads
+		const std::size_t perRing = request.batched ? AgentSlotCount : std::min<std::size_t>(WaveEnd(request, next) - next, AgentSlotCount);
+
+		job.SetPhase(JobPhase::WritingPath, next);
+
+		// the slots are in the target already, filling them is all the writing there is
+		injection::PhaseTimer writeTimer(injection::InjectionPhase::Write);
+		tickets.clear();
+		while (next + tickets.size() < count && tickets.size() < perRing) {
+			const std::string& library = request.libraries[next + tickets.size()];
+			std::uint32_t ticket = 0;
+			if (!channel.WaitFree(job.Deadline()))
+				break;
+			if (!channel.Push(AgentCommand::Load, 0, 0, library, ticket))
+				break;
+			tickets.push_back(ticket);
+			result.bytesWritten += library.size() + 1;
+		}
+		if (tickets.empty())
+			return Fail(result, channel.Exited() ? JobState::Failed : JobState::TimedOut, "The agent is still busy with earlier commands");
+		writeTimer.Stop();
+
+		// from the doorbell on, the agent often finishes before the wake up call returns
+		injection::PhaseTimer loadTimer(injection::InjectionPhase::Load);
+		channel.Ring();
+		for (std::uint32_t ticket : tickets) {
+			job.SetPhase(JobPhase::Loading, next);
+
+			if (!channel.Wait(ticket, job.Deadline())) {
+				if (channel.Exited())
+					return Fail(result, JobState::Failed, "The agent has exited");
+				return Fail(result, JobState::TimedOut, "The libraries did not load before the deadline");
+			}
+
+			const AgentSlot& slot = channel.Slot(ticket);
+			LibraryResult& library = result.libraries[next++];
+			library.module = slot.value;
+			if (slot.value != 0) {
+				++result.loaded;
+				continue;
+			}
+
+#ifdef _WIN32
+			library.error = static_cast<std::uint32_t>(slot.error);
+#else
+			// dlopen has no error code, the agent left the message in the slot
+			library.error = 1;
+			if (firstError.empty())
+				firstError.assign(slot.path, strnlen(slot.path, sizeof(slot.path)));
+#endif
+		}
+	}
+
+	if (result.loaded != count) {
+		std::string error = std::to_string(count - result.loaded) + " of " + std::to_string(count) + " libraries failed to load";
+		if (!firstError.empty())
+			error += ": " + firstError;
+		return Fail(result, JobState::Failed, error.c_str());
+	}
+
+	result.state = JobState::Succeeded;
+	return std::move(result);
+}
+
+/**
+* @brief Runs a job against the session of its target, shared by the platform backends.
+* @param job The job, Begin() and Plan() must have been called.
+* @param mutex The mutex of the target's session, held until the job ends.
+* @param payloads The session's record of the payloads our jobs loaded.
+* @param load The backend's LoadIntoTarget(), called with the mutex held.
+* @return The outcome of the job.
+* @remarks With skipUnchanged the payloads are fingerprinted first (see PayloadCache). A job
+*  whose libraries the target has all loaded (from the same content, if our jobs loaded them)
+*  is done without touching it, the target's module list is read to tell (see ModuleCache);
+*  otherwise the modules of changed files are handed to the backend to unload before the
+*  libraries are loaded again, and what was loaded is recorded.
+*
+*  Imports no payload provides are looked for in the target's modules and ld.so's search path
+*  before anything is written into the target (see CheckDependencies()). A job skipped as
+*  unchanged loads nothing and is not checked.
+*/
+injection::InjectionResult injection::ExecuteInSession(InjectionJob& job, std::mutex& mutex, LoadedPayloads& payloads, const SessionLoader& load)
+{
+	const InjectionRequest& request = job.Planned();
+	InjectionResult result;
+
+	std::vector<PayloadFingerprint> fingerprints;
+	if (request.skipUnchanged) {
+		const char* error = nullptr;
+		if (const std::size_t bad = FingerprintPayloads(request.libraries, fingerprints, error); bad != request.libraries.size())
+			return FailPayload(result, request.libraries[bad], error);
+	}
+
+	job.SetPhase(JobPhase::OpeningProcess, 0);
+	std::lock_guard lock(mutex);
+
+	std::shared_ptr<const process::ModuleList> modules;
+	if (request.skipUnchanged || !request.dependencies.empty())
+		modules = process::ModuleCache::Shared().Get(request.target);
+
+	std::string missing;
+	if (!request.skipUnchanged) {
+		if (!CheckDependencies(request, modules.get(), missing))
+			return Fail(result, JobState::Failed, missing.c_str());
+		return load({ }, result);
+	}
+
+	// what the target loaded or unloaded by itself counts as much as what our jobs did
+	if (modules)
+		payloads.Prune(*modules);
+
+	// the files were checked when they were loaded, unchanged content needs no second look
+	if (payloads.AllUnchanged(request.libraries, fingerprints, modules.get(), result))
+		return result;
+
+	if (!CheckDependencies(request, modules.get(), missing))
+		return Fail(result, JobState::Failed, missing.c_str());
+
+	std::vector<StaleModule> stale;
+	payloads.Stale(request.libraries, fingerprints, stale);
+
+	InjectionResult outcome = load(stale, result);
+	payloads.Record(request.libraries, fingerprints, outcome);
+	return outcome;
+}
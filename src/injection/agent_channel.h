@@ -0,0 +1,215 @@
+/**
+
+@file agent_channel.h
+@brief Command ring shared with the resident agent in a target process.
+*/
+
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include "injection_job.h"
+#include "payload_cache.h"
+#include "remote_memory.h"
+
+namespace injection
+{
+	/**
+	* @brief What the agent is asked to do with a slot.
+	*/
+	enum class AgentCommand : std::uint32_t
+	{
+		Load = 1,   // value = dlopen(path, RTLD_NOW) / LoadLibraryA(path)
+		Unload = 2, // value = dlclose(argument) / FreeLibrary(argument)
+		Call = 3,   // value = argument(parameter)
+	};
+
+	/**
+	* @brief Start of the shared region, offsets are hard coded in the agent code.
+	* @remarks head is only written by us and tail only by the agent, each on a cache line of its
+	*  own. Both are free running counters, the slot of command n is n & mask. The rest is filled
+	*  in once before the agent starts.
+	*/
+	struct AgentControl
+	{
+		std::uint32_t head;     // commands submitted, the agent sleeps on it
+		std::uint32_t stop;     // the agent returns once it finds the ring empty
+		std::uint8_t padding0[56];
+
+		std::uint32_t tail;     // commands completed, we sleep on it
+		std::uint32_t exited;   // set by the agent just before it returns
+		std::uint8_t padding1[56];
+
+		std::uint32_t mask;     // number of slots - 1
+		std::uint32_t reserved;
+		std::uint64_t load;       // dlopen / LoadLibraryA
+		std::uint64_t lastError;  // dlerror / GetLastError
+		std::uint64_t unload;     // dlclose / FreeLibrary
+		std::uint64_t wait;       // Windows: WaitForSingleObject
+		std::uint64_t signal;     // Windows: SetEvent
+		std::uint64_t doorbell;   // Windows: event the agent waits on, a handle in the target
+		std::uint64_t completion; // Windows: event the agent sets after every command
+		std::uint64_t thread;     // Linux: pthread_t of the agent
+	};
+
+	/**
+	* @brief One command and its result.
+	*/
+	struct AgentSlot
+	{
+		AgentCommand command;
+		std::uint32_t reserved;
+		std::uint64_t argument;  // module to unload or function to call
+		std::uint64_t parameter; // argument of the function
+		std::uint64_t value;     // written by the agent: module, return value
+		std::uint64_t error;     // written by the agent after a failed load: GetLastError() / dlerror()
+
+		// NUL terminated library path; on Linux the agent copies the dlerror() message over it
+		char path[4096 - 40];
+	};
+
+	// the control block takes the first page, every slot a page of its own
+	constexpr std::size_t AgentSlotsOffset = 4096;
+	constexpr std::uint32_t AgentSlotCount = 16;
+	constexpr std::size_t AgentRegionSize = AgentSlotsOffset + AgentSlotCount * sizeof(AgentSlot);
+
+	static_assert(sizeof(AgentSlot) == 4096 && offsetof(AgentSlot, path) == 0x28, "layout is hard coded in the agent code");
+	static_assert(offsetof(AgentControl, tail) == 0x40 && offsetof(AgentControl, mask) == 0x80 && offsetof(AgentControl, load) == 0x88 &&
+		offsetof(AgentControl, completion) == 0xB8 && sizeof(AgentControl) <= AgentSlotsOffset, "layout is hard coded in the agent code");
+	static_assert((AgentSlotCount & (AgentSlotCount - 1)) == 0, "the slot index is a mask");
+
+	/**
+	* @brief Our side of the ring of one agent: submits commands and waits for their completion.
+	* @remarks The region is mapped into both processes, commands and results never go through
+	*  ReadProcessMemory or process_vm_readv. A single producer (the caller, who must serialize
+	*  access, e.g. with the target session's mutex) and a single consumer (the agent thread) need
+	*  no locks: a command is written into its slot before head is advanced with release
+	*  semantics, the agent writes the result before advancing tail. The doorbell is a futex on
+	*  head (Linux) or an auto-reset event (Windows), rung once per batch of commands; completions
+	*  are polled for a few microseconds before sleeping on tail or the completion event.
+	*/
+	class AgentChannel
+	{
+	public:
+		AgentChannel() noexcept = default;
+		~AgentChannel();
+
+		AgentChannel(const AgentChannel&) = delete;
+		AgentChannel& operator=(const AgentChannel&) = delete;
+
+#ifdef _WIN32
+		/**
+		* @brief Creates the region and the events and maps them into the target.
+		* @param process The target, needs PROCESS_DUP_HANDLE and PROCESS_VM_OPERATION access.
+		* @param remote Receives the address of the region in the target.
+		* @return Null on success, otherwise the error.
+		*/
+		const char* Create(RemoteProcess process, std::uint64_t& remote);
+#else
+		/**
+		* @brief Maps a region the target created, through /proc/<pid>/fd.
+		* @param process The target.
+		* @param descriptor The target's descriptor of the region (a memfd), still open.
+		* @return Null on success, otherwise the error.
+		*/
+		const char* Map(RemoteProcess process, int descriptor);
+#endif
+
+		bool Attached() const noexcept { return view != nullptr; }
+
+		// our view of the control block, for filling it in before the agent starts
+		AgentControl& Control() noexcept { return *reinterpret_cast<AgentControl*>(view); }
+
+		// commands that can be pushed without waiting for the agent
+		std::uint32_t Free() const noexcept;
+
+		/**
+		* @brief Writes a command into the next slot, the agent sees it after Ring().
+		* @param path Copied into the slot, only used by Load.
+		* @param ticket Receives the number of the command, for Wait() and Slot().
+		* @return False if the ring is full or the path does not fit.
+		*/
+		bool Push(AgentCommand command, std::uint64_t argument, std::uint64_t parameter, std::string_view path, std::uint32_t& ticket) noexcept;
+
+		// publishes everything pushed so far and wakes the agent up
+		void Ring() noexcept;
+
+		/**
+		* @brief Waits until a command has completed.
+		* @return False if the deadline passed or the agent has exited first.
+		*/
+		bool Wait(std::uint32_t ticket, std::chrono::steady_clock::time_point deadline) noexcept;
+
+		// the slot of a completed command, valid until more commands than slots are pushed after it
+		const AgentSlot& Slot(std::uint32_t ticket) const noexcept;
+
+		// waits until at least one slot is free, commands of timed out jobs may still occupy them
+		bool WaitFree(std::chrono::steady_clock::time_point deadline) noexcept;
+
+		/**
+		* @brief Submits a single command and waits for it.
+		* @param value Receives what the agent returned.
+		* @return Null on success, otherwise the error.
+		*/
+		const char* Run(AgentCommand command, std::uint64_t argument, std::uint64_t parameter, std::chrono::steady_clock::time_point deadline, std::uint64_t& value) noexcept;
+
+		// asks the agent to return once the ring is empty
+		void RequestStop() noexcept;
+		bool Exited() const noexcept;
+
+		// platform part: unmaps our view and closes our handles, the agent keeps its own
+		void Close() noexcept;
+
+	private:
+		// platform part: wakes the agent, sleeps until tail moves away from seen or the deadline
+		void Wake() noexcept;
+		void Sleep(std::uint32_t seen, std::chrono::steady_clock::time_point deadline) noexcept;
+
+		AgentSlot& SlotAt(std::uint32_t ticket) const noexcept;
+
+		unsigned char* view = nullptr;
+
+		// commands pushed, published to the agent by Ring()
+		std::uint32_t pushed = 0;
+
+#ifdef _WIN32
+		void* section = nullptr;
+		void* doorbell = nullptr;
+		void* completion = nullptr;
+#endif
+	};
+
+	/**
+	* @brief Loads the libraries of a job through a running agent, shared by the platform backends.
+	* @param job The job.
+	* @param channel The ring of the target's agent, the caller holds the session.
+	* @param result Receives the outcome.
+	* @return The outcome of the job.
+	* @remarks Batched jobs submit up to a ring full of libraries with a single doorbell,
+	*  unbatched jobs one wave of independent payloads per doorbell (see InjectionRequest::waves),
+	*  so a cancel takes effect before the next wave. Commands
+	*  still running at the deadline are completed by the agent later, their slots are reused
+	*  only once it has.
+	*/
+	InjectionResult LoadThroughAgent(InjectionJob& job, AgentChannel& channel, InjectionResult& result);
+
+	// loads the libraries of a job into its target once the session is locked, given the modules to unload first
+	using SessionLoader = std::function<InjectionResult(const std::vector<StaleModule>& stale, InjectionResult& result)>;
+
+	/**
+	* @brief Does the part of Execute() shared by the platform backends.
+	* @param job The job, Begin() and Plan() must have been called.
+	* @param mutex The mutex of the target's session, held until the job ends.
+	* @param payloads The session's record of the payloads our jobs loaded.
+	* @param load The backend's LoadIntoTarget().
+	* @return The outcome of the job.
+	* @remarks Skips unchanged jobs and checks the imports of the others before the target is
+	*  touched, see the definition.
+	*/
+	InjectionResult ExecuteInSession(InjectionJob& job, std::mutex& mutex, LoadedPayloads& payloads, const SessionLoader& load);
+}
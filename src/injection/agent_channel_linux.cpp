@@ -0,0 +1,86 @@
+/**
+ * @file agent_channel_linux.cpp
+ * @brief Linux agent ring: a memfd mapped on both sides with futex doorbells.
+ */
+
+#ifdef __linux__
+
+#include "agent_channel.h"
+
+#include <cstdio>
+#include <ctime>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+* @brief Maps the target's memfd into our address space.
+* @param process The target pid.
+* @param descriptor Its descriptor of the memfd.
+* @return Null on success, otherwise the error.
+* @remarks Opening /proc/<pid>/fd/<n> reopens the file behind the target's descriptor, which
+*  needs the same ptrace access we already have. The mapping is MAP_SHARED, so both views see
+*  the same pages and the futexes on them are shared between the processes.
+*/
+const char* injection::AgentChannel::Map(RemoteProcess process, int descriptor)
+{
+	// the view of an agent that has exited, when a later job starts a new one
+	Close();
+
+	char path[64];
+	std::snprintf(path, sizeof(path), "/proc/%d/fd/%d", process, descriptor);
+
+	const int file = open(path, O_RDWR | O_CLOEXEC);
+	if (file < 0)
+		return "Could not open the memory shared with the agent";
+
+	struct stat status = { };
+	void* mapped = MAP_FAILED;
+	if (fstat(file, &status) == 0 && static_cast<std::size_t>(status.st_size) >= AgentRegionSize)
+		mapped = mmap(nullptr, AgentRegionSize, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	close(file);
+
+	if (mapped == MAP_FAILED)
+		return "Could not map the memory shared with the agent";
+
+	view = static_cast<unsigned char*>(mapped);
+	pushed = 0;
+	return nullptr;
+}
+
+/**
+* @brief Wakes the agent if it sleeps on head.
+*/
+void injection::AgentChannel::Wake() noexcept
+{
+	syscall(SYS_futex, &Control().head, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+/**
+* @brief Sleeps until tail changes, the deadline passes or a signal arrives.
+*/
+void injection::AgentChannel::Sleep(std::uint32_t seen, std::chrono::steady_clock::time_point deadline) noexcept
+{
+	const auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now()).count();
+	if (left <= 0)
+		return;
+
+	const timespec timeout = { static_cast<time_t>(left / 1000000000), static_cast<long>(left % 1000000000) };
+	syscall(SYS_futex, &Control().tail, FUTEX_WAIT, seen, &timeout, nullptr, 0);
+}
+
+/**
+* @brief Unmaps our view.
+*/
+void injection::AgentChannel::Close() noexcept
+{
+	if (view)
+		munmap(view, AgentRegionSize);
+	view = nullptr;
+}
+
+#endif // __linux__
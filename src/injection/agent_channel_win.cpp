@@ -0,0 +1,119 @@
+/**
+ * @file agent_channel_win.cpp
+ * @brief Windows agent ring: a pagefile backed section mapped on both sides with event doorbells.
+ */
+
+#ifdef _WIN32
+
+#include "agent_channel.h"
+
+#include <initializer_list>
+
+#include <windows.h>
+
+namespace
+{
+	// ntdll's NtMapViewOfSection, maps a view into another process on every Windows version
+	using MapViewOfSectionFunction = LONG(NTAPI*)(HANDLE section, HANDLE process, PVOID* base, ULONG_PTR zeroBits, SIZE_T commitSize,
+		PLARGE_INTEGER offset, PSIZE_T viewSize, DWORD inheritDisposition, ULONG allocationType, ULONG protection);
+
+	constexpr DWORD ViewUnmap = 2;
+
+	/**
+	* @brief Creates an auto-reset event and a handle to it in the target.
+	* @return False if either failed.
+	*/
+	bool CreateSharedEvent(HANDLE process, HANDLE& local, std::uint64_t& remote)
+	{
+		local = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+		if (!local)
+			return false;
+
+		HANDLE duplicate = nullptr;
+		if (!DuplicateHandle(GetCurrentProcess(), local, process, &duplicate, 0, FALSE, DUPLICATE_SAME_ACCESS))
+			return false;
+
+		remote = reinterpret_cast<std::uint64_t>(duplicate);
+		return true;
+	}
+}
+
+/**
+* @brief Creates the region and its events and maps both into the target.
+* @param process The target.
+* @param remote Receives the address of the region in the target.
+* @return Null on success, otherwise the error.
+* @remarks The handles in the target are written into the control block. The target's view
+*  and handles stay until it exits, the agent may still use them after we let go.
+*/
+const char* injection::AgentChannel::Create(RemoteProcess process, std::uint64_t& remote)
+{
+	static const auto mapViewOfSection = reinterpret_cast<MapViewOfSectionFunction>(GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtMapViewOfSection"));
+	if (!mapViewOfSection)
+		return "Could not find NtMapViewOfSection";
+
+	// the section and view of an agent that has exited, when a later job starts a new one
+	Close();
+
+	section = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, static_cast<DWORD>(AgentRegionSize), nullptr);
+	if (!section)
+		return "Could not create the memory shared with the agent";
+
+	view = static_cast<unsigned char*>(MapViewOfFile(section, FILE_MAP_ALL_ACCESS, 0, 0, AgentRegionSize));
+	if (!view) {
+		Close();
+		return "Could not map the memory shared with the agent";
+	}
+	pushed = 0;
+
+	PVOID base = nullptr;
+	SIZE_T size = 0;
+	if (mapViewOfSection(section, process, &base, 0, 0, nullptr, &size, ViewUnmap, 0, PAGE_READWRITE) < 0) {
+		Close();
+		return "Could not map the memory shared with the agent into the process";
+	}
+	remote = reinterpret_cast<std::uint64_t>(base);
+
+	AgentControl& control = Control();
+	if (!CreateSharedEvent(process, doorbell, control.doorbell) || !CreateSharedEvent(process, completion, control.completion)) {
+		Close();
+		return "Could not create the events of the agent";
+	}
+	return nullptr;
+}
+
+/**
+* @brief Sets the event the agent waits on.
+*/
+void injection::AgentChannel::Wake() noexcept
+{
+	SetEvent(doorbell);
+}
+
+/**
+* @brief Waits for the agent's next completion or the deadline.
+* @remarks The event is auto-reset and set once per command, a stale signal only makes the
+*  caller look at tail once more.
+*/
+void injection::AgentChannel::Sleep(std::uint32_t, std::chrono::steady_clock::time_point deadline) noexcept
+{
+	const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+	WaitForSingleObject(completion, left > 0 ? static_cast<DWORD>(left) + 1 : 0);
+}
+
+/**
+* @brief Unmaps our view and closes our handles.
+*/
+void injection::AgentChannel::Close() noexcept
+{
+	if (view)
+		UnmapViewOfFile(view);
+	for (void* handle : { section, doorbell, completion }) {
+		if (handle)
+			CloseHandle(handle);
+	}
+	view = nullptr;
+	section = doorbell = completion = nullptr;
+}
+
+#endif // _WIN32
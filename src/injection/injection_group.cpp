@@ -0,0 +1,87 @@
+/**
+ * @file injection_group.cpp
+ * @brief Implements the fan-out injection group.
+ */
+
+#include "injection_group.h"
+
+#include <algorithm>
+
+/**
+* @brief Creates a group of freshly submitted jobs.
+* @param id Unique id assigned by the queue.
+* @param jobs One job per target.
+*/
+injection::InjectionGroup::InjectionGroup(std::uint64_t id, std::vector<std::shared_ptr<InjectionJob>> jobs)
+	: id(id),
+	jobs(std::move(jobs)),
+	submittedAt(std::chrono::steady_clock::now())
+{
+}
+
+/**
+* @brief Cancels the jobs of the group.
+*/
+void injection::InjectionGroup::Cancel() noexcept
+{
+	for (const auto& job : jobs)
+		job->Cancel();
+}
+
+/**
+* @brief Checks whether every job of the group is done.
+* @return True if no job is queued or running.
+*/
+bool injection::InjectionGroup::Finished() const noexcept
+{
+	return std::all_of(jobs.begin(), jobs.end(), [](const auto& job) {
+		const JobState state = job->State();
+		return state != JobState::Queued && state != JobState::Running;
+	});
+}
+
+/**
+* @brief Computes the progress and timing of the group.
+* @return The statistics.
+*/
+injection::GroupStats injection::InjectionGroup::Stats() const
+{
+	GroupStats stats;
+	stats.total = jobs.size();
+
+	std::vector<double> latencies;
+	latencies.reserve(jobs.size());
+	auto end = submittedAt;
+
+	for (const auto& job : jobs) {
+		switch (job->State()) {
+		case JobState::Queued: ++stats.queued; continue;
+		case JobState::Running: ++stats.running; continue;
+		case JobState::Succeeded: ++stats.succeeded; break;
+		case JobState::Cancelled: ++stats.cancelled; break;
+		default: ++stats.failed; break;
+		}
+
+		// jobs cancelled in the queue never started
+		if (job->StartedAt() != std::chrono::steady_clock::time_point{})
+			latencies.push_back(std::chrono::duration<double, std::milli>(job->FinishedAt() - job->StartedAt()).count());
+		end = std::max(end, job->FinishedAt());
+	}
+
+	if (stats.queued + stats.running > 0)
+		end = std::chrono::steady_clock::now();
+
+	stats.elapsedSeconds = std::chrono::duration<double>(end - submittedAt).count();
+	const std::size_t finished = stats.succeeded + stats.failed + stats.cancelled;
+	if (stats.elapsedSeconds > 0.0)
+		stats.throughput = static_cast<double>(finished) / stats.elapsedSeconds;
+
+	if (!latencies.empty()) {
+		std::sort(latencies.begin(), latencies.end());
+		const auto percentile = [&](double p) { return latencies[static_cast<std::size_t>(p * static_cast<double>(latencies.size() - 1) + 0.5)]; };
+		stats.latencyP50Ms = percentile(0.50);
+		stats.latencyP95Ms = percentile(0.95);
+		stats.latencyMaxMs = latencies.back();
+	}
+	return stats;
+}
@@ -0,0 +1,69 @@
+/**
+
+@file injection_group.h
+@brief A set of injection jobs submitted together, one per target process.
+*/
+
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "injection_job.h"
+
+namespace injection
+{
+	/**
+	* @brief Aggregate progress and timing of a group.
+	*/
+	struct GroupStats
+	{
+		std::size_t total = 0;
+		std::size_t queued = 0;
+		std::size_t running = 0;
+		std::size_t succeeded = 0;
+		std::size_t failed = 0; // failed or timed out
+		std::size_t cancelled = 0;
+
+		// from submission to the last finished job, or to now while jobs are pending
+		double elapsedSeconds = 0.0;
+
+		// finished targets per second over elapsedSeconds
+		double throughput = 0.0;
+
+		// time a worker spent on a target, over all finished targets
+		double latencyP50Ms = 0.0;
+		double latencyP95Ms = 0.0;
+		double latencyMaxMs = 0.0;
+	};
+
+	/**
+	* @brief The jobs of one fan-out injection.
+	* @remarks Jobs of a group run in parallel up to the concurrency limit of the queue. The
+	*  group itself holds no state besides its jobs, statistics are computed on request.
+	*/
+	class InjectionGroup
+	{
+	public:
+		InjectionGroup(std::uint64_t id, std::vector<std::shared_ptr<InjectionJob>> jobs);
+
+		std::uint64_t Id() const noexcept { return id; }
+		const std::vector<std::shared_ptr<InjectionJob>>& Jobs() const noexcept { return jobs; }
+
+		// cancels every job that has not finished yet
+		void Cancel() noexcept;
+
+		// true once every job has a result
+		bool Finished() const noexcept;
+
+		// walks all jobs, O(n log n) for the latency percentiles
+		GroupStats Stats() const;
+
+	private:
+		const std::uint64_t id;
+		const std::vector<std::shared_ptr<InjectionJob>> jobs;
+		const std::chrono::steady_clock::time_point submittedAt;
+	};
+}
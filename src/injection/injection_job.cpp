@@ -0,0 +1,161 @@
+/**
+ * @file injection_job.cpp
+ * @brief Implements the injection job status.
+ */
+
+#include "injection_job.h"
+#include "payload_graph.h"
+
+/**
+* @brief Creates a queued job.
+* @param id Unique id assigned by the queue.
+* @param request What to inject where.
+*/
+injection::InjectionJob::InjectionJob(std::uint64_t id, InjectionRequest request)
+	: id(id),
+	request(std::move(request)),
+	submittedAt(std::chrono::steady_clock::now()),
+	result(promise.get_future().share())
+{
+}
+
+/**
+* @brief Gets the lifecycle state.
+* @return The current state.
+*/
+injection::JobState injection::InjectionJob::State() const noexcept
+{
+	return state.load(std::memory_order_acquire);
+}
+
+/**
+* @brief Gets what the worker is currently doing.
+* @return The current phase.
+*/
+injection::JobPhase injection::InjectionJob::Phase() const noexcept
+{
+	return phase.load(std::memory_order_relaxed);
+}
+
+/**
+* @brief Gets the library the worker is at.
+* @return An index into Planned().libraries.
+*/
+std::size_t injection::InjectionJob::Progress() const noexcept
+{
+	return progress.load(std::memory_order_relaxed);
+}
+
+/**
+* @brief Requests cancellation.
+* @remarks Queued jobs are dropped when a worker picks them up, running jobs stop before
+*  their next library.
+*/
+void injection::InjectionJob::Cancel() noexcept
+{
+	cancelRequested.store(true, std::memory_order_relaxed);
+}
+
+/**
+* @brief Checks whether Cancel() has been called.
+* @return True if the job should stop.
+*/
+bool injection::InjectionJob::CancelRequested() const noexcept
+{
+	return cancelRequested.load(std::memory_order_relaxed);
+}
+
+/**
+* @brief Marks the job as running.
+* @remarks The deadline starts now, time spent in the queue does not count against it.
+*/
+void injection::InjectionJob::Begin()
+{
+	startedAt = std::chrono::steady_clock::now();
+	deadline = startedAt + request.timeout;
+	state.store(JobState::Running, std::memory_order_release);
+}
+
+/**
+* @brief Puts the payloads in load order.
+* @param error Receives a cycle or an unreadable payload.
+* @return False if the payloads cannot be ordered.
+* @remarks Runs on the worker after Begin(), so reading the import tables counts against the
+*  deadline instead of stalling whoever submitted the job. The UI keeps reading Request(),
+*  Planned() is only written here. An unload job is taken as it is.
+*/
+bool injection::InjectionJob::Plan(std::string& error)
+{
+	planned = request;
+	return !planned.unload.empty() || PlanPayloads(planned, error);
+}
+
+/**
+* @brief Updates the progress shown by the UI.
+* @param phase The new phase.
+* @param library The index of the library being worked on.
+*/
+void injection::InjectionJob::SetPhase(JobPhase phase, std::size_t library) noexcept
+{
+	progress.store(library, std::memory_order_relaxed);
+	this->phase.store(phase, std::memory_order_relaxed);
+}
+
+/**
+* @brief Publishes the final result.
+* @param outcome The result, its state becomes the state of the job.
+*/
+void injection::InjectionJob::Finish(InjectionResult outcome)
+{
+	const JobState finalState = outcome.state;
+	finishedAt = std::chrono::steady_clock::now();
+
+	progress.store(outcome.loaded, std::memory_order_relaxed);
+	phase.store(JobPhase::Finished, std::memory_order_relaxed);
+	promise.set_value(std::move(outcome));
+
+	// set last, a finished state guarantees a ready result
+	state.store(finalState, std::memory_order_release);
+}
+
+/**
+* @brief Unloads the modules of an earlier job, in reverse load order.
+* @param job The job, Begin() must have been called.
+* @return The outcome, the first module that cannot be unloaded ends the job.
+* @remarks Modules the earlier job did not load (module 0) are skipped. The agent is given
+*  whatever is left of the job deadline for every module.
+*/
+injection::InjectionResult injection::ExecuteUnload(InjectionJob& job)
+{
+	const InjectionRequest& request = job.Request();
+	InjectionResult result;
+	result.libraries.resize(request.unload.size());
+
+	for (std::size_t i = request.unload.size(); i-- > 0;) {
+		if (job.CancelRequested()) {
+			result.state = JobState::Cancelled;
+			return result;
+		}
+		if (request.unload[i] == 0)
+			continue;
+
+		job.SetPhase(JobPhase::Loading, request.unload.size() - 1 - i);
+
+		const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(job.Deadline() - std::chrono::steady_clock::now());
+		if (left.count() <= 0) {
+			result.state = JobState::TimedOut;
+			result.error = "The modules were not unloaded before the deadline";
+			return result;
+		}
+
+		if (const char* error = UnloadLibrary(request.target, request.unload[i], left)) {
+			result.error = error;
+			return result;
+		}
+		result.libraries[i].module = request.unload[i];
+		++result.loaded;
+	}
+
+	result.state = JobState::Succeeded;
+	return result;
+}
@@ -0,0 +1,270 @@
+/**
+
+@file injection_job.h
+@brief One injection request and the live status of its execution.
+*/
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "../process/process_snapshot.h"
+
+namespace injection
+{
+	/**
+	* @brief Lifecycle of an injection job.
+	*/
+	enum class JobState : std::uint8_t
+	{
+		Queued,
+		Running,
+		Succeeded,
+		Failed,
+		TimedOut, // the target did not finish loading before the deadline
+		Cancelled,
+	};
+
+	/**
+	* @brief What a running job is currently doing.
+	*/
+	enum class JobPhase : std::uint8_t
+	{
+		Waiting,
+		OpeningProcess,
+		WritingPath,
+		Loading,
+		Finished,
+	};
+
+	/**
+	* @brief A library one of the payloads imports that none of them provides.
+	*/
+	struct PayloadDependency
+	{
+		std::size_t library = 0; // index of the importing payload in the request
+		std::string name;
+	};
+
+	/**
+	* @brief Everything needed to inject a set of libraries into one process.
+	*/
+	struct InjectionRequest
+	{
+		// the target instance, a job never touches a different process that reuses the pid
+		process::ProcessKey target;
+		process::NameId targetName = 0;
+
+		// full paths, loaded in this order, which InjectionJob::Plan() changes to put imports first
+		std::vector<std::string> libraries;
+
+		// set by InjectionJob::Plan() from the payloads' import tables (see PlanPayloads()): where
+		// each wave of libraries that do not import one another ends, empty for one wave per library
+		std::vector<std::size_t> waves;
+		std::vector<PayloadDependency> dependencies;
+
+		// time budget of the whole job, counted from the moment a worker picks it up
+		std::chrono::milliseconds timeout = std::chrono::seconds(10);
+
+		// load all libraries from a single remote thread instead of one thread per library
+		bool batched = true;
+
+		// Linux: stop a single idle thread only after everything has been staged; a target without
+		// pthread_create gets all libraries loaded with one resume of it, see Execute()
+		bool minimalStop = false;
+
+		// Linux: longest the target may be held stopped, zero for no limit. The job fails
+		// without loading the remaining libraries once it runs out
+		std::chrono::microseconds stopBudget = { };
+
+		// load through a resident agent in the target, started by the first such job; later jobs
+		// neither create threads nor stop the target, see Execute()
+		bool useAgent = false;
+
+		// libraries a previous job loaded into the target from the same file content, or the target
+		// has loaded itself, are not loaded again, changed ones are unloaded first; a job with
+		// nothing left to do is done at once
+		bool skipUnchanged = false;
+
+		// watch mode: when the target was seen starting, the epoch for jobs submitted by hand
+		std::chrono::steady_clock::time_point spawnedAt = { };
+
+		// when not empty the job unloads these modules (one per library, as an earlier job loaded
+		// them) through the target's agent, last first, instead of loading anything
+		std::vector<std::uint64_t> unload;
+	};
+
+	/**
+	* @brief What the target loader returned for one library.
+	*/
+	struct LibraryResult
+	{
+		// module handle in the target, 0 if loading failed or was not attempted (also when the
+		// target had loaded the library by itself, we hold no reference on it then)
+		std::uint64_t module = 0;
+
+		// the target's last error code after a failed load
+		std::uint32_t error = 0;
+	};
+
+	/**
+	* @brief Final outcome of a job, delivered through its future.
+	*/
+	struct InjectionResult
+	{
+		JobState state = JobState::Failed;
+		std::string error;
+
+		// why the job did not load the way it was asked to, e.g. without the agent; empty if it did
+		std::string warning;
+
+		// number of libraries loaded before the job ended
+		std::size_t loaded = 0;
+
+		// of those, libraries not loaded again as the target had them with the same content (skipUnchanged)
+		std::size_t unchanged = 0;
+
+		// modules of changed libraries unloaded before loading them again (skipUnchanged)
+		std::size_t reloaded = 0;
+
+		// one entry per library, in InjectionJob::Planned() order
+		std::vector<LibraryResult> libraries;
+
+		// remote regions reserved and bytes written into the target by this job
+		std::size_t remoteAllocations = 0;
+		std::size_t bytesWritten = 0;
+
+		// how long the target was held stopped, zero where injecting does not stop it (Windows)
+		std::chrono::nanoseconds targetStopped = { };
+	};
+
+	/**
+	* @brief Shared status of one submitted request.
+	* @remarks The worker executing the job updates state, phase and progress through atomics,
+	*  so the UI can poll them every frame without locking. The final result is published once
+	*  through a shared future.
+	*/
+	class InjectionJob
+	{
+	public:
+		InjectionJob(std::uint64_t id, InjectionRequest request);
+
+		InjectionJob(const InjectionJob&) = delete;
+		InjectionJob& operator=(const InjectionJob&) = delete;
+
+		std::uint64_t Id() const noexcept { return id; }
+
+		// the request as submitted, its libraries in the requested order
+		const InjectionRequest& Request() const noexcept { return request; }
+
+		// the request with its libraries in load order, valid once the job has finished, and on the worker after Plan()
+		const InjectionRequest& Planned() const noexcept { return planned; }
+
+		JobState State() const noexcept;
+		JobPhase Phase() const noexcept;
+
+		// index of the library being worked on, or the number loaded once finished
+		std::size_t Progress() const noexcept;
+
+		// becomes ready when the job has finished, failed, timed out or was cancelled
+		std::shared_future<InjectionResult> Result() const { return result; }
+
+		// asks the job to stop before the next library, a running LoadLibrary is not interrupted
+		void Cancel() noexcept;
+		bool CancelRequested() const noexcept;
+
+		// worker side: marks the job as running and fixes its deadline
+		void Begin();
+
+		// worker side: orders the payloads into Planned(), false with the reason if they cannot be
+		bool Plan(std::string& error);
+
+		// worker side: reports progress, library is the index into Planned().libraries
+		void SetPhase(JobPhase phase, std::size_t library) noexcept;
+
+		// worker side: publishes the result, must be called exactly once
+		void Finish(InjectionResult outcome);
+
+		// point in time by which the job must be done, valid after Begin()
+		std::chrono::steady_clock::time_point Deadline() const noexcept { return deadline; }
+
+		// when the job was submitted
+		std::chrono::steady_clock::time_point SubmittedAt() const noexcept { return submittedAt; }
+
+		// when a worker picked the job up and when it finished, valid once State() says so
+		std::chrono::steady_clock::time_point StartedAt() const noexcept { return startedAt; }
+		std::chrono::steady_clock::time_point FinishedAt() const noexcept { return finishedAt; }
+
+	private:
+		const std::uint64_t id;
+		const InjectionRequest request;
+		InjectionRequest planned;
+
+		std::atomic<JobState> state = JobState::Queued;
+		std::atomic<JobPhase> phase = JobPhase::Waiting;
+		std::atomic<std::size_t> progress = 0;
+		std::atomic<bool> cancelRequested = false;
+		const std::chrono::steady_clock::time_point submittedAt;
+		std::chrono::steady_clock::time_point deadline = { };
+		std::chrono::steady_clock::time_point startedAt = { };
+		std::chrono::steady_clock::time_point finishedAt = { };
+
+		std::promise<InjectionResult> promise;
+		std::shared_future<InjectionResult> result;
+	};
+
+	/**
+	* @brief Executes a job on the calling thread, implemented per platform.
+	* @param job The job, Begin() and Plan() must have been called.
+	* @return The outcome, which the caller passes on to Finish().
+	* @remarks Never waits past the job deadline. Jobs for the same target run one after the
+	*  other, they share the process handle and remote memory of that target.
+	*/
+	InjectionResult Execute(InjectionJob& job);
+
+	/**
+	* @brief Executes a job with InjectionRequest::unload set on the calling thread.
+	* @param job The job, Begin() must have been called.
+	* @return The outcome, loaded counts the modules that were unloaded.
+	* @remarks Goes through UnloadLibrary(), so it waits for a job running on the same target.
+	*/
+	InjectionResult ExecuteUnload(InjectionJob& job);
+
+	/**
+	* @brief Drops the process handle, remote memory and resolved symbols kept for a target, implemented per platform.
+	* @param target The process, typically one that has just exited or replaced its program.
+	* @remarks A job still running on the target keeps its resources until it finishes.
+	*/
+	void ReleaseTarget(const process::ProcessKey& target);
+
+	/**
+	* @brief Releases the resources of every target, call after the injection queue has been stopped.
+	*/
+	void ReleaseAllTargets();
+
+	/**
+	* @brief Unloads a library through the resident agent of a target, implemented per platform.
+	* @param target The process, a job with useAgent must have started its agent.
+	* @param module The module handle from LibraryResult::module.
+	* @param timeout How long to wait for the agent.
+	* @return Null on success, otherwise the error.
+	* @remarks Waits for a job running on the same target to finish first.
+	*/
+	const char* UnloadLibrary(const process::ProcessKey& target, std::uint64_t module, std::chrono::milliseconds timeout);
+
+	/**
+	* @brief Calls a function in a target on the thread of its resident agent, implemented per platform.
+	* @param target The process, a job with useAgent must have started its agent.
+	* @param function Address of the function in the target, it takes one pointer sized argument.
+	* @param argument Passed to the function.
+	* @param value Receives the return value.
+	* @param timeout How long to wait for the function to return.
+	* @return Null on success, otherwise the error.
+	*/
+	const char* CallFunction(const process::ProcessKey& target, std::uint64_t function, std::uint64_t argument, std::uint64_t& value, std::chrono::milliseconds timeout);
+}
@@ -0,0 +1,1515 @@
+/**
+ * @file injection_linux.cpp
+ * @brief Linux injection through dlopen called from a ptrace-hijacked thread.
+ */
+
+#ifdef __linux__
+
+#include "agent_channel.h"
+#include "injection_job.h"
+#include "injection_metrics.h"
+#include "payload_cache.h"
+#include "payload_graph.h"
+#include "remote_arena.h"
+#include "remote_memory.h"
+#include "symbol_resolver.h"
+#include "../process/process_details.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/user.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+	/**
+	* @brief Closes a file descriptor when leaving the scope.
+	*/
+	struct FileDescriptor
+	{
+		int fd = -1;
+		~FileDescriptor() { if (fd >= 0) close(fd); }
+	};
+
+	/**
+	* @brief What is kept per target between injections.
+	* @remarks The remote region is mapped by the first job and reused by every later one. It
+	*  is never unmapped: that would need another stop of the target, and the region is small.
+	*/
+	struct TargetSession
+	{
+		// held for the whole job, jobs for one target never overlap
+		std::mutex mutex;
+
+		injection::RemoteArena arena;
+
+		// whether the first page of the region holds the loader stub and has been made executable
+		bool stubInstalled = false;
+
+		// the resident agent, once a job asked for it
+		injection::AgentChannel agent;
+
+		// code of the agent and of the loader thread, separate from the region, which is replaced
+		// when a job outgrows it or a loader thread may still use it; mapped once, never unmapped
+		std::uint64_t codePage = 0;
+
+		// what skipUnchanged jobs have loaded
+		injection::LoadedPayloads payloads;
+
+		~TargetSession()
+		{
+			agent.RequestStop();
+		}
+	};
+
+	/**
+	* @brief Sessions of all targets, keyed by process identity.
+	*/
+	struct SessionTable
+	{
+		std::mutex mutex;
+		std::unordered_map<process::ProcessKey, std::shared_ptr<TargetSession>, process::ProcessKeyHash> sessions;
+	};
+
+	SessionTable& Sessions()
+	{
+		static SessionTable table;
+		return table;
+	}
+
+	std::shared_ptr<TargetSession> FindSession(const process::ProcessKey& key)
+	{
+		SessionTable& table = Sessions();
+		std::lock_guard lock(table.mutex);
+
+		const auto found = table.sessions.find(key);
+		return found != table.sessions.end() ? found->second : nullptr;
+	}
+
+	std::shared_ptr<TargetSession> FindOrCreateSession(const process::ProcessKey& key)
+	{
+		SessionTable& table = Sessions();
+		std::lock_guard lock(table.mutex);
+
+		std::shared_ptr<TargetSession>& session = table.sessions[key];
+		if (!session)
+			session = std::make_shared<TargetSession>();
+		return session;
+	}
+
+	/**
+	* @brief Reads a NUL terminated string out of the target.
+	* @remarks Reads page by page, the string may end right before an unmapped page.
+	*/
+	std::string ReadRemoteString(injection::RemoteMemory& memory, std::uint64_t address, std::size_t limit)
+	{
+		static const std::uint64_t pageSize = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+
+		std::string text;
+		while (address && text.size() < limit) {
+			char chunk[256];
+			const std::size_t size = static_cast<std::size_t>(std::min<std::uint64_t>({ sizeof(chunk), pageSize - address % pageSize, limit - text.size() }));
+
+			if (!memory.Read(address, chunk, size))
+				break;
+
+			const std::size_t length = strnlen(chunk, size);
+			text.append(chunk, length);
+			if (length < size)
+				break;
+			address += size;
+		}
+		return text;
+	}
+
+	/**
+	* @brief Ends a job with an error.
+	*/
+	injection::InjectionResult Fail(injection::InjectionResult& result, injection::JobState state, const char* error)
+	{
+		result.state = state;
+		result.error = error ? error : "";
+		return std::move(result);
+	}
+
+#ifdef __x86_64__
+	/**
+	* @brief One thread of the target under our control.
+	* @remarks The thread is seized without stopping it, then interrupted. While it is stopped
+	*  functions are called on it by pointing its registers at them with a return address of 0:
+	*  the call ends in a SIGSEGV at address 0, which we catch and suppress. The original
+	*  registers are restored before detaching, so the thread continues (or restarts the
+	*  system call it was blocked in) as if nothing happened. All ptrace requests must come
+	*  from the thread that seized the target.
+	*/
+	class Tracee
+	{
+	public:
+		explicit Tracee(pid_t tid) noexcept : tid(tid) { }
+		~Tracee() { Detach(); }
+
+		Tracee(const Tracee&) = delete;
+		Tracee& operator=(const Tracee&) = delete;
+
+		// attaches without stopping the thread
+		const char* Seize() noexcept
+		{
+			if (ptrace(PTRACE_SEIZE, tid, nullptr, nullptr) != 0)
+				return errno == EPERM ? "Not permitted to trace the process (ptrace_scope or missing privileges)" : "Could not attach to the process";
+			attached = true;
+			return nullptr;
+		}
+
+		// stops the thread and saves its registers
+		const char* Interrupt() noexcept
+		{
+			if (ptrace(PTRACE_INTERRUPT, tid, nullptr, nullptr) != 0)
+				return "Could not interrupt the process";
+
+			int status = 0;
+			if (!Wait(status))
+				return "The process exited during injection";
+
+			// a signal that arrived first stops the thread just as well, it is delivered on detach
+			if (status >> 16 == 0)
+				pendingSignal = WSTOPSIG(status);
+
+			stopped = true;
+			stoppedAt = std::chrono::steady_clock::now();
+
+			if (ptrace(PTRACE_GETREGS, tid, nullptr, &saved) != 0)
+				return "Could not read the registers of the process";
+			if (saved.cs != 0x33)
+				return "32-bit processes are not supported";
+			return nullptr;
+		}
+
+		/**
+		* @brief Calls a function in the target and waits for it to return.
+		* @param function The remote address.
+		* @param arguments Up to six integer arguments.
+		* @param value Receives rax.
+		* @param expiry When to set the abort flag, ignored without one.
+		* @param abortFlag Remote address of a 32-bit flag the called code polls, 0 if it has none.
+		* @return Null on success, otherwise the error.
+		* @remarks Blocks until the function returns, even past the job deadline: detaching
+		*  while the call runs would make it return into address 0 unobserved and kill the target.
+		*  With an abort flag the wait polls until the expiry, then sets the flag and blocks, so the
+		*  called code gets to stop early and return normally.
+		*/
+		const char* Call(std::uint64_t function, std::initializer_list<std::uint64_t> arguments, std::uint64_t& value,
+			std::chrono::steady_clock::time_point expiry = { }, std::uint64_t abortFlag = 0) noexcept
+		{
+			user_regs_struct regs = saved;
+
+			// below the red zone, aligned as if the return address had just been pushed
+			regs.rsp = ((saved.rsp - 256) & ~std::uint64_t(15)) - 8;
+			if (ptrace(PTRACE_POKEDATA, tid, reinterpret_cast<void*>(regs.rsp), nullptr) != 0)
+				return "Could not write to the stack of the process";
+
+			unsigned long long* const slots[] = { &regs.rdi, &regs.rsi, &regs.rdx, &regs.rcx, &regs.r8, &regs.r9 };
+			std::size_t i = 0;
+			for (std::uint64_t argument : arguments)
+				*slots[i++] = argument;
+
+			regs.rip = function;
+			regs.rax = 0;       // no vector registers used by a variadic callee
+			regs.orig_rax = -1; // no system call to restart for our frame
+
+			if (ptrace(PTRACE_SETREGS, tid, nullptr, &regs) != 0)
+				return "Could not set the registers of the process";
+			modified = true;
+
+			int signal = 0;
+			for (;;) {
+				if (ptrace(PTRACE_CONT, tid, nullptr, reinterpret_cast<void*>(static_cast<std::uintptr_t>(signal))) != 0)
+					return "Could not resume the process";
+
+				int status = 0;
+				bool stop = false;
+				if (abortFlag && !aborted) {
+					stop = Poll(status, expiry);
+					if (!attached)
+						return "The process exited during injection";
+
+					if (!stop) {
+						// out of time, the called code stops at its next check of the flag
+						const std::uint32_t abort = 1;
+						injection::RemoteMemory(tid).Write(abortFlag, &abort, sizeof(abort));
+						aborted = true;
+					}
+				}
+				if (!stop && !Wait(status))
+					return "The process exited during injection";
+
+				signal = 0;
+				if (status >> 16 != 0)
+					continue; // an interrupt or group stop, not a signal
+
+				if (WSTOPSIG(status) != SIGSEGV) {
+					signal = WSTOPSIG(status); // belongs to the target, handled on top of our frame
+					continue;
+				}
+
+				if (ptrace(PTRACE_GETREGS, tid, nullptr, &regs) != 0)
+					return "Could not read the registers of the process";
+
+				if (regs.rip != 0) {
+					// a genuine crash inside the call, the target gets to see it
+					crashed = true;
+					pendingSignal = SIGSEGV;
+					return "The process crashed while loading a library";
+				}
+
+				value = regs.rax;
+				return nullptr;
+			}
+		}
+
+		// restores the registers and lets the thread go
+		void Detach() noexcept
+		{
+			if (!attached)
+				return;
+
+			// a running tracee cannot be detached from
+			int status = 0;
+			if (!stopped) {
+				if (ptrace(PTRACE_INTERRUPT, tid, nullptr, nullptr) != 0 || !Wait(status))
+					return;
+				stopped = true;
+				stoppedAt = std::chrono::steady_clock::now();
+			}
+
+			if (stopped) {
+				if (modified && !crashed)
+					ptrace(PTRACE_SETREGS, tid, nullptr, &saved);
+				ptrace(PTRACE_DETACH, tid, nullptr, reinterpret_cast<void*>(static_cast<std::uintptr_t>(pendingSignal)));
+				stoppedFor = std::chrono::steady_clock::now() - stoppedAt;
+			}
+			attached = false;
+		}
+
+		// from the stop being observed until the detach, valid after Detach()
+		std::chrono::nanoseconds StoppedFor() const noexcept { return std::chrono::duration_cast<std::chrono::nanoseconds>(stoppedFor); }
+
+		// time held stopped so far
+		std::chrono::steady_clock::duration Elapsed() const noexcept { return stopped ? std::chrono::steady_clock::now() - stoppedAt : std::chrono::steady_clock::duration{ }; }
+
+		// when the stop began, valid after Interrupt()
+		std::chrono::steady_clock::time_point StoppedAt() const noexcept { return stoppedAt; }
+
+		// where the thread was stopped, valid after Interrupt()
+		std::uint64_t InstructionPointer() const noexcept { return saved.rip; }
+
+		// whether a Call() had to raise its abort flag
+		bool Aborted() const noexcept { return aborted; }
+
+	private:
+		// polls for the next stop until expiry, sleeping in between; false if none came or the thread is gone
+		bool Poll(int& status, std::chrono::steady_clock::time_point expiry) noexcept
+		{
+			// most calls return within tens of microseconds, a slow library constructor
+			// is checked every millisecond instead of keeping a core busy for the whole stop
+			std::chrono::microseconds interval(20);
+			for (;;) {
+				const pid_t waited = waitpid(tid, &status, __WALL | WNOHANG);
+				if (waited == tid) {
+					if (WIFSTOPPED(status))
+						return true;
+					attached = false;
+					return false;
+				}
+				if (waited < 0 && errno != EINTR) {
+					attached = false;
+					return false;
+				}
+				const auto now = std::chrono::steady_clock::now();
+				if (now >= expiry)
+					return false;
+				std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(interval, expiry - now));
+				interval = std::min(interval * 2, std::chrono::microseconds(1000));
+			}
+		}
+
+		// waits for the next stop, false if the thread is gone
+		bool Wait(int& status) noexcept
+		{
+			for (;;) {
+				const pid_t waited = waitpid(tid, &status, __WALL);
+				if (waited == tid)
+					break;
+				if (waited < 0 && errno != EINTR) {
+					attached = false;
+					return false;
+				}
+			}
+
+			if (WIFSTOPPED(status))
+				return true;
+
+			attached = false;
+			return false;
+		}
+
+		const pid_t tid;
+		bool attached = false;
+		bool stopped = false;
+		bool modified = false;
+		bool crashed = false;
+		bool aborted = false;
+		int pendingSignal = 0;
+		user_regs_struct saved = { };
+		std::chrono::steady_clock::time_point stoppedAt = { };
+		std::chrono::steady_clock::duration stoppedFor = { };
+	};
+
+	/**
+	* @brief Start of the parameter block of the loader stub.
+	*/
+	struct BatchHeader
+	{
+		std::uint64_t dlopen;
+		std::uint64_t dlerror;
+		std::uint32_t count;
+		std::uint32_t abort;      // set by us while the stub runs, it stops before the next library
+		std::uint64_t firstError; // dlerror() after the first failed library
+	};
+
+	/**
+	* @brief One library of a batch, the stub fills module and attempted.
+	*/
+	struct BatchEntry
+	{
+		std::uint64_t path;
+		std::uint64_t module;
+		std::uint32_t attempted;
+		std::uint32_t reserved;
+	};
+
+	static_assert(sizeof(BatchHeader) == 32 && sizeof(BatchEntry) == 24, "layout is hard coded in the loader stub");
+
+	/**
+	* @brief Routine that loads every entry of a batch in one call.
+	* @remarks Equivalent to
+	*  for (i = 0; i < header->count && !header->abort; i++) {
+	*      entry[i].module = dlopen(entry[i].path, RTLD_NOW);
+	*      if (!entry[i].module && !header->firstError) header->firstError = dlerror();
+	*      entry[i].attempted = 1;
+	*  }
+	*  return 0;
+	*/
+	constexpr unsigned char LoaderStub[] = {
+		0x53,                               // push rbx
+		0x41, 0x54,                         // push r12
+		0x41, 0x55,                         // push r13          ; rsp 16 byte aligned from here
+		0x48, 0x89, 0xFB,                   // mov rbx, rdi      ; header
+		0x4C, 0x8D, 0x67, 0x20,             // lea r12, [rdi+20h] ; first entry
+		0x44, 0x8B, 0x6F, 0x10,             // mov r13d, [rdi+10h] ; count
+		// next:
+		0x45, 0x85, 0xED,                   // test r13d, r13d
+		0x74, 0x3B,                         // jz done
+		0x83, 0x7B, 0x14, 0x00,             // cmp dword [rbx+14h], 0 ; abort
+		0x75, 0x35,                         // jne done
+		0x49, 0x8B, 0x3C, 0x24,             // mov rdi, [r12]    ; path
+		0xBE, 0x02, 0x00, 0x00, 0x00,       // mov esi, 2        ; RTLD_NOW
+		0xFF, 0x13,                         // call [rbx]        ; dlopen
+		0x49, 0x89, 0x44, 0x24, 0x08,       // mov [r12+8], rax
+		0x48, 0x85, 0xC0,                   // test rax, rax
+		0x75, 0x0E,                         // jnz attempted
+		0x48, 0x83, 0x7B, 0x18, 0x00,       // cmp qword [rbx+18h], 0 ; firstError
+		0x75, 0x07,                         // jne attempted
+		0xFF, 0x53, 0x08,                   // call [rbx+8]      ; dlerror
+		0x48, 0x89, 0x43, 0x18,             // mov [rbx+18h], rax
+		// attempted:
+		0x41, 0xC7, 0x44, 0x24, 0x10, 0x01, 0x00, 0x00, 0x00, // mov dword [r12+10h], 1
+		0x49, 0x83, 0xC4, 0x18,             // add r12, 18h
+		0x41, 0xFF, 0xCD,                   // dec r13d
+		0xEB, 0xC0,                         // jmp next
+		// done:
+		0x41, 0x5D,                         // pop r13
+		0x41, 0x5C,                         // pop r12
+		0x5B,                               // pop rbx
+		0x31, 0xC0,                         // xor eax, eax
+		0xC3,                               // ret
+	};
+
+	static_assert(RTLD_NOW == 2, "the loader stub passes RTLD_NOW as an immediate");
+
+	// the stub gets a page of its own so it can be made executable without the data
+	constexpr std::size_t StubPageSize = 4096;
+
+	// regions are mapped in steps of this size, jobs rarely need more than the first one
+	constexpr std::size_t RegionGranularity = 64 * 1024;
+
+	/**
+	* @brief Thread routine of the resident agent, serves the ring until asked to stop.
+	* @remarks Equivalent to
+	*  for (;;) {
+	*      while (control->tail == control->head) {
+	*          if (control->stop) { control->exited = 1; futex_wake(&control->tail); return 0; }
+	*          futex_wait(&control->head, control->tail);
+	*      }
+	*      slot = slots[control->tail & control->mask];
+	*      switch (slot->command) {
+	*      case Load:   slot->value = dlopen(slot->path, RTLD_NOW);
+	*                   if (!slot->value) { slot->error = dlerror(); copy it over slot->path; } break;
+	*      case Unload: slot->value = dlclose(slot->argument); break;
+	*      case Call:   slot->value = slot->argument(slot->parameter); break;
+	*      }
+	*      control->tail++;
+	*      futex_wake(&control->tail);
+	*  }
+	*  The futexes are not private, the region is shared with us.
+	*/
+	constexpr unsigned char AgentStub[] = {
+		0x53,                               // push rbx
+		0x41, 0x54,                         // push r12
+		0x41, 0x55,                         // push r13          ; rsp 16 byte aligned from here
+		0x48, 0x89, 0xFB,                   // mov rbx, rdi      ; control
+		// next:
+		0x44, 0x8B, 0x6B, 0x40,             // mov r13d, [rbx+40h] ; tail
+		0x44, 0x3B, 0x2B,                   // cmp r13d, [rbx]   ; head
+		0x75, 0x1E,                         // jne work
+		0x83, 0x7B, 0x04, 0x00,             // cmp dword [rbx+4], 0 ; stop
+		0x0F, 0x85, 0xC9, 0x00, 0x00, 0x00, // jne quit
+		0x48, 0x89, 0xDF,                   // mov rdi, rbx      ; &head
+		0x31, 0xF6,                         // xor esi, esi      ; FUTEX_WAIT
+		0x44, 0x89, 0xEA,                   // mov edx, r13d     ; expected
+		0x45, 0x31, 0xD2,                   // xor r10d, r10d    ; no timeout
+		0xB8, 0xCA, 0x00, 0x00, 0x00,       // mov eax, 202      ; SYS_futex
+		0x0F, 0x05,                         // syscall
+		0xEB, 0xD9,                         // jmp next
+		// work:
+		0x44, 0x89, 0xE8,                   // mov eax, r13d
+		0x23, 0x83, 0x80, 0x00, 0x00, 0x00, // and eax, [rbx+80h] ; mask
+		0x48, 0xC1, 0xE0, 0x0C,             // shl rax, 12
+		0x4C, 0x8D, 0xA4, 0x03, 0x00, 0x10, 0x00, 0x00, // lea r12, [rbx+rax+1000h] ; slot
+		0x41, 0x8B, 0x04, 0x24,             // mov eax, [r12]    ; command
+		0x83, 0xF8, 0x01,                   // cmp eax, 1
+		0x75, 0x4B,                         // jne notload
+		0x49, 0x8D, 0x7C, 0x24, 0x28,       // lea rdi, [r12+28h] ; path
+		0xBE, 0x02, 0x00, 0x00, 0x00,       // mov esi, 2        ; RTLD_NOW
+		0xFF, 0x93, 0x88, 0x00, 0x00, 0x00, // call [rbx+88h]    ; dlopen
+		0x49, 0x89, 0x44, 0x24, 0x18,       // mov [r12+18h], rax
+		0x48, 0x85, 0xC0,                   // test rax, rax
+		0x75, 0x5C,                         // jnz complete
+		0xFF, 0x93, 0x90, 0x00, 0x00, 0x00, // call [rbx+90h]    ; dlerror
+		0x49, 0x89, 0x44, 0x24, 0x20,       // mov [r12+20h], rax
+		0x49, 0x8D, 0x7C, 0x24, 0x28,       // lea rdi, [r12+28h]
+		0xB9, 0xD7, 0x0F, 0x00, 0x00,       // mov ecx, 0FD7h    ; room for the message
+		0x48, 0x85, 0xC0,                   // test rax, rax
+		0x74, 0x12,                         // jz terminate
+		// copy:
+		0x8A, 0x10,                         // mov dl, [rax]
+		0x84, 0xD2,                         // test dl, dl
+		0x74, 0x0C,                         // jz terminate
+		0x88, 0x17,                         // mov [rdi], dl
+		0x48, 0xFF, 0xC0,                   // inc rax
+		0x48, 0xFF, 0xC7,                   // inc rdi
+		0xFF, 0xC9,                         // dec ecx
+		0x75, 0xEE,                         // jnz copy
+		// terminate:
+		0xC6, 0x07, 0x00,                   // mov byte [rdi], 0
+		0xEB, 0x2B,                         // jmp complete
+		// notload:
+		0x83, 0xF8, 0x02,                   // cmp eax, 2
+		0x75, 0x12,                         // jne notunload
+		0x49, 0x8B, 0x7C, 0x24, 0x08,       // mov rdi, [r12+8]  ; module
+		0xFF, 0x93, 0x98, 0x00, 0x00, 0x00, // call [rbx+98h]    ; dlclose
+		0x49, 0x89, 0x44, 0x24, 0x18,       // mov [r12+18h], rax
+		0xEB, 0x14,                         // jmp complete
+		// notunload:
+		0x83, 0xF8, 0x03,                   // cmp eax, 3
+		0x75, 0x0F,                         // jne complete
+		0x49, 0x8B, 0x7C, 0x24, 0x10,       // mov rdi, [r12+10h] ; parameter
+		0x41, 0xFF, 0x54, 0x24, 0x08,       // call [r12+8]      ; function
+		0x49, 0x89, 0x44, 0x24, 0x18,       // mov [r12+18h], rax
+		// complete:
+		0x41, 0xFF, 0xC5,                   // inc r13d
+		0x44, 0x89, 0x6B, 0x40,             // mov [rbx+40h], r13d ; tail
+		0x48, 0x8D, 0x7B, 0x40,             // lea rdi, [rbx+40h]
+		0xBE, 0x01, 0x00, 0x00, 0x00,       // mov esi, 1        ; FUTEX_WAKE
+		0xBA, 0x01, 0x00, 0x00, 0x00,       // mov edx, 1
+		0xB8, 0xCA, 0x00, 0x00, 0x00,       // mov eax, 202      ; SYS_futex
+		0x0F, 0x05,                         // syscall
+		0xE9, 0x24, 0xFF, 0xFF, 0xFF,       // jmp next
+		// quit:
+		0xC7, 0x43, 0x44, 0x01, 0x00, 0x00, 0x00, // mov dword [rbx+44h], 1 ; exited
+		0x48, 0x8D, 0x7B, 0x40,             // lea rdi, [rbx+40h]
+		0xBE, 0x01, 0x00, 0x00, 0x00,       // mov esi, 1        ; FUTEX_WAKE
+		0xBA, 0xFF, 0xFF, 0xFF, 0x7F,       // mov edx, 7FFFFFFFh
+		0xB8, 0xCA, 0x00, 0x00, 0x00,       // mov eax, 202      ; SYS_futex
+		0x0F, 0x05,                         // syscall
+		0x41, 0x5D,                         // pop r13
+		0x41, 0x5C,                         // pop r12
+		0x5B,                               // pop rbx
+		0x31, 0xC0,                         // xor eax, eax
+		0xC3,                               // ret
+	};
+
+	/**
+	* @brief Makes a system call with the number in the first argument, the raw result in rax.
+	* @remarks Lets the agent setup call memfd_create on C libraries that predate its wrapper.
+	*/
+	constexpr unsigned char SyscallStub[] = {
+		0x48, 0x89, 0xF8,                   // mov rax, rdi
+		0x48, 0x89, 0xF7,                   // mov rdi, rsi
+		0x48, 0x89, 0xD6,                   // mov rsi, rdx
+		0x48, 0x89, 0xCA,                   // mov rdx, rcx
+		0x4D, 0x89, 0xC2,                   // mov r10, r8
+		0x4D, 0x89, 0xC8,                   // mov r8, r9
+		0x0F, 0x05,                         // syscall
+		0xC3,                               // ret
+	};
+
+	static_assert(SYS_futex == 202 && FUTEX_WAIT == 0 && FUTEX_WAKE == 1, "the agent passes these as immediates");
+	static_assert(sizeof(injection::AgentSlot::path) - 1 == 0xFD7, "the agent copies at most this many bytes of a message");
+
+	/**
+	* @brief Parameter block of a loader thread, see ThreadStub.
+	*/
+	struct LoaderThread
+	{
+		std::uint64_t currentThread; // pthread_self
+		std::uint64_t detachThread;  // pthread_detach
+		std::uint64_t loader;        // the loader stub
+		std::uint64_t batch;         // its header
+		std::uint32_t done;          // set once the loader stub has returned
+		std::uint32_t reserved;
+		std::uint64_t thread;        // filled in by pthread_create, unused
+		char message[512];           // the batch's first error, dlerror()'s buffer goes with the thread
+	};
+
+	static_assert(offsetof(LoaderThread, done) == 0x20 && offsetof(LoaderThread, message) == 0x30, "layout is hard coded in the thread stub");
+
+	/**
+	* @brief Thread routine that runs the loader stub on a thread of the target's own.
+	* @remarks Equivalent to
+	*  pthread_detach(pthread_self());
+	*  loader(batch);
+	*  copy batch->firstError into message;
+	*  done = 1;
+	*  return 0;
+	*  The thread cleans up after itself, nobody joins it. It lives on the code page, which is
+	*  never unmapped, so the few instructions after done is set run wherever the region went.
+	*/
+	constexpr unsigned char ThreadStub[] = {
+		0x53,                               // push rbx          ; rsp 16 byte aligned from here
+		0x48, 0x89, 0xFB,                   // mov rbx, rdi      ; block
+		0xFF, 0x13,                         // call [rbx]        ; pthread_self
+		0x48, 0x89, 0xC7,                   // mov rdi, rax
+		0xFF, 0x53, 0x08,                   // call [rbx+8]      ; pthread_detach
+		0x48, 0x8B, 0x7B, 0x18,             // mov rdi, [rbx+18h] ; batch
+		0xFF, 0x53, 0x10,                   // call [rbx+10h]    ; loader
+		0x48, 0x8B, 0x43, 0x18,             // mov rax, [rbx+18h]
+		0x48, 0x8B, 0x40, 0x18,             // mov rax, [rax+18h] ; firstError
+		0x48, 0x8D, 0x7B, 0x30,             // lea rdi, [rbx+30h] ; message
+		0xB9, 0xFF, 0x01, 0x00, 0x00,       // mov ecx, 1FFh     ; room for the message
+		0x48, 0x85, 0xC0,                   // test rax, rax
+		0x74, 0x12,                         // jz terminate
+		// copy:
+		0x8A, 0x10,                         // mov dl, [rax]
+		0x84, 0xD2,                         // test dl, dl
+		0x74, 0x0C,                         // jz terminate
+		0x88, 0x17,                         // mov [rdi], dl
+		0x48, 0xFF, 0xC0,                   // inc rax
+		0x48, 0xFF, 0xC7,                   // inc rdi
+		0xFF, 0xC9,                         // dec ecx
+		0x75, 0xEE,                         // jnz copy
+		// terminate:
+		0xC6, 0x07, 0x00,                   // mov byte [rdi], 0
+		0xC7, 0x43, 0x20, 0x01, 0x00, 0x00, 0x00, // mov dword [rbx+20h], 1 ; done
+		0x5B,                               // pop rbx
+		0x31, 0xC0,                         // xor eax, eax
+		0xC3,                               // ret
+	};
+
+	static_assert(offsetof(BatchHeader, firstError) == 0x18 && sizeof(LoaderThread::message) - 1 == 0x1FF, "the thread stub reads and copies these");
+
+	// layout of the code page
+	constexpr std::size_t AgentSyscallOffset = 0x200;
+	constexpr std::size_t AgentNameOffset = 0x300;
+	constexpr std::size_t ThreadStubOffset = 0x400;
+	constexpr char AgentName[] = "injectify-agent";
+
+	/**
+	* @brief Makes sure the session has a region with room for a job and resets it.
+	* @param needed The number of bytes the job will allocate.
+	* @return Null on success, otherwise the error.
+	* @remarks Mapping and unmapping are done by calling mmap and munmap in the target, so they
+	*  only happen for the first job and for jobs that outgrow the region. The first page is
+	*  kept for the loader stub.
+	*/
+	const char* PrepareArena(TargetSession& session, Tracee& tracee, const injection::LoaderSymbols& symbols, std::size_t needed, injection::InjectionResult& result)
+	{
+		injection::RemoteArena& arena = session.arena;
+		if (arena.Attached() && arena.Available() >= needed) {
+			arena.Reset();
+			return nullptr;
+		}
+
+		injection::PhaseTimer timer(injection::InjectionPhase::Allocate);
+
+		std::uint64_t value = 0;
+		if (arena.Attached()) {
+			if (const char* error = tracee.Call(symbols.unmap, { arena.Base(), arena.Capacity() }, value))
+				return error;
+			arena.Detach();
+		}
+
+		const std::size_t capacity = (StubPageSize + needed + RegionGranularity - 1) / RegionGranularity * RegionGranularity;
+		if (const char* error = tracee.Call(symbols.map, { 0, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, static_cast<std::uint64_t>(-1), 0 }, value))
+			return error;
+		if (value == reinterpret_cast<std::uint64_t>(MAP_FAILED) || value == 0)
+			return "Could not allocate memory";
+		++result.remoteAllocations;
+
+		arena.Attach(value, capacity, StubPageSize);
+		session.stubInstalled = false;
+		return nullptr;
+	}
+
+	/**
+	* @brief Maps the code page of a target, once per target.
+	* @return Null on success, otherwise the error.
+	* @remarks Two calls on the stopped thread: a page is mapped for the agent, the system call
+	*  stub and the thread stub, and made executable once they are written. A failure after
+	*  mapping leaves the page behind.
+	*/
+	const char* InstallCode(TargetSession& session, Tracee& tracee, injection::RemoteMemory& memory, const injection::LoaderSymbols& symbols, injection::InjectionResult& result)
+	{
+		if (session.codePage)
+			return nullptr;
+
+		injection::PhaseTimer timer(injection::InjectionPhase::Allocate);
+
+		std::uint64_t page = 0;
+		if (const char* error = tracee.Call(symbols.map, { 0, StubPageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, static_cast<std::uint64_t>(-1), 0 }, page))
+			return error;
+		if (page == reinterpret_cast<std::uint64_t>(MAP_FAILED) || page == 0)
+			return "Could not allocate memory";
+		++result.remoteAllocations;
+
+		unsigned char code[ThreadStubOffset + sizeof(ThreadStub)] = { };
+		std::memcpy(code, AgentStub, sizeof(AgentStub));
+		std::memcpy(code + AgentSyscallOffset, SyscallStub, sizeof(SyscallStub));
+		std::memcpy(code + AgentNameOffset, AgentName, sizeof(AgentName));
+		std::memcpy(code + ThreadStubOffset, ThreadStub, sizeof(ThreadStub));
+		if (!memory.Write(page, code, sizeof(code)))
+			return "Could not write process memory";
+		result.bytesWritten += sizeof(code);
+
+		std::uint64_t value = 0;
+		if (const char* error = tracee.Call(symbols.protect, { page, StubPageSize, PROT_READ | PROT_EXEC }, value))
+			return error;
+		if (value != 0)
+			return "Could not make the agent executable";
+		session.codePage = page;
+		return nullptr;
+	}
+
+	/**
+	* @brief Starts the resident agent of a target, during the stop of the first job that wants it.
+	* @return Null on success, otherwise the error; the job then goes on without the agent.
+	* @remarks Five calls on the stopped thread after the code page (see InstallCode()): a
+	*  memfd is created, sized and mapped shared, its descriptor is closed once we have mapped it
+	*  through /proc as well, and pthread_create starts the agent on the shared region.
+	*/
+	const char* StartAgent(TargetSession& session, Tracee& tracee, injection::RemoteMemory& memory, pid_t pid, const injection::LoaderSymbols& symbols, injection::InjectionResult& result)
+	{
+		if (!symbols.startThread || !symbols.unload)
+			return "The process has no pthread_create";
+
+		if (const char* error = InstallCode(session, tracee, memory, symbols, result))
+			return error;
+
+		std::uint64_t value = 0;
+		const std::uint64_t systemCall = session.codePage + AgentSyscallOffset;
+
+		injection::PhaseTimer allocateTimer(injection::InjectionPhase::Allocate);
+		if (const char* error = tracee.Call(systemCall, { SYS_memfd_create, session.codePage + AgentNameOffset, MFD_CLOEXEC }, value))
+			return error;
+		const auto descriptor = static_cast<std::int64_t>(value);
+		if (descriptor < 0)
+			return "Could not create memory to share with the agent";
+
+		// the descriptor is closed on every path from here on
+		const char* failure = nullptr;
+		std::uint64_t region = 0;
+		if (const char* error = tracee.Call(systemCall, { SYS_ftruncate, static_cast<std::uint64_t>(descriptor), injection::AgentRegionSize }, value))
+			failure = error;
+		else if (value != 0)
+			failure = "Could not size the memory shared with the agent";
+		else if (const char* error = tracee.Call(symbols.map, { 0, injection::AgentRegionSize, PROT_READ | PROT_WRITE, MAP_SHARED, static_cast<std::uint64_t>(descriptor), 0 }, region))
+			failure = error;
+		else if (region == reinterpret_cast<std::uint64_t>(MAP_FAILED) || region == 0)
+			failure = "Could not map the memory shared with the agent";
+		else
+			failure = session.agent.Map(pid, static_cast<int>(descriptor));
+
+		if (const char* error = tracee.Call(systemCall, { SYS_close, static_cast<std::uint64_t>(descriptor) }, value); error && !failure)
+			failure = error;
+		allocateTimer.Stop();
+
+		if (failure) {
+			session.agent.Close();
+			return failure;
+		}
+		++result.remoteAllocations;
+
+		injection::AgentControl& control = session.agent.Control();
+		control.mask = injection::AgentSlotCount - 1;
+		control.load = symbols.load;
+		control.lastError = symbols.lastError;
+		control.unload = symbols.unload;
+
+		injection::PhaseTimer threadTimer(injection::InjectionPhase::CreateThread);
+		if (const char* error = tracee.Call(symbols.startThread, { region + offsetof(injection::AgentControl, thread), 0, session.codePage, region }, value)) {
+			session.agent.Close();
+			return error;
+		}
+		if (static_cast<std::int32_t>(value) != 0) {
+			session.agent.Close();
+			return "Could not start the agent thread";
+		}
+		return nullptr;
+	}
+
+	/**
+	* @brief Writes all paths of a job with one call.
+	* @param addresses Receives the remote address of every path.
+	* @return False if the paths could not be written.
+	*/
+	bool WritePaths(TargetSession& session, injection::RemoteMemory& memory, const std::vector<std::string>& libraries, std::vector<std::uint64_t>& addresses, injection::InjectionResult& result)
+	{
+		std::size_t size = 0;
+		for (const std::string& library : libraries)
+			size += library.size() + 1;
+
+		const std::uint64_t remote = session.arena.Allocate(size, 1);
+		if (!remote)
+			return false;
+
+		std::vector<char> image(size);
+		std::size_t offset = 0;
+		addresses.resize(libraries.size());
+		for (std::size_t i = 0; i < libraries.size(); i++) {
+			std::memcpy(image.data() + offset, libraries[i].c_str(), libraries[i].size() + 1);
+			addresses[i] = remote + offset;
+			offset += libraries[i].size() + 1;
+		}
+
+		injection::PhaseTimer timer(injection::InjectionPhase::Write);
+		if (!memory.Write(remote, image.data(), image.size()))
+			return false;
+
+		result.bytesWritten += image.size();
+		return true;
+	}
+
+	/**
+	* @brief Checks whether a job has held its target stopped for longer than it may.
+	*/
+	bool OverBudget(const Tracee& tracee, const injection::InjectionRequest& request) noexcept
+	{
+		return request.stopBudget.count() > 0 && tracee.Elapsed() >= request.stopBudget;
+	}
+
+	/**
+	* @brief Ends a job once every library was attempted.
+	* @param firstError dlerror() after the first library that failed, if any.
+	*/
+	injection::InjectionResult FinishLoading(injection::InjectionResult& result, std::size_t count, const std::string& firstError)
+	{
+		if (result.loaded != count) {
+			std::string error = std::to_string(count - result.loaded) + " of " + std::to_string(count) + " libraries failed to load";
+			if (!firstError.empty())
+				error += ": " + firstError;
+			return Fail(result, injection::JobState::Failed, error.c_str());
+		}
+
+		result.state = injection::JobState::Succeeded;
+		return std::move(result);
+	}
+
+	/**
+	* @brief Loads the libraries one by one with a call per library, all in one stop.
+	* @remarks The fallback for targets without threads. A dlopen that hangs holds the job past
+	*  its deadline, the thread cannot be let go in the middle of a call.
+	*/
+	injection::InjectionResult ExecuteStopped(injection::InjectionJob& job, TargetSession& session, Tracee& tracee, injection::RemoteMemory& memory, const injection::LoaderSymbols& symbols, injection::InjectionResult& result)
+	{
+		using injection::JobPhase;
+		using injection::JobState;
+
+		const injection::InjectionRequest& request = job.Planned();
+		result.libraries.resize(request.libraries.size());
+
+		std::size_t needed = 0;
+		for (const std::string& library : request.libraries)
+			needed += library.size() + 1;
+
+		if (const char* error = PrepareArena(session, tracee, symbols, needed, result))
+			return Fail(result, JobState::Failed, error);
+
+		job.SetPhase(JobPhase::WritingPath, 0);
+
+		std::vector<std::uint64_t> paths;
+		if (!WritePaths(session, memory, request.libraries, paths, result))
+			return Fail(result, JobState::Failed, "Could not write process memory");
+
+		std::string firstError;
+		for (std::size_t i = 0; i < request.libraries.size(); i++) {
+			if (job.CancelRequested())
+				return Fail(result, JobState::Cancelled, nullptr);
+			if (std::chrono::steady_clock::now() >= job.Deadline())
+				return Fail(result, JobState::TimedOut, "The libraries did not load before the deadline");
+			if (OverBudget(tracee, request)) {
+				return Fail(result, JobState::Failed,
+					("The stop budget ran out after " + std::to_string(i) + " of " + std::to_string(request.libraries.size()) + " libraries").c_str());
+			}
+
+			job.SetPhase(JobPhase::Loading, i);
+
+			std::uint64_t module = 0;
+			injection::PhaseTimer loadTimer(injection::InjectionPhase::Load);
+			if (const char* error = tracee.Call(symbols.load, { paths[i], RTLD_NOW }, module))
+				return Fail(result, JobState::Failed, error);
+			loadTimer.Stop();
+
+			result.libraries[i].module = module;
+			if (module != 0) {
+				++result.loaded;
+				continue;
+			}
+
+			// dlopen has no error code, the message is the only useful information
+			result.libraries[i].error = 1;
+			if (firstError.empty()) {
+				injection::PhaseTimer readTimer(injection::InjectionPhase::ReadResults);
+				std::uint64_t message = 0;
+				if (!tracee.Call(symbols.lastError, { }, message))
+					firstError = ReadRemoteString(memory, message, 512);
+			}
+		}
+
+		return FinishLoading(result, request.libraries.size(), firstError);
+	}
+
+	/**
+	* @brief Reads the scheduler state of a thread out of /proc/<pid>/task/<tid>/stat.
+	* @return The state letter, 0 if the thread does not exist (anymore).
+	*/
+	char ThreadState(pid_t pid, pid_t tid) noexcept
+	{
+		char path[64];
+		std::snprintf(path, sizeof(path), "/proc/%d/task/%d/stat", pid, tid);
+
+		FileDescriptor file{ open(path, O_RDONLY | O_CLOEXEC) };
+		if (file.fd < 0)
+			return 0;
+
+		char line[512];
+		const ssize_t length = pread(file.fd, line, sizeof(line), 0);
+		if (length <= 0)
+			return 0;
+
+		// the state follows the name, which ends at the last ')'
+		const char* cursor = line + length;
+		while (cursor > line && cursor[-1] != ')')
+			--cursor;
+		return cursor > line && cursor + 1 < line + length ? cursor[1] : 0;
+	}
+
+	/**
+	* @brief Picks the thread to hijack for a minimal stop.
+	* @return The main thread if it sleeps, otherwise the first sleeping thread, otherwise the main thread.
+	* @remarks A sleeping thread waits for something anyway, holding it for a moment does not hold
+	*  up work the way stopping a running thread does.
+	*/
+	pid_t PickThread(pid_t pid)
+	{
+		if (ThreadState(pid, pid) == 'S')
+			return pid;
+
+		char path[32];
+		std::snprintf(path, sizeof(path), "/proc/%d/task", pid);
+
+		DIR* directory = opendir(path);
+		if (!directory)
+			return pid;
+
+		pid_t chosen = pid;
+		while (const dirent* entry = readdir(directory)) {
+			const auto tid = static_cast<pid_t>(std::strtol(entry->d_name, nullptr, 10));
+			if (tid > 0 && tid != pid && ThreadState(pid, tid) == 'S') {
+				chosen = tid;
+				break;
+			}
+		}
+		closedir(directory);
+		return chosen;
+	}
+
+	/**
+	* @brief The parameter block of a minimal stop job.
+	*/
+	struct StagedBatch
+	{
+		// header, entries and paths
+		std::vector<unsigned char> image;
+
+		// remote address of the header
+		std::uint64_t base = 0;
+
+		// whether image is already in the target
+		bool written = false;
+	};
+
+	std::size_t BatchSize(const std::vector<std::string>& libraries) noexcept
+	{
+		std::size_t size = sizeof(BatchHeader) + libraries.size() * sizeof(BatchEntry);
+		for (const std::string& library : libraries)
+			size += library.size() + 1;
+		return size;
+	}
+
+	// the parameter block followed by the block of a loader thread
+	std::size_t BatchRoom(const std::vector<std::string>& libraries) noexcept
+	{
+		return BatchSize(libraries) + 8 + sizeof(LoaderThread);
+	}
+
+	/**
+	* @brief Lays out the parameter block for a remote address.
+	*/
+	void BuildBatch(const std::vector<std::string>& libraries, const injection::LoaderSymbols& symbols, std::uint64_t base, std::vector<unsigned char>& image)
+	{
+		image.assign(BatchSize(libraries), 0);
+
+		BatchHeader header = { };
+		header.dlopen = symbols.load;
+		header.dlerror = symbols.lastError;
+		header.count = static_cast<std::uint32_t>(libraries.size());
+		std::memcpy(image.data(), &header, sizeof(header));
+
+		std::size_t pathOffset = sizeof(BatchHeader) + libraries.size() * sizeof(BatchEntry);
+		for (std::size_t i = 0; i < libraries.size(); i++) {
+			BatchEntry entry = { };
+			entry.path = base + pathOffset;
+			std::memcpy(image.data() + sizeof(BatchHeader) + i * sizeof(BatchEntry), &entry, sizeof(entry));
+
+			std::memcpy(image.data() + pathOffset, libraries[i].c_str(), libraries[i].size() + 1);
+			pathOffset += libraries[i].size() + 1;
+		}
+	}
+
+	/**
+	* @brief Writes the parameter block (and the stub, the first time) while the target still runs.
+	* @remarks Only possible when an earlier job left a region with enough room, otherwise the
+	*  block is written during the stop right after mapping a region.
+	*/
+	void StageBatch(TargetSession& session, injection::RemoteMemory& memory, const injection::InjectionRequest& request, const injection::LoaderSymbols& symbols, StagedBatch& staged, injection::InjectionResult& result)
+	{
+		injection::RemoteArena& arena = session.arena;
+		const std::size_t size = BatchSize(request.libraries);
+		if (!arena.Attached() || arena.Available() < BatchRoom(request.libraries))
+			return;
+
+		injection::PhaseTimer timer(injection::InjectionPhase::Write);
+
+		arena.Reset();
+		staged.base = arena.Allocate(size);
+		BuildBatch(request.libraries, symbols, staged.base, staged.image);
+
+		// the stub page stays writable until the stub is installed, both go out in one call
+		if (!session.stubInstalled)
+			memory.QueueWrite(arena.Base(), LoaderStub, sizeof(LoaderStub));
+		memory.QueueWrite(staged.base, staged.image.data(), staged.image.size());
+
+		const std::size_t before = memory.BytesTransferred();
+		staged.written = memory.Flush();
+		result.bytesWritten += memory.BytesTransferred() - before;
+	}
+
+	/**
+	* @brief Writes the parameter block unless it was staged, and makes the loader stub executable.
+	* @return Null on success, otherwise the error.
+	*/
+	const char* PrepareBatch(injection::InjectionJob& job, TargetSession& session, Tracee& tracee, injection::RemoteMemory& memory, const injection::LoaderSymbols& symbols, StagedBatch& staged, injection::InjectionResult& result)
+	{
+		const injection::InjectionRequest& request = job.Planned();
+		injection::RemoteArena& arena = session.arena;
+
+		if (!staged.written) {
+			if (const char* error = PrepareArena(session, tracee, symbols, BatchRoom(request.libraries), result))
+				return error;
+
+			job.SetPhase(injection::JobPhase::WritingPath, 0);
+			injection::PhaseTimer timer(injection::InjectionPhase::Write);
+
+			staged.base = arena.Allocate(BatchSize(request.libraries));
+			BuildBatch(request.libraries, symbols, staged.base, staged.image);
+
+			if (!session.stubInstalled)
+				memory.QueueWrite(arena.Base(), LoaderStub, sizeof(LoaderStub));
+			memory.QueueWrite(staged.base, staged.image.data(), staged.image.size());
+
+			const std::size_t before = memory.BytesTransferred();
+			staged.written = memory.Flush();
+			result.bytesWritten += memory.BytesTransferred() - before;
+			if (!staged.written)
+				return "Could not write process memory";
+		}
+
+		if (!session.stubInstalled) {
+			injection::PhaseTimer timer(injection::InjectionPhase::Allocate);
+			std::uint64_t value = 0;
+			if (const char* error = tracee.Call(symbols.protect, { arena.Base(), StubPageSize, PROT_READ | PROT_EXEC }, value))
+				return error;
+			if (value != 0)
+				return "Could not make the loader executable";
+			session.stubInstalled = true;
+		}
+		return nullptr;
+	}
+
+	/**
+	* @brief Copies the outcome of every attempted entry of a batch into the result.
+	* @param block Header and entries as read from the target.
+	* @return The number of entries the loader stub got to.
+	*/
+	std::size_t RecordEntries(const std::vector<unsigned char>& block, std::size_t count, injection::InjectionResult& result)
+	{
+		std::size_t attempted = 0;
+		for (std::size_t i = 0; i < count; i++) {
+			BatchEntry entry;
+			std::memcpy(&entry, block.data() + sizeof(BatchHeader) + i * sizeof(BatchEntry), sizeof(entry));
+			if (!entry.attempted)
+				continue;
+
+			++attempted;
+			result.libraries[i].module = entry.module;
+			result.libraries[i].error = entry.module ? 0 : 1;
+			if (entry.module)
+				++result.loaded;
+		}
+		return attempted;
+	}
+
+	/**
+	* @brief Loads all libraries with a single resume of the stopped thread.
+	* @remarks The fallback for targets without pthread_create. The stub is told to stop before
+	*  the next library once the stop budget or the deadline runs out; a dlopen already running
+	*  is not interrupted and holds the job until it returns.
+	*/
+	injection::InjectionResult ExecuteBatch(injection::InjectionJob& job, TargetSession& session, Tracee& tracee, injection::RemoteMemory& memory, const injection::LoaderSymbols& symbols, StagedBatch& staged, injection::InjectionResult& result)
+	{
+		using injection::JobPhase;
+		using injection::JobState;
+
+		const injection::InjectionRequest& request = job.Planned();
+		const std::size_t count = request.libraries.size();
+		result.libraries.resize(count);
+
+		if (const char* error = PrepareBatch(job, session, tracee, memory, symbols, staged, result))
+			return Fail(result, JobState::Failed, error);
+
+		if (job.CancelRequested())
+			return Fail(result, JobState::Cancelled, nullptr);
+		if (OverBudget(tracee, request))
+			return Fail(result, JobState::Failed, "The stop budget ran out before loading");
+
+		job.SetPhase(JobPhase::Loading, 0);
+
+		std::chrono::steady_clock::time_point expiry = job.Deadline();
+		if (request.stopBudget.count() > 0)
+			expiry = std::min(expiry, tracee.StoppedAt() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(request.stopBudget));
+
+		std::uint64_t value = 0;
+		injection::PhaseTimer loadTimer(injection::InjectionPhase::Load);
+		if (const char* error = tracee.Call(session.arena.Base(), { staged.base }, value, expiry, staged.base + offsetof(BatchHeader, abort)))
+			return Fail(result, JobState::Failed, error);
+		loadTimer.Stop();
+
+		// header and entries in one read, the message while its buffer is still valid
+		injection::PhaseTimer readTimer(injection::InjectionPhase::ReadResults);
+		std::vector<unsigned char> block(sizeof(BatchHeader) + count * sizeof(BatchEntry));
+		if (!memory.Read(staged.base, block.data(), block.size()))
+			return Fail(result, JobState::Failed, "Could not read the loader results");
+
+		BatchHeader header;
+		std::memcpy(&header, block.data(), sizeof(header));
+		const std::string firstError = header.firstError ? ReadRemoteString(memory, header.firstError, 512) : std::string();
+		readTimer.Stop();
+
+		const std::size_t attempted = RecordEntries(block, count, result);
+		if (attempted != count) {
+			if (std::chrono::steady_clock::now() >= job.Deadline())
+				return Fail(result, JobState::TimedOut, "The libraries did not load before the deadline");
+			return Fail(result, JobState::Failed,
+				("The stop budget ran out after " + std::to_string(attempted) + " of " + std::to_string(count) + " libraries").c_str());
+		}
+		return FinishLoading(result, count, firstError);
+	}
+
+	/**
+	* @brief Starts a thread in the target that loads the batch, see ThreadStub.
+	* @param thread Receives the remote address of the thread's block.
+	* @return Null on success, otherwise the error; nothing has been loaded then.
+	* @remarks Only the writes and pthread_create happen during the stop, the libraries load
+	*  while the target runs. Their constructors can take as long as they like, the job waits
+	*  for them no longer than its deadline (see WaitForLoader()).
+	*/
+	const char* StartLoader(injection::InjectionJob& job, TargetSession& session, Tracee& tracee, injection::RemoteMemory& memory, const injection::LoaderSymbols& symbols, StagedBatch& staged, std::uint64_t& thread, injection::InjectionResult& result)
+	{
+		if (const char* error = PrepareBatch(job, session, tracee, memory, symbols, staged, result))
+			return error;
+		if (const char* error = InstallCode(session, tracee, memory, symbols, result))
+			return error;
+
+		LoaderThread block = { };
+		block.currentThread = symbols.currentThread;
+		block.detachThread = symbols.detachThread;
+		block.loader = session.arena.Base();
+		block.batch = staged.base;
+
+		const std::uint64_t remote = session.arena.Allocate(sizeof(block));
+		if (!remote)
+			return "Could not allocate memory";
+		{
+			injection::PhaseTimer timer(injection::InjectionPhase::Write);
+			if (!memory.Write(remote, &block, sizeof(block)))
+				return "Could not write process memory";
+			result.bytesWritten += sizeof(block);
+		}
+
+		std::uint64_t value = 0;
+		if (const char* error = tracee.Call(symbols.startThread, { remote + offsetof(LoaderThread, thread), 0, session.codePage + ThreadStubOffset, remote }, value))
+			return error;
+		if (static_cast<std::int32_t>(value) != 0)
+			return "Could not start the loader thread";
+
+		thread = remote;
+		return nullptr;
+	}
+
+	/**
+	* @brief Waits for the loader thread of a job, at most until the deadline.
+	* @param thread The block returned by StartLoader().
+	* @remarks Polls the thread's completion word, backing off from 20 µs to 1 ms. When the job
+	*  is cancelled or runs out of time the loader is told to stop before the next library and
+	*  left running; the region is left to it and the next job maps a new one.
+	*/
+	injection::InjectionResult WaitForLoader(injection::InjectionJob& job, TargetSession& session, injection::RemoteMemory& memory, const StagedBatch& staged, std::uint64_t thread, injection::InjectionResult& result)
+	{
+		using injection::JobPhase;
+		using injection::JobState;
+
+		const injection::InjectionRequest& request = job.Planned();
+		const std::size_t count = request.libraries.size();
+		std::vector<unsigned char> block(sizeof(BatchHeader) + count * sizeof(BatchEntry));
+
+		injection::PhaseTimer loadTimer(injection::InjectionPhase::Load);
+		std::chrono::microseconds backoff{ 20 };
+		for (;;) {
+			std::uint32_t done = 0;
+			if (!memory.Read(thread + offsetof(LoaderThread, done), &done, sizeof(done)) || !memory.Read(staged.base, block.data(), block.size())) {
+				process::ProcessDetails details;
+				return Fail(result, JobState::Failed, process::QueryProcessDetails(request.target, details) ? "Could not read the loader results" : "The selected process has exited");
+			}
+			if (done)
+				break;
+
+			std::size_t attempted = 0;
+			for (std::size_t i = 0; i < count; i++) {
+				BatchEntry entry;
+				std::memcpy(&entry, block.data() + sizeof(BatchHeader) + i * sizeof(BatchEntry), sizeof(entry));
+				attempted += entry.attempted;
+			}
+			job.SetPhase(JobPhase::Loading, std::min(attempted, count - 1));
+
+			const bool cancelled = job.CancelRequested();
+			if (cancelled || std::chrono::steady_clock::now() >= job.Deadline()) {
+				const std::uint32_t abort = 1;
+				memory.Write(staged.base + offsetof(BatchHeader, abort), &abort, sizeof(abort));
+				RecordEntries(block, count, result);
+				session.arena.Detach();
+				return cancelled ? Fail(result, JobState::Cancelled, nullptr) : Fail(result, JobState::TimedOut, "The libraries did not load before the deadline");
+			}
+
+			std::this_thread::sleep_for(backoff);
+			backoff = std::min(backoff * 2, std::chrono::microseconds(1000));
+		}
+		loadTimer.Stop();
+
+		// the thread is gone, its message was copied into the block
+		injection::PhaseTimer readTimer(injection::InjectionPhase::ReadResults);
+		char message[sizeof(LoaderThread::message)] = { };
+		memory.Read(thread + offsetof(LoaderThread, message), message, sizeof(message) - 1);
+		readTimer.Stop();
+
+		if (RecordEntries(block, count, result) != count)
+			return Fail(result, JobState::Failed, "The loader stopped early");
+		return FinishLoading(result, count, message);
+	}
+
+	/**
+	* @brief Does the work of Execute() once the session is locked.
+	* @param stale Modules of changed libraries, dlclose'd (as often as our jobs loaded them)
+	*  before anything is loaded.
+	* @remarks dlopen, mmap and friends are located in the target's own libc before the target
+	*  is touched (see SymbolResolver). The main thread, or a sleeping one for a minimal stop
+	*  job, is then seized and interrupted; a thread stopped inside ld.so, typically because the
+	*  process has only just been started, is released and stopped again a millisecond later
+	*  until it is out, as calling dlopen there would deadlock or crash. The parameter block is
+	*  written into the region of the target's session, while the target still runs if an
+	*  earlier job left one, and the loader thread is started (see StartLoader()). Targets
+	*  without threads load during the stop instead (see ExecuteBatch() and ExecuteStopped()).
+	*  The registers are restored before detaching and the time the target was held is
+	*  reported in the result.
+	*
+	*  A job with useAgent starts the resident agent instead (see StartAgent()), then loads
+	*  through it like every later job on the target, which does not stop the target at all
+	*  and honours the batched flag (see LoadThroughAgent()). Where the agent cannot be started
+	*  the job loads as usual.
+	*/
+	injection::InjectionResult LoadIntoTarget(injection::InjectionJob& job, TargetSession& session, const std::vector<injection::StaleModule>& stale, injection::InjectionResult& result)
+	{
+		using injection::JobState;
+
+		const injection::InjectionRequest& request = job.Planned();
+
+		// with the agent running nothing is stopped or attached to; a killed target leaves its
+		// flags as they were, so the process is looked at first instead of waiting for the deadline
+		if (request.useAgent && session.agent.Attached() && !session.agent.Exited()) {
+			process::ProcessDetails details;
+			if (!process::QueryProcessDetails(request.target, details))
+				return Fail(result, JobState::Failed, "The selected process has exited");
+
+			session.payloads.DropStale(stale, result, [&](std::uint64_t module) {
+				std::uint64_t value = 0;
+				return !session.agent.Run(injection::AgentCommand::Unload, module, 0, job.Deadline(), value) && static_cast<std::int32_t>(value) == 0;
+			});
+			return injection::LoadThroughAgent(job, session.agent, result);
+		}
+
+		const auto pid = static_cast<pid_t>(request.target.pid);
+
+		// everything that does not need the target stopped comes first
+		injection::LoaderSymbols symbols;
+		if (const char* error = injection::SymbolResolver::Shared().Resolve(request.target, pid, symbols))
+			return Fail(result, JobState::Failed, error);
+
+		const pid_t tid = request.minimalStop ? PickThread(pid) : pid;
+		injection::RemoteMemory memory(pid);
+
+		// the libraries load on a thread of the target's own where it has threads
+		const bool onThread = symbols.startThread && symbols.currentThread && symbols.detachThread;
+
+		StagedBatch staged;
+		if (request.minimalStop || onThread)
+			StageBatch(session, memory, request, symbols, staged, result);
+
+		std::optional<Tracee> tracee;
+		injection::PhaseTimer openTimer(injection::InjectionPhase::OpenProcess);
+
+		// a thread stopped inside ld.so, e.g. of a process still starting up, is let go and tried again
+		std::chrono::nanoseconds stoppedInLoader{ 0 };
+		for (;;) {
+			tracee.emplace(tid);
+			process::ProcessDetails details;
+			if (const char* error = tracee->Seize())
+				return Fail(result, JobState::Failed, process::QueryProcessDetails(request.target, details) ? error : "The selected process has exited");
+
+			// the pid cannot be reused while we trace it, so checking after attaching is race free
+			if (!process::QueryProcessDetails(request.target, details) || !ThreadState(pid, tid))
+				return Fail(result, JobState::Failed, "The selected process has exited");
+
+			if (const char* error = tracee->Interrupt()) {
+				tracee->Detach();
+				return Fail(result, JobState::Failed, error);
+			}
+
+			const std::uint64_t rip = tracee->InstructionPointer();
+			if (rip < symbols.loaderBegin || rip >= symbols.loaderEnd)
+				break;
+
+			tracee->Detach();
+			stoppedInLoader += tracee->StoppedFor();
+			if (std::chrono::steady_clock::now() >= job.Deadline())
+				return Fail(result, JobState::TimedOut, "The process did not leave its dynamic loader before the deadline");
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		openTimer.Stop();
+
+		// modules of changed files go first, dlopen would merely find them again
+		session.payloads.DropStale(stale, result, [&](std::uint64_t module) {
+			std::uint64_t value = 0;
+			return symbols.unload != 0 && !tracee->Call(symbols.unload, { module }, value) && static_cast<std::int32_t>(value) == 0;
+		});
+
+		// a job that starts the agent lets the thread go right away and loads through the agent
+		bool viaAgent = false;
+		if (request.useAgent) {
+			const char* error = StartAgent(session, *tracee, memory, pid, symbols, result);
+			viaAgent = !error;
+			if (error)
+				result.warning = std::string("Loaded without the agent: ") + error;
+		}
+
+		// otherwise a loader thread is started and waited for once the target runs again
+		std::uint64_t thread = 0;
+		if (!viaAgent && onThread) {
+			result.libraries.resize(request.libraries.size());
+			if (const char* error = StartLoader(job, session, *tracee, memory, symbols, staged, thread, result))
+				result.warning = std::string("Loaded on the stopped thread: ") + error;
+		}
+
+		injection::InjectionResult outcome;
+		if (!viaAgent && !thread)
+			outcome = request.minimalStop ? ExecuteBatch(job, session, *tracee, memory, symbols, staged, result) : ExecuteStopped(job, session, *tracee, memory, symbols, result);
+
+		tracee->Detach();
+		const std::chrono::nanoseconds stopped = tracee->StoppedFor() + stoppedInLoader;
+		injection::InjectionMetrics::Shared().Record(injection::InjectionPhase::TargetStopped, stopped);
+
+		if (viaAgent)
+			outcome = injection::LoadThroughAgent(job, session.agent, result);
+		else if (thread)
+			outcome = WaitForLoader(job, session, memory, staged, thread, result);
+		outcome.targetStopped = stopped;
+		return outcome;
+	}
+#endif // __x86_64__
+}
+
+/**
+* @brief Loads every library of a job into its target process.
+* @param job The job, Begin() and Plan() must have been called.
+* @return The outcome of the job.
+* @remarks Unchanged jobs are skipped and imports checked first (see ExecuteInSession()), then
+*  a thread of the target is stopped just long enough to start a loader thread or the agent,
+*  which dlopen the libraries bounded by the job deadline (see LoadIntoTarget()).
+*/
+injection::InjectionResult injection::Execute(InjectionJob& job)
+{
+#ifndef __x86_64__
+	(void)job;
+	InjectionResult result;
+	return Fail(result, JobState::Failed, "Injection is only implemented for x86-64 on Linux");
+#else
+	const std::shared_ptr<TargetSession> session = FindOrCreateSession(job.Planned().target);
+	return ExecuteInSession(job, session->mutex, session->payloads, [&](const std::vector<StaleModule>& stale, InjectionResult& result) {
+		return LoadIntoTarget(job, *session, stale, result);
+	});
+#endif
+}
+
+/**
+* @brief Forgets the session of a target.
+* @param target The process.
+*/
+void injection::ReleaseTarget(const process::ProcessKey& target)
+{
+	std::shared_ptr<TargetSession> session;
+	{
+		SessionTable& table = Sessions();
+		std::lock_guard lock(table.mutex);
+
+		const auto found = table.sessions.find(target);
+		if (found == table.sessions.end())
+			return;
+
+		session = std::move(found->second);
+		table.sessions.erase(found);
+	}
+
+	SymbolResolver::Shared().Forget(target);
+	process::ModuleCache::Shared().Forget(target);
+}
+
+/**
+* @brief Forgets the sessions of all targets.
+*/
+void injection::ReleaseAllTargets()
+{
+	std::unordered_map<process::ProcessKey, std::shared_ptr<TargetSession>, process::ProcessKeyHash> sessions;
+	{
+		SessionTable& table = Sessions();
+		std::lock_guard lock(table.mutex);
+		sessions.swap(table.sessions);
+	}
+
+	SymbolResolver::Shared().Clear();
+	process::ModuleCache::Shared().Clear();
+}
+
+/**
+* @brief Unloads a library through the agent of a target.
+* @param target The process.
+* @param module The handle dlopen returned.
+* @param timeout How long to wait for dlclose.
+* @return Null on success, otherwise the error.
+*/
+const char* injection::UnloadLibrary(const process::ProcessKey& target, std::uint64_t module, std::chrono::milliseconds timeout)
+{
+	const std::shared_ptr<TargetSession> session = FindSession(target);
+	if (!session)
+		return "No agent runs in the process";
+
+	std::lock_guard lock(session->mutex);
+
+	std::uint64_t value = 0;
+	if (const char* error = session->agent.Run(AgentCommand::Unload, module, 0, std::chrono::steady_clock::now() + timeout, value))
+		return error;
+	if (static_cast<std::int32_t>(value) != 0)
+		return "dlclose failed in the target process";
+
+	session->payloads.Unloaded(module);
+	return nullptr;
+}
+
+/**
+* @brief Calls a function on the agent thread of a target.
+* @param target The process.
+* @param function The remote address.
+* @param argument Its argument.
+* @param value Receives rax.
+* @param timeout How long to wait for the function.
+* @return Null on success, otherwise the error.
+*/
+const char* injection::CallFunction(const process::ProcessKey& target, std::uint64_t function, std::uint64_t argument, std::uint64_t& value, std::chrono::milliseconds timeout)
+{
+	const std::shared_ptr<TargetSession> session = FindSession(target);
+	if (!session)
+		return "No agent runs in the process";
+
+	std::lock_guard lock(session->mutex);
+	return session->agent.Run(AgentCommand::Call, function, argument, std::chrono::steady_clock::now() + timeout, value);
+}
+
+#endif // __linux__
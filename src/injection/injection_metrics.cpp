@@ -0,0 +1,102 @@
+/**
+ * @file injection_metrics.cpp
+ * @brief Implements the injection latency metrics.
+ */
+
+#include "injection_metrics.h"
+
+#include <fstream>
+
+/**
+* @brief Gets the display name of a phase.
+* @param phase The phase.
+* @return A static string.
+*/
+const char* injection::PhaseName(InjectionPhase phase) noexcept
+{
+	switch (phase) {
+	case InjectionPhase::Queue: return "queue";
+	case InjectionPhase::OpenProcess: return "open";
+	case InjectionPhase::Validate: return "validate";
+	case InjectionPhase::Allocate: return "allocate";
+	case InjectionPhase::Write: return "write";
+	case InjectionPhase::CreateThread: return "thread";
+	case InjectionPhase::Load: return "load";
+	case InjectionPhase::ReadResults: return "read";
+	case InjectionPhase::TargetStopped: return "stopped";
+	case InjectionPhase::Total: return "total";
+	case InjectionPhase::Detect: return "detect";
+	case InjectionPhase::Spawn: return "spawn";
+	default: return "?";
+	}
+}
+
+/**
+* @brief Gets the metrics used throughout the application.
+* @return The shared metrics.
+*/
+injection::InjectionMetrics& injection::InjectionMetrics::Shared()
+{
+	static InjectionMetrics metrics;
+	return metrics;
+}
+
+/**
+* @brief Records the duration of one phase.
+* @param phase The phase.
+* @param duration How long it took.
+*/
+void injection::InjectionMetrics::Record(InjectionPhase phase, std::chrono::steady_clock::duration duration) noexcept
+{
+	histograms[static_cast<std::size_t>(phase)].Record(duration);
+}
+
+/**
+* @brief Clears all histograms.
+*/
+void injection::InjectionMetrics::Reset() noexcept
+{
+	for (LatencyHistogram& histogram : histograms)
+		histogram.Reset();
+}
+
+/**
+* @brief Writes all histograms as text.
+* @param out The stream to write to.
+* @remarks Values are in nanoseconds. The bucket lines ("bucket <phase> <lower> <upper> <count>")
+*  keep the full distribution, so two dumps can be compared beyond the summary.
+*/
+void injection::InjectionMetrics::Dump(std::ostream& out) const
+{
+	out << "# phase count p50_ns p90_ns p99_ns max_ns mean_ns\n";
+	for (std::size_t i = 0; i < histograms.size(); i++) {
+		const LatencySummary summary = histograms[i].Summarize();
+		out << PhaseName(static_cast<InjectionPhase>(i)) << ' ' << summary.count << ' ' << summary.p50 << ' ' << summary.p90 << ' '
+			<< summary.p99 << ' ' << summary.max << ' ' << static_cast<std::uint64_t>(summary.mean) << '\n';
+	}
+
+	for (std::size_t i = 0; i < histograms.size(); i++) {
+		for (std::size_t bucket = 0; bucket < LatencyHistogram::BucketCount; bucket++) {
+			const std::uint64_t value = histograms[i].BucketValue(bucket);
+			if (value != 0) {
+				out << "bucket " << PhaseName(static_cast<InjectionPhase>(i)) << ' ' << LatencyHistogram::BucketLowerBound(bucket) << ' '
+					<< LatencyHistogram::BucketUpperBound(bucket) << ' ' << value << '\n';
+			}
+		}
+	}
+}
+
+/**
+* @brief Writes all histograms to a file.
+* @param path The file, replaced if it exists.
+* @return False if the file could not be written.
+*/
+bool injection::InjectionMetrics::DumpToFile(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file)
+		return false;
+
+	Dump(file);
+	return static_cast<bool>(file);
+}
@@ -0,0 +1,95 @@
+/**
+
+@file injection_metrics.h
+@brief Per-phase latency histograms of all injections.
+*/
+
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "latency_histogram.h"
+
+namespace injection
+{
+	/**
+	* @brief The timed steps of an injection.
+	*/
+	enum class InjectionPhase : std::uint8_t
+	{
+		Queue,         // submission until a worker picks the job up
+		OpenProcess,   // opening and verifying the target
+		Validate,      // checking the payload files, before the target is touched
+		Allocate,      // reserving remote memory
+		Write,         // writing paths, stub and parameters
+		CreateThread,  // starting the remote thread
+		Load,          // waiting for the loader, i.e. the DllMain of the payloads
+		ReadResults,   // reading the loader results back
+		TargetStopped, // time the target was held stopped, only where injecting stops it
+		Total,         // a worker picking the job up until its result
+		Detect,        // watch mode: the target starting until its job was submitted
+		Spawn,         // watch mode: the target starting until its job succeeded
+		Count,
+	};
+
+	// short lower case name of a phase, for the UI and the dump
+	const char* PhaseName(InjectionPhase phase) noexcept;
+
+	/**
+	* @brief One histogram per phase, shared by all workers.
+	*/
+	class InjectionMetrics
+	{
+	public:
+		// the metrics all injections report to
+		static InjectionMetrics& Shared();
+
+		void Record(InjectionPhase phase, std::chrono::steady_clock::duration duration) noexcept;
+
+		const LatencyHistogram& Histogram(InjectionPhase phase) const noexcept { return histograms[static_cast<std::size_t>(phase)]; }
+
+		void Reset() noexcept;
+
+		// writes a summary line per phase followed by the non-empty buckets
+		void Dump(std::ostream& out) const;
+		bool DumpToFile(const std::string& path) const;
+
+	private:
+		std::array<LatencyHistogram, static_cast<std::size_t>(InjectionPhase::Count)> histograms;
+	};
+
+	/**
+	* @brief Times a phase from construction until destruction or Stop().
+	*/
+	class PhaseTimer
+	{
+	public:
+		explicit PhaseTimer(InjectionPhase phase) noexcept
+			: phase(phase), start(std::chrono::steady_clock::now())
+		{
+		}
+
+		~PhaseTimer() { Stop(); }
+
+		PhaseTimer(const PhaseTimer&) = delete;
+		PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+		// records the elapsed time now, later calls do nothing
+		void Stop() noexcept
+		{
+			if (stopped)
+				return;
+			stopped = true;
+			InjectionMetrics::Shared().Record(phase, std::chrono::steady_clock::now() - start);
+		}
+
+	private:
+		const InjectionPhase phase;
+		const std::chrono::steady_clock::time_point start;
+		bool stopped = false;
+	};
+}
@@ -0,0 +1,207 @@
+/**
+ * @file injection_queue.cpp
+ * @brief Implements the injection worker pool.
+ */
+
+#include "injection_queue.h"
+#include "injection_metrics.h"
+
+#include <algorithm>
+
+/**
+* @brief Creates a stopped queue.
+* @param maxWorkers Number of worker threads, the upper bound of the concurrency.
+* @param concurrency Number of jobs that may run at the same time.
+* @param historySize Number of groups kept for RecentGroups().
+*/
+injection::InjectionQueue::InjectionQueue(std::size_t maxWorkers, std::size_t concurrency, std::size_t historySize)
+	: maxWorkers(maxWorkers ? maxWorkers : 1),
+	historySize(historySize),
+	concurrency(std::clamp<std::size_t>(concurrency, 1, this->maxWorkers))
+{
+}
+
+/**
+* @brief Stops the workers if they are still running.
+*/
+injection::InjectionQueue::~InjectionQueue()
+{
+	Stop();
+}
+
+/**
+* @brief Starts the worker threads.
+*/
+void injection::InjectionQueue::Start()
+{
+	if (!workers.empty())
+		return;
+
+	{
+		std::lock_guard lock(mutex);
+		stopping = false;
+	}
+
+	for (std::size_t i = 0; i < maxWorkers; i++)
+		workers.emplace_back(&InjectionQueue::Run, this);
+}
+
+/**
+* @brief Cancels the queued jobs and joins the workers.
+* @remarks Running jobs are asked to cancel as well, a library that is currently being loaded
+*  still gets until the job deadline.
+*/
+void injection::InjectionQueue::Stop() noexcept
+{
+	std::deque<std::shared_ptr<InjectionJob>> dropped;
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+		dropped.swap(pending);
+
+		for (const auto& group : history)
+			group->Cancel();
+	}
+	wake.notify_all();
+
+	for (const auto& job : dropped) {
+		InjectionResult result;
+		result.state = JobState::Cancelled;
+		job->Finish(std::move(result));
+	}
+
+	for (std::thread& worker : workers)
+		worker.join();
+	workers.clear();
+}
+
+/**
+* @brief Limits the number of jobs running at the same time.
+* @param concurrency The new limit, running jobs above it are allowed to finish.
+*/
+void injection::InjectionQueue::SetConcurrency(std::size_t concurrency) noexcept
+{
+	{
+		std::lock_guard lock(mutex);
+		this->concurrency = std::clamp<std::size_t>(concurrency, 1, maxWorkers);
+	}
+	wake.notify_all();
+}
+
+/**
+* @brief Gets the concurrency limit.
+* @return The number of jobs that may run at the same time.
+*/
+std::size_t injection::InjectionQueue::GetConcurrency() const noexcept
+{
+	std::lock_guard lock(mutex);
+	return concurrency;
+}
+
+/**
+* @brief Enqueues an injection request.
+* @param request What to inject where.
+* @return The job, its Result() becomes ready once a worker is done with it.
+* @remarks Jobs submitted while the queue is stopped wait until Start().
+*/
+std::shared_ptr<injection::InjectionJob> injection::InjectionQueue::Submit(InjectionRequest request)
+{
+	std::vector<InjectionRequest> requests;
+	requests.push_back(std::move(request));
+	return SubmitGroup(std::move(requests))->Jobs().front();
+}
+
+/**
+* @brief Enqueues a fan-out injection.
+* @param requests One request per target.
+* @return The group, which tracks the jobs of all targets.
+*/
+std::shared_ptr<injection::InjectionGroup> injection::InjectionQueue::SubmitGroup(std::vector<InjectionRequest> requests)
+{
+	std::shared_ptr<InjectionGroup> group;
+	{
+		std::lock_guard lock(mutex);
+
+		std::vector<std::shared_ptr<InjectionJob>> jobs;
+		jobs.reserve(requests.size());
+		for (InjectionRequest& request : requests)
+			jobs.push_back(std::make_shared<InjectionJob>(nextJobId++, std::move(request)));
+
+		pending.insert(pending.end(), jobs.begin(), jobs.end());
+		group = std::make_shared<InjectionGroup>(nextGroupId++, std::move(jobs));
+
+		history.push_front(group);
+		if (history.size() > historySize)
+			history.pop_back();
+	}
+	wake.notify_all();
+	return group;
+}
+
+/**
+* @brief Gets the most recently submitted groups.
+* @param out Receives the groups, newest first.
+*/
+void injection::InjectionQueue::RecentGroups(std::vector<std::shared_ptr<InjectionGroup>>& out) const
+{
+	std::lock_guard lock(mutex);
+	out.assign(history.begin(), history.end());
+}
+
+/**
+* @brief Worker loop, executes jobs until Stop() is called.
+*/
+void injection::InjectionQueue::Run()
+{
+	std::unique_lock lock(mutex);
+	for (;;)
+	{
+		wake.wait(lock, [this] { return stopping || (!pending.empty() && running < concurrency); });
+		if (stopping)
+			break;
+
+		std::shared_ptr<InjectionJob> job = std::move(pending.front());
+		pending.pop_front();
+		++running;
+		lock.unlock();
+
+		if (job->CancelRequested()) {
+			InjectionResult result;
+			result.state = JobState::Cancelled;
+			job->Finish(std::move(result));
+		}
+		else {
+			job->Begin();
+			InjectionMetrics::Shared().Record(InjectionPhase::Queue, job->StartedAt() - job->SubmittedAt());
+
+			const auto spawnedAt = job->Request().spawnedAt;
+			if (spawnedAt != std::chrono::steady_clock::time_point{ })
+				InjectionMetrics::Shared().Record(InjectionPhase::Detect, job->SubmittedAt() - spawnedAt);
+
+			PhaseTimer total(InjectionPhase::Total);
+			InjectionResult result;
+			if (std::string error; !job->Plan(error)) {
+				// payloads that cannot be ordered fail the job before anything touches its target
+				result.error = std::move(error);
+			}
+			else {
+				result = job->Request().unload.empty() ? Execute(*job) : ExecuteUnload(*job);
+			}
+			total.Stop();
+
+			const bool succeeded = result.state == JobState::Succeeded;
+			job->Finish(std::move(result));
+
+			// spawn to injected, the number watch mode is tuned by
+			if (succeeded && spawnedAt != std::chrono::steady_clock::time_point{ })
+				InjectionMetrics::Shared().Record(InjectionPhase::Spawn, job->FinishedAt() - spawnedAt);
+		}
+
+		job.reset();
+		lock.lock();
+		--running;
+
+		// a slot is free again, another worker may start the next job
+		wake.notify_one();
+	}
+}
@@ -0,0 +1,78 @@
+/**
+
+@file injection_queue.h
+@brief Worker threads executing injection jobs off the render thread.
+*/
+
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "injection_group.h"
+#include "injection_job.h"
+
+namespace injection
+{
+	/**
+	* @brief First in, first out queue of injection jobs served by a pool of worker threads.
+	* @remarks Submit() only enqueues and returns, the render thread never waits for a target
+	*  process. Every job is bounded by its own deadline, so a hung DllMain ties up one worker
+	*  for at most that long; the job then ends TimedOut with the library still loading. The
+	*  exception is a Linux target without pthread_create, whose libraries load on a hijacked
+	*  thread that cannot be let go until dlopen returns. At most GetConcurrency() jobs run at the same time, which keeps
+	*  a fan-out over hundreds of targets from starving the host. The most recent groups are
+	*  kept for the UI to display.
+	*/
+	class InjectionQueue
+	{
+	public:
+		explicit InjectionQueue(std::size_t maxWorkers = 8, std::size_t concurrency = 2, std::size_t historySize = 16);
+		~InjectionQueue();
+
+		InjectionQueue(const InjectionQueue&) = delete;
+		InjectionQueue& operator=(const InjectionQueue&) = delete;
+
+		// starts the worker threads, does nothing if they are already running
+		void Start();
+
+		// cancels all queued jobs, waits for the running ones (bounded by their deadlines) and joins the workers
+		void Stop() noexcept;
+
+		// number of jobs allowed to run at once, clamped to [1, maxWorkers]
+		void SetConcurrency(std::size_t concurrency) noexcept;
+		std::size_t GetConcurrency() const noexcept;
+
+		// enqueues a request as a group of one, the returned job can be polled or waited on through Result()
+		std::shared_ptr<InjectionJob> Submit(InjectionRequest request);
+
+		// enqueues one job per request, typically one request per target process
+		std::shared_ptr<InjectionGroup> SubmitGroup(std::vector<InjectionRequest> requests);
+
+		// copies the most recent groups, newest first
+		void RecentGroups(std::vector<std::shared_ptr<InjectionGroup>>& out) const;
+
+	private:
+		void Run();
+
+		const std::size_t maxWorkers;
+		const std::size_t historySize;
+
+		std::vector<std::thread> workers;
+		mutable std::mutex mutex;
+		std::condition_variable wake;
+		bool stopping = false;
+		std::size_t concurrency;
+		std::size_t running = 0;
+
+		std::deque<std::shared_ptr<InjectionJob>> pending;
+		std::deque<std::shared_ptr<InjectionGroup>> history; // newest first
+		std::uint64_t nextJobId = 1;
+		std::uint64_t nextGroupId = 1;
+	};
+}
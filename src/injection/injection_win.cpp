@@ -0,0 +1,915 @@
+/**
+ * @file injection_win.cpp
+ * @brief Windows injection through LoadLibraryA in a remote thread.
+ */
+
+#ifdef _WIN32
+
+#include "agent_channel.h"
+#include "injection_job.h"
+#include "injection_metrics.h"
+#include "payload_cache.h"
+#include "payload_graph.h"
+#include "pe_image.h"
+#include "remote_arena.h"
+#include "remote_memory.h"
+#include "symbol_resolver.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <windows.h>
+
+namespace
+{
+	/**
+	* @brief Closes a handle when leaving the scope.
+	*/
+	struct HandleGuard
+	{
+		HANDLE handle = nullptr;
+
+		~HandleGuard()
+		{
+			if (handle)
+				CloseHandle(handle);
+		}
+	};
+
+	/**
+	* @brief What is kept per target between injections.
+	* @remarks The handle is only closed when the target exits or the application shuts down,
+	*  and the remote region with the loader stub is reused by every job.
+	*/
+	struct TargetSession
+	{
+		// held for the whole job, jobs for one target never overlap
+		std::mutex mutex;
+
+		HANDLE process = nullptr;
+		injection::RemoteArena arena;
+
+		// the resident agent, once a job asked for it; its code has a page of its own, which is
+		// never freed since the agent may still run it
+		injection::AgentChannel agent;
+
+		// what skipUnchanged jobs have loaded
+		injection::LoadedPayloads payloads;
+
+		~TargetSession()
+		{
+			agent.RequestStop();
+			if (!process)
+				return;
+
+			if (arena.Attached())
+				VirtualFreeEx(process, reinterpret_cast<LPVOID>(arena.Base()), 0, MEM_RELEASE);
+			CloseHandle(process);
+		}
+	};
+
+	/**
+	* @brief Sessions of all targets, keyed by process identity.
+	*/
+	struct SessionTable
+	{
+		std::mutex mutex;
+		std::unordered_map<process::ProcessKey, std::shared_ptr<TargetSession>, process::ProcessKeyHash> sessions;
+	};
+
+	SessionTable& Sessions()
+	{
+		static SessionTable table;
+		return table;
+	}
+
+	std::shared_ptr<TargetSession> FindSession(const process::ProcessKey& key)
+	{
+		SessionTable& table = Sessions();
+		std::lock_guard lock(table.mutex);
+
+		const auto found = table.sessions.find(key);
+		return found != table.sessions.end() ? found->second : nullptr;
+	}
+
+	std::shared_ptr<TargetSession> FindOrCreateSession(const process::ProcessKey& key)
+	{
+		SessionTable& table = Sessions();
+		std::lock_guard lock(table.mutex);
+
+		std::shared_ptr<TargetSession>& session = table.sessions[key];
+		if (!session)
+			session = std::make_shared<TargetSession>();
+		return session;
+	}
+
+	/**
+	* @brief Start of the parameter block of the batch loader stub.
+	* @remarks Fields are 64 bits wide for both stubs, the x86 stub only uses the low halves.
+	*/
+	struct BatchHeader
+	{
+		std::uint64_t loadLibrary;
+		std::uint64_t getLastError;
+		std::uint32_t count;
+		std::uint32_t reserved;
+	};
+
+	/**
+	* @brief One library of a batch, the stub fills module and error.
+	*/
+	struct BatchEntry
+	{
+		std::uint64_t path;
+		std::uint64_t module;
+		std::uint32_t error;
+		std::uint32_t reserved;
+	};
+
+	static_assert(sizeof(BatchHeader) == 24 && sizeof(BatchEntry) == 24, "layout is hard coded in the loader stubs");
+
+	/**
+	* @brief Thread routine that loads every entry of a batch.
+	* @remarks Equivalent to
+	*  for (i = 0; i < header->count; i++) {
+	*      entry[i].module = LoadLibraryA(entry[i].path);
+	*      if (!entry[i].module) entry[i].error = GetLastError();
+	*  }
+	*  return 0;
+	*  A 64-bit build carries both stubs and picks the one matching the target.
+	*/
+	constexpr unsigned char LoaderStub64[] = {
+		0x53,                   // push rbx
+		0x56,                   // push rsi
+		0x57,                   // push rdi
+		0x48, 0x83, 0xEC, 0x20, // sub rsp, 20h          ; shadow space, keeps rsp 16 byte aligned
+		0x48, 0x89, 0xCB,       // mov rbx, rcx          ; header
+		0x8B, 0x7B, 0x10,       // mov edi, [rbx+10h]    ; count
+		0x48, 0x8D, 0x73, 0x18, // lea rsi, [rbx+18h]    ; first entry
+		// next:
+		0x85, 0xFF,             // test edi, edi
+		0x74, 0x1C,             // jz done
+		0x48, 0x8B, 0x0E,       // mov rcx, [rsi]        ; path
+		0xFF, 0x13,             // call [rbx]            ; LoadLibraryA
+		0x48, 0x89, 0x46, 0x08, // mov [rsi+8], rax
+		0x48, 0x85, 0xC0,       // test rax, rax
+		0x75, 0x06,             // jnz loaded
+		0xFF, 0x53, 0x08,       // call [rbx+8]          ; GetLastError
+		0x89, 0x46, 0x10,       // mov [rsi+10h], eax
+		// loaded:
+		0x48, 0x83, 0xC6, 0x18, // add rsi, 18h
+		0xFF, 0xCF,             // dec edi
+		0xEB, 0xE0,             // jmp next
+		// done:
+		0x48, 0x83, 0xC4, 0x20, // add rsp, 20h
+		0x5F,                   // pop rdi
+		0x5E,                   // pop rsi
+		0x5B,                   // pop rbx
+		0x31, 0xC0,             // xor eax, eax
+		0xC3,                   // ret
+	};
+
+	constexpr unsigned char LoaderStub32[] = {
+		0x53,                   // push ebx
+		0x56,                   // push esi
+		0x57,                   // push edi
+		0x8B, 0x5C, 0x24, 0x10, // mov ebx, [esp+10h]    ; header
+		0x8B, 0x7B, 0x10,       // mov edi, [ebx+10h]    ; count
+		0x8D, 0x73, 0x18,       // lea esi, [ebx+18h]    ; first entry
+		// next:
+		0x85, 0xFF,             // test edi, edi
+		0x74, 0x17,             // jz done
+		0xFF, 0x36,             // push dword [esi]      ; path
+		0xFF, 0x13,             // call [ebx]            ; LoadLibraryA
+		0x89, 0x46, 0x08,       // mov [esi+8], eax
+		0x85, 0xC0,             // test eax, eax
+		0x75, 0x06,             // jnz loaded
+		0xFF, 0x53, 0x08,       // call [ebx+8]          ; GetLastError
+		0x89, 0x46, 0x10,       // mov [esi+10h], eax
+		// loaded:
+		0x83, 0xC6, 0x18,       // add esi, 18h
+		0x4F,                   // dec edi
+		0xEB, 0xE5,             // jmp next
+		// done:
+		0x5F,                   // pop edi
+		0x5E,                   // pop esi
+		0x5B,                   // pop ebx
+		0x31, 0xC0,             // xor eax, eax
+		0xC2, 0x04, 0x00,       // ret 4
+	};
+
+	/**
+	* @brief Thread routine of the resident agent, serves the ring until asked to stop.
+	* @remarks Equivalent to
+	*  for (;;) {
+	*      while (control->tail == control->head) {
+	*          if (control->stop) { control->exited = 1; SetEvent(control->completion); return 0; }
+	*          WaitForSingleObject(control->doorbell, INFINITE);
+	*      }
+	*      slot = slots[control->tail & control->mask];
+	*      switch (slot->command) {
+	*      case Load:   slot->value = LoadLibraryA(slot->path);
+	*                   if (!slot->value) slot->error = GetLastError(); break;
+	*      case Unload: slot->value = FreeLibrary(slot->argument); break;
+	*      case Call:   slot->value = slot->argument(slot->parameter); break;
+	*      }
+	*      control->tail++;
+	*      SetEvent(control->completion);
+	*  }
+	*  Only for 64-bit targets, 32-bit ones keep using a remote thread per job.
+	*/
+	constexpr unsigned char AgentStub64[] = {
+		0x53,                               // push rbx
+		0x56,                               // push rsi
+		0x57,                               // push rdi
+		0x48, 0x83, 0xEC, 0x20,             // sub rsp, 20h      ; shadow space, keeps rsp 16 byte aligned
+		0x48, 0x89, 0xCB,                   // mov rbx, rcx      ; control
+		// next:
+		0x8B, 0x73, 0x40,                   // mov esi, [rbx+40h] ; tail
+		0x3B, 0x33,                         // cmp esi, [rbx]    ; head
+		0x75, 0x1E,                         // jne work
+		0x83, 0x7B, 0x04, 0x00,             // cmp dword [rbx+4], 0 ; stop
+		0x0F, 0x85, 0x8A, 0x00, 0x00, 0x00, // jne quit
+		0x48, 0x8B, 0x8B, 0xB0, 0x00, 0x00, 0x00, // mov rcx, [rbx+0B0h] ; doorbell
+		0xBA, 0xFF, 0xFF, 0xFF, 0xFF,       // mov edx, INFINITE
+		0xFF, 0x93, 0xA0, 0x00, 0x00, 0x00, // call [rbx+0A0h]   ; WaitForSingleObject
+		0xEB, 0xDB,                         // jmp next
+		// work:
+		0x89, 0xF0,                         // mov eax, esi
+		0x23, 0x83, 0x80, 0x00, 0x00, 0x00, // and eax, [rbx+80h] ; mask
+		0x48, 0xC1, 0xE0, 0x0C,             // shl rax, 12
+		0x48, 0x8D, 0xBC, 0x03, 0x00, 0x10, 0x00, 0x00, // lea rdi, [rbx+rax+1000h] ; slot
+		0x8B, 0x07,                         // mov eax, [rdi]    ; command
+		0x83, 0xF8, 0x01,                   // cmp eax, 1
+		0x75, 0x1F,                         // jne notload
+		0x48, 0x8D, 0x4F, 0x28,             // lea rcx, [rdi+28h] ; path
+		0xFF, 0x93, 0x88, 0x00, 0x00, 0x00, // call [rbx+88h]    ; LoadLibraryA
+		0x48, 0x89, 0x47, 0x18,             // mov [rdi+18h], rax
+		0x48, 0x85, 0xC0,                   // test rax, rax
+		0x75, 0x31,                         // jnz complete
+		0xFF, 0x93, 0x90, 0x00, 0x00, 0x00, // call [rbx+90h]    ; GetLastError
+		0x48, 0x89, 0x47, 0x20,             // mov [rdi+20h], rax
+		0xEB, 0x25,                         // jmp complete
+		// notload:
+		0x83, 0xF8, 0x02,                   // cmp eax, 2
+		0x75, 0x10,                         // jne notunload
+		0x48, 0x8B, 0x4F, 0x08,             // mov rcx, [rdi+8]  ; module
+		0xFF, 0x93, 0x98, 0x00, 0x00, 0x00, // call [rbx+98h]    ; FreeLibrary
+		0x48, 0x89, 0x47, 0x18,             // mov [rdi+18h], rax
+		0xEB, 0x10,                         // jmp complete
+		// notunload:
+		0x83, 0xF8, 0x03,                   // cmp eax, 3
+		0x75, 0x0B,                         // jne complete
+		0x48, 0x8B, 0x4F, 0x10,             // mov rcx, [rdi+10h] ; parameter
+		0xFF, 0x57, 0x08,                   // call [rdi+8]      ; function
+		0x48, 0x89, 0x47, 0x18,             // mov [rdi+18h], rax
+		// complete:
+		0xFF, 0xC6,                         // inc esi
+		0x89, 0x73, 0x40,                   // mov [rbx+40h], esi ; tail
+		0x48, 0x8B, 0x8B, 0xB8, 0x00, 0x00, 0x00, // mov rcx, [rbx+0B8h] ; completion
+		0xFF, 0x93, 0xA8, 0x00, 0x00, 0x00, // call [rbx+0A8h]   ; SetEvent
+		0xE9, 0x65, 0xFF, 0xFF, 0xFF,       // jmp next
+		// quit:
+		0xC7, 0x43, 0x44, 0x01, 0x00, 0x00, 0x00, // mov dword [rbx+44h], 1 ; exited
+		0x48, 0x8B, 0x8B, 0xB8, 0x00, 0x00, 0x00, // mov rcx, [rbx+0B8h] ; completion
+		0xFF, 0x93, 0xA8, 0x00, 0x00, 0x00, // call [rbx+0A8h]   ; SetEvent
+		0x48, 0x83, 0xC4, 0x20,             // add rsp, 20h
+		0x5F,                               // pop rdi
+		0x5E,                               // pop rsi
+		0x5B,                               // pop rbx
+		0x31, 0xC0,                         // xor eax, eax
+		0xC3,                               // ret
+	};
+
+	// the stub gets a page of its own so it can be made executable without the data
+	constexpr std::size_t StubPageSize = 4096;
+
+	// VirtualAllocEx hands out whole 64 KiB blocks anyway
+	constexpr std::size_t RegionGranularity = 64 * 1024;
+
+	/**
+	* @brief Ends a job with an error.
+	*/
+	injection::InjectionResult Fail(injection::InjectionResult& result, injection::JobState state, const char* error)
+	{
+		result.state = state;
+		result.error = error ? error : "";
+		return std::move(result);
+	}
+
+	/**
+	* @brief Gets the time left until a deadline, as a wait timeout.
+	*/
+	DWORD RemainingMilliseconds(std::chrono::steady_clock::time_point deadline) noexcept
+	{
+		const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+		return left > 0 ? static_cast<DWORD>(left) : 0;
+	}
+
+	/**
+	* @brief Ends a job because of a payload, naming the file.
+	*/
+	injection::InjectionResult FailPayload(injection::InjectionResult& result, const std::string& library, const char* error)
+	{
+		const std::size_t name = library.find_last_of("\\/");
+		result.state = injection::JobState::Failed;
+		result.error = (name == std::string::npos ? library : library.substr(name + 1)) + ": " + error;
+		return std::move(result);
+	}
+
+	/**
+	* @brief Checks the payloads of a job before anything is done to the target.
+	* @param libraries The paths of the job.
+	* @param machines Receives the machine type of every library.
+	* @param error Receives what is wrong with the first library that is no loadable DLL.
+	* @return The index of that library, libraries.size() if all of them are fine.
+	* @remarks Each file is mapped and only its headers are read, which is cheap next to a
+	*  remote thread that would merely fail in LoadLibraryA with a less helpful error.
+	*/
+	std::size_t InspectPayloads(const std::vector<std::string>& libraries, std::vector<std::uint16_t>& machines, const char*& error)
+	{
+		injection::PhaseTimer timer(injection::InjectionPhase::Validate);
+
+		machines.resize(libraries.size());
+		for (std::size_t i = 0; i < libraries.size(); i++) {
+			error = injection::InspectPayload(libraries[i], machines[i]);
+			if (error)
+				return i;
+		}
+		return libraries.size();
+	}
+
+	/**
+	* @brief Opens the target of a session, once per target.
+	* @return Null on success, otherwise the error.
+	*/
+	const char* OpenTarget(TargetSession& session, const process::ProcessKey& key)
+	{
+		// a kept handle stays valid after the process exits, the agent would never answer
+		if (session.process)
+			return WaitForSingleObject(session.process, 0) == WAIT_OBJECT_0 ? "The selected process has exited" : nullptr;
+
+		injection::PhaseTimer timer(injection::InjectionPhase::OpenProcess);
+
+		HandleGuard process{ OpenProcess(PROCESS_ALL_ACCESS, FALSE, key.pid) };
+		if (!process.handle)
+			return "Could not open process";
+
+		// make sure the pid has not been reused by another process since it was selected,
+		// a process whose start time cannot be read is not known to be the selected one
+		FILETIME creation, exit, kernel, user;
+		if (!GetProcessTimes(process.handle, &creation, &exit, &kernel, &user) ||
+			(static_cast<std::uint64_t>(creation.dwHighDateTime) << 32 | creation.dwLowDateTime) != key.startTime) {
+			return "The selected process has exited";
+		}
+
+		session.process = process.handle;
+		process.handle = nullptr;
+		return nullptr;
+	}
+
+	/**
+	* @brief Makes sure the session has a region with room for a job and resets it.
+	* @param needed The number of data bytes the job will allocate.
+	* @param wide Whether the target is a 64-bit process.
+	* @return False if the region could not be set up.
+	* @remarks A new region is only reserved for the first job on a target or when a job needs
+	*  more room than the current region has. The loader stub is written once per region.
+	*/
+	bool PrepareArena(TargetSession& session, std::size_t needed, bool wide, injection::InjectionResult& result)
+	{
+		injection::RemoteArena& arena = session.arena;
+		if (arena.Attached() && arena.Available() >= needed) {
+			arena.Reset();
+			return true;
+		}
+
+		if (arena.Attached()) {
+			VirtualFreeEx(session.process, reinterpret_cast<LPVOID>(arena.Base()), 0, MEM_RELEASE);
+			arena.Detach();
+		}
+
+		const std::size_t capacity = (StubPageSize + needed + RegionGranularity - 1) / RegionGranularity * RegionGranularity;
+
+		injection::PhaseTimer allocateTimer(injection::InjectionPhase::Allocate);
+		LPVOID remote = VirtualAllocEx(session.process, nullptr, capacity, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+		allocateTimer.Stop();
+		if (!remote)
+			return false;
+		++result.remoteAllocations;
+
+		const std::span<const unsigned char> stub = wide ? std::span<const unsigned char>(LoaderStub64) : std::span<const unsigned char>(LoaderStub32);
+
+		injection::PhaseTimer writeTimer(injection::InjectionPhase::Write);
+		DWORD oldProtection = 0;
+		if (!injection::RemoteMemory(session.process).Write(reinterpret_cast<std::uint64_t>(remote), stub.data(), stub.size()) ||
+			!VirtualProtectEx(session.process, remote, StubPageSize, PAGE_EXECUTE_READ, &oldProtection)) {
+			VirtualFreeEx(session.process, remote, 0, MEM_RELEASE);
+			return false;
+		}
+		FlushInstructionCache(session.process, remote, stub.size());
+		result.bytesWritten += stub.size();
+
+		arena.Attach(reinterpret_cast<std::uint64_t>(remote), capacity, StubPageSize);
+		return true;
+	}
+
+	/**
+	* @brief Starts the resident agent of a target.
+	* @return Null on success, otherwise the error; the job then goes on without the agent.
+	* @remarks Nothing is stopped: the agent code goes into a page of its own, the shared
+	*  section and the two events are mapped and duplicated into the target, and one last
+	*  remote thread runs the agent for as long as the target lives.
+	*/
+	const char* StartAgent(TargetSession& session, const injection::LoaderSymbols& symbols, injection::InjectionResult& result)
+	{
+		if (!symbols.wide || sizeof(void*) != 8)
+			return "The agent is only available for 64-bit processes";
+		if (!symbols.unload || !symbols.wait || !symbols.signal)
+			return "Could not find the functions the agent needs";
+
+		injection::PhaseTimer allocateTimer(injection::InjectionPhase::Allocate);
+		LPVOID code = VirtualAllocEx(session.process, nullptr, StubPageSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+		if (!code)
+			return "Could not allocate memory";
+		++result.remoteAllocations;
+
+		DWORD oldProtection = 0;
+		if (!injection::RemoteMemory(session.process).Write(reinterpret_cast<std::uint64_t>(code), AgentStub64, sizeof(AgentStub64)) ||
+			!VirtualProtectEx(session.process, code, StubPageSize, PAGE_EXECUTE_READ, &oldProtection)) {
+			VirtualFreeEx(session.process, code, 0, MEM_RELEASE);
+			return "Could not write process memory";
+		}
+		FlushInstructionCache(session.process, code, sizeof(AgentStub64));
+		result.bytesWritten += sizeof(AgentStub64);
+
+		std::uint64_t region = 0;
+		if (const char* error = session.agent.Create(session.process, region)) {
+			VirtualFreeEx(session.process, code, 0, MEM_RELEASE);
+			return error;
+		}
+		allocateTimer.Stop();
+		++result.remoteAllocations;
+
+		injection::AgentControl& control = session.agent.Control();
+		control.mask = injection::AgentSlotCount - 1;
+		control.load = symbols.load;
+		control.lastError = symbols.lastError;
+		control.unload = symbols.unload;
+		control.wait = symbols.wait;
+		control.signal = symbols.signal;
+
+		injection::PhaseTimer threadTimer(injection::InjectionPhase::CreateThread);
+		HandleGuard thread{ CreateRemoteThread(session.process, NULL, 0, reinterpret_cast<LPTHREAD_START_ROUTINE>(code), reinterpret_cast<LPVOID>(region), 0, NULL) };
+		if (!thread.handle) {
+			session.agent.Close();
+			VirtualFreeEx(session.process, code, 0, MEM_RELEASE);
+			return "Could not create remote thread";
+		}
+		return nullptr;
+	}
+
+	/**
+	* @brief Calls FreeLibrary on a module of the target in a remote thread.
+	* @return False if the thread did not finish before the deadline or FreeLibrary failed.
+	*/
+	bool FreeRemoteLibrary(TargetSession& session, const injection::LoaderSymbols& symbols, std::uint64_t module, std::chrono::steady_clock::time_point deadline)
+	{
+		HandleGuard thread{ CreateRemoteThread(session.process, NULL, 0, reinterpret_cast<LPTHREAD_START_ROUTINE>(static_cast<std::uintptr_t>(symbols.unload)), reinterpret_cast<LPVOID>(module), 0, NULL) };
+		if (!thread.handle || WaitForSingleObject(thread.handle, RemainingMilliseconds(deadline)) != WAIT_OBJECT_0)
+			return false;
+
+		DWORD exitCode = 0;
+		return GetExitCodeThread(thread.handle, &exitCode) && exitCode != 0;
+	}
+
+	/**
+	* @brief Writes all paths of a job with one call.
+	* @param addresses Receives the remote address of every path.
+	* @return False if the paths could not be written.
+	*/
+	bool WritePaths(TargetSession& session, const std::vector<std::string>& libraries, std::vector<std::uint64_t>& addresses, injection::InjectionResult& result)
+	{
+		std::size_t size = 0;
+		for (const std::string& library : libraries)
+			size += library.size() + 1;
+
+		const std::uint64_t remote = session.arena.Allocate(size, 1);
+		if (!remote)
+			return false;
+
+		std::vector<char> image(size);
+		std::size_t offset = 0;
+		addresses.resize(libraries.size());
+		for (std::size_t i = 0; i < libraries.size(); i++) {
+			std::memcpy(image.data() + offset, libraries[i].c_str(), libraries[i].size() + 1);
+			addresses[i] = remote + offset;
+			offset += libraries[i].size() + 1;
+		}
+
+		injection::PhaseTimer timer(injection::InjectionPhase::Write);
+		if (!injection::RemoteMemory(session.process).Write(remote, image.data(), image.size()))
+			return false;
+
+		result.bytesWritten += image.size();
+		return true;
+	}
+
+	/**
+	* @brief Gets the module a LoadLibraryA thread loaded from its exit code.
+	* @param modules The target's modules, read after the thread returned.
+	* @return The module handle, 0 if it cannot be told.
+	* @remarks The exit code is the low half of the handle. In a 64-bit target the module is
+	*  looked up by path instead, and a handle that does not match is not kept: freeing the
+	*  truncated value later would hit whatever is mapped there.
+	*/
+	std::uint64_t LoadedModule(const process::ModuleList* modules, const std::string& library, DWORD exitCode, bool wide)
+	{
+		if (!wide)
+			return exitCode;
+
+		const process::ModuleInfo* module = modules ? modules->Find(library, 0, 0) : nullptr;
+		return module && static_cast<DWORD>(module->base) == exitCode ? module->base : 0;
+	}
+
+	/**
+	* @brief Loads the libraries with a remote thread each, one wave of independent payloads at a time.
+	* @remarks The threads of a wave are started together and waited for together, so the
+	*  payloads of a wave load in whatever order the loader lock lets them in and a payload
+	*  that imports another one starts only after the wave with its import has returned.
+	*  Waves wider than WaitForMultipleObjects() can take are split. In a 64-bit target the
+	*  modules are read after every wave, see LoadedModule().
+	*/
+	injection::InjectionResult ExecuteEach(injection::InjectionJob& job, TargetSession& session, const injection::LoaderSymbols& symbols, injection::InjectionResult& result)
+	{
+		using injection::JobPhase;
+		using injection::JobState;
+
+		const injection::InjectionRequest& request = job.Planned();
+		const std::size_t count = request.libraries.size();
+		result.libraries.resize(count);
+
+		job.SetPhase(JobPhase::WritingPath, 0);
+
+		std::vector<std::uint64_t> paths;
+		if (!WritePaths(session, request.libraries, paths, result))
+			return Fail(result, JobState::Failed, "Could not write process memory");
+
+		for (std::size_t next = 0; next < count;) {
+			if (job.CancelRequested())
+				return Fail(result, JobState::Cancelled, nullptr);
+
+			job.SetPhase(JobPhase::Loading, next);
+
+			const std::size_t end = std::min<std::size_t>(injection::WaveEnd(request, next), next + MAXIMUM_WAIT_OBJECTS);
+			HandleGuard threads[MAXIMUM_WAIT_OBJECTS];
+			HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+			DWORD started = 0;
+
+			injection::PhaseTimer threadTimer(injection::InjectionPhase::CreateThread);
+			for (std::size_t i = next; i < end; i++) {
+				threads[started].handle = CreateRemoteThread(session.process, NULL, 0, reinterpret_cast<LPTHREAD_START_ROUTINE>(static_cast<std::uintptr_t>(symbols.load)), reinterpret_cast<LPVOID>(paths[i]), 0, NULL);
+				if (!threads[started].handle)
+					break;
+				handles[started] = threads[started].handle;
+				++started;
+			}
+			threadTimer.Stop();
+
+			// threads that did start are waited for either way, they read their paths from the arena
+			injection::PhaseTimer loadTimer(injection::InjectionPhase::Load);
+			if (started > 0 && WaitForMultipleObjects(started, handles, TRUE, RemainingMilliseconds(job.Deadline())) != WAIT_OBJECT_0) {
+				// the threads may still read their paths, the region is left to the target
+				session.arena.Detach();
+				return Fail(result, JobState::TimedOut, "LoadLibraryA did not return before the deadline");
+			}
+			loadTimer.Stop();
+
+			std::shared_ptr<const process::ModuleList> modules;
+			if (symbols.wide && started > 0)
+				modules = process::ModuleCache::Shared().Get(request.target);
+
+			// every thread of the wave is accounted for before failing, the modules that did load are the job's
+			std::size_t failed = 0;
+			for (DWORD i = 0; i < started; i++) {
+				// the exit code is the low half of the module handle, zero means LoadLibraryA failed
+				// (a 64-bit module based exactly on a 4 GiB boundary would look the same, which image bases practically never are)
+				DWORD exitCode = 0;
+				if (!GetExitCodeThread(handles[i], &exitCode) || exitCode == 0) {
+					++failed;
+					continue;
+				}
+
+				result.libraries[next + i].module = LoadedModule(modules.get(), request.libraries[next + i], exitCode, symbols.wide);
+				++result.loaded;
+			}
+
+			if (next + started < end)
+				return Fail(result, JobState::Failed, "Could not create remote thread");
+			if (failed > 0) {
+				return Fail(result, JobState::Failed,
+					("LoadLibraryA failed in the target process for " + std::to_string(failed) + " of " + std::to_string(started) + " DLLs").c_str());
+			}
+			next = end;
+		}
+
+		result.state = JobState::Succeeded;
+		return std::move(result);
+	}
+
+	/**
+	* @brief Loads all libraries from a single remote thread running the loader stub.
+	* @remarks The header, one entry per library and the paths go into the arena with a single
+	*  write. While the thread runs the entries are read back now and then to report progress,
+	*  afterwards once for the results.
+	*/
+	injection::InjectionResult ExecuteBatch(injection::InjectionJob& job, TargetSession& session, const injection::LoaderSymbols& symbols, injection::InjectionResult& result)
+	{
+		using injection::JobPhase;
+		using injection::JobState;
+
+		const injection::InjectionRequest& request = job.Planned();
+		const std::size_t count = request.libraries.size();
+
+		job.SetPhase(JobPhase::WritingPath, 0);
+
+		const std::size_t entriesOffset = sizeof(BatchHeader);
+		const std::size_t pathsOffset = entriesOffset + count * sizeof(BatchEntry);
+
+		std::size_t size = pathsOffset;
+		for (const std::string& library : request.libraries)
+			size += library.size() + 1;
+
+		const std::uint64_t base = session.arena.Allocate(size);
+		if (!base)
+			return Fail(result, JobState::Failed, "Could not allocate memory");
+
+		std::vector<unsigned char> image(size);
+
+		BatchHeader header = { };
+		header.loadLibrary = symbols.load;
+		header.getLastError = symbols.lastError;
+		header.count = static_cast<std::uint32_t>(count);
+		std::memcpy(image.data(), &header, sizeof(header));
+
+		std::size_t pathOffset = pathsOffset;
+		for (std::size_t i = 0; i < count; i++) {
+			const std::string& library = request.libraries[i];
+
+			BatchEntry entry = { };
+			entry.path = base + pathOffset;
+			std::memcpy(image.data() + entriesOffset + i * sizeof(BatchEntry), &entry, sizeof(entry));
+
+			std::memcpy(image.data() + pathOffset, library.c_str(), library.size() + 1);
+			pathOffset += library.size() + 1;
+		}
+
+		injection::RemoteMemory memory(session.process);
+
+		injection::PhaseTimer writeTimer(injection::InjectionPhase::Write);
+		if (!memory.Write(base, image.data(), image.size()))
+			return Fail(result, JobState::Failed, "Could not write process memory");
+		writeTimer.Stop();
+		result.bytesWritten += image.size();
+
+		job.SetPhase(JobPhase::Loading, 0);
+
+		injection::PhaseTimer threadTimer(injection::InjectionPhase::CreateThread);
+		HandleGuard thread{ CreateRemoteThread(session.process, NULL, 0, (LPTHREAD_START_ROUTINE)session.arena.Base(), reinterpret_cast<LPVOID>(base), 0, NULL) };
+		threadTimer.Stop();
+		if (!thread.handle)
+			return Fail(result, JobState::Failed, "Could not create remote thread");
+
+		// includes the progress reads, they are rare compared to the time a DllMain takes
+		injection::PhaseTimer loadTimer(injection::InjectionPhase::Load);
+
+		std::vector<BatchEntry> entries(count);
+		const auto readEntries = [&]() {
+			return memory.Read(base + entriesOffset, entries.data(), count * sizeof(BatchEntry));
+		};
+		const auto attempted = [&]() {
+			return static_cast<std::size_t>(std::count_if(entries.begin(), entries.end(), [](const BatchEntry& entry) { return entry.module != 0 || entry.error != 0; }));
+		};
+
+		for (;;) {
+			const DWORD remaining = RemainingMilliseconds(job.Deadline());
+			const DWORD wait = WaitForSingleObject(thread.handle, (std::min)(remaining, DWORD(100)));
+			if (wait == WAIT_OBJECT_0)
+				break;
+
+			if (wait != WAIT_TIMEOUT || remaining <= 100) {
+				// the stub is still running and uses the region, it is left to the target
+				result.loaded = readEntries() ? attempted() : 0;
+				session.arena.Detach();
+				return Fail(result, JobState::TimedOut, "The loader did not finish before the deadline");
+			}
+
+			if (readEntries())
+				job.SetPhase(JobPhase::Loading, (std::min)(attempted(), count - 1));
+		}
+
+		loadTimer.Stop();
+
+		injection::PhaseTimer readTimer(injection::InjectionPhase::ReadResults);
+		const bool read = readEntries();
+		readTimer.Stop();
+		if (!read)
+			return Fail(result, JobState::Failed, "Could not read the loader results");
+
+		result.libraries.resize(count);
+		for (std::size_t i = 0; i < count; i++) {
+			result.libraries[i].module = entries[i].module;
+			result.libraries[i].error = entries[i].error;
+			if (entries[i].module != 0)
+				++result.loaded;
+		}
+
+		if (result.loaded != count) {
+			return Fail(result, JobState::Failed,
+				(std::to_string(count - result.loaded) + " of " + std::to_string(count) + " DLLs failed to load").c_str());
+		}
+
+		result.state = JobState::Succeeded;
+		return std::move(result);
+	}
+
+	/**
+	* @brief Does the work of Execute() once the session is locked.
+	* @param stale Modules of changed libraries, freed (as often as our jobs loaded them) before
+	*  anything is loaded.
+	* @remarks Payloads are checked first (see InspectPayload()): files that are no DLL fail the
+	*  job before the target is opened, DLLs of the wrong bitness before anything is written to
+	*  it. The process handle and a remote region holding the loader stub are kept per target,
+	*  so repeated jobs neither reopen it nor reserve memory again and only write the paths.
+	*  Batched jobs run the stub in a single remote thread, otherwise LoadLibraryA runs in a
+	*  thread per library, the threads of a wave of independent payloads at the same time. When
+	*  the deadline passes the remote thread keeps running, so the region is left to the target
+	*  and the next job reserves a new one. With useAgent the first job on a 64-bit target
+	*  starts the resident agent, and it and every later one load through it (see
+	*  LoadThroughAgent()).
+	*/
+	injection::InjectionResult LoadIntoTarget(injection::InjectionJob& job, TargetSession& session, const std::vector<injection::StaleModule>& stale, injection::InjectionResult& result)
+	{
+		const injection::InjectionRequest& request = job.Planned();
+
+		// wrong files are rejected before the target is opened, the bitness check has to wait for it
+		std::vector<std::uint16_t> machines;
+		const char* payloadError = nullptr;
+		if (const std::size_t bad = InspectPayloads(request.libraries, machines, payloadError); bad != request.libraries.size())
+			return FailPayload(result, request.libraries[bad], payloadError);
+
+		if (const char* error = OpenTarget(session, request.target))
+			return Fail(result, injection::JobState::Failed, error);
+
+		injection::LoaderSymbols symbols;
+		if (const char* error = injection::SymbolResolver::Shared().Resolve(request.target, session.process, symbols))
+			return Fail(result, injection::JobState::Failed, error);
+
+		for (std::size_t i = 0; i < machines.size(); i++) {
+			if (!injection::MachineRunsIn(machines[i], symbols.wide))
+				return FailPayload(result, request.libraries[i], symbols.wide ? "A 32-bit DLL cannot be loaded into a 64-bit process" : "A 64-bit DLL cannot be loaded into a 32-bit process");
+		}
+
+		// the agent is optional, without it the job falls back to remote threads
+		if (request.useAgent && (!session.agent.Attached() || session.agent.Exited())) {
+			if (const char* error = StartAgent(session, symbols, result))
+				result.warning = std::string("Loaded without the agent: ") + error;
+		}
+		const bool viaAgent = request.useAgent && session.agent.Attached() && !session.agent.Exited();
+
+		// modules of changed files go first, LoadLibraryA would merely find them again
+		session.payloads.DropStale(stale, result, [&](std::uint64_t module) {
+			std::uint64_t value = 0;
+			if (viaAgent)
+				return !session.agent.Run(injection::AgentCommand::Unload, module, 0, job.Deadline(), value) && static_cast<BOOL>(value);
+			return symbols.unload != 0 && FreeRemoteLibrary(session, symbols, module, job.Deadline());
+		});
+
+		if (viaAgent)
+			return injection::LoadThroughAgent(job, session.agent, result);
+
+		const bool batched = request.batched && request.libraries.size() > 1;
+
+		// what the job allocates from the arena, paths plus the batch header and entries
+		std::size_t needed = batched ? sizeof(BatchHeader) + request.libraries.size() * sizeof(BatchEntry) : 0;
+		for (const std::string& library : request.libraries)
+			needed += library.size() + 1;
+
+		if (!PrepareArena(session, needed, symbols.wide, result))
+			return Fail(result, injection::JobState::Failed, "Could not allocate memory");
+
+		if (batched)
+			return ExecuteBatch(job, session, symbols, result);
+
+		return ExecuteEach(job, session, symbols, result);
+	}
+}
+
+/**
+* @brief Loads every library of a job into its target process.
+* @param job The job, Begin() and Plan() must have been called.
+* @return The outcome of the job.
+* @remarks Unchanged jobs are skipped and imports checked first (see ExecuteInSession()), then
+*  LoadLibraryA runs in the target from remote threads or through the agent, bounded by the
+*  job deadline (see LoadIntoTarget()).
+*/
+injection::InjectionResult injection::Execute(InjectionJob& job)
+{
+	const std::shared_ptr<TargetSession> session = FindOrCreateSession(job.Planned().target);
+	return ExecuteInSession(job, session->mutex, session->payloads, [&](const std::vector<StaleModule>& stale, InjectionResult& result) {
+		return LoadIntoTarget(job, *session, stale, result);
+	});
+}
+
+/**
+* @brief Forgets the session of a target.
+* @param target The process.
+*/
+void injection::ReleaseTarget(const process::ProcessKey& target)
+{
+	std::shared_ptr<TargetSession> session;
+	{
+		SessionTable& table = Sessions();
+		std::lock_guard lock(table.mutex);
+
+		const auto found = table.sessions.find(target);
+		if (found == table.sessions.end())
+			return;
+
+		session = std::move(found->second);
+		table.sessions.erase(found);
+	}
+
+	SymbolResolver::Shared().Forget(target);
+	process::ModuleCache::Shared().Forget(target);
+
+	// the handle is closed here unless a job still holds the session
+}
+
+/**
+* @brief Forgets the sessions of all targets.
+*/
+void injection::ReleaseAllTargets()
+{
+	std::unordered_map<process::ProcessKey, std::shared_ptr<TargetSession>, process::ProcessKeyHash> sessions;
+	{
+		SessionTable& table = Sessions();
+		std::lock_guard lock(table.mutex);
+		sessions.swap(table.sessions);
+	}
+
+	SymbolResolver::Shared().Clear();
+	process::ModuleCache::Shared().Clear();
+}
+
+/**
+* @brief Unloads a library through the agent of a target.
+* @param target The process.
+* @param module The handle LoadLibraryA returned.
+* @param timeout How long to wait for FreeLibrary.
+* @return Null on success, otherwise the error.
+*/
+const char* injection::UnloadLibrary(const process::ProcessKey& target, std::uint64_t module, std::chrono::milliseconds timeout)
+{
+	const std::shared_ptr<TargetSession> session = FindSession(target);
+	if (!session)
+		return "No agent runs in the process";
+
+	std::lock_guard lock(session->mutex);
+
+	std::uint64_t value = 0;
+	if (const char* error = session->agent.Run(AgentCommand::Unload, module, 0, std::chrono::steady_clock::now() + timeout, value))
+		return error;
+	if (!static_cast<BOOL>(value))
+		return "FreeLibrary failed in the target process";
+
+	session->payloads.Unloaded(module);
+	return nullptr;
+}
+
+/**
+* @brief Calls a function on the agent thread of a target.
+* @param target The process.
+* @param function The remote address.
+* @param argument Its argument.
+* @param value Receives rax.
+* @param timeout How long to wait for the function.
+* @return Null on success, otherwise the error.
+*/
+const char* injection::CallFunction(const process::ProcessKey& target, std::uint64_t function, std::uint64_t argument, std::uint64_t& value, std::chrono::milliseconds timeout)
+{
+	const std::shared_ptr<TargetSession> session = FindSession(target);
+	if (!session)
+		return "No agent runs in the process";
+
+	std::lock_guard lock(session->mutex);
+	return session->agent.Run(AgentCommand::Call, function, argument, std::chrono::steady_clock::now() + timeout, value);
+}
+
+#endif // _WIN32
@@ -0,0 +1,132 @@
+/**
+ * @file latency_histogram.cpp
+ * @brief Implements the log-linear latency histogram.
+ */
+
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+/**
+* @brief Records a latency.
+* @param nanoseconds The value, clamped to the tracked range.
+*/
+void injection::LatencyHistogram::Record(std::uint64_t nanoseconds) noexcept
+{
+	buckets[BucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_relaxed);
+	sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+	std::uint64_t current = max.load(std::memory_order_relaxed);
+	while (nanoseconds > current && !max.compare_exchange_weak(current, nanoseconds, std::memory_order_relaxed)) {
+	}
+}
+
+/**
+* @brief Records a latency measured with the steady clock.
+* @param duration The value, negative durations count as zero.
+*/
+void injection::LatencyHistogram::Record(std::chrono::steady_clock::duration duration) noexcept
+{
+	const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+	Record(static_cast<std::uint64_t>(nanoseconds > 0 ? nanoseconds : 0));
+}
+
+/**
+* @brief Gets a percentile.
+* @param q The fraction, 0.5 for the median.
+* @return The upper bound of the bucket holding the percentile, never more than the maximum, 0 if empty.
+*/
+std::uint64_t injection::LatencyHistogram::Percentile(double q) const noexcept
+{
+	const std::uint64_t total = count.load(std::memory_order_relaxed);
+	if (total == 0)
+		return 0;
+
+	const auto rank = static_cast<std::uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * static_cast<double>(total)));
+	const std::uint64_t highest = max.load(std::memory_order_relaxed);
+
+	std::uint64_t seen = 0;
+	for (std::size_t i = 0; i < BucketCount; i++) {
+		seen += buckets[i].load(std::memory_order_relaxed);
+		if (seen >= std::max<std::uint64_t>(rank, 1))
+			return std::min(BucketUpperBound(i), highest);
+	}
+	return highest;
+}
+
+/**
+* @brief Gets the usual percentiles in one go.
+* @return The summary.
+*/
+injection::LatencySummary injection::LatencyHistogram::Summarize() const noexcept
+{
+	LatencySummary summary;
+	summary.count = count.load(std::memory_order_relaxed);
+	if (summary.count == 0)
+		return summary;
+
+	summary.p50 = Percentile(0.50);
+	summary.p90 = Percentile(0.90);
+	summary.p99 = Percentile(0.99);
+	summary.max = max.load(std::memory_order_relaxed);
+	summary.mean = static_cast<double>(sum.load(std::memory_order_relaxed)) / static_cast<double>(summary.count);
+	return summary;
+}
+
+/**
+* @brief Gets the smallest value counted in a bucket.
+*/
+std::uint64_t injection::LatencyHistogram::BucketLowerBound(std::size_t bucket) noexcept
+{
+	if (bucket < 2 * SubBucketCount)
+		return bucket;
+
+	const std::size_t shift = (bucket - 2 * SubBucketCount) / SubBucketCount + 1;
+	const std::uint64_t sub = (bucket - 2 * SubBucketCount) % SubBucketCount;
+	return (SubBucketCount + sub) << shift;
+}
+
+/**
+* @brief Gets the largest value counted in a bucket.
+*/
+std::uint64_t injection::LatencyHistogram::BucketUpperBound(std::size_t bucket) noexcept
+{
+	if (bucket < 2 * SubBucketCount)
+		return bucket;
+
+	const std::size_t shift = (bucket - 2 * SubBucketCount) / SubBucketCount + 1;
+	return BucketLowerBound(bucket) + (1ull << shift) - 1;
+}
+
+/**
+* @brief Clears all counters.
+*/
+void injection::LatencyHistogram::Reset() noexcept
+{
+	for (auto& bucket : buckets)
+		bucket.store(0, std::memory_order_relaxed);
+	count.store(0, std::memory_order_relaxed);
+	sum.store(0, std::memory_order_relaxed);
+	max.store(0, std::memory_order_relaxed);
+}
+
+/**
+* @brief Maps a value to its bucket.
+* @remarks The top bit selects the power of two, the next SubBucketBits bits the sub-bucket.
+*/
+std::size_t injection::LatencyHistogram::BucketIndex(std::uint64_t value) noexcept
+{
+	if (value < 2 * SubBucketCount)
+		return static_cast<std::size_t>(value);
+
+	const unsigned top = static_cast<unsigned>(std::bit_width(value)) - 1;
+	if (top >= MaxValueBits)
+		return BucketCount - 1;
+
+	const unsigned shift = top - SubBucketBits;
+	const std::uint64_t sub = (value >> shift) - SubBucketCount;
+	return static_cast<std::size_t>(2 * SubBucketCount + (shift - 1) * SubBucketCount + sub);
+}
@@ -0,0 +1,72 @@
+/**
+
+@file latency_histogram.h
+@brief Lock-free log-linear histogram for latencies.
+*/
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace injection
+{
+	/**
+	* @brief Summary of a histogram, values in nanoseconds.
+	*/
+	struct LatencySummary
+	{
+		std::uint64_t count = 0;
+		std::uint64_t p50 = 0;
+		std::uint64_t p90 = 0;
+		std::uint64_t p99 = 0;
+		std::uint64_t max = 0;
+		double mean = 0.0;
+	};
+
+	/**
+	* @brief Counts latencies in buckets with a bounded relative error, like an HDR histogram.
+	* @remarks Values below 64 ns get a bucket each, above that every power of two is split into
+	*  32 linear sub-buckets, so a recorded value is off by at most about 3 %. Values up to
+	*  2^48 ns (three days) are tracked, larger ones are clamped. Record() is a handful of
+	*  relaxed atomic operations and may be called from any number of threads while another
+	*  thread reads percentiles.
+	*/
+	class LatencyHistogram
+	{
+	public:
+		static constexpr unsigned SubBucketBits = 5;
+		static constexpr std::uint64_t SubBucketCount = 1ull << SubBucketBits;
+		static constexpr unsigned MaxValueBits = 48;
+		static constexpr std::size_t BucketCount = 2 * SubBucketCount + (MaxValueBits - SubBucketBits - 1) * SubBucketCount;
+
+		// adds one value in nanoseconds
+		void Record(std::uint64_t nanoseconds) noexcept;
+		void Record(std::chrono::steady_clock::duration duration) noexcept;
+
+		// smallest value v such that a fraction q of all recorded values is <= v (up to the bucket precision)
+		std::uint64_t Percentile(double q) const noexcept;
+
+		LatencySummary Summarize() const noexcept;
+
+		std::uint64_t Count() const noexcept { return count.load(std::memory_order_relaxed); }
+
+		// number of values in a bucket and the range of values it stands for
+		std::uint64_t BucketValue(std::size_t bucket) const noexcept { return buckets[bucket].load(std::memory_order_relaxed); }
+		static std::uint64_t BucketLowerBound(std::size_t bucket) noexcept;
+		static std::uint64_t BucketUpperBound(std::size_t bucket) noexcept;
+
+		// forgets everything, values recorded concurrently may survive
+		void Reset() noexcept;
+
+	private:
+		static std::size_t BucketIndex(std::uint64_t value) noexcept;
+
+		std::array<std::atomic<std::uint64_t>, BucketCount> buckets = { };
+		std::atomic<std::uint64_t> count = 0;
+		std::atomic<std::uint64_t> sum = 0;
+		std::atomic<std::uint64_t> max = 0;
+	};
+}
@@ -0,0 +1,65 @@
+/**
+
+@file mapped_file.h
+@brief Read-only memory mapping of a whole file.
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace injection
+{
+	/**
+	* @brief What a file's directory entry says about its content, without reading it.
+	*/
+	struct FileStamp
+	{
+		std::uint64_t size = 0;
+		std::int64_t modified = 0; // last write time in the platform's own units (ns on Linux, 100 ns on Windows)
+		std::uint64_t device = 0;  // Linux: st_dev and st_ino, the file identity ld.so compares; 0 on Windows
+		std::uint64_t inode = 0;
+
+		bool operator==(const FileStamp&) const noexcept = default;
+	};
+
+	/**
+	* @brief Reads the size, last write time and identity of a file, implemented per platform.
+	* @return False if the file does not exist or is no regular file.
+	*/
+	bool QueryFileStamp(const std::string& path, FileStamp& out);
+
+	/**
+	* @brief Maps a file read-only, so it can be parsed in place instead of being read into a buffer.
+	* @remarks Only the pages that are actually touched are read from disk, checking the headers
+	*  of a payload costs one or two page faults no matter how large it is. Empty files are not
+	*  mapped, they have no content to look at.
+	*/
+	class MappedFile
+	{
+	public:
+		MappedFile() noexcept = default;
+		~MappedFile() { Close(); }
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		/**
+		* @brief Maps a file, unmapping the previous one, implemented per platform.
+		* @param path The file, on Windows in the ANSI code page, as LoadLibraryA reads it.
+		* @return Null on success, otherwise the error.
+		*/
+		const char* Open(const std::string& path);
+
+		// platform part: unmaps the file
+		void Close() noexcept;
+
+		std::span<const unsigned char> Data() const noexcept { return { view, size }; }
+
+	private:
+		const unsigned char* view = nullptr;
+		std::size_t size = 0;
+	};
+}
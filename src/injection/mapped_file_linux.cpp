@@ -0,0 +1,79 @@
+/**
+ * @file mapped_file_linux.cpp
+ * @brief Linux file mapping through mmap.
+ */
+
+#ifdef __linux__
+
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+* @brief Stats a file.
+* @param path The file.
+* @param out Receives its size, modification time and identity.
+* @return False if it cannot be stat'ed or is no regular file.
+*/
+bool injection::QueryFileStamp(const std::string& path, FileStamp& out)
+{
+	struct stat status = { };
+	if (stat(path.c_str(), &status) != 0 || !S_ISREG(status.st_mode))
+		return false;
+
+	out.size = static_cast<std::uint64_t>(status.st_size);
+	out.modified = static_cast<std::int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+	out.device = static_cast<std::uint64_t>(status.st_dev);
+	out.inode = static_cast<std::uint64_t>(status.st_ino);
+	return true;
+}
+
+/**
+* @brief Maps a file read-only.
+* @param path The file.
+* @return Null on success, otherwise the error.
+*/
+const char* injection::MappedFile::Open(const std::string& path)
+{
+	Close();
+
+	const int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (file < 0)
+		return "Could not open the file";
+
+	struct stat status = { };
+	if (fstat(file, &status) != 0 || !S_ISREG(status.st_mode)) {
+		close(file);
+		return "Not a regular file";
+	}
+	if (status.st_size == 0) {
+		close(file);
+		return "The file is empty";
+	}
+
+	void* mapped = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (mapped == MAP_FAILED)
+		return "Could not map the file";
+
+	view = static_cast<const unsigned char*>(mapped);
+	size = static_cast<std::size_t>(status.st_size);
+	return nullptr;
+}
+
+/**
+* @brief Unmaps the file.
+*/
+void injection::MappedFile::Close() noexcept
+{
+	if (view)
+		munmap(const_cast<unsigned char*>(view), size);
+
+	view = nullptr;
+	size = 0;
+}
+
+#endif // __linux__
@@ -0,0 +1,83 @@
+/**
+ * @file mapped_file_win.cpp
+ * @brief Windows file mapping through a read-only section.
+ */
+
+#ifdef _WIN32
+
+#include "mapped_file.h"
+
+#include <windows.h>
+
+/**
+* @brief Reads a file's attributes, without opening it.
+* @param path The file.
+* @param out Receives its size and last write time.
+* @return False if it does not exist or is a directory.
+*/
+bool injection::QueryFileStamp(const std::string& path, FileStamp& out)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes) || (attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+		return false;
+
+	out.size = static_cast<std::uint64_t>(attributes.nFileSizeHigh) << 32 | attributes.nFileSizeLow;
+	out.modified = static_cast<std::int64_t>(static_cast<std::uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32 | attributes.ftLastWriteTime.dwLowDateTime);
+	return true;
+}
+
+/**
+* @brief Maps a file read-only.
+* @param path The file.
+* @return Null on success, otherwise the error.
+* @remarks The file is opened with FILE_SHARE_DELETE too, so a payload being replaced by a
+*  build while it is checked does not fail the build.
+*/
+const char* injection::MappedFile::Open(const std::string& path)
+{
+	Close();
+
+	const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return "Could not open the file";
+
+	LARGE_INTEGER length = { };
+	if (!GetFileSizeEx(file, &length) || length.QuadPart == 0) {
+		CloseHandle(file);
+		return "The file is empty";
+	}
+	if (static_cast<unsigned long long>(length.QuadPart) > static_cast<SIZE_T>(-1)) {
+		CloseHandle(file);
+		return "The file is too large";
+	}
+
+	const HANDLE section = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!section)
+		return "Could not map the file";
+
+	// the view keeps the section alive
+	void* mapped = MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(section);
+	if (!mapped)
+		return "Could not map the file";
+
+	view = static_cast<const unsigned char*>(mapped);
+	size = static_cast<std::size_t>(length.QuadPart);
+	return nullptr;
+}
+
+/**
+* @brief Unmaps the file.
+*/
+void injection::MappedFile::Close() noexcept
+{
+	if (view)
+		UnmapViewOfFile(view);
+
+	view = nullptr;
+	size = 0;
+}
+
+#endif // _WIN32
@@ -0,0 +1,327 @@
+/**
+ * @file payload_cache.cpp
+ * @brief Implements the payload fingerprints and the per-target load record.
+ */
+
+#include "payload_cache.h"
+
+#include <bit>
+#include <cstring>
+
+namespace
+{
+	constexpr std::uint64_t Prime1 = 0x9E3779B185EBCA87ULL;
+	constexpr std::uint64_t Prime2 = 0xC2B2AE3D27D4EB4FULL;
+	constexpr std::uint64_t Prime3 = 0x165667B19E3779F9ULL;
+	constexpr std::uint64_t Prime4 = 0x85EBCA77C2B2AE63ULL;
+	constexpr std::uint64_t Prime5 = 0x27D4EB2F165667C5ULL;
+
+	template <typename T>
+	T ReadLittle(const unsigned char* at) noexcept
+	{
+		static_assert(std::endian::native == std::endian::little, "the hash reads its input in place");
+
+		T value;
+		std::memcpy(&value, at, sizeof(T));
+		return value;
+	}
+
+	std::uint64_t Round(std::uint64_t accumulator, std::uint64_t input) noexcept
+	{
+		return std::rotl(accumulator + input * Prime2, 31) * Prime1;
+	}
+
+	std::uint64_t Merge(std::uint64_t hash, std::uint64_t lane) noexcept
+	{
+		return (hash ^ Round(0, lane)) * Prime1 + Prime4;
+	}
+}
+
+/**
+* @brief Hashes a byte range.
+* @param data The bytes, typically a mapped file.
+* @return The xxHash64 of the bytes.
+*/
+std::uint64_t injection::HashContent(std::span<const unsigned char> data) noexcept
+{
+	const unsigned char* at = data.data();
+	const unsigned char* const end = at + data.size();
+
+	std::uint64_t hash;
+	if (data.size() >= 32) {
+		std::uint64_t lanes[4] = { Prime1 + Prime2, Prime2, 0, 0 - Prime1 };
+		for (; end - at >= 32; at += 32) {
+			lanes[0] = Round(lanes[0], ReadLittle<std::uint64_t>(at));
+			lanes[1] = Round(lanes[1], ReadLittle<std::uint64_t>(at + 8));
+			lanes[2] = Round(lanes[2], ReadLittle<std::uint64_t>(at + 16));
+			lanes[3] = Round(lanes[3], ReadLittle<std::uint64_t>(at + 24));
+		}
+
+		hash = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+		for (std::uint64_t lane : lanes)
+			hash = Merge(hash, lane);
+	}
+	else {
+		hash = Prime5;
+	}
+
+	hash += data.size();
+	for (; end - at >= 8; at += 8)
+		hash = std::rotl(hash ^ Round(0, ReadLittle<std::uint64_t>(at)), 27) * Prime1 + Prime4;
+	if (end - at >= 4) {
+		hash = std::rotl(hash ^ ReadLittle<std::uint32_t>(at) * Prime1, 23) * Prime2 + Prime3;
+		at += 4;
+	}
+	for (; at < end; ++at)
+		hash = std::rotl(hash ^ *at * Prime5, 11) * Prime1;
+
+	hash ^= hash >> 33;
+	hash *= Prime2;
+	hash ^= hash >> 29;
+	hash *= Prime3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+/**
+* @brief Gets the cache used throughout the application.
+*/
+injection::PayloadCache& injection::PayloadCache::Shared()
+{
+	static PayloadCache cache;
+	return cache;
+}
+
+/**
+* @brief Gets the hash of a file's content, from the cache while its stamp is unchanged.
+* @param path The file.
+* @param fingerprint Receives the hash and the current stamp.
+* @return Null on success, otherwise the error.
+* @remarks The file is hashed without the lock, workers fingerprinting other files do not
+*  wait for it.
+*/
+const char* injection::PayloadCache::Fingerprint(const std::string& path, PayloadFingerprint& fingerprint)
+{
+	FileStamp& stamp = fingerprint.stamp;
+	if (!QueryFileStamp(path, stamp))
+		return "The file does not exist";
+
+	{
+		std::lock_guard lock(mutex);
+		const auto found = entries.find(path);
+		if (found != entries.end() && found->second.stamp == stamp && found->second.hashed) {
+			fingerprint.hash = found->second.hash;
+			hits.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+	}
+
+	misses.fetch_add(1, std::memory_order_relaxed);
+
+	MappedFile file;
+	if (const char* error = file.Open(path))
+		return error;
+	const std::uint64_t content = HashContent(file.Data());
+
+	// a write between the stat and the mapping is caught by the next lookup, the stamp is older
+	std::lock_guard lock(mutex);
+	Entry& entry = EntryFor(path, stamp);
+	entry.hash = content;
+	entry.hashed = true;
+	fingerprint.hash = content;
+	return nullptr;
+}
+
+/**
+* @brief Gets the imports of a file, from the cache while its stamp is unchanged.
+* @param path The file.
+* @param imports Receives the imports.
+* @return Null on success, otherwise the error.
+* @remarks Planning a job and checking its dependencies both ask, only the first reads the
+*  file. Files that cannot be parsed are read again on every request.
+*/
+const char* injection::PayloadCache::Imports(const std::string& path, PayloadImports& imports)
+{
+	FileStamp stamp;
+	if (!QueryFileStamp(path, stamp))
+		return "The file does not exist";
+
+	{
+		std::lock_guard lock(mutex);
+		const auto found = entries.find(path);
+		if (found != entries.end() && found->second.stamp == stamp && found->second.parsed) {
+			imports = found->second.imports;
+			hits.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+	}
+
+	misses.fetch_add(1, std::memory_order_relaxed);
+
+	MappedFile file;
+	if (const char* error = file.Open(path))
+		return error;
+	if (const char* error = ReadImports(file.Data(), imports))
+		return error;
+
+	std::lock_guard lock(mutex);
+	Entry& entry = EntryFor(path, stamp);
+	entry.imports = imports;
+	entry.parsed = true;
+	return nullptr;
+}
+
+/**
+* @brief Gets the entry of a path, emptied first if it was for another stamp.
+*/
+injection::PayloadCache::Entry& injection::PayloadCache::EntryFor(const std::string& path, const FileStamp& stamp)
+{
+	Entry& entry = entries[path];
+	if (entry.stamp != stamp) {
+		entry = Entry();
+		entry.stamp = stamp;
+	}
+	return entry;
+}
+
+/**
+* @brief Forgets all fingerprints.
+*/
+void injection::PayloadCache::Clear()
+{
+	std::lock_guard lock(mutex);
+	entries.clear();
+}
+
+std::size_t injection::PayloadCache::Hits() const noexcept
+{
+	return hits.load(std::memory_order_relaxed);
+}
+
+std::size_t injection::PayloadCache::Misses() const noexcept
+{
+	return misses.load(std::memory_order_relaxed);
+}
+
+/**
+* @brief Completes a job without loading anything if its libraries are loaded already.
+* @param libraries The paths of the job.
+* @param fingerprints Their fingerprints.
+* @param modules The target's modules, null if they could not be read.
+* @param result Receives the recorded modules, untouched unless the job has nothing to do.
+* @return True if every library is loaded, by our jobs with the same content or by the target.
+* @remarks Without a module list nothing is answered from the record, the process may have
+*  exited and opening it is left to tell. A library our jobs did not load counts as loaded if the module list has it: the
+*  loader would hand out the module it has (ld.so compares device and inode, LoadLibrary the
+*  path), so loading it again would change nothing. We hold no reference on such a module,
+*  its result has no module handle and it cannot be unloaded through us.
+*/
+bool injection::LoadedPayloads::AllUnchanged(const std::vector<std::string>& libraries, const std::vector<PayloadFingerprint>& fingerprints, const process::ModuleList* modules, InjectionResult& result) const
+{
+	if (!modules)
+		return false;
+
+	for (std::size_t i = 0; i < libraries.size(); i++) {
+		const auto found = loaded.find(libraries[i]);
+		if (found != loaded.end() ? found->second.hash != fingerprints[i].hash :
+			!modules->Find(libraries[i], fingerprints[i].stamp.device, fingerprints[i].stamp.inode))
+			return false;
+	}
+
+	result.libraries.resize(libraries.size());
+	for (std::size_t i = 0; i < libraries.size(); i++) {
+		const auto found = loaded.find(libraries[i]);
+		result.libraries[i].module = found != loaded.end() ? found->second.module : 0;
+	}
+
+	result.state = JobState::Succeeded;
+	result.loaded = libraries.size();
+	result.unchanged = libraries.size();
+	return true;
+}
+
+/**
+* @brief Forgets the libraries the target has unloaded by itself.
+* @param modules The target's current modules.
+* @remarks A library is looked up by the identity of the file that was loaded, a library
+*  whose file has been replaced since is still found while its old module is loaded.
+*/
+void injection::LoadedPayloads::Prune(const process::ModuleList& modules)
+{
+	std::erase_if(loaded, [&](const auto& entry) {
+		return !modules.Find(entry.first, entry.second.device, entry.second.inode);
+	});
+}
+
+/**
+* @brief Lists the modules loaded from an earlier content of the job's libraries.
+* @param libraries The paths of the job.
+* @param fingerprints Their current fingerprints.
+* @param out Receives the modules.
+*/
+void injection::LoadedPayloads::Stale(const std::vector<std::string>& libraries, const std::vector<PayloadFingerprint>& fingerprints, std::vector<StaleModule>& out) const
+{
+	out.clear();
+	for (std::size_t i = 0; i < libraries.size(); i++) {
+		const auto found = loaded.find(libraries[i]);
+		if (found != loaded.end() && found->second.hash != fingerprints[i].hash)
+			out.push_back({ libraries[i], found->second.module, found->second.references });
+	}
+}
+
+/**
+* @brief Records the libraries a job loaded.
+* @param libraries The paths of the job.
+* @param fingerprints Their fingerprints.
+* @param result The outcome, libraries with a module were loaded.
+* @remarks A library recorded with a different hash or module gets a fresh entry, e.g. after
+*  its stale module could not be unloaded.
+*/
+void injection::LoadedPayloads::Record(const std::vector<std::string>& libraries, const std::vector<PayloadFingerprint>& fingerprints, const InjectionResult& result)
+{
+	for (std::size_t i = 0; i < libraries.size() && i < result.libraries.size(); i++) {
+		const std::uint64_t module = result.libraries[i].module;
+		if (module == 0)
+			continue;
+
+		const PayloadFingerprint& fingerprint = fingerprints[i];
+		Loaded& entry = loaded[libraries[i]];
+		if (entry.hash != fingerprint.hash || entry.module != module)
+			entry = { fingerprint.hash, module, 0, fingerprint.stamp.device, fingerprint.stamp.inode };
+		++entry.references;
+	}
+}
+
+/**
+* @brief Takes note of an unload through UnloadLibrary().
+* @param module The module handle.
+*/
+void injection::LoadedPayloads::Unloaded(std::uint64_t module)
+{
+	for (auto entry = loaded.begin(); entry != loaded.end(); ++entry) {
+		if (entry->second.module != module)
+			continue;
+
+		if (--entry->second.references == 0)
+			loaded.erase(entry);
+		return;
+	}
+}
+
+/**
+* @brief Fingerprints the libraries of a job through the shared cache.
+* @param libraries The paths.
+* @param fingerprints Receives a fingerprint per path.
+* @param error Receives what went wrong with the first file that failed.
+* @return The index of that file, libraries.size() if all were hashed.
+*/
+std::size_t injection::FingerprintPayloads(const std::vector<std::string>& libraries, std::vector<PayloadFingerprint>& fingerprints, const char*& error)
+{
+	fingerprints.resize(libraries.size());
+	for (std::size_t i = 0; i < libraries.size(); i++) {
+		error = PayloadCache::Shared().Fingerprint(libraries[i], fingerprints[i]);
+		if (error)
+			return i;
+	}
+	return libraries.size();
+}
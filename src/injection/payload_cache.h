@@ -0,0 +1,178 @@
+/**
+
+@file payload_cache.h
+@brief Content fingerprints of payload files and the record of what each target has loaded.
+*/
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "injection_job.h"
+#include "mapped_file.h"
+#include "payload_graph.h"
+#include "../process/module_list.h"
+
+namespace injection
+{
+	/**
+	* @brief 64-bit hash of a byte range, xxHash64 with seed 0.
+	* @remarks Four independent multiply-rotate lanes over 32 byte stripes, memory bandwidth
+	*  rather than the hash bounds it. Not meant to resist deliberate collisions, it only has
+	*  to tell a rebuilt payload from the one loaded before.
+	*/
+	std::uint64_t HashContent(std::span<const unsigned char> data) noexcept;
+
+	/**
+	* @brief What a job knows about one of its payload files.
+	*/
+	struct PayloadFingerprint
+	{
+		std::uint64_t hash = 0;
+		FileStamp stamp;
+	};
+
+	/**
+	* @brief Content hashes and imports of payload files, kept while their size and last write time stay the same.
+	* @remarks A lookup stats the file and only maps and reads it when the stamp differs from the
+	*  cached one, so a repeated request for unchanged files reads none of them. A file rewritten
+	*  within the timestamp resolution of its file system without changing size goes unnoticed.
+	*/
+	class PayloadCache
+	{
+	public:
+		// the cache all injections use
+		static PayloadCache& Shared();
+
+		/**
+		* @brief Gets the hash of a file's content.
+		* @param path The file.
+		* @param fingerprint Receives the hash and the current stamp.
+		* @return Null on success, otherwise the error.
+		*/
+		const char* Fingerprint(const std::string& path, PayloadFingerprint& fingerprint);
+
+		/**
+		* @brief Gets the libraries a file imports, see ReadImports().
+		* @param path The file.
+		* @param imports Receives the imports.
+		* @return Null on success, otherwise the error.
+		*/
+		const char* Imports(const std::string& path, PayloadImports& imports);
+
+		void Clear();
+
+		// lookups answered from the cache and files read, since the start
+		std::size_t Hits() const noexcept;
+		std::size_t Misses() const noexcept;
+
+	private:
+		// what is known of a file with the stamp, each part read on first request
+		struct Entry
+		{
+			FileStamp stamp;
+			std::uint64_t hash = 0;
+			bool hashed = false;
+			bool parsed = false;
+			PayloadImports imports;
+		};
+
+		// the entry of a path for a stamp, emptied if the file changed; the mutex must be held
+		Entry& EntryFor(const std::string& path, const FileStamp& stamp);
+
+		mutable std::mutex mutex;
+		std::unordered_map<std::string, Entry> entries;
+		std::atomic<std::size_t> hits = 0;
+		std::atomic<std::size_t> misses = 0;
+	};
+
+	/**
+	* @brief A module loaded from an earlier content of a payload, with the references we hold on it.
+	*/
+	struct StaleModule
+	{
+		std::string path;
+		std::uint64_t module = 0;
+		std::uint32_t references = 0;
+	};
+
+	/**
+	* @brief What the jobs on one target have loaded, by path, part of the target's session.
+	* @remarks Only loads we did are recorded, the target's module list (see ModuleCache) tells
+	*  what it loaded or unloaded by itself. The caller serializes access, like everything else
+	*  in the session.
+	*/
+	class LoadedPayloads
+	{
+	public:
+		/**
+		* @brief Answers a job without touching the target if every library is loaded already.
+		* @param libraries The paths of the job.
+		* @param fingerprints Their fingerprints.
+		* @param modules The target's modules, null if they could not be read (then never true).
+		* @param result Filled with the recorded modules if so.
+		* @return True if the job has nothing to do.
+		*/
+		bool AllUnchanged(const std::vector<std::string>& libraries, const std::vector<PayloadFingerprint>& fingerprints, const process::ModuleList* modules, InjectionResult& result) const;
+
+		// forgets the libraries that are no longer among the target's modules
+		void Prune(const process::ModuleList& modules);
+
+		// modules of the job's libraries whose files have changed since, to be unloaded before loading again
+		void Stale(const std::vector<std::string>& libraries, const std::vector<PayloadFingerprint>& fingerprints, std::vector<StaleModule>& out) const;
+
+		/**
+		* @brief Drops the references our jobs hold on stale modules and forgets them.
+		* @param stale From Stale().
+		* @param result Counts the modules that were unloaded completely.
+		* @param unload Called once per reference as bool(std::uint64_t module), false if it failed.
+		* @remarks A module another part of the target holds on to as well stays loaded, loading
+		*  the library again then merely adds a reference to the old content.
+		*/
+		template <typename Unload>
+		void DropStale(const std::vector<StaleModule>& stale, InjectionResult& result, Unload&& unload)
+		{
+			for (const StaleModule& module : stale) {
+				std::uint32_t dropped = 0;
+				while (dropped < module.references && unload(module.module))
+					++dropped;
+				if (dropped == module.references)
+					++result.reloaded;
+				loaded.erase(module.path);
+			}
+		}
+
+		// takes note of the libraries a job loaded, whatever its final state
+		void Record(const std::vector<std::string>& libraries, const std::vector<PayloadFingerprint>& fingerprints, const InjectionResult& result);
+
+		// drops one reference on a module that was unloaded through UnloadLibrary()
+		void Unloaded(std::uint64_t module);
+
+	private:
+		struct Loaded
+		{
+			std::uint64_t hash = 0;
+			std::uint64_t module = 0;
+			std::uint32_t references = 0; // loads by our jobs, each holds a loader reference
+			std::uint64_t device = 0;     // identity of the file that was loaded, see FileStamp
+			std::uint64_t inode = 0;
+		};
+
+		std::unordered_map<std::string, Loaded> loaded;
+	};
+
+	/**
+	* @brief Fingerprints the libraries of a job.
+	* @param libraries The paths.
+	* @param fingerprints Receives a fingerprint per path.
+	* @param error Receives what went wrong with the first file that failed.
+	* @return The index of that file, libraries.size() if all were hashed.
+	*/
+	std::size_t FingerprintPayloads(const std::vector<std::string>& libraries, std::vector<PayloadFingerprint>& fingerprints, const char*& error);
+}
@@ -0,0 +1,383 @@
+/**
+ * @file payload_graph.cpp
+ * @brief Import tables of PE and ELF payloads, their load order and the check of their external imports.
+ */
+
+#include "payload_graph.h"
+
+#include "payload_cache.h"
+#include "pe_image.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace
+{
+	// ELF constants, the files are parsed without <elf.h> so this builds on Windows too
+	constexpr unsigned char ElfClass32 = 1;
+	constexpr unsigned char ElfClass64 = 2;
+	constexpr unsigned char ElfDataLittle = 1;
+	constexpr std::uint32_t ElfLoad = 1;    // PT_LOAD
+	constexpr std::uint32_t ElfDynamic = 2; // PT_DYNAMIC
+	constexpr std::int64_t ElfNeeded = 1;   // DT_NEEDED
+	constexpr std::int64_t ElfStrtab = 5;   // DT_STRTAB
+	constexpr std::int64_t ElfStrsz = 10;   // DT_STRSZ
+	constexpr std::int64_t ElfSoname = 14;  // DT_SONAME
+	constexpr std::int64_t ElfRpath = 15;   // DT_RPATH
+	constexpr std::int64_t ElfRunpath = 29; // DT_RUNPATH
+
+	// size of IMAGE_IMPORT_DESCRIPTOR, the Name RVA is at offset 12
+	constexpr std::uint32_t ImportDescriptorSize = 20;
+
+	/**
+	* @brief Reads a little endian field, false if it is not entirely inside the file.
+	*/
+	template <typename T>
+	bool Read(std::span<const unsigned char> file, std::uint64_t offset, T& value) noexcept
+	{
+		static_assert(std::endian::native == std::endian::little, "fields are read in place");
+
+		if (offset > file.size() || file.size() - offset < sizeof(T))
+			return false;
+		std::memcpy(&value, file.data() + offset, sizeof(T));
+		return true;
+	}
+
+	/**
+	* @brief Reads a field of an ELF structure that is 4 bytes wide in ELF32 and 8 in ELF64.
+	*/
+	bool ReadWord(std::span<const unsigned char> file, std::uint64_t offset, bool wide, std::uint64_t& value) noexcept
+	{
+		if (wide)
+			return Read(file, offset, value);
+
+		std::uint32_t narrow = 0;
+		if (!Read(file, offset, narrow))
+			return false;
+		value = narrow;
+		return true;
+	}
+
+	/**
+	* @brief The imports of a PE image, from its import descriptors.
+	*/
+	const char* ReadPeImports(std::span<const unsigned char> file, injection::PayloadImports& out)
+	{
+		injection::PeImage image;
+		if (const char* error = image.Parse(file))
+			return error;
+
+		out.pe = true;
+		const injection::PeDirectory directory = image.Directory(injection::PeDirectoryIndex::Import);
+		if (directory.rva == 0)
+			return nullptr;
+
+		// the table ends with an all zero descriptor, not necessarily where the directory size says
+		for (std::uint32_t rva = directory.rva;; rva += ImportDescriptorSize) {
+			const std::span<const unsigned char> descriptor = image.At(rva, ImportDescriptorSize);
+			if (descriptor.empty())
+				return "The import table is cut off";
+			if (std::all_of(descriptor.begin(), descriptor.end(), [](unsigned char byte) { return byte == 0; }))
+				return nullptr;
+
+			std::uint32_t nameRva = 0;
+			std::memcpy(&nameRva, descriptor.data() + 12, sizeof(nameRva));
+			const std::string_view name = image.String(nameRva);
+			if (name.empty())
+				return "An import has no name";
+			out.names.emplace_back(name);
+		}
+	}
+
+	/**
+	* @brief Maps a virtual address of an ELF file to its file offset through the PT_LOAD segments.
+	* @return False if no segment backs it with file content.
+	*/
+	bool ElfOffset(std::span<const unsigned char> file, std::uint64_t headers, std::uint16_t count, std::uint16_t size, bool wide, std::uint64_t address, std::uint64_t& offset) noexcept
+	{
+		for (std::uint16_t i = 0; i < count; i++) {
+			const std::uint64_t header = headers + static_cast<std::uint64_t>(i) * size;
+			std::uint32_t type = 0;
+			std::uint64_t fileOffset = 0, virtualAddress = 0, fileSize = 0;
+			if (!Read(file, header, type) ||
+				!ReadWord(file, header + (wide ? 8 : 4), wide, fileOffset) ||
+				!ReadWord(file, header + (wide ? 16 : 8), wide, virtualAddress) ||
+				!ReadWord(file, header + (wide ? 32 : 16), wide, fileSize))
+				return false;
+
+			if (type == ElfLoad && address >= virtualAddress && address - virtualAddress < fileSize) {
+				offset = fileOffset + (address - virtualAddress);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/**
+	* @brief The imports of an ELF object, from its dynamic section.
+	*/
+	const char* ReadElfImports(std::span<const unsigned char> file, injection::PayloadImports& out)
+	{
+		const unsigned char elfClass = file[4];
+		if ((elfClass != ElfClass32 && elfClass != ElfClass64) || file[5] != ElfDataLittle)
+			return "Not a little endian ELF file";
+		const bool wide = elfClass == ElfClass64;
+
+		std::uint64_t headers = 0;
+		std::uint16_t headerSize = 0, headerCount = 0;
+		if (!ReadWord(file, wide ? 0x20 : 0x1C, wide, headers) ||
+			!Read(file, wide ? 0x36 : 0x2A, headerSize) ||
+			!Read(file, wide ? 0x38 : 0x2C, headerCount) ||
+			headerSize < (wide ? 56 : 32))
+			return "The ELF header is corrupt";
+
+		// the dynamic section, an object without one imports nothing
+		std::uint64_t dynamic = 0, dynamicSize = 0;
+		for (std::uint16_t i = 0; i < headerCount; i++) {
+			const std::uint64_t header = headers + static_cast<std::uint64_t>(i) * headerSize;
+			std::uint32_t type = 0;
+			if (!Read(file, header, type))
+				return "The program headers are cut off";
+			if (type == ElfDynamic) {
+				if (!ReadWord(file, header + (wide ? 8 : 4), wide, dynamic) || !ReadWord(file, header + (wide ? 32 : 16), wide, dynamicSize))
+					return "The program headers are cut off";
+				break;
+			}
+		}
+		if (dynamicSize == 0)
+			return nullptr;
+
+		// string offsets first, the string table may come after them in the section
+		const std::uint64_t entrySize = wide ? 16 : 8;
+		std::uint64_t strtab = 0, strsz = 0;
+		std::int64_t soname = -1, rpath = -1, runpath = -1;
+		std::vector<std::uint64_t> needed;
+		for (std::uint64_t entry = dynamic; entry + entrySize <= dynamic + dynamicSize; entry += entrySize) {
+			std::uint64_t tag = 0, value = 0;
+			if (!ReadWord(file, entry, wide, tag) || !ReadWord(file, entry + entrySize / 2, wide, value))
+				return "The dynamic section is cut off";
+
+			const std::int64_t signedTag = wide ? static_cast<std::int64_t>(tag) : static_cast<std::int32_t>(tag);
+			if (signedTag == 0)
+				break;
+			switch (signedTag) {
+			case ElfNeeded: needed.push_back(value); break;
+			case ElfStrtab: strtab = value; break;
+			case ElfStrsz: strsz = value; break;
+			case ElfSoname: soname = static_cast<std::int64_t>(value); break;
+			case ElfRpath: rpath = static_cast<std::int64_t>(value); break;
+			case ElfRunpath: runpath = static_cast<std::int64_t>(value); break;
+			default: break;
+			}
+		}
+
+		std::uint64_t strings = 0;
+		if (!ElfOffset(file, headers, headerCount, headerSize, wide, strtab, strings) || strings > file.size())
+			return "The dynamic string table is not in the file";
+		const std::uint64_t stringsSize = std::min<std::uint64_t>(strsz, file.size() - strings);
+
+		const auto string = [&](std::uint64_t offset) -> std::string_view {
+			if (offset >= stringsSize)
+				return { };
+			const char* begin = reinterpret_cast<const char*>(file.data() + strings + offset);
+			const void* end = std::memchr(begin, '\0', static_cast<std::size_t>(stringsSize - offset));
+			return end ? std::string_view(begin, static_cast<const char*>(end) - begin) : std::string_view();
+		};
+
+		for (std::uint64_t offset : needed) {
+			const std::string_view name = string(offset);
+			if (name.empty())
+				return "A DT_NEEDED entry has no name";
+			out.names.emplace_back(name);
+		}
+		if (soname >= 0)
+			out.soname = string(static_cast<std::uint64_t>(soname));
+
+		// DT_RPATH is ignored by ld.so when there is a DT_RUNPATH
+		const std::int64_t path = runpath >= 0 ? runpath : rpath;
+		if (path >= 0) {
+			const std::string_view list = string(static_cast<std::uint64_t>(path));
+			for (std::size_t begin = 0; begin <= list.size();) {
+				const std::size_t end = std::min(list.find(':', begin), list.size());
+				if (end > begin)
+					out.runpath.emplace_back(list.substr(begin, end - begin));
+				begin = end + 1;
+			}
+		}
+		return nullptr;
+	}
+
+	std::string_view FileName(std::string_view path) noexcept
+	{
+		const std::size_t slash = path.find_last_of("/\\");
+		return slash == std::string_view::npos ? path : path.substr(slash + 1);
+	}
+
+	// PE import names are matched like the loader does, ignoring ASCII case
+	bool SameName(std::string_view left, std::string_view right, bool ignoreCase) noexcept
+	{
+		if (!ignoreCase)
+			return left == right;
+		return left.size() == right.size() && std::equal(left.begin(), left.end(), right.begin(), [](char a, char b) {
+			return (a >= 'A' && a <= 'Z' ? a - 'A' + 'a' : a) == (b >= 'A' && b <= 'Z' ? b - 'A' + 'a' : b);
+		});
+	}
+
+	/**
+	* @brief Whether the target has a module loaded under an import's name.
+	*/
+	bool LoadedByName(const process::ModuleList& modules, std::string_view name, bool ignoreCase) noexcept
+	{
+		return std::any_of(modules.modules.begin(), modules.modules.end(), [&](const process::ModuleInfo& module) {
+			return SameName(FileName(process::NamePool::Shared().View(module.path)), name, ignoreCase);
+		});
+	}
+}
+
+/**
+* @brief Reads the imports of a PE or ELF file.
+* @param file The whole file.
+* @param out Receives the imports.
+* @return Null on success, otherwise what is wrong with the file.
+*/
+const char* injection::ReadImports(std::span<const unsigned char> file, PayloadImports& out)
+{
+	out = { };
+	if (file.size() >= 16 && std::memcmp(file.data(), "\x7F" "ELF", 4) == 0)
+		return ReadElfImports(file, out);
+	return ReadPeImports(file, out);
+}
+
+/**
+* @brief Orders the payloads of a request into waves by their imports.
+* @param request The request, its libraries are reordered and its waves and dependencies set.
+* @param error Receives a cycle or an unreadable payload.
+* @return False if the payloads cannot be ordered.
+*/
+bool injection::PlanPayloads(InjectionRequest& request, std::string& error)
+{
+	const std::vector<std::string>& libraries = request.libraries;
+	const std::size_t count = libraries.size();
+
+	std::vector<PayloadImports> imports(count);
+	for (std::size_t i = 0; i < count; i++) {
+		if (const char* problem = PayloadCache::Shared().Imports(libraries[i], imports[i])) {
+			error = libraries[i] + ": " + problem;
+			return false;
+		}
+	}
+
+	// edges to the payloads each one imports, the other imports are the target's business
+	std::vector<std::vector<std::size_t>> imported(count);
+	std::vector<PayloadDependency> external;
+	for (std::size_t i = 0; i < count; i++) {
+		for (const std::string& name : imports[i].names) {
+			std::size_t provider = 0;
+			while (provider < count && !SameName(name, FileName(libraries[provider]), imports[i].pe) &&
+				(imports[i].pe || imports[provider].soname != name))
+				++provider;
+
+			if (provider == count)
+				external.push_back({ i, name });
+			else if (provider != i)
+				imported[i].push_back(provider);
+		}
+	}
+
+	std::vector<std::size_t> order;
+	std::vector<std::size_t> waves;
+	std::vector<bool> placed(count, false);
+	std::vector<std::size_t> wave;
+	while (order.size() < count) {
+		wave.clear();
+		for (std::size_t i = 0; i < count; i++) {
+			if (!placed[i] && std::all_of(imported[i].begin(), imported[i].end(), [&](std::size_t provider) { return placed[provider]; }))
+				wave.push_back(i);
+		}
+
+		if (wave.empty()) {
+			// every payload left imports another one that is left, following those edges runs into a cycle
+			std::vector<std::size_t> path;
+			std::size_t at = std::find(placed.begin(), placed.end(), false) - placed.begin();
+			while (std::find(path.begin(), path.end(), at) == path.end()) {
+				path.push_back(at);
+				at = *std::find_if(imported[at].begin(), imported[at].end(), [&](std::size_t provider) { return !placed[provider]; });
+			}
+
+			error = "The payloads import each other in a cycle: ";
+			for (auto step = std::find(path.begin(), path.end(), at); step != path.end(); ++step)
+				error.append(FileName(libraries[*step])).append(" -> ");
+			error.append(FileName(libraries[at]));
+			return false;
+		}
+
+		for (std::size_t i : wave) {
+			placed[i] = true;
+			order.push_back(i);
+		}
+		waves.push_back(order.size());
+	}
+
+	std::vector<std::string> ordered(count);
+	std::vector<std::size_t> position(count);
+	for (std::size_t i = 0; i < count; i++) {
+		ordered[i] = std::move(request.libraries[order[i]]);
+		position[order[i]] = i;
+	}
+	for (PayloadDependency& dependency : external)
+		dependency.library = position[dependency.library];
+	std::stable_sort(external.begin(), external.end(), [](const PayloadDependency& left, const PayloadDependency& right) {
+		return left.library < right.library;
+	});
+
+	request.libraries = std::move(ordered);
+	request.waves = std::move(waves);
+	request.dependencies = std::move(external);
+	return true;
+}
+
+/**
+* @brief Checks that the imports no payload provides can be found by the target's loader.
+* @param request The planned request.
+* @param modules The target's modules, null if they could not be read.
+* @param error Receives the first import that cannot be found.
+* @return False if one is missing.
+*/
+bool injection::CheckDependencies(const InjectionRequest& request, const process::ModuleList* modules, std::string& error)
+{
+	// the dependencies of one payload are next to each other, its imports are read once
+	std::size_t importer = request.libraries.size();
+	PayloadImports imports;
+	for (const PayloadDependency& dependency : request.dependencies) {
+		const std::string& library = request.libraries[dependency.library];
+		if (dependency.library != importer) {
+			if (const char* problem = PayloadCache::Shared().Imports(library, imports)) {
+				error = library + ": " + problem;
+				return false;
+			}
+			importer = dependency.library;
+		}
+
+		if (modules && LoadedByName(*modules, dependency.name, imports.pe))
+			continue;
+		if (FindOnSearchPath(dependency.name, library, imports, request.target))
+			continue;
+
+		error = std::string(FileName(library)) + " imports " + dependency.name + ", which is neither a payload nor loaded in the target nor on its library search path";
+		return false;
+	}
+	return true;
+}
+
+/**
+* @brief Finds where the wave of a library ends.
+* @param request The request.
+* @param library Index of the library.
+* @return The index after the last library of its wave.
+*/
+std::size_t injection::WaveEnd(const InjectionRequest& request, std::size_t library) noexcept
+{
+	const auto end = std::upper_bound(request.waves.begin(), request.waves.end(), library);
+	return end != request.waves.end() ? std::min(*end, request.libraries.size()) : library + 1;
+}
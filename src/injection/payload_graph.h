@@ -0,0 +1,79 @@
+/**
+
+@file payload_graph.h
+@brief Load order of a job's payloads from their import tables, and the check of what they import from elsewhere.
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "injection_job.h"
+#include "../process/module_list.h"
+
+namespace injection
+{
+	/**
+	* @brief What a payload needs from the loader, read from the file.
+	*/
+	struct PayloadImports
+	{
+		bool pe = false;                    // a PE image, its names compare ignoring case
+		std::string soname;                 // ELF: DT_SONAME, the name other objects need it by
+		std::vector<std::string> names;     // PE: import descriptors; ELF: DT_NEEDED
+		std::vector<std::string> runpath;   // ELF: DT_RUNPATH, or DT_RPATH without one, split at ':'
+	};
+
+	/**
+	* @brief Reads the libraries a PE or ELF file imports.
+	* @param file The whole file.
+	* @param out Receives the imports.
+	* @return Null on success, otherwise what is wrong with the file.
+	* @remarks Both formats are parsed on any host. Delay-load imports of a PE image are left
+	*  out, they are resolved on first use and do not constrain the load order.
+	*/
+	const char* ReadImports(std::span<const unsigned char> file, PayloadImports& out);
+
+	/**
+	* @brief Orders the payloads of a job so that every one is loaded after the payloads it imports.
+	* @param request The request, its libraries are reordered and its waves and dependencies set.
+	* @param error Receives a cycle or an unreadable payload.
+	* @return False if the payloads cannot be ordered.
+	* @remarks The payloads form a graph with an edge from each payload to the payloads it
+	*  imports by name (file name, or DT_SONAME for ELF). Kahn's algorithm peels it into waves:
+	*  a wave holds the payloads whose imports are all in earlier waves, the payloads of one wave
+	*  are independent of each other and keep their requested order. Payloads left over when no
+	*  wave can be formed are part of a cycle, one of which is reported. Imports no payload
+	*  provides are kept in request.dependencies for CheckDependencies(). Both read the imports
+	*  through PayloadCache, unchanged payloads are not read again.
+	*/
+	bool PlanPayloads(InjectionRequest& request, std::string& error);
+
+	/**
+	* @brief Checks that the imports no payload provides can be found by the target's loader.
+	* @param request The planned request.
+	* @param modules The target's modules, null if they could not be read.
+	* @param error Receives the first import that cannot be found.
+	* @return False if one is missing.
+	* @remarks An import the target has loaded already is found, otherwise it is looked for the
+	*  way the platform loader searches (see FindOnSearchPath()).
+	*/
+	bool CheckDependencies(const InjectionRequest& request, const process::ModuleList* modules, std::string& error);
+
+	// the end of the wave a library is loaded in, the next library for a request without waves
+	std::size_t WaveEnd(const InjectionRequest& request, std::size_t library) noexcept;
+
+	/**
+	* @brief Looks for an import on the target loader's search path, implemented per platform.
+	* @param name The import.
+	* @param importer The payload that imports it.
+	* @param imports The importer's imports, for its run path.
+	* @param target The process it is loaded into.
+	* @return True if the loader would find it.
+	*/
+	bool FindOnSearchPath(std::string_view name, const std::string& importer, const PayloadImports& imports, const process::ProcessKey& target);
+}
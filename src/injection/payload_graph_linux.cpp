@@ -0,0 +1,133 @@
+/**
+ * @file payload_graph_linux.cpp
+ * @brief Linux search for payload imports the way ld.so looks for DT_NEEDED entries.
+ */
+
+#ifdef __linux__
+
+#include "payload_graph.h"
+
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+	bool IsFile(const std::string& path)
+	{
+		injection::FileStamp stamp;
+		return injection::QueryFileStamp(path, stamp);
+	}
+
+	// whether one of the ':' separated directories has the file
+	bool InDirectories(std::string_view directories, std::string_view name, std::string_view origin)
+	{
+		std::string path;
+		for (std::size_t begin = 0; begin <= directories.size();) {
+			const std::size_t end = std::min(directories.find(':', begin), directories.size());
+			std::string_view directory = directories.substr(begin, end - begin);
+			begin = end + 1;
+			if (directory.empty())
+				continue;
+
+			path.clear();
+			for (std::string_view token : { std::string_view("$ORIGIN"), std::string_view("${ORIGIN}") }) {
+				if (directory.starts_with(token)) {
+					path.assign(origin);
+					directory.remove_prefix(token.size());
+					break;
+				}
+			}
+			path.append(directory).append("/").append(name);
+			if (IsFile(path))
+				return true;
+		}
+		return false;
+	}
+
+	/**
+	* @brief Reads LD_LIBRARY_PATH from the environment the target started with.
+	* @return Empty if it is not set or the environment cannot be read.
+	*/
+	std::string TargetLibraryPath(const process::ProcessKey& target)
+	{
+		const std::string path = "/proc/" + std::to_string(target.pid) + "/environ";
+		const int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (file < 0)
+			return { };
+
+		std::string environment;
+		char buffer[4096];
+		for (ssize_t got; (got = read(file, buffer, sizeof(buffer))) > 0;)
+			environment.append(buffer, static_cast<std::size_t>(got));
+		close(file);
+
+		constexpr std::string_view variable = "LD_LIBRARY_PATH=";
+		for (std::size_t begin = 0; begin < environment.size();) {
+			const std::size_t end = std::min(environment.find('\0', begin), environment.size());
+			const std::string_view entry = std::string_view(environment).substr(begin, end - begin);
+			if (entry.starts_with(variable))
+				return std::string(entry.substr(variable.size()));
+			begin = end + 1;
+		}
+		return { };
+	}
+
+	/**
+	* @brief Whether /etc/ld.so.cache lists a library by name.
+	* @remarks The cache's string table holds the names ldconfig found and the paths they map
+	*  to, NUL terminated. ldconfig lets a name share the tail of its path, so the name is
+	*  searched for as a whole string or as the last component of a path, instead of parsing
+	*  the entries of the cache format in use.
+	*/
+	bool InLoaderCache(std::string_view name)
+	{
+		injection::MappedFile cache;
+		if (cache.Open("/etc/ld.so.cache"))
+			return false;
+
+		const std::span<const unsigned char> data = cache.Data();
+		std::string needle;
+		for (char before : { '\0', '/' }) {
+			needle.assign(1, before).append(name).push_back('\0');
+			if (memmem(data.data(), data.size(), needle.data(), needle.size()))
+				return true;
+		}
+		return false;
+	}
+}
+
+/**
+* @brief Looks for a DT_NEEDED entry the way ld.so does for the target.
+* @param name The import.
+* @param importer The payload that imports it.
+* @param imports The importer's imports, for its run path.
+* @param target The process it is loaded into.
+* @return True if ld.so would find it.
+* @remarks A name with a slash is a path. Otherwise the order is DT_RUNPATH (or DT_RPATH),
+*  LD_LIBRARY_PATH of the target, /etc/ld.so.cache and the default directories. DT_RPATH of
+*  the target's own objects and hardware capability subdirectories are not looked at, and a
+*  library that is found is not checked for the target's architecture.
+*/
+bool injection::FindOnSearchPath(std::string_view name, const std::string& importer, const PayloadImports& imports, const process::ProcessKey& target)
+{
+	if (name.find('/') != std::string_view::npos)
+		return IsFile(std::string(name));
+
+	const std::size_t slash = importer.rfind('/');
+	const std::string_view origin = slash == std::string::npos ? std::string_view(".") : std::string_view(importer).substr(0, slash);
+	for (const std::string& directory : imports.runpath) {
+		if (InDirectories(directory, name, origin))
+			return true;
+	}
+
+	if (InDirectories(TargetLibraryPath(target), name, origin))
+		return true;
+
+	return InLoaderCache(name) || InDirectories("/lib:/usr/lib:/lib64:/usr/lib64", name, origin);
+}
+
+#endif // __linux__
@@ -0,0 +1,104 @@
+/**
+ * @file payload_graph_win.cpp
+ * @brief Windows search for payload imports the way the loader looks for a DLL.
+ */
+
+#ifdef _WIN32
+
+#include "payload_graph.h"
+
+#include "../process/process_details.h"
+
+#include <algorithm>
+
+#include <windows.h>
+
+namespace
+{
+	bool InDirectory(const std::string& directory, std::string_view name)
+	{
+		if (directory.empty())
+			return false;
+
+		const std::string path = directory + "\\" + std::string(name);
+		const DWORD attributes = GetFileAttributesA(path.c_str());
+		return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+	}
+
+	std::string ParentDirectory(std::string_view path)
+	{
+		const std::size_t slash = path.find_last_of("\\/");
+		return slash == std::string_view::npos ? std::string() : std::string(path.substr(0, slash));
+	}
+
+	// the system directory of the target's bitness, SysWOW64 for an x86 target of a 64-bit injector
+	std::string SystemDirectory(process::Architecture architecture)
+	{
+		char buffer[MAX_PATH];
+		UINT length = 0;
+#ifdef _WIN64
+		if (architecture == process::Architecture::X86)
+			length = GetSystemWow64DirectoryA(buffer, MAX_PATH);
+#else
+		(void)architecture;
+#endif
+		if (length == 0)
+			length = GetSystemDirectoryA(buffer, MAX_PATH);
+		return length > 0 && length < MAX_PATH ? std::string(buffer, length) : std::string();
+	}
+}
+
+/**
+* @brief Looks for an imported DLL the way the loader does for the target.
+* @param name The import.
+* @param importer The payload that imports it.
+* @param imports The importer's imports, unused on Windows.
+* @param target The process it is loaded into.
+* @return True if the loader would find it.
+* @remarks API set names (api-* and ext-*) are resolved by the loader without a file and are
+*  always found. Otherwise the standard search order is followed: the directory of the
+*  target's executable, the system directory, the Windows directory and PATH. Known DLLs are
+*  in the system directory anyway. The current directory of the target, side-by-side
+*  assemblies and directories added with AddDllDirectory() are not looked at, and PATH is
+*  ours rather than the target's. The importer's directory is looked at as well, since a
+*  payload loaded by full path has its dependencies next to it more often than not and
+*  LoadLibraryEx() with LOAD_WITH_ALTERED_SEARCH_PATH looks there.
+*/
+bool injection::FindOnSearchPath(std::string_view name, const std::string& importer, const PayloadImports& imports, const process::ProcessKey& target)
+{
+	(void)imports;
+
+	const auto prefixed = [&](std::string_view prefix) {
+		return name.size() >= prefix.size() && std::equal(prefix.begin(), prefix.end(), name.begin(), [](char a, char b) {
+			return a == (b >= 'A' && b <= 'Z' ? b - 'A' + 'a' : b);
+		});
+	};
+	if (prefixed("api-") || prefixed("ext-"))
+		return true;
+
+	process::ProcessDetails details;
+	process::QueryProcessDetails(target, details);
+	if (details.imagePath != 0 && InDirectory(ParentDirectory(process::NamePool::Shared().View(details.imagePath)), name))
+		return true;
+
+	if (InDirectory(ParentDirectory(importer), name) || InDirectory(SystemDirectory(details.architecture), name))
+		return true;
+
+	char windows[MAX_PATH];
+	const UINT length = GetWindowsDirectoryA(windows, MAX_PATH);
+	if (length > 0 && length < MAX_PATH && InDirectory(std::string(windows, length), name))
+		return true;
+
+	char path[32767];
+	const DWORD pathLength = GetEnvironmentVariableA("PATH", path, sizeof(path));
+	const std::string_view directories(path, pathLength < sizeof(path) ? pathLength : 0);
+	for (std::size_t begin = 0; begin < directories.size();) {
+		const std::size_t end = std::min(directories.find(';', begin), directories.size());
+		if (InDirectory(std::string(directories.substr(begin, end - begin)), name))
+			return true;
+		begin = end + 1;
+	}
+	return false;
+}
+
+#endif // _WIN32
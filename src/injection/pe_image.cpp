@@ -0,0 +1,354 @@
+/**
+ * @file pe_image.cpp
+ * @brief Implements the PE parser and the payload check.
+ */
+
+#include "pe_image.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace
+{
+	// field offsets, relative to the structure named in front
+	constexpr std::size_t DosNewHeader = 0x3C;            // IMAGE_DOS_HEADER::e_lfanew
+	constexpr std::size_t FileHeaderMachine = 4;          // IMAGE_NT_HEADERS::FileHeader
+	constexpr std::size_t FileHeaderSections = 6;
+	constexpr std::size_t FileHeaderOptionalSize = 20;
+	constexpr std::size_t FileHeaderCharacteristics = 22;
+	constexpr std::size_t OptionalHeaderOffset = 24;
+	constexpr std::size_t OptionalEntryPoint = 16;        // IMAGE_OPTIONAL_HEADER32/64
+	constexpr std::size_t OptionalSectionAlignment = 32;
+	constexpr std::size_t OptionalFileAlignment = 36;
+	constexpr std::size_t OptionalSizeOfImage = 56;
+	constexpr std::size_t OptionalSizeOfHeaders = 60;
+	constexpr std::size_t OptionalDllCharacteristics = 70;
+	constexpr std::size_t OptionalDirectories32 = 96;     // DataDirectory, NumberOfRvaAndSizes right before it
+	constexpr std::size_t OptionalDirectories64 = 112;
+	constexpr std::size_t SectionHeaderSize = 40;
+
+	constexpr std::uint16_t DosSignature = 0x5A4D;        // MZ
+	constexpr std::uint32_t NtSignature = 0x00004550;     // PE\0\0
+	constexpr std::uint16_t OptionalMagic32 = 0x10B;
+	constexpr std::uint16_t OptionalMagic64 = 0x20B;
+	constexpr std::uint16_t FileExecutableImage = 0x0002;
+	constexpr std::uint16_t FileDll = 0x2000;
+
+	// the loader refuses images with more sections
+	constexpr std::uint32_t MaxSections = 96;
+
+	/**
+	* @brief Whether the loader reads a directory from the file while mapping or initializing the image.
+	* @remarks Those must lie within the raw data of a section (or the headers). Others, e.g. the
+	*  exception table, may in principle point at memory only filled in at run time.
+	*/
+	bool NeedsFileData(injection::PeDirectoryIndex index) noexcept
+	{
+		switch (index) {
+		case injection::PeDirectoryIndex::Export:
+		case injection::PeDirectoryIndex::Import:
+		case injection::PeDirectoryIndex::BaseRelocation:
+		case injection::PeDirectoryIndex::Tls:
+		case injection::PeDirectoryIndex::LoadConfig:
+		case injection::PeDirectoryIndex::DelayImport:
+			return true;
+		default:
+			return false;
+		}
+	}
+}
+
+/**
+* @brief Checks a file and remembers where its headers are.
+* @param file The whole file.
+* @return Null on success, otherwise what is wrong with the file.
+*/
+const char* injection::PeImage::Parse(std::span<const unsigned char> file) noexcept
+{
+	*this = PeImage();
+	this->file = file;
+
+	const char* error = ParseHeaders();
+	if (error)
+		*this = PeImage();
+	return error;
+}
+
+/**
+* @brief Does the work of Parse(), every offset is checked against the file before it is read.
+*/
+const char* injection::PeImage::ParseHeaders() noexcept
+{
+	if (file.size() < DosNewHeader + 4 || Field<std::uint16_t>(0) != DosSignature)
+		return "Not a PE file, the MZ header is missing";
+
+	const std::size_t ntHeaders = Field<std::uint32_t>(DosNewHeader);
+	if (ntHeaders > file.size() || file.size() - ntHeaders < OptionalHeaderOffset)
+		return "The PE header lies outside the file";
+	if (Field<std::uint32_t>(ntHeaders) != NtSignature)
+		return "Not a PE file, the PE signature is missing";
+
+	machine = Field<std::uint16_t>(ntHeaders + FileHeaderMachine);
+	sectionCount = Field<std::uint16_t>(ntHeaders + FileHeaderSections);
+	characteristics = Field<std::uint16_t>(ntHeaders + FileHeaderCharacteristics);
+
+	const std::size_t optionalSize = Field<std::uint16_t>(ntHeaders + FileHeaderOptionalSize);
+	optionalHeader = ntHeaders + OptionalHeaderOffset;
+	if (optionalSize < sizeof(std::uint16_t) || file.size() - optionalHeader < optionalSize)
+		return "The optional header lies outside the file";
+
+	const std::uint16_t magic = Field<std::uint16_t>(optionalHeader);
+	if (magic != OptionalMagic32 && magic != OptionalMagic64)
+		return "The optional header has an unknown format";
+	wide = magic == OptionalMagic64;
+
+	const std::size_t directories = wide ? OptionalDirectories64 : OptionalDirectories32;
+	if (optionalSize < directories)
+		return "The optional header is truncated";
+
+	directoryCount = Field<std::uint32_t>(optionalHeader + directories - sizeof(std::uint32_t));
+	if (directoryCount > static_cast<std::uint32_t>(PeDirectoryIndex::Count) || optionalSize < directories + directoryCount * sizeof(PeDirectory))
+		return "The data directories do not fit into the optional header";
+
+	if (!(characteristics & FileExecutableImage))
+		return "Not an executable image, perhaps an object file";
+
+	switch (machine) {
+	case PeMachineI386:
+		if (wide)
+			return "A 32-bit x86 image with a 64-bit optional header";
+		break;
+	case PeMachineAmd64:
+	case PeMachineArm64:
+		if (!wide)
+			return "A 64-bit image with a 32-bit optional header";
+		break;
+	default:
+		return "The image is for an unsupported machine type";
+	}
+
+	const std::uint32_t sectionAlignment = Field<std::uint32_t>(optionalHeader + OptionalSectionAlignment);
+	const std::uint32_t fileAlignment = Field<std::uint32_t>(optionalHeader + OptionalFileAlignment);
+	if (!std::has_single_bit(sectionAlignment) || !std::has_single_bit(fileAlignment) || sectionAlignment < fileAlignment)
+		return "The image has invalid section or file alignment";
+
+	sizeOfImage = Field<std::uint32_t>(optionalHeader + OptionalSizeOfImage);
+	sizeOfHeaders = Field<std::uint32_t>(optionalHeader + OptionalSizeOfHeaders);
+	if (sizeOfImage == 0 || sizeOfHeaders > sizeOfImage || sizeOfHeaders > file.size())
+		return "The headers do not fit into the image";
+
+	// the section table is part of the headers the loader maps
+	sectionTable = optionalHeader + optionalSize;
+	if (sectionCount == 0 || sectionCount > MaxSections)
+		return "The image has no or too many sections";
+	if (sectionTable > sizeOfHeaders || (sizeOfHeaders - sectionTable) / SectionHeaderSize < sectionCount)
+		return "The section table lies outside the headers";
+
+	// sections are mapped in ascending order behind the headers and must not overlap
+	std::uint64_t previousEnd = sizeOfHeaders;
+	for (std::uint32_t i = 0; i < sectionCount; i++) {
+		const PeSection section = Section(i);
+		if (section.rawSize != 0 && (section.rawOffset > file.size() || file.size() - section.rawOffset < section.rawSize))
+			return "The data of a section lies outside the file";
+
+		const std::uint64_t end = static_cast<std::uint64_t>(section.virtualAddress) + (section.virtualSize ? section.virtualSize : section.rawSize);
+		if (end > sizeOfImage)
+			return "A section lies outside the image";
+		if (section.virtualAddress < previousEnd)
+			return "Sections overlap each other or the headers";
+		previousEnd = end;
+	}
+
+	if (EntryPoint() >= sizeOfImage)
+		return "The entry point lies outside the image";
+
+	for (std::uint32_t i = 0; i < directoryCount; i++) {
+		const PeDirectoryIndex index = static_cast<PeDirectoryIndex>(i);
+		const PeDirectory directory = Directory(index);
+		if (directory.rva == 0)
+			continue;
+
+		if (index == PeDirectoryIndex::Security) {
+			if (directory.rva > file.size() || file.size() - directory.rva < directory.size)
+				return "The certificate table lies outside the file";
+			continue;
+		}
+
+		if (static_cast<std::uint64_t>(directory.rva) + directory.size > sizeOfImage)
+			return "A data directory lies outside the image";
+
+		std::size_t offset = 0;
+		if (NeedsFileData(index) && Backing(directory.rva, offset) < (directory.size ? directory.size : 1))
+			return "A data directory lies outside the data of the file";
+	}
+
+	return nullptr;
+}
+
+/**
+* @brief Gets the IMAGE_DLLCHARACTERISTICS_* flags.
+*/
+std::uint16_t injection::PeImage::DllCharacteristics() const noexcept
+{
+	return Field<std::uint16_t>(optionalHeader + OptionalDllCharacteristics);
+}
+
+/**
+* @brief Checks for IMAGE_FILE_DLL, programs cannot be loaded as a library.
+*/
+bool injection::PeImage::IsDll() const noexcept
+{
+	return (characteristics & FileDll) != 0;
+}
+
+/**
+* @brief Gets the RVA of the entry point, 0 if the image has none.
+*/
+std::uint32_t injection::PeImage::EntryPoint() const noexcept
+{
+	return Field<std::uint32_t>(optionalHeader + OptionalEntryPoint);
+}
+
+/**
+* @brief Reads a section header.
+* @param index Below SectionCount().
+*/
+injection::PeSection injection::PeImage::Section(std::uint32_t index) const noexcept
+{
+	const std::size_t header = sectionTable + index * SectionHeaderSize;
+
+	const char* name = reinterpret_cast<const char*>(file.data() + header);
+	PeSection section;
+	section.name = std::string_view(name, strnlen(name, 8));
+	section.virtualSize = Field<std::uint32_t>(header + 8);
+	section.virtualAddress = Field<std::uint32_t>(header + 12);
+	section.rawSize = Field<std::uint32_t>(header + 16);
+	section.rawOffset = Field<std::uint32_t>(header + 20);
+	section.characteristics = Field<std::uint32_t>(header + 36);
+	return section;
+}
+
+/**
+* @brief Reads a data directory.
+* @param index Which one.
+* @return The directory, zero if the optional header has fewer.
+*/
+injection::PeDirectory injection::PeImage::Directory(PeDirectoryIndex index) const noexcept
+{
+	const std::uint32_t i = static_cast<std::uint32_t>(index);
+	if (i >= directoryCount)
+		return { };
+
+	const std::size_t entry = optionalHeader + (wide ? OptionalDirectories64 : OptionalDirectories32) + i * sizeof(PeDirectory);
+	return { Field<std::uint32_t>(entry), Field<std::uint32_t>(entry + 4) };
+}
+
+/**
+* @brief Finds the file bytes of an RVA range.
+* @param rva Start of the range.
+* @param size Its length.
+* @return The bytes, empty if the range is not completely in the file.
+*/
+std::span<const unsigned char> injection::PeImage::At(std::uint32_t rva, std::uint32_t size) const noexcept
+{
+	std::size_t offset = 0;
+	if (Backing(rva, offset) < size)
+		return { };
+	return file.subspan(offset, size);
+}
+
+/**
+* @brief Reads a string such as an import name.
+* @param rva Where it starts.
+* @return The string without the NUL, empty if there is none before the end of the data.
+*/
+std::string_view injection::PeImage::String(std::uint32_t rva) const noexcept
+{
+	std::size_t offset = 0;
+	const std::size_t available = Backing(rva, offset);
+	if (available == 0)
+		return { };
+
+	const char* start = reinterpret_cast<const char*>(file.data() + offset);
+	const void* end = std::memchr(start, '\0', available);
+	return end ? std::string_view(start, static_cast<const char*>(end) - start) : std::string_view();
+}
+
+/**
+* @brief Reads a little endian field at a file offset the caller has checked.
+*/
+template <typename T>
+T injection::PeImage::Field(std::size_t offset) const noexcept
+{
+	static_assert(std::endian::native == std::endian::little, "fields are read in place");
+
+	// headers may sit at any offset, memcpy instead of a possibly unaligned load
+	T value;
+	std::memcpy(&value, file.data() + offset, sizeof(T));
+	return value;
+}
+
+/**
+* @brief Maps an RVA to the file.
+* @param rva The address relative to the image base.
+* @param offset Receives the file offset.
+* @return How many bytes of the file from offset on belong to the same part of the image,
+*  0 if the RVA is not backed by the file (e.g. uninitialized data).
+* @remarks Like the loader, only min(SizeOfRawData, VirtualSize) bytes of a section come from
+*  the file, the rest of its pages are zero.
+*/
+std::size_t injection::PeImage::Backing(std::uint32_t rva, std::size_t& offset) const noexcept
+{
+	if (rva < sizeOfHeaders) {
+		offset = rva;
+		return sizeOfHeaders - rva;
+	}
+
+	for (std::uint32_t i = 0; i < sectionCount; i++) {
+		const PeSection section = Section(i);
+		const std::uint32_t loaded = section.virtualSize ? (std::min)(section.virtualSize, section.rawSize) : section.rawSize;
+		if (rva >= section.virtualAddress && rva - section.virtualAddress < loaded) {
+			offset = static_cast<std::size_t>(section.rawOffset) + (rva - section.virtualAddress);
+			return loaded - (rva - section.virtualAddress);
+		}
+	}
+	return 0;
+}
+
+/**
+* @brief Maps a payload and checks it.
+* @param path The file.
+* @param machine Receives the machine type of the image.
+* @return Null on success, otherwise what is wrong with it.
+* @remarks Only the pages holding the headers, the section table and the directories that are
+*  checked are read, the file is unmapped again before returning.
+*/
+const char* injection::InspectPayload(const std::string& path, std::uint16_t& machine)
+{
+	MappedFile file;
+	if (const char* error = file.Open(path))
+		return error;
+
+	PeImage image;
+	if (const char* error = image.Parse(file.Data()))
+		return error;
+	if (!image.IsDll())
+		return "Not a DLL but a program";
+
+	machine = image.Machine();
+	return nullptr;
+}
+
+/**
+* @brief Checks whether a process of the given bitness can load an image.
+* @param machine IMAGE_FILE_MACHINE_* of the image.
+* @param wide Whether the process is 64-bit.
+* @remarks A 64-bit process may run on x64 or ARM64, so either 64-bit machine type passes;
+*  the loader reports the rare mismatch between those two itself.
+*/
+bool injection::MachineRunsIn(std::uint16_t machine, bool wide) noexcept
+{
+	return wide ? machine == PeMachineAmd64 || machine == PeMachineArm64 : machine == PeMachineI386;
+}
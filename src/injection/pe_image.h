@@ -0,0 +1,137 @@
+/**
+
+@file pe_image.h
+@brief Portable parser for the headers and directories of PE files, used to check payloads.
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace injection
+{
+	// IMAGE_FILE_MACHINE_* of the images we know how to inject
+	constexpr std::uint16_t PeMachineI386 = 0x014C;
+	constexpr std::uint16_t PeMachineAmd64 = 0x8664;
+	constexpr std::uint16_t PeMachineArm64 = 0xAA64;
+
+	/**
+	* @brief IMAGE_DIRECTORY_ENTRY_* indices of the data directories.
+	*/
+	enum class PeDirectoryIndex : std::uint32_t
+	{
+		Export = 0,
+		Import = 1,
+		Resource = 2,
+		Exception = 3,
+		Security = 4, // a file offset rather than an RVA, the certificates are not mapped
+		BaseRelocation = 5,
+		Debug = 6,
+		Tls = 9,
+		LoadConfig = 10,
+		BoundImport = 11,
+		ImportAddressTable = 12,
+		DelayImport = 13,
+		ClrRuntime = 14,
+		Count = 16,
+	};
+
+	struct PeDirectory
+	{
+		std::uint32_t rva = 0;
+		std::uint32_t size = 0;
+	};
+
+	/**
+	* @brief The fields of a section header the parser checks.
+	*/
+	struct PeSection
+	{
+		std::string_view name; // up to 8 characters, not NUL terminated
+		std::uint32_t virtualAddress = 0;
+		std::uint32_t virtualSize = 0;
+		std::uint32_t rawOffset = 0;
+		std::uint32_t rawSize = 0;
+		std::uint32_t characteristics = 0;
+	};
+
+	/**
+	* @brief A view of a PE file in memory, typically a MappedFile, checked the way the loader would.
+	* @remarks Nothing is copied: the parser keeps the span and the offsets of the headers,
+	*  fields are read from the file when asked for. Parse() checks everything an accessor relies
+	*  on (header and section table bounds, section and directory ranges against the file and the
+	*  image), so the accessors need no further checks of their own and never read outside the
+	*  span, whatever the file contains. Reading works on any little endian host, so payloads can
+	*  be checked without Windows.
+	*/
+	class PeImage
+	{
+	public:
+		/**
+		* @brief Checks the headers, sections and directories of a file.
+		* @param file The whole file, it must stay valid while the image is used.
+		* @return Null on success, otherwise what is wrong with the file.
+		* @remarks The accessors may only be used after a successful Parse().
+		*/
+		const char* Parse(std::span<const unsigned char> file) noexcept;
+
+		std::uint16_t Machine() const noexcept { return machine; }
+
+		// PE32+, i.e. an image for 64-bit processes
+		bool Wide() const noexcept { return wide; }
+
+		// IMAGE_FILE_* and IMAGE_DLLCHARACTERISTICS_* flags
+		std::uint16_t Characteristics() const noexcept { return characteristics; }
+		std::uint16_t DllCharacteristics() const noexcept;
+		bool IsDll() const noexcept;
+
+		std::uint32_t SizeOfImage() const noexcept { return sizeOfImage; }
+		std::uint32_t EntryPoint() const noexcept;
+
+		std::uint32_t SectionCount() const noexcept { return sectionCount; }
+		PeSection Section(std::uint32_t index) const noexcept;
+
+		// a zero directory if the image has none
+		PeDirectory Directory(PeDirectoryIndex index) const noexcept;
+
+		// the file bytes of an RVA range, empty if any part of it is not in the file
+		std::span<const unsigned char> At(std::uint32_t rva, std::uint32_t size) const noexcept;
+
+		// the NUL terminated string at an RVA, empty if it does not end inside its section
+		std::string_view String(std::uint32_t rva) const noexcept;
+
+	private:
+		const char* ParseHeaders() noexcept;
+
+		template <typename T>
+		T Field(std::size_t offset) const noexcept;
+
+		// file offset of an RVA and how many bytes of the file follow it, 0 if it is not in the file
+		std::size_t Backing(std::uint32_t rva, std::size_t& offset) const noexcept;
+
+		std::span<const unsigned char> file;
+		std::size_t optionalHeader = 0;
+		std::size_t sectionTable = 0;
+		std::uint32_t sectionCount = 0;
+		std::uint32_t directoryCount = 0;
+		std::uint32_t sizeOfHeaders = 0;
+		std::uint32_t sizeOfImage = 0;
+		std::uint16_t machine = 0;
+		std::uint16_t characteristics = 0;
+		bool wide = false;
+	};
+
+	/**
+	* @brief Maps a payload and checks that it is a DLL the loader can map.
+	* @param path The file.
+	* @param machine Receives its machine type.
+	* @return Null on success, otherwise what is wrong with it.
+	*/
+	const char* InspectPayload(const std::string& path, std::uint16_t& machine);
+
+	// whether an image of the machine type can be loaded into a 64-bit or 32-bit process
+	bool MachineRunsIn(std::uint16_t machine, bool wide) noexcept;
+}
@@ -0,0 +1,223 @@
+/**
+ * @file process_watch.cpp
+ * @brief Implements watch mode.
+ */
+
+#include "process_watch.h"
+#include "target_selector.h"
+#include "../process/sort_keys.h"
+
+#include <algorithm>
+
+namespace
+{
+	// spawn times the snapshots never picked up, e.g. of processes that exited right away, are dropped after this
+	constexpr std::chrono::seconds SpawnRetention(5);
+}
+
+/**
+* @brief Creates a stopped watch without rules.
+* @param snapshots The service whose snapshots are matched, refreshed early on new processes.
+* @param queue Receives the jobs.
+* @param fallbackInterval Snapshot interval while rules exist and there is no spawn monitor.
+*/
+injection::ProcessWatch::ProcessWatch(process::SnapshotService& snapshots, InjectionQueue& queue, std::chrono::milliseconds fallbackInterval) noexcept
+	: snapshots(snapshots), queue(queue), fallbackInterval(fallbackInterval)
+{
+}
+
+/**
+* @brief Stops watching.
+*/
+injection::ProcessWatch::~ProcessWatch()
+{
+	Stop();
+}
+
+/**
+* @brief Registers with the snapshot service, rules take effect from the next snapshot on.
+*/
+void injection::ProcessWatch::Start()
+{
+	{
+		std::lock_guard lock(mutex);
+		if (listener != 0)
+			return;
+	}
+
+	const std::size_t id = snapshots.AddListener([this](const process::ProcessSnapshot& previous, const process::ProcessSnapshot& current) {
+		OnSnapshot(previous, current);
+	});
+
+	std::lock_guard lock(mutex);
+	listener = id;
+	UpdateMonitor();
+}
+
+/**
+* @brief Unregisters from the snapshot service and stops the monitor, the rules are kept.
+*/
+void injection::ProcessWatch::Stop() noexcept
+{
+	std::size_t id = 0;
+	{
+		std::lock_guard lock(mutex);
+		id = listener;
+		listener = 0;
+		UpdateMonitor();
+	}
+
+	// not under the mutex, RemoveListener() waits for a running OnSnapshot(), which takes it
+	if (id != 0)
+		snapshots.RemoveListener(id);
+}
+
+/**
+* @brief Adds a rule.
+* @param rule The rule, its id and counter are overwritten.
+* @return The id of the rule.
+*/
+std::uint64_t injection::ProcessWatch::AddRule(WatchRule rule)
+{
+	std::lock_guard lock(mutex);
+
+	rule.id = nextRuleId++;
+	rule.matched = 0;
+
+	ActiveRule active{ std::move(rule), std::string() };
+	active.folded.resize(active.rule.pattern.size());
+	process::FoldAsciiCase(active.rule.pattern, active.folded.data());
+	rules.push_back(std::move(active));
+
+	UpdateMonitor();
+	return rules.back().rule.id;
+}
+
+/**
+* @brief Removes a rule, jobs it already submitted are not affected.
+* @param id The id returned by AddRule().
+*/
+void injection::ProcessWatch::RemoveRule(std::uint64_t id)
+{
+	std::lock_guard lock(mutex);
+	std::erase_if(rules, [id](const ActiveRule& active) { return active.rule.id == id; });
+	UpdateMonitor();
+}
+
+/**
+* @brief Copies the rules.
+* @param out Receives the rules in the order they were added.
+*/
+void injection::ProcessWatch::Rules(std::vector<WatchRule>& out) const
+{
+	std::lock_guard lock(mutex);
+	out.clear();
+	for (const ActiveRule& active : rules)
+		out.push_back(active.rule);
+}
+
+/**
+* @brief Runs the spawn monitor exactly while the watch is started and has rules.
+* @remarks Without a monitor the snapshot interval is lowered instead and restored afterwards.
+*/
+void injection::ProcessWatch::UpdateMonitor()
+{
+	const bool wanted = listener != 0 && !rules.empty();
+	if (wanted == monitoring)
+		return;
+
+	monitoring = wanted;
+	if (wanted) {
+		const bool started = monitor.Start([this](std::uint32_t pid, std::chrono::steady_clock::time_point at) {
+			OnSpawn(pid, at);
+		});
+
+		if (!started && snapshots.GetInterval() > fallbackInterval) {
+			savedInterval = snapshots.GetInterval();
+			snapshots.SetInterval(fallbackInterval);
+		}
+		return;
+	}
+
+	monitor.Stop();
+	if (savedInterval.count() != 0) {
+		snapshots.SetInterval(savedInterval);
+		savedInterval = { };
+	}
+
+	std::lock_guard lock(spawnMutex);
+	spawned.clear();
+}
+
+/**
+* @brief Notes when a process started and asks for a snapshot that shows it.
+* @remarks Runs on the monitor thread. The first report of a pid wins: fork comes before
+*  exec, and the fork is when the process started.
+*/
+void injection::ProcessWatch::OnSpawn(std::uint32_t pid, std::chrono::steady_clock::time_point at)
+{
+	if (pid != 0) {
+		std::lock_guard lock(spawnMutex);
+		spawned.emplace(pid, at);
+	}
+	snapshots.RequestRefresh();
+}
+
+/**
+* @brief Submits a job per rule for every process that started since the previous snapshot.
+* @param previous The snapshot before.
+* @param current The new snapshot, current.changes holds the diff.
+* @remarks Runs on the snapshot worker. A Changed event with a new name is an exec on Linux
+*  and counts as a start. Without a spawn time from the monitor the previous snapshot's time
+*  is used, the earliest the process can have started, so latencies err on the high side.
+*/
+void injection::ProcessWatch::OnSnapshot(const process::ProcessSnapshot& previous, const process::ProcessSnapshot& current)
+{
+	// the first snapshot lists everything that was already running
+	if (previous.generation == 0)
+		return;
+
+	std::vector<InjectionRequest> requests;
+	{
+		std::lock_guard lock(mutex);
+		if (rules.empty())
+			return;
+
+		std::lock_guard spawnLock(spawnMutex);
+		for (const process::ProcessEvent& event : current.changes) {
+			const bool started = event.type == process::ProcessEventType::Added ||
+				(event.type == process::ProcessEventType::Changed && previous.processes[event.previousIndex].nameId != current.processes[event.currentIndex].nameId);
+			if (!started)
+				continue;
+
+			const process::ProcessInfo& info = current.processes[event.currentIndex];
+
+			std::chrono::steady_clock::time_point spawnedAt = previous.takenAt;
+			if (const auto found = spawned.find(info.pid); found != spawned.end()) {
+				spawnedAt = found->second;
+				spawned.erase(found);
+			}
+
+			for (ActiveRule& active : rules) {
+				if (!MatchesPattern(info.sortKey, active.folded))
+					continue;
+
+				InjectionRequest& request = requests.emplace_back();
+				request.target = info.Key();
+				request.targetName = info.nameId;
+				request.libraries = active.rule.libraries;
+				request.timeout = active.rule.timeout;
+				request.batched = active.rule.batched;
+				request.minimalStop = active.rule.minimalStop;
+				request.spawnedAt = spawnedAt;
+				++active.rule.matched;
+			}
+		}
+
+		const auto expired = current.takenAt - SpawnRetention;
+		std::erase_if(spawned, [expired](const auto& entry) { return entry.second < expired; });
+	}
+
+	if (!requests.empty())
+		queue.SubmitGroup(std::move(requests));
+}
@@ -0,0 +1,109 @@
+/**
+
+@file process_watch.h
+@brief Watch mode: injects into matching processes as soon as they start.
+*/
+
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "injection_queue.h"
+#include "../process/snapshot_service.h"
+#include "../process/spawn_monitor.h"
+
+namespace injection
+{
+	/**
+	* @brief Inject these libraries into every new process whose name matches a pattern.
+	*/
+	struct WatchRule
+	{
+		// assigned by ProcessWatch::AddRule()
+		std::uint64_t id = 0;
+
+		// like TargetSelector::pattern, case-insensitive with '*' and '?'
+		std::string pattern;
+
+		// full paths, loaded in this order
+		std::vector<std::string> libraries;
+
+		// copied into every request
+		std::chrono::milliseconds timeout = std::chrono::seconds(10);
+		bool batched = true;
+		bool minimalStop = false;
+
+		// processes the rule has submitted a job for
+		std::uint64_t matched = 0;
+	};
+
+	/**
+	* @brief Evaluates watch rules against the diff of every new snapshot.
+	* @remarks Only processes that start (or, on Linux, exec) while the watch runs are matched,
+	*  never the ones already running. To see them within milliseconds rather than at the next
+	*  regular refresh, a SpawnMonitor asks the snapshot service for a refresh the moment the
+	*  kernel reports a new process; where there is none (Windows) the snapshot interval is
+	*  lowered while rules exist. Each job carries the time its target started, the queue
+	*  records spawn to submit ("detect") and spawn to injected ("spawn") latencies from it.
+	*/
+	class ProcessWatch
+	{
+	public:
+		ProcessWatch(process::SnapshotService& snapshots, InjectionQueue& queue,
+			std::chrono::milliseconds fallbackInterval = std::chrono::milliseconds(50)) noexcept;
+		~ProcessWatch();
+
+		ProcessWatch(const ProcessWatch&) = delete;
+		ProcessWatch& operator=(const ProcessWatch&) = delete;
+
+		// starts following the snapshots, call before the snapshot service stops
+		void Start();
+		void Stop() noexcept;
+
+		// returns the id of the new rule
+		std::uint64_t AddRule(WatchRule rule);
+		void RemoveRule(std::uint64_t id);
+
+		// copies the rules with their counters
+		void Rules(std::vector<WatchRule>& out) const;
+
+		// where new processes are learned from, None while no rule exists
+		process::SpawnSource Source() const noexcept { return monitor.Source(); }
+
+	private:
+		struct ActiveRule
+		{
+			WatchRule rule;
+			std::string folded;
+		};
+
+		void OnSpawn(std::uint32_t pid, std::chrono::steady_clock::time_point at);
+		void OnSnapshot(const process::ProcessSnapshot& previous, const process::ProcessSnapshot& current);
+
+		// starts the monitor with the first rule and stops it with the last, mutex must be held
+		void UpdateMonitor();
+
+		process::SnapshotService& snapshots;
+		InjectionQueue& queue;
+		const std::chrono::milliseconds fallbackInterval;
+
+		mutable std::mutex mutex;
+		std::vector<ActiveRule> rules;
+		std::uint64_t nextRuleId = 1;
+		std::size_t listener = 0;
+		process::SpawnMonitor monitor;
+		bool monitoring = false;
+
+		// the snapshot interval replaced while polling without a monitor, zero if it was not
+		std::chrono::milliseconds savedInterval = { };
+
+		// when the monitor saw each pid start, consumed by the next snapshot that lists it
+		std::mutex spawnMutex;
+		std::unordered_map<std::uint32_t, std::chrono::steady_clock::time_point> spawned;
+	};
+}
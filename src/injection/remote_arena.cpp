@@ -0,0 +1,53 @@
+/**
+ * @file remote_arena.cpp
+ * @brief Implements the remote bump allocator.
+ */
+
+#include "remote_arena.h"
+
+/**
+* @brief Starts handing out addresses of a region.
+* @param base The remote address of the region.
+* @param capacity The size of the region.
+* @param reserved The size of the prefix that is kept for the caller.
+*/
+void injection::RemoteArena::Attach(std::uint64_t base, std::size_t capacity, std::size_t reserved) noexcept
+{
+	this->base = base;
+	this->capacity = capacity;
+	this->reserved = reserved < capacity ? reserved : capacity;
+	offset = this->reserved;
+}
+
+/**
+* @brief Stops using the region.
+* @remarks Used when a remote thread may still read the region, it is then left to the target.
+*/
+void injection::RemoteArena::Detach() noexcept
+{
+	*this = RemoteArena();
+}
+
+/**
+* @brief Allocates remote memory.
+* @param size The number of bytes.
+* @param alignment The alignment of the address, a power of two.
+* @return The remote address, or 0 if the region has no room left.
+*/
+std::uint64_t injection::RemoteArena::Allocate(std::size_t size, std::size_t alignment) noexcept
+{
+	const std::size_t start = (offset + alignment - 1) & ~(alignment - 1);
+	if (!Attached() || start > capacity || capacity - start < size)
+		return 0;
+
+	offset = start + size;
+	return base + start;
+}
+
+/**
+* @brief Makes the whole region after the reserved prefix available again.
+*/
+void injection::RemoteArena::Reset() noexcept
+{
+	offset = reserved;
+}
@@ -0,0 +1,49 @@
+/**
+
+@file remote_arena.h
+@brief Bump allocator for a memory region inside a target process.
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace injection
+{
+	/**
+	* @brief Hands out addresses inside one remote region.
+	* @remarks The arena only does the bookkeeping, reserving and writing the region is up to
+	*  the platform code. A region is reserved once per target and reused by every injection
+	*  into it: the first bytes hold the loader stub, the rest is reset before each job and
+	*  bump-allocated for paths and result slots. Addresses are 64-bit regardless of the
+	*  bitness of either process.
+	*/
+	class RemoteArena
+	{
+	public:
+		// takes over a region, the first reserved bytes are never handed out
+		void Attach(std::uint64_t base, std::size_t capacity, std::size_t reserved) noexcept;
+
+		// forgets the region without releasing it
+		void Detach() noexcept;
+
+		bool Attached() const noexcept { return base != 0; }
+		std::uint64_t Base() const noexcept { return base; }
+		std::size_t Capacity() const noexcept { return capacity; }
+
+		// bytes left for Allocate() after a Reset()
+		std::size_t Available() const noexcept { return capacity - reserved; }
+
+		// returns the remote address of size bytes, 0 if the region is full
+		std::uint64_t Allocate(std::size_t size, std::size_t alignment = 8) noexcept;
+
+		// drops every allocation, the reserved prefix stays
+		void Reset() noexcept;
+
+	private:
+		std::uint64_t base = 0;
+		std::size_t capacity = 0;
+		std::size_t reserved = 0;
+		std::size_t offset = 0;
+	};
+}
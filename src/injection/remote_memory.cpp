@@ -0,0 +1,70 @@
+/**
+ * @file remote_memory.cpp
+ * @brief Implements the queue of the remote memory access.
+ */
+
+#include "remote_memory.h"
+
+/**
+* @brief Queues a write.
+* @param address The remote destination.
+* @param data The bytes, must stay valid until the next flush.
+* @param size The number of bytes.
+*/
+void injection::RemoteMemory::QueueWrite(std::uint64_t address, const void* data, std::size_t size)
+{
+	if (size != 0)
+		queue.push_back({ address, const_cast<void*>(data), size, true });
+}
+
+/**
+* @brief Queues a read.
+* @param address The remote source.
+* @param out Receives the bytes during the next flush.
+* @param size The number of bytes.
+*/
+void injection::RemoteMemory::QueueRead(std::uint64_t address, void* out, std::size_t size)
+{
+	if (size != 0)
+		queue.push_back({ address, out, size, false });
+}
+
+/**
+* @brief Carries out all queued operations.
+* @return False if any operation failed, later batches are still attempted.
+*/
+bool injection::RemoteMemory::Flush()
+{
+	bool succeeded = true;
+	for (std::size_t first = 0; first < queue.size();) {
+		std::size_t last = first + 1;
+		while (last < queue.size() && queue[last].write == queue[first].write)
+			++last;
+
+		if (!Transfer(queue.data() + first, last - first))
+			succeeded = false;
+		first = last;
+	}
+	queue.clear();
+	return succeeded;
+}
+
+/**
+* @brief Writes one buffer, together with whatever is queued.
+* @return False if anything failed.
+*/
+bool injection::RemoteMemory::Write(std::uint64_t address, const void* data, std::size_t size)
+{
+	QueueWrite(address, data, size);
+	return Flush();
+}
+
+/**
+* @brief Reads one buffer, together with whatever is queued.
+* @return False if anything failed.
+*/
+bool injection::RemoteMemory::Read(std::uint64_t address, void* out, std::size_t size)
+{
+	QueueRead(address, out, size);
+	return Flush();
+}
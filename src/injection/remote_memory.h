@@ -0,0 +1,85 @@
+/**
+
+@file remote_memory.h
+@brief Batched reads and writes of the memory of another process.
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace injection
+{
+#ifdef _WIN32
+	// a process HANDLE with PROCESS_VM_READ, PROCESS_VM_WRITE and PROCESS_VM_OPERATION access
+	using RemoteProcess = void*;
+#else
+	// a pid (or tid) we are allowed to ptrace
+	using RemoteProcess = int;
+#endif
+
+	/**
+	* @brief Queues reads and writes of a target's memory and carries them out with as few calls as possible.
+	* @remarks Buffers are not copied, they must stay valid until Flush(). Operations take effect
+	*  in queue order, consecutive operations in the same direction form one batch. On Linux a
+	*  batch is a single process_vm_writev/readv (per IOV_MAX operations), falling back to
+	*  pwrite/pread on /proc/<pid>/mem for what the vectored calls refuse, e.g. read-only pages.
+	*  Windows has no vectored call, there operations on adjacent remote ranges are merged into
+	*  one WriteProcessMemory/ReadProcessMemory through a staging buffer.
+	*/
+	class RemoteMemory
+	{
+	public:
+		explicit RemoteMemory(RemoteProcess process) noexcept : process(process) { }
+		~RemoteMemory();
+
+		RemoteMemory(const RemoteMemory&) = delete;
+		RemoteMemory& operator=(const RemoteMemory&) = delete;
+
+		void QueueWrite(std::uint64_t address, const void* data, std::size_t size);
+		void QueueRead(std::uint64_t address, void* out, std::size_t size);
+
+		// carries out everything queued, false if anything failed; the queue is empty afterwards either way
+		bool Flush();
+
+		// a single operation, flushes the queue with it
+		bool Write(std::uint64_t address, const void* data, std::size_t size);
+		bool Read(std::uint64_t address, void* out, std::size_t size);
+
+		std::size_t Pending() const noexcept { return queue.size(); }
+
+		// totals over all flushes so far
+		std::size_t BytesTransferred() const noexcept { return transferred; }
+		std::size_t Calls() const noexcept { return calls; }
+
+	private:
+		struct Operation
+		{
+			std::uint64_t address;
+			void* buffer;
+			std::size_t size;
+			bool write;
+		};
+
+		// platform part, carries out operations that all go in the same direction
+		bool Transfer(const Operation* operations, std::size_t count);
+
+		RemoteProcess process;
+		std::vector<Operation> queue;
+		std::size_t transferred = 0;
+		std::size_t calls = 0;
+
+#ifdef _WIN32
+		std::vector<unsigned char> staging;
+#else
+		bool TransferFallback(const Operation& operation, std::size_t offset);
+
+		// /proc/<pid>/mem, opened by the first fallback
+		int memory = -1;
+
+		// cleared when the kernel lacks process_vm_readv/writev
+		bool vectored = true;
+#endif
+	};
+}
@@ -0,0 +1,130 @@
+/**
+ * @file remote_memory_linux.cpp
+ * @brief Linux remote memory access through process_vm_readv/writev and /proc/<pid>/mem.
+ */
+
+#ifdef __linux__
+
+#include "remote_memory.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace
+{
+	// UIO_MAXIOV, the most iovecs a single call accepts
+	constexpr std::size_t MaxVectors = 1024;
+}
+
+/**
+* @brief Closes /proc/<pid>/mem if a fallback opened it.
+*/
+injection::RemoteMemory::~RemoteMemory()
+{
+	if (memory >= 0)
+		close(memory);
+}
+
+/**
+* @brief Carries out a batch of operations in one direction.
+* @param operations The batch.
+* @param count The number of operations.
+* @return False if any operation failed.
+* @remarks process_vm_writev stops at the first page it cannot write (read-only code, or
+*  memory the target has not touched yet on some kernels) and reports how far it got, the
+*  rest of the batch is then written through /proc/<pid>/mem, which ignores page protection
+*  the way a debugger does.
+*/
+bool injection::RemoteMemory::Transfer(const Operation* operations, std::size_t count)
+{
+	const bool write = operations[0].write;
+	bool succeeded = true;
+
+	iovec local[MaxVectors];
+	iovec remote[MaxVectors];
+
+	for (std::size_t first = 0; first < count; first += MaxVectors) {
+		const std::size_t batch = (std::min)(count - first, MaxVectors);
+
+		// bytes of the batch the vectored call got through
+		std::size_t done = 0;
+		if (vectored) {
+			std::size_t total = 0;
+			for (std::size_t i = 0; i < batch; i++) {
+				const Operation& operation = operations[first + i];
+				local[i] = { operation.buffer, operation.size };
+				remote[i] = { reinterpret_cast<void*>(operation.address), operation.size };
+				total += operation.size;
+			}
+
+			const ssize_t moved = write ? process_vm_writev(process, local, batch, remote, batch, 0) : process_vm_readv(process, local, batch, remote, batch, 0);
+			++calls;
+			if (moved > 0)
+				done = static_cast<std::size_t>(moved);
+			else if (moved < 0 && errno == ENOSYS)
+				vectored = false;
+
+			if (done == total) {
+				transferred += total;
+				continue;
+			}
+		}
+
+		transferred += done;
+		for (std::size_t i = 0; i < batch; i++) {
+			const Operation& operation = operations[first + i];
+			if (done >= operation.size) {
+				done -= operation.size;
+				continue;
+			}
+
+			if (!TransferFallback(operation, done))
+				succeeded = false;
+			done = 0;
+		}
+	}
+	return succeeded;
+}
+
+/**
+* @brief Carries out the rest of one operation through /proc/<pid>/mem.
+* @param operation The operation.
+* @param offset The number of bytes already transferred.
+* @return False if the remaining bytes could not be transferred.
+*/
+bool injection::RemoteMemory::TransferFallback(const Operation& operation, std::size_t offset)
+{
+	if (memory < 0) {
+		char path[32];
+		std::snprintf(path, sizeof(path), "/proc/%d/mem", process);
+		memory = open(path, O_RDWR | O_CLOEXEC);
+		if (memory < 0)
+			return false;
+	}
+
+	char* buffer = static_cast<char*>(operation.buffer) + offset;
+	std::uint64_t address = operation.address + offset;
+	std::size_t remaining = operation.size - offset;
+
+	while (remaining > 0) {
+		const ssize_t moved = operation.write ? pwrite(memory, buffer, remaining, static_cast<off_t>(address)) : pread(memory, buffer, remaining, static_cast<off_t>(address));
+		++calls;
+		if (moved < 0 && errno == EINTR)
+			continue;
+		if (moved <= 0)
+			return false;
+
+		buffer += moved;
+		address += static_cast<std::uint64_t>(moved);
+		remaining -= static_cast<std::size_t>(moved);
+		transferred += static_cast<std::size_t>(moved);
+	}
+	return true;
+}
+
+#endif // __linux__
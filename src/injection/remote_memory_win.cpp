@@ -0,0 +1,80 @@
+/**
+ * @file remote_memory_win.cpp
+ * @brief Windows remote memory access through ReadProcessMemory/WriteProcessMemory.
+ */
+
+#ifdef _WIN32
+
+#include "remote_memory.h"
+
+#include <cstring>
+
+#include <windows.h>
+
+/**
+* @brief Nothing to release, the handle belongs to the caller.
+*/
+injection::RemoteMemory::~RemoteMemory()
+{
+}
+
+/**
+* @brief Carries out a batch of operations in one direction.
+* @param operations The batch.
+* @param count The number of operations.
+* @return False if any operation failed.
+* @remarks Each call crosses into the kernel and maps the target pages, so operations on
+*  adjacent remote ranges (a header followed by its entries and strings, say) are merged into
+*  one call through the staging buffer.
+*/
+bool injection::RemoteMemory::Transfer(const Operation* operations, std::size_t count)
+{
+	const bool write = operations[0].write;
+	bool succeeded = true;
+
+	for (std::size_t first = 0; first < count;) {
+		std::size_t last = first + 1;
+		std::size_t size = operations[first].size;
+		while (last < count && operations[last].address == operations[last - 1].address + operations[last - 1].size)
+			size += operations[last++].size;
+
+		void* remote = reinterpret_cast<void*>(operations[first].address);
+		SIZE_T moved = 0;
+		BOOL result = FALSE;
+
+		if (last - first == 1) {
+			result = write ? WriteProcessMemory(process, remote, operations[first].buffer, size, &moved) :
+				ReadProcessMemory(process, remote, operations[first].buffer, size, &moved);
+		}
+		else {
+			staging.resize(size);
+			if (write) {
+				std::size_t offset = 0;
+				for (std::size_t i = first; i < last; i++) {
+					std::memcpy(staging.data() + offset, operations[i].buffer, operations[i].size);
+					offset += operations[i].size;
+				}
+				result = WriteProcessMemory(process, remote, staging.data(), size, &moved);
+			}
+			else {
+				result = ReadProcessMemory(process, remote, staging.data(), size, &moved);
+				if (result) {
+					std::size_t offset = 0;
+					for (std::size_t i = first; i < last; i++) {
+						std::memcpy(operations[i].buffer, staging.data() + offset, operations[i].size);
+						offset += operations[i].size;
+					}
+				}
+			}
+		}
+
+		++calls;
+		transferred += moved;
+		if (!result || moved != size)
+			succeeded = false;
+		first = last;
+	}
+	return succeeded;
+}
+
+#endif // _WIN32
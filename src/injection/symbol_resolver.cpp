@@ -0,0 +1,68 @@
+/**
+ * @file symbol_resolver.cpp
+ * @brief Implements the cache of the remote symbol lookup.
+ */
+
+#include "symbol_resolver.h"
+
+/**
+* @brief Gets the resolver shared by all backends.
+*/
+injection::SymbolResolver& injection::SymbolResolver::Shared()
+{
+	static SymbolResolver resolver;
+	return resolver;
+}
+
+/**
+* @brief Gets the loader functions of a target, from the cache if possible.
+* @param target The identity of the process, the cache key.
+* @param process Gives access to its memory, only used on a miss.
+* @param out Receives the addresses.
+* @return Null on success, otherwise the error.
+* @remarks The lookup itself runs without the lock. Jobs for one target are serialized by
+*  the backends, so two lookups for the same target at once only happen through separate
+*  callers and merely duplicate the work.
+*/
+const char* injection::SymbolResolver::Resolve(const process::ProcessKey& target, RemoteProcess process, LoaderSymbols& out)
+{
+	{
+		std::lock_guard lock(mutex);
+		const auto found = resolved.find(target);
+		if (found != resolved.end()) {
+			out = found->second;
+			hits.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+	}
+
+	misses.fetch_add(1, std::memory_order_relaxed);
+
+	LoaderSymbols symbols;
+	if (const char* error = Lookup(process, symbols))
+		return error;
+
+	std::lock_guard lock(mutex);
+	resolved[target] = symbols;
+	out = symbols;
+	return nullptr;
+}
+
+/**
+* @brief Drops what is known about a target.
+* @param target The process.
+*/
+void injection::SymbolResolver::Forget(const process::ProcessKey& target)
+{
+	std::lock_guard lock(mutex);
+	resolved.erase(target);
+}
+
+/**
+* @brief Drops what is known about all targets.
+*/
+void injection::SymbolResolver::Clear()
+{
+	std::lock_guard lock(mutex);
+	resolved.clear();
+}
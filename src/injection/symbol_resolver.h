@@ -0,0 +1,89 @@
+/**
+
+@file symbol_resolver.h
+@brief Addresses of the loader functions inside a target, cached per target.
+*/
+
+#pragma once
+#include "remote_memory.h"
+#include "../process/process_snapshot.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+namespace injection
+{
+	/**
+	* @brief The functions injection calls in a target, as addresses in the target.
+	* @remarks Injecting needs load and lastError; Linux also maps the remote region from inside
+	*  the target. The resident agent needs unload plus a way to wait and signal (Windows) or to
+	*  start its thread (Linux); those are 0 where the target lacks them, which only rules out
+	*  the agent. Linux loads on a thread of its own when the target has pthread_create,
+	*  pthread_self and pthread_detach, otherwise on the hijacked thread.
+	*/
+	struct LoaderSymbols
+	{
+		// image the functions were found in (kernel32.dll or libc) and whether the target is 64-bit
+		std::uint64_t moduleBase = 0;
+		bool wide = false;
+
+		std::uint64_t load = 0;      // LoadLibraryA / dlopen
+		std::uint64_t lastError = 0; // GetLastError / dlerror
+		std::uint64_t map = 0;       // mmap
+		std::uint64_t unmap = 0;     // munmap
+		std::uint64_t protect = 0;   // mprotect
+
+		std::uint64_t unload = 0;        // FreeLibrary / dlclose
+		std::uint64_t wait = 0;          // WaitForSingleObject
+		std::uint64_t signal = 0;        // SetEvent
+		std::uint64_t startThread = 0;   // pthread_create
+		std::uint64_t currentThread = 0; // pthread_self
+		std::uint64_t detachThread = 0;  // pthread_detach
+
+		// Linux: where ld.so is mapped, a thread stopped in there must not be made to call dlopen
+		std::uint64_t loaderBegin = 0;
+		std::uint64_t loaderEnd = 0;
+	};
+
+	/**
+	* @brief Looks up the loader functions of a target in the target's own memory.
+	* @remarks The export table of the target's kernel32.dll (of the target's bitness, so WOW64
+	*  targets get the 32-bit one) or the dynamic symbol table of its libc is read remotely,
+	*  nothing is assumed about our own copy of either. That happens on the first job for a
+	*  target; the image base, bitness and addresses are kept until the target is forgotten, as
+	*  neither library is ever unloaded, so later jobs do no lookups at all.
+	*/
+	class SymbolResolver
+	{
+	public:
+		static SymbolResolver& Shared();
+
+		/**
+		* @brief Gets the loader functions of a target, from the cache if possible.
+		* @param target The identity of the process, the cache key.
+		* @param process Gives access to its memory, only used on a miss.
+		* @param out Receives the addresses.
+		* @return Null on success, otherwise the error.
+		*/
+		const char* Resolve(const process::ProcessKey& target, RemoteProcess process, LoaderSymbols& out);
+
+		// drops what is known about a target, e.g. when it exits
+		void Forget(const process::ProcessKey& target);
+		void Clear();
+
+		std::uint64_t Hits() const noexcept { return hits.load(std::memory_order_relaxed); }
+		std::uint64_t Misses() const noexcept { return misses.load(std::memory_order_relaxed); }
+
+	private:
+		// platform part, reads the target's tables
+		static const char* Lookup(RemoteProcess process, LoaderSymbols& out);
+
+		std::mutex mutex;
+		std::unordered_map<process::ProcessKey, LoaderSymbols, process::ProcessKeyHash> resolved;
+
+		std::atomic<std::uint64_t> hits{ 0 };
+		std::atomic<std::uint64_t> misses{ 0 };
+	};
+}
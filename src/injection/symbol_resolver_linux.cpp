@@ -0,0 +1,435 @@
+/**
+ * @file symbol_resolver_linux.cpp
+ * @brief Linux symbol lookup through the dynamic symbol table of the target's libc.
+ */
+
+#ifdef __linux__
+
+#include "symbol_resolver.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h> // ElfW
+#include <unistd.h>
+
+namespace
+{
+	// how long a process that has just exec'd gets to map its C library
+	constexpr std::chrono::milliseconds LibraryWait(250);
+
+	/**
+	* @brief Closes a file descriptor when leaving the scope.
+	*/
+	struct FileDescriptor
+	{
+		int fd = -1;
+		~FileDescriptor() { if (fd >= 0) close(fd); }
+	};
+
+	/**
+	* @brief A file mapped at offset 0, i.e. the load address of a shared object.
+	*/
+	struct Image
+	{
+		std::uint64_t base = 0;
+		std::uint64_t end = 0; // end of the last consecutive mapping of the file
+		std::string name;      // file name without directory
+	};
+
+	/**
+	* @brief Lists the images mapped into a process.
+	* @param pid The process.
+	* @param out Receives one entry per file mapping at offset 0, extended over the mappings of
+	*  the same file that follow it.
+	* @return False if /proc/<pid>/maps could not be read.
+	*/
+	bool ReadImages(int pid, std::vector<Image>& out)
+	{
+		out.clear();
+
+		char path[64];
+		std::snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+
+		FileDescriptor file{ open(path, O_RDONLY | O_CLOEXEC) };
+		if (file.fd < 0)
+			return false;
+
+		std::string content;
+		char buffer[16 * 1024];
+		for (;;) {
+			const ssize_t length = read(file.fd, buffer, sizeof(buffer));
+			if (length < 0)
+				return false;
+			if (length == 0)
+				break;
+			content.append(buffer, static_cast<std::size_t>(length));
+		}
+
+		std::size_t lineStart = 0;
+		while (lineStart < content.size()) {
+			std::size_t lineEnd = content.find('\n', lineStart);
+			if (lineEnd == std::string::npos)
+				lineEnd = content.size();
+
+			// start-end perms offset major:minor inode path
+			unsigned long long start = 0, end = 0, offset = 0, inode = 0;
+			int pathStart = 0;
+			if (std::sscanf(content.c_str() + lineStart, "%llx-%llx %*s %llx %*x:%*x %llu %n", &start, &end, &offset, &inode, &pathStart) == 4 &&
+				inode != 0 && lineStart + pathStart < lineEnd) {
+				std::string_view file(content.data() + lineStart + pathStart, lineEnd - lineStart - pathStart);
+				file = file.substr(file.rfind('/') + 1);
+				if (offset == 0)
+					out.push_back({ start, end, std::string(file) });
+				else if (!out.empty() && out.back().name == file)
+					out.back().end = end;
+			}
+			lineStart = lineEnd + 1;
+		}
+		return true;
+	}
+
+	/**
+	* @brief Finds the first image whose file name is one of the stems plus a version suffix.
+	* @remarks "libc" matches libc.so.6 and libc-2.31.so but not libcrypto.so.3.
+	*/
+	const Image* FindImage(const std::vector<Image>& images, std::initializer_list<std::string_view> stems)
+	{
+		for (const Image& image : images) {
+			for (std::string_view stem : stems) {
+				if (image.name.size() > stem.size() && image.name.compare(0, stem.size(), stem) == 0 &&
+					(image.name[stem.size()] == '.' || image.name[stem.size()] == '-')) {
+					return &image;
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	// hash functions of DT_GNU_HASH and DT_HASH
+	std::uint32_t GnuHash(const char* name) noexcept
+	{
+		std::uint32_t hash = 5381;
+		for (; *name; ++name)
+			hash = hash * 33 + static_cast<unsigned char>(*name);
+		return hash;
+	}
+
+	std::uint32_t ElfHash(const char* name) noexcept
+	{
+		std::uint32_t hash = 0;
+		for (; *name; ++name) {
+			hash = (hash << 4) + static_cast<unsigned char>(*name);
+			const std::uint32_t high = hash & 0xF0000000;
+			if (high)
+				hash ^= high >> 24;
+			hash &= ~high;
+		}
+		return hash;
+	}
+
+	/**
+	* @brief The dynamic symbol table of an image in the target, read through its hash table.
+	* @remarks Only the program headers, the dynamic section and the hash chains that are walked
+	*  are read, a handful of small reads per symbol. The dynamic section may hold addresses
+	*  relocated by the target's ld.so or plain offsets, both are accepted.
+	*/
+	class DynamicSymbols
+	{
+	public:
+		explicit DynamicSymbols(injection::RemoteMemory& memory) noexcept : memory(memory) { }
+
+		// reads the tables of the image mapped at base, null on success
+		const char* Open(std::uint64_t base);
+
+		// the address of a defined function, 0 if there is none
+		std::uint64_t Find(const char* name);
+
+	private:
+		std::uint64_t Address(std::uint64_t value) const noexcept { return value < bias ? bias + value : value; }
+
+		// checks one symbol of a hash chain, out is set on a match
+		bool Matches(std::uint32_t index, const char* name, std::uint64_t& out, bool& hidden);
+
+		std::uint64_t FindGnu(const char* name);
+		std::uint64_t FindSysV(const char* name);
+
+		injection::RemoteMemory& memory;
+
+		std::uint64_t bias = 0;
+		std::uint64_t symbols = 0;
+		std::uint64_t strings = 0;
+		std::uint64_t stringsSize = 0;
+		std::uint64_t versions = 0;
+		std::uint64_t gnuHash = 0;
+		std::uint64_t sysvHash = 0;
+
+		// DT_GNU_HASH header: bucket count, index of the first hashed symbol, bloom filter words
+		std::uint32_t gnuHeader[4] = { };
+	};
+
+	const char* DynamicSymbols::Open(std::uint64_t base)
+	{
+		ElfW(Ehdr) header;
+		if (!memory.Read(base, &header, sizeof(header)) || std::memcmp(header.e_ident, ELFMAG, SELFMAG) != 0)
+			return "Could not read the C library of the process";
+
+		if (header.e_ident[EI_CLASS] != (sizeof(void*) == 8 ? ELFCLASS64 : ELFCLASS32))
+			return "The process has a different word size than the injector";
+
+		if (header.e_phentsize != sizeof(ElfW(Phdr)) || header.e_phnum == 0 || header.e_phnum > 128)
+			return "The C library of the process has unexpected program headers";
+
+		std::vector<ElfW(Phdr)> programs(header.e_phnum);
+		if (!memory.Read(base + header.e_phoff, programs.data(), programs.size() * sizeof(ElfW(Phdr))))
+			return "Could not read the C library of the process";
+
+		// the mapping at offset 0 starts at the page of the first loadable segment
+		static const std::uint64_t pageSize = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+
+		const ElfW(Phdr)* dynamic = nullptr;
+		bool loadSeen = false;
+		for (const ElfW(Phdr)& program : programs) {
+			if (program.p_type == PT_LOAD && !loadSeen) {
+				bias = base - (program.p_vaddr & ~(pageSize - 1));
+				loadSeen = true;
+			}
+			if (program.p_type == PT_DYNAMIC)
+				dynamic = &program;
+		}
+		if (!loadSeen || !dynamic || dynamic->p_memsz > 64 * 1024)
+			return "The C library of the process has no dynamic section";
+
+		std::vector<ElfW(Dyn)> entries(dynamic->p_memsz / sizeof(ElfW(Dyn)));
+		if (!memory.Read(bias + dynamic->p_vaddr, entries.data(), entries.size() * sizeof(ElfW(Dyn))))
+			return "Could not read the dynamic section of the C library";
+
+		for (const ElfW(Dyn)& entry : entries) {
+			if (entry.d_tag == DT_NULL)
+				break;
+
+			switch (entry.d_tag) {
+			case DT_SYMTAB: symbols = Address(entry.d_un.d_ptr); break;
+			case DT_STRTAB: strings = Address(entry.d_un.d_ptr); break;
+			case DT_STRSZ: stringsSize = entry.d_un.d_val; break;
+			case DT_VERSYM: versions = Address(entry.d_un.d_ptr); break;
+			case DT_GNU_HASH: gnuHash = Address(entry.d_un.d_ptr); break;
+			case DT_HASH: sysvHash = Address(entry.d_un.d_ptr); break;
+			}
+		}
+
+		if (!symbols || !strings || (!gnuHash && !sysvHash))
+			return "The C library of the process has no symbol table";
+
+		if (gnuHash && (!memory.Read(gnuHash, gnuHeader, sizeof(gnuHeader)) || gnuHeader[0] == 0))
+			gnuHash = 0;
+		if (!gnuHash && !sysvHash)
+			return "Could not read the symbol table of the C library";
+		return nullptr;
+	}
+
+	std::uint64_t DynamicSymbols::Find(const char* name)
+	{
+		return gnuHash ? FindGnu(name) : FindSysV(name);
+	}
+
+	/**
+	* @brief Checks one symbol of a hash chain.
+	* @param hidden Set if the match is an old version of the symbol.
+	* @remarks glibc exports some functions twice, e.g. dlopen@GLIBC_2.2.5 for old binaries
+	*  and dlopen@@GLIBC_2.34; the default version is the one without the hidden bit.
+	*/
+	bool DynamicSymbols::Matches(std::uint32_t index, const char* name, std::uint64_t& out, bool& hidden)
+	{
+		ElfW(Sym) symbol;
+		if (!memory.Read(symbols + std::uint64_t(index) * sizeof(symbol), &symbol, sizeof(symbol)))
+			return false;
+
+		if (symbol.st_shndx == SHN_UNDEF || ELF64_ST_TYPE(symbol.st_info) != STT_FUNC ||
+			(stringsSize && symbol.st_name >= stringsSize)) {
+			return false;
+		}
+
+		const std::size_t length = std::strlen(name) + 1;
+		char text[64];
+		if (length > sizeof(text) || !memory.Read(strings + symbol.st_name, text, length) || std::memcmp(text, name, length) != 0)
+			return false;
+
+		std::uint16_t version = 0;
+		hidden = versions && memory.Read(versions + std::uint64_t(index) * sizeof(version), &version, sizeof(version)) && (version & 0x8000);
+		out = bias + symbol.st_value;
+		return true;
+	}
+
+	std::uint64_t DynamicSymbols::FindGnu(const char* name)
+	{
+		const std::uint32_t bucketCount = gnuHeader[0];
+		const std::uint32_t firstHashed = gnuHeader[1];
+		const std::uint64_t buckets = gnuHash + sizeof(gnuHeader) + std::uint64_t(gnuHeader[2]) * sizeof(ElfW(Addr));
+		const std::uint64_t chains = buckets + std::uint64_t(bucketCount) * sizeof(std::uint32_t);
+
+		const std::uint32_t hash = GnuHash(name);
+
+		std::uint32_t index = 0;
+		if (!memory.Read(buckets + (hash % bucketCount) * sizeof(std::uint32_t), &index, sizeof(index)) || index < firstHashed)
+			return 0;
+
+		// the chain holds the hashes of consecutive symbols, the low bit marks the last one;
+		// read a few at a time, one by one near the end of the table where that overshoots
+		std::uint64_t fallback = 0;
+		std::size_t batch = 16;
+		for (;;) {
+			std::uint32_t chain[16];
+			if (!memory.Read(chains + std::uint64_t(index - firstHashed) * sizeof(std::uint32_t), chain, batch * sizeof(std::uint32_t))) {
+				if (batch == 1)
+					return fallback;
+				batch = 1;
+				continue;
+			}
+
+			for (std::size_t i = 0; i < batch; i++) {
+				const std::uint32_t value = chain[i];
+				std::uint64_t address = 0;
+				bool hidden = false;
+				if ((value | 1) == (hash | 1) && Matches(index, name, address, hidden)) {
+					if (!hidden)
+						return address;
+					fallback = address;
+				}
+				if (value & 1)
+					return fallback;
+				++index;
+			}
+		}
+	}
+
+	std::uint64_t DynamicSymbols::FindSysV(const char* name)
+	{
+		std::uint32_t header[2]; // bucket count, chain count
+		if (!memory.Read(sysvHash, header, sizeof(header)) || header[0] == 0)
+			return 0;
+
+		const std::uint64_t buckets = sysvHash + sizeof(header);
+		const std::uint64_t chains = buckets + std::uint64_t(header[0]) * sizeof(std::uint32_t);
+
+		std::uint32_t index = 0;
+		if (!memory.Read(buckets + (ElfHash(name) % header[0]) * sizeof(std::uint32_t), &index, sizeof(index)))
+			return 0;
+
+		std::uint64_t fallback = 0;
+		for (std::uint32_t steps = 0; index != STN_UNDEF && index < header[1] && steps < header[1]; steps++) {
+			std::uint64_t address = 0;
+			bool hidden = false;
+			if (Matches(index, name, address, hidden)) {
+				if (!hidden)
+					return address;
+				fallback = address;
+			}
+			if (!memory.Read(chains + std::uint64_t(index) * sizeof(std::uint32_t), &index, sizeof(index)))
+				break;
+		}
+		return fallback;
+	}
+}
+
+/**
+* @brief Reads the addresses of dlopen and friends out of the target's libc.
+* @param process The pid.
+* @param out Receives the addresses.
+* @return Null on success, otherwise the error.
+* @remarks The target's own tables are used, so a target running a different libc than the
+*  injector (a container, or a binary shipping its own) resolves correctly. Before glibc 2.34
+*  dlopen and friends live in libdl and pthread_create in libpthread, which are searched when
+*  libc does not have them.
+*
+*  A process caught during or right after exec may not have its libraries mapped yet, so
+*  without libc the map is read again for a short while; static binaries fail only after
+*  that. The range of ld.so is reported so callers can tell whether a thread is still inside
+*  it; with musl the loader is libc itself and no range is reported.
+*/
+const char* injection::SymbolResolver::Lookup(RemoteProcess process, LoaderSymbols& out)
+{
+	std::vector<Image> images;
+	const Image* libc = nullptr;
+	const Image* loader = nullptr;
+	for (const auto giveUp = std::chrono::steady_clock::now() + LibraryWait;;) {
+		if (!ReadImages(process, images))
+			return "Could not read the memory map of the process";
+
+		libc = FindImage(images, { "libc", "ld-musl" });
+		loader = FindImage(images, { "ld-linux", "ld-2" }); // ld-linux-x86-64.so.2, ld-2.31.so
+		if (libc || std::chrono::steady_clock::now() >= giveUp)
+			break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	if (!libc)
+		return "The process is not linked against a C library";
+
+	if (loader) {
+		out.loaderBegin = loader->base;
+		out.loaderEnd = loader->end;
+	}
+
+	RemoteMemory memory(process);
+
+	DynamicSymbols table(memory);
+	if (const char* error = table.Open(libc->base))
+		return error;
+
+	out.moduleBase = libc->base;
+	out.wide = sizeof(void*) == 8;
+	out.map = table.Find("mmap");
+	out.unmap = table.Find("munmap");
+	out.protect = table.Find("mprotect");
+	if (!out.map || !out.unmap || !out.protect)
+		return "Could not find mmap in the C library of the process";
+
+	out.load = table.Find("dlopen");
+	out.lastError = table.Find("dlerror");
+	out.unload = table.Find("dlclose");
+	out.startThread = table.Find("pthread_create");
+	out.currentThread = table.Find("pthread_self");
+	out.detachThread = table.Find("pthread_detach");
+
+	if (!out.startThread || !out.currentThread || !out.detachThread) {
+		// optional, only the agent and the loader thread need them
+		DynamicSymbols pthread(memory);
+		const Image* libpthread = FindImage(images, { "libpthread" });
+		if (libpthread && !pthread.Open(libpthread->base)) {
+			if (!out.startThread)
+				out.startThread = pthread.Find("pthread_create");
+			if (!out.currentThread)
+				out.currentThread = pthread.Find("pthread_self");
+			if (!out.detachThread)
+				out.detachThread = pthread.Find("pthread_detach");
+		}
+	}
+
+	if (out.load && out.lastError)
+		return nullptr;
+
+	const Image* libdl = FindImage(images, { "libdl" });
+	if (!libdl)
+		return "The process has not loaded libdl, which its C library needs for dlopen";
+
+	DynamicSymbols dl(memory);
+	if (const char* error = dl.Open(libdl->base))
+		return error;
+
+	out.load = dl.Find("dlopen");
+	out.lastError = dl.Find("dlerror");
+	out.unload = dl.Find("dlclose");
+	if (!out.load || !out.lastError)
+		return "Could not find dlopen in the process";
+	return nullptr;
+}
+
+#endif // __linux__
@@ -0,0 +1,261 @@
+/**
+ * @file symbol_resolver_win.cpp
+ * @brief Windows symbol lookup through the export table of the target's kernel32.dll.
+ */
+
+#ifdef _WIN32
+
+#include "symbol_resolver.h"
+
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <windows.h>
+#include <psapi.h>
+
+namespace
+{
+	/**
+	* @brief Compares two ASCII names, ignoring case like the loader does.
+	*/
+	bool SameModuleName(std::string_view a, std::string_view b) noexcept
+	{
+		if (a.size() != b.size())
+			return false;
+
+		for (std::size_t i = 0; i < a.size(); i++) {
+			const char x = a[i] >= 'A' && a[i] <= 'Z' ? a[i] - 'A' + 'a' : a[i];
+			const char y = b[i] >= 'A' && b[i] <= 'Z' ? b[i] - 'A' + 'a' : b[i];
+			if (x != y)
+				return false;
+		}
+		return true;
+	}
+
+	/**
+	* @brief Finds a loaded module of the target by file name.
+	* @param wide Whether to look at the 64-bit or the 32-bit modules of the process.
+	* @return The image base, 0 if it is not loaded.
+	*/
+	std::uint64_t FindModule(HANDLE process, bool wide, std::string_view name)
+	{
+		std::vector<HMODULE> modules(256);
+		DWORD needed = 0;
+		for (;;) {
+			const DWORD size = static_cast<DWORD>(modules.size() * sizeof(HMODULE));
+			if (!EnumProcessModulesEx(process, modules.data(), size, &needed, wide ? LIST_MODULES_64BIT : LIST_MODULES_32BIT))
+				return 0;
+			if (needed <= size)
+				break;
+			modules.resize(needed / sizeof(HMODULE));
+		}
+
+		for (std::size_t i = 0; i < needed / sizeof(HMODULE); i++) {
+			char file[MAX_PATH];
+			const DWORD length = GetModuleBaseNameA(process, modules[i], file, MAX_PATH);
+			if (length != 0 && SameModuleName(std::string_view(file, length), name))
+				return reinterpret_cast<std::uint64_t>(modules[i]);
+		}
+		return 0;
+	}
+
+	/**
+	* @brief The export table of a module in the target.
+	* @remarks The export data (directory, address tables and names) is read with one call and
+	*  searched locally. The headers are read as PE32 or PE32+ according to the target's
+	*  bitness, which may differ from ours.
+	*/
+	class ExportTable
+	{
+	public:
+		explicit ExportTable(injection::RemoteMemory& memory) noexcept : memory(memory) { }
+
+		// reads the export data of the module at base, false if it has none
+		bool Open(std::uint64_t base, bool wide);
+
+		// the address of a named export; 0 with forward set if it is forwarded to another module
+		std::uint64_t Find(std::string_view name, std::string& forward) const;
+
+		injection::RemoteMemory& Memory() const noexcept { return memory; }
+
+	private:
+		template <typename Headers, WORD Magic>
+		bool ReadDirectory(std::uint64_t headers, IMAGE_DATA_DIRECTORY& out);
+
+		template <typename T>
+		const T* At(DWORD rva, std::size_t count) const noexcept
+		{
+			if (rva < start || rva - start > data.size() || count > (data.size() - (rva - start)) / sizeof(T))
+				return nullptr;
+			return reinterpret_cast<const T*>(data.data() + (rva - start));
+		}
+
+		// a NUL terminated string inside the export data, empty if it is not
+		std::string_view String(DWORD rva) const noexcept;
+
+		injection::RemoteMemory& memory;
+
+		std::uint64_t base = 0;
+		DWORD start = 0;
+		std::vector<unsigned char> data;
+		IMAGE_EXPORT_DIRECTORY directory = { };
+	};
+
+	template <typename Headers, WORD Magic>
+	bool ExportTable::ReadDirectory(std::uint64_t headers, IMAGE_DATA_DIRECTORY& out)
+	{
+		Headers nt;
+		if (!memory.Read(headers, &nt, sizeof(nt)) || nt.Signature != IMAGE_NT_SIGNATURE || nt.OptionalHeader.Magic != Magic ||
+			nt.OptionalHeader.NumberOfRvaAndSizes <= IMAGE_DIRECTORY_ENTRY_EXPORT) {
+			return false;
+		}
+
+		out = nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT];
+		return true;
+	}
+
+	bool ExportTable::Open(std::uint64_t module, bool wide)
+	{
+		IMAGE_DOS_HEADER dos;
+		if (!memory.Read(module, &dos, sizeof(dos)) || dos.e_magic != IMAGE_DOS_SIGNATURE || dos.e_lfanew <= 0)
+			return false;
+
+		IMAGE_DATA_DIRECTORY exports = { };
+		const bool read = wide ?
+			ReadDirectory<IMAGE_NT_HEADERS64, IMAGE_NT_OPTIONAL_HDR64_MAGIC>(module + dos.e_lfanew, exports) :
+			ReadDirectory<IMAGE_NT_HEADERS32, IMAGE_NT_OPTIONAL_HDR32_MAGIC>(module + dos.e_lfanew, exports);
+		if (!read || exports.Size < sizeof(IMAGE_EXPORT_DIRECTORY) || exports.Size > 16 * 1024 * 1024)
+			return false;
+
+		base = module;
+		start = exports.VirtualAddress;
+		data.resize(exports.Size);
+		if (!memory.Read(module + start, data.data(), data.size()))
+			return false;
+
+		std::memcpy(&directory, data.data(), sizeof(directory));
+		return true;
+	}
+
+	std::string_view ExportTable::String(DWORD rva) const noexcept
+	{
+		const char* text = At<char>(rva, 1);
+		if (!text)
+			return { };
+
+		const std::size_t left = data.size() - (rva - start);
+		const std::size_t length = strnlen(text, left);
+		return length < left ? std::string_view(text, length) : std::string_view();
+	}
+
+	std::uint64_t ExportTable::Find(std::string_view name, std::string& forward) const
+	{
+		forward.clear();
+
+		// the linker places the tables inside the export data, anything else is not supported
+		const DWORD* names = At<DWORD>(directory.AddressOfNames, directory.NumberOfNames);
+		const WORD* ordinals = At<WORD>(directory.AddressOfNameOrdinals, directory.NumberOfNames);
+		const DWORD* functions = At<DWORD>(directory.AddressOfFunctions, directory.NumberOfFunctions);
+		if (!names || !ordinals || !functions)
+			return 0;
+
+		// the name table is sorted by the bytes of the names
+		std::size_t low = 0, high = directory.NumberOfNames;
+		while (low < high) {
+			const std::size_t middle = low + (high - low) / 2;
+			const int order = String(names[middle]).compare(name);
+			if (order < 0) {
+				low = middle + 1;
+				continue;
+			}
+			if (order > 0) {
+				high = middle;
+				continue;
+			}
+
+			const WORD ordinal = ordinals[middle];
+			if (ordinal >= directory.NumberOfFunctions)
+				return 0;
+
+			// an address inside the export data is a forwarder string like "KERNELBASE.LoadLibraryA"
+			const DWORD rva = functions[ordinal];
+			if (rva >= start && rva - start < data.size()) {
+				forward = String(rva);
+				return 0;
+			}
+			return rva ? base + rva : 0;
+		}
+		return 0;
+	}
+
+	/**
+	* @brief Finds an export, following forwarders into other modules of the target.
+	* @remarks Forwarders by ordinal and into API sets are not followed, kernel32 exports the
+	*  functions injection needs directly.
+	*/
+	std::uint64_t FindExport(const ExportTable& table, HANDLE process, bool wide, std::string_view name, int depth = 0)
+	{
+		std::string forward;
+		const std::uint64_t address = table.Find(name, forward);
+		if (address || forward.empty() || depth >= 2)
+			return address;
+
+		const std::size_t dot = forward.find('.');
+		if (dot == std::string::npos || dot + 1 >= forward.size() || forward[dot + 1] == '#')
+			return 0;
+
+		const std::uint64_t module = FindModule(process, wide, forward.substr(0, dot) + ".dll");
+		ExportTable next(table.Memory());
+		if (!module || !next.Open(module, wide))
+			return 0;
+
+		return FindExport(next, process, wide, std::string_view(forward).substr(dot + 1), depth + 1);
+	}
+}
+
+/**
+* @brief Reads the addresses of LoadLibraryA and friends out of the target's kernel32.dll.
+* @param process A handle with PROCESS_QUERY_INFORMATION and PROCESS_VM_READ access.
+* @param out Receives the addresses.
+* @return Null on success, otherwise the error.
+* @remarks A WOW64 target has its own 32-bit kernel32.dll, whose functions are nowhere near
+*  the addresses of ours, so the copy matching the target's bitness is looked up.
+*/
+const char* injection::SymbolResolver::Lookup(RemoteProcess process, LoaderSymbols& out)
+{
+	BOOL wow64 = FALSE;
+	if (!IsWow64Process(process, &wow64))
+		return "Could not query the architecture of the process";
+
+#ifdef _WIN64
+	out.wide = !wow64;
+#else
+	BOOL selfWow64 = FALSE;
+	if (IsWow64Process(GetCurrentProcess(), &selfWow64) && selfWow64 && !wow64)
+		return "A 32-bit build cannot inject into 64-bit processes";
+	out.wide = false;
+#endif
+
+	out.moduleBase = FindModule(process, out.wide, "kernel32.dll");
+	if (!out.moduleBase)
+		return "kernel32.dll is not loaded in the process yet";
+
+	RemoteMemory memory(process);
+	ExportTable table(memory);
+	if (!table.Open(out.moduleBase, out.wide))
+		return "Could not read the export table of kernel32.dll";
+
+	out.load = FindExport(table, process, out.wide, "LoadLibraryA");
+	out.lastError = FindExport(table, process, out.wide, "GetLastError");
+	if (!out.load || !out.lastError)
+		return "Could not find LoadLibraryA in kernel32.dll of the process";
+
+	out.unload = FindExport(table, process, out.wide, "FreeLibrary");
+	out.wait = FindExport(table, process, out.wide, "WaitForSingleObject");
+	out.signal = FindExport(table, process, out.wide, "SetEvent");
+	return nullptr;
+}
+
+#endif // _WIN32
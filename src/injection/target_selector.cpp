@@ -0,0 +1,93 @@
+/**
+ * @file target_selector.cpp
+ * @brief Implements the target selection.
+ */
+
+#include "target_selector.h"
+#include "../process/sort_keys.h"
+
+#include <algorithm>
+
+/**
+* @brief Matches a name against a wildcard pattern.
+* @param name The folded name.
+* @param pattern The folded pattern.
+* @return True if the pattern covers the whole name.
+* @remarks Greedy matching with backtracking to the last '*', linear for typical patterns.
+*/
+bool injection::MatchesPattern(std::string_view name, std::string_view pattern) noexcept
+{
+	std::size_t n = 0, p = 0;
+	std::size_t starPattern = std::string_view::npos, starName = 0;
+
+	while (n < name.size()) {
+		if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+			++n;
+			++p;
+		}
+		else if (p < pattern.size() && pattern[p] == '*') {
+			starPattern = p++;
+			starName = n;
+		}
+		else if (starPattern != std::string_view::npos) {
+			// let the last '*' swallow one more character
+			p = starPattern + 1;
+			n = ++starName;
+		}
+		else {
+			return false;
+		}
+	}
+
+	while (p < pattern.size() && pattern[p] == '*')
+		++p;
+	return p == pattern.size();
+}
+
+/**
+* @brief Finds the processes described by a selector.
+* @param snapshot The snapshot to search, its lookup table must have been built.
+* @param selector The selection.
+* @param out Receives snapshot indices of accessible processes, processes we cannot open are skipped.
+* @remarks Children are only selected while their parent is in the snapshot, and only the ones
+*  started after it, so a reused parent pid never selects another process's children.
+*/
+void injection::SelectTargets(const process::ProcessSnapshot& snapshot, const TargetSelector& selector, std::vector<std::uint32_t>& out)
+{
+	out.clear();
+
+	switch (selector.mode) {
+	case TargetMode::Explicit:
+		for (const process::ProcessKey& key : selector.targets) {
+			const process::ProcessInfo* info = snapshot.Find(key);
+			if (info && info->accessible)
+				out.push_back(static_cast<std::uint32_t>(info - snapshot.processes.data()));
+		}
+		std::sort(out.begin(), out.end());
+		out.erase(std::unique(out.begin(), out.end()), out.end());
+		break;
+
+	case TargetMode::NamePattern: {
+		std::string folded(selector.pattern.size(), '\0');
+		process::FoldAsciiCase(selector.pattern, folded.data());
+
+		for (std::uint32_t i = 0; i < snapshot.processes.size(); i++) {
+			const process::ProcessInfo& info = snapshot.processes[i];
+			if (info.accessible && MatchesPattern(info.sortKey, folded))
+				out.push_back(i);
+		}
+	} break;
+
+	case TargetMode::Children: {
+		// orphans keep the pid of their exited parent, which a new process may have taken since
+		if (!snapshot.Find(selector.parent))
+			break;
+
+		for (std::uint32_t i = 0; i < snapshot.processes.size(); i++) {
+			const process::ProcessInfo& info = snapshot.processes[i];
+			if (info.accessible && info.parentPid == selector.parent.pid && info.startTime >= selector.parent.startTime && info.Key() != selector.parent)
+				out.push_back(i);
+		}
+	} break;
+	}
+}
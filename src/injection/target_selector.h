@@ -0,0 +1,57 @@
+/**
+
+@file target_selector.h
+@brief Picks the processes a fan-out injection goes to.
+*/
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../process/process_snapshot.h"
+
+namespace injection
+{
+	/**
+	* @brief How the targets of an injection are chosen.
+	*/
+	enum class TargetMode : std::uint8_t
+	{
+		Explicit,    // the processes listed in TargetSelector::targets
+		NamePattern, // every process whose name matches TargetSelector::pattern
+		Children,    // every direct child of TargetSelector::parent
+	};
+
+	/**
+	* @brief Describes a set of target processes.
+	*/
+	struct TargetSelector
+	{
+		TargetMode mode = TargetMode::Explicit;
+
+		// used by Explicit
+		std::vector<process::ProcessKey> targets;
+
+		// used by NamePattern, case-insensitive, '*' matches any run of characters and '?' a single one
+		std::string pattern;
+
+		// used by Children, the parent instance: children of a later process with its pid are not its children
+		process::ProcessKey parent;
+	};
+
+	/**
+	* @brief Matches a folded name against a folded wildcard pattern.
+	* @return True if the whole name matches, a pattern without wildcards must be equal to the name.
+	*/
+	bool MatchesPattern(std::string_view name, std::string_view pattern) noexcept;
+
+	/**
+	* @brief Resolves a selector against a snapshot.
+	* @param snapshot The processes to choose from.
+	* @param selector The selection.
+	* @param out Receives the indices into snapshot.processes of all accessible matches, in pid order.
+	*/
+	void SelectTargets(const process::ProcessSnapshot& snapshot, const TargetSelector& selector, std::vector<std::uint32_t>& out);
+}
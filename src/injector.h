@@ -6,23 +6,34 @@
 #ifndef INJECTOR_H
 #define INJECTOR_H
 
+#include <memory>
 #include <vector>
 #include <string>
 #include <shlwapi.h>
 
+#include "injection/injection_group.h"
+
 /**
 
-@brief Injects a DLL into a target process.
-This function injects the specified DLL into a target process by creating a remote thread
-and calling LoadLibraryA in the target process.
-@throw std::runtime_error if the injection fails.
+@brief Injects the selected DLLs into every target process.
+This function resolves globals::targets against the latest process snapshot, submits one job
+per target to globals::injectionQueue and returns immediately. Up to the concurrency limit of
+the queue, targets are processed in parallel. For each target a worker first orders the DLLs
+so that each is loaded after the DLLs it imports, and checks that their other imports can be
+found in the target. It then loads them through LoadLibraryA in the target process, either
+all from one remote thread (globals::batchInjection) or with a remote thread per wave of DLLs
+that do not import one another, waiting at most globals::injectionTimeout for the whole job.
+With globals::agentInjection the first job starts a resident agent in the target and later
+jobs load through it without creating threads. With globals::skipUnchanged DLLs the target
+already has loaded from the same file content are skipped and changed ones are unloaded first.
+@return The group of jobs, poll it for progress and statistics.
 */
-void inject_dll();
+std::shared_ptr<injection::InjectionGroup> inject_dll();
 /**
 
 @brief Gets the name of the process with the specified process ID.
-This function retrieves the name of the process with the specified process ID using
-the Windows API functions OpenProcess, EnumProcessModules, and GetModuleFileNameEx.
+This function takes a process snapshot and looks the process ID up in it. Prefer reading
+the snapshot published by globals::processSnapshots when querying many processes.
 @param processId The ID of the target process.
 @return The name of the process with the specified process ID.
 @throw std::runtime_error if the process name cannot be retrieved.
@@ -31,8 +42,8 @@ std::string GetProcessName(DWORD processId);
 /**
 
 @brief Gets the IDs of all currently running processes.
-This function retrieves the IDs of all currently running processes using the
-Windows API function CreateToolhelp32Snapshot and Process32Next.
+This function takes a process snapshot (see process::ProcessEnumerator) and returns
+the ID of every entry.
 @return A vector containing the IDs of all currently running processes.
 @throw std::runtime_error if the process IDs cannot be retrieved.
 */
@@ -40,8 +51,8 @@ std::vector<DWORD> GetAllProcessIds();
 /**
 
 @brief Gets the ID of the process with the specified name.
-This function retrieves the ID of the process with the specified name by iterating
-through all currently running processes and comparing their names to the specified name.
+This function takes a process snapshot and returns the first entry whose executable
+name matches the specified name.
 @param processName The name of the target process.
 @return The ID of the process with the specified name, or 0 if no matching process is found.
 @throw std::runtime_error if the process IDs cannot be retrieved.
@@ -6,7 +6,7 @@
 #include "gui/gui.h" // for GUI functions
 #include <thread>
 #include <string>
-#include "globals.h" // for isRunning
+#include "globals.h" // for processSnapshots and injectionQueue
 
  /**
   * @brief The entry point of the application.
@@ -24,6 +24,30 @@ INT APIENTRY WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
     gui::CreateDevice();
     gui::CreateImGui();
 
+    // Enumerate processes in the background, the render loop only reads the result
+    globals::processSnapshots.Start();
+
+    // Inject on worker threads, a slow target never blocks the render loop
+    globals::injectionQueue.Start();
+
+    // Inject into processes matching a watch rule as soon as they start
+    globals::processWatch.Start();
+
+    // Drop the handle, remote memory and resolved symbols kept for a target once it exits,
+    // or once it runs another program (exec on Linux keeps the pid but replaces every mapping)
+    globals::processSnapshots.AddListener([](const process::ProcessSnapshot& previous, const process::ProcessSnapshot& current) {
+        for (const process::ProcessEvent& event : current.changes) {
+            if (event.type == process::ProcessEventType::Removed ||
+                (event.type == process::ProcessEventType::Changed && previous.processes[event.previousIndex].nameId != current.processes[event.currentIndex].nameId))
+                injection::ReleaseTarget(previous.processes[event.previousIndex].Key());
+        }
+    });
+
+    // Scan the modules of the selected process after every snapshot, the UI only reads the list
+    globals::processSnapshots.AddListener([](const process::ProcessSnapshot&, const process::ProcessSnapshot&) {
+        globals::selectedModules.Refresh();
+    });
+
     // Main loop
     while (gui::isRunning)
     {
@@ -34,6 +58,11 @@ INT APIENTRY WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
         std::this_thread::sleep_for(std::chrono::milliseconds(5));
     }
 
+    globals::processWatch.Stop();
+    globals::injectionQueue.Stop();
+    injection::ReleaseAllTargets();
+    globals::processSnapshots.Stop();
+
     // Clean up GUI components
     gui::DestroyImGui();
     gui::DestroyDevice();
@@ -0,0 +1,193 @@
+/**
+ * @file module_list.cpp
+ * @brief Platform independent parts of the module lists and their cache.
+ */
+
+#include "module_list.h"
+
+#include <algorithm>
+
+namespace
+{
+	char FoldPathCharacter(char c) noexcept
+	{
+		if (c >= 'A' && c <= 'Z')
+			return static_cast<char>(c - 'A' + 'a');
+		return c == '/' ? '\\' : c;
+	}
+
+	// whether two paths name the same file on a case-insensitive file system that accepts both separators
+	bool SamePath(std::string_view left, std::string_view right) noexcept
+	{
+		if (left.size() != right.size())
+			return false;
+		for (std::size_t i = 0; i < left.size(); i++) {
+			if (FoldPathCharacter(left[i]) != FoldPathCharacter(right[i]))
+				return false;
+		}
+		return true;
+	}
+}
+
+/**
+* @brief Looks a library up among the modules.
+* @param path The library as it would be loaded.
+* @param device File identity of the library, 0 if unknown.
+* @param inode File identity of the library, 0 if unknown.
+* @return The module, null if it is not loaded.
+* @remarks With a file identity (Linux) the file is compared the way ld.so does before it maps
+*  a library twice, which also sees through symbolic links and tells a replaced file from the
+*  one that was loaded. Without one (Windows) the paths are compared ignoring ASCII case.
+*/
+const process::ModuleInfo* process::ModuleList::Find(std::string_view path, std::uint64_t device, std::uint64_t inode) const noexcept
+{
+	for (const ModuleInfo& module : modules) {
+		if (inode != 0 ? module.inode == inode && module.device == device : SamePath(NamePool::Shared().View(module.path), path))
+			return &module;
+	}
+	return nullptr;
+}
+
+process::ModuleCache& process::ModuleCache::Shared()
+{
+	static ModuleCache cache;
+	return cache;
+}
+
+/**
+* @brief Gets the modules of a process, scanning them again if the cached list is too old.
+* @param key The process.
+* @param maxAge How old a cached list may be, zero always scans again.
+* @return Null if the process cannot be read or has exited.
+*/
+std::shared_ptr<const process::ModuleList> process::ModuleCache::Get(const ProcessKey& key, std::chrono::steady_clock::duration maxAge)
+{
+	const std::shared_ptr<Entry> entry = Acquire(key);
+
+	std::lock_guard lock(entry->mutex);
+	const auto now = std::chrono::steady_clock::now();
+	if (entry->list && now - entry->scanned < maxAge)
+		return entry->list;
+
+	if (!entry->opened && !(entry->opened = entry->source.Open(key))) {
+		Forget(key);
+		return nullptr;
+	}
+
+	static const std::vector<ModuleInfo> none;
+	switch (entry->source.Scan(entry->list ? entry->list->modules : none, entry->modules)) {
+	case ModuleScan::Failed:
+		Forget(key);
+		return nullptr;
+
+	case ModuleScan::Unchanged:
+		unchanged.fetch_add(1, std::memory_order_relaxed);
+		break;
+
+	case ModuleScan::Changed: {
+		// the scratch list keeps its capacity for the next scan, the published one is a copy
+		auto list = std::make_shared<ModuleList>();
+		list->modules = entry->modules;
+		list->generation = entry->list ? entry->list->generation + 1 : 1;
+		entry->list = std::move(list);
+		changed.fetch_add(1, std::memory_order_relaxed);
+		break;
+	}
+	}
+
+	entry->scanned = now;
+	return entry->list;
+}
+
+/**
+* @brief Finds or creates the entry of a process and marks it as used.
+* @param key The process.
+* @return The entry.
+*/
+std::shared_ptr<process::ModuleCache::Entry> process::ModuleCache::Acquire(const ProcessKey& key)
+{
+	std::lock_guard lock(mutex);
+	std::shared_ptr<Entry>& entry = entries[key];
+	if (!entry) {
+		entry = std::make_shared<Entry>();
+
+		if (entries.size() > Capacity) {
+			const auto oldest = std::min_element(entries.begin(), entries.end(), [&](const auto& left, const auto& right) {
+				return left.second != entry && (right.second == entry || left.second->used < right.second->used);
+			});
+			entries.erase(oldest);
+		}
+	}
+	entry->used = std::chrono::steady_clock::now();
+	return entry;
+}
+
+/**
+* @brief Drops the list of a process and closes it.
+* @param key The process.
+*/
+void process::ModuleCache::Forget(const ProcessKey& key)
+{
+	std::lock_guard lock(mutex);
+	entries.erase(key);
+}
+
+/**
+* @brief Drops all lists.
+*/
+void process::ModuleCache::Clear()
+{
+	std::lock_guard lock(mutex);
+	entries.clear();
+}
+
+std::uint64_t process::ModuleCache::Unchanged() const noexcept
+{
+	return unchanged.load(std::memory_order_relaxed);
+}
+
+std::uint64_t process::ModuleCache::Changed() const noexcept
+{
+	return changed.load(std::memory_order_relaxed);
+}
+
+/**
+* @brief Names the process whose modules are kept fresh.
+* @param key The process, an empty key stops scanning.
+* @return True if the process changed, the caller may want a refresh sooner than the next tick.
+*/
+bool process::ModuleWatch::Watch(const ProcessKey& key)
+{
+	std::lock_guard lock(mutex);
+	if (watched == key)
+		return false;
+	watched = key;
+	return true;
+}
+
+/**
+* @brief Scans the watched process and publishes its modules.
+* @param maxAge How old the cached list may be, a scan that finds it unchanged publishes the same list.
+* @remarks Called on one worker thread, scanning can take a while for a process with many modules.
+*/
+void process::ModuleWatch::Refresh(std::chrono::steady_clock::duration maxAge)
+{
+	ProcessKey key;
+	{
+		std::lock_guard lock(mutex);
+		key = watched;
+	}
+	if (key == ProcessKey{ })
+		return;
+
+	std::shared_ptr<const ModuleList> list = ModuleCache::Shared().Get(key, maxAge);
+	const std::shared_ptr<const Published> previous = latest.load(std::memory_order_acquire);
+	if (previous && previous->key == key && previous->list == list)
+		return;
+	latest.store(std::make_shared<const Published>(Published{ key, std::move(list) }), std::memory_order_release);
+}
+
+std::shared_ptr<const process::ModuleWatch::Published> process::ModuleWatch::Latest() const noexcept
+{
+	return latest.load(std::memory_order_acquire);
+}
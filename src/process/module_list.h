@@ -0,0 +1,192 @@
+/**
+
+@file module_list.h
+@brief Modules loaded in a process, cached per process and refreshed incrementally.
+*/
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "name_pool.h"
+#include "process_snapshot.h"
+
+namespace process
+{
+	/**
+	* @brief One module of a process: a DLL on Windows, a file mapped from offset 0 on Linux.
+	*/
+	struct ModuleInfo
+	{
+		std::uint64_t base = 0;
+		std::uint64_t size = 0; // SizeOfImage on Windows, up to the end of the last mapping of the file on Linux
+		std::uint64_t device = 0; // Linux: st_dev and st_ino of the mapped file, 0 on Windows
+		std::uint64_t inode = 0;
+		NameId path = 0;
+
+		bool operator==(const ModuleInfo&) const noexcept = default;
+	};
+
+	/**
+	* @brief The modules of a process at one point in time, shared read-only once published.
+	*/
+	struct ModuleList
+	{
+		std::vector<ModuleInfo> modules; // sorted by base
+		std::uint64_t generation = 0;    // changes whenever the modules do
+
+		/**
+		* @brief Looks a library up by file identity, or by path where there is none.
+		* @param path The library as it would be loaded.
+		* @param device File identity of the library, 0 if unknown.
+		* @param inode File identity of the library, 0 if unknown.
+		* @return The module, null if it is not loaded.
+		*/
+		const ModuleInfo* Find(std::string_view path, std::uint64_t device, std::uint64_t inode) const noexcept;
+	};
+
+	/**
+	* @brief Outcome of reading the modules of a process.
+	*/
+	enum class ModuleScan
+	{
+		Failed,    // the process has exited or cannot be read
+		Unchanged, // the modules are the ones of the previous scan
+		Changed,
+	};
+
+	/**
+	* @brief Reads the modules of one process, implemented per platform.
+	* @remarks The process is opened once and stays open, a handle (Windows) or an open maps
+	*  file (Linux) keeps referring to the same process even if its PID is reused, so later
+	*  scans need no identity check. Every scan compares the raw listing with the previous one
+	*  and only resolves what is new: on Linux the maps text is parsed with a scanner that
+	*  neither allocates nor copies (the read buffer is kept between scans), on Windows only
+	*  module handles not seen before are asked for their size and path. Paths are interned in
+	*  the NamePool, modules that stay loaded keep their handle without touching the pool.
+	*/
+	class ModuleSource
+	{
+	public:
+		ModuleSource() noexcept = default;
+		~ModuleSource() { Close(); }
+
+		ModuleSource(const ModuleSource&) = delete;
+		ModuleSource& operator=(const ModuleSource&) = delete;
+
+		// platform part: opens the process, false if it cannot be read or is not the one of the key
+		bool Open(const ProcessKey& key);
+
+		// platform part
+		void Close() noexcept;
+
+		/**
+		* @brief Platform part: lists the modules of the process.
+		* @param previous The modules of the previous scan, whose paths are reused.
+		* @param modules Receives the modules sorted by base, only if they changed.
+		* @return Whether the modules changed.
+		*/
+		ModuleScan Scan(const std::vector<ModuleInfo>& previous, std::vector<ModuleInfo>& modules);
+
+	private:
+		int maps = -1;             // Linux: /proc/<pid>/maps
+		void* process = nullptr;   // Windows: process handle
+
+		std::vector<unsigned char> listing; // raw listing of the previous scan
+		std::vector<unsigned char> buffer;  // raw listing of the current scan
+	};
+
+	/**
+	* @brief Module lists of the processes the UI looks at or injects into.
+	* @remarks A list is refreshed when it is asked for and is older than the caller accepts,
+	*  refreshing a process whose modules did not change publishes nothing new. Different
+	*  processes refresh in parallel, one process refreshes once at a time. Processes that
+	*  exited are dropped on their next refresh, the least recently used ones when there are
+	*  more than Capacity.
+	*/
+	class ModuleCache
+	{
+	public:
+		static constexpr std::size_t Capacity = 64;
+
+		// the cache the UI and the injections share
+		static ModuleCache& Shared();
+
+		/**
+		* @brief Gets the modules of a process.
+		* @param key The process.
+		* @param maxAge How old a cached list may be, zero always scans again.
+		* @return Null if the process cannot be read or has exited.
+		*/
+		std::shared_ptr<const ModuleList> Get(const ProcessKey& key, std::chrono::steady_clock::duration maxAge = { });
+
+		void Forget(const ProcessKey& key);
+		void Clear();
+
+		// scans that found the modules unchanged and that published a new list, since the start
+		std::uint64_t Unchanged() const noexcept;
+		std::uint64_t Changed() const noexcept;
+
+	private:
+		struct Entry
+		{
+			std::mutex mutex; // held while scanning
+			ModuleSource source;
+			bool opened = false;
+			std::vector<ModuleInfo> modules; // scratch list the scans fill
+			std::shared_ptr<const ModuleList> list;
+			std::chrono::steady_clock::time_point scanned;
+			std::chrono::steady_clock::time_point used;
+		};
+
+		std::shared_ptr<Entry> Acquire(const ProcessKey& key);
+
+		std::mutex mutex;
+		std::unordered_map<ProcessKey, std::shared_ptr<Entry>, ProcessKeyHash> entries;
+		std::atomic<std::uint64_t> unchanged = 0;
+		std::atomic<std::uint64_t> changed = 0;
+	};
+
+	/**
+	* @brief Keeps the module list of one process, the one the UI shows, fresh off the render thread.
+	* @remarks Refresh() scans through the shared ModuleCache and is called on a worker, the
+	*  snapshot worker after every snapshot. The render thread only names the process with
+	*  Watch() and reads the outcome with Latest(), a lock-free load.
+	*/
+	class ModuleWatch
+	{
+	public:
+		/**
+		* @brief What the last refresh found for the watched process.
+		*/
+		struct Published
+		{
+			ProcessKey key;
+			std::shared_ptr<const ModuleList> list; // null if the process cannot be read
+		};
+
+		/**
+		* @brief Names the process to keep fresh.
+		* @param key The process, an empty key stops scanning.
+		* @return True if it is a different process than before, nothing has been published for it yet.
+		*/
+		bool Watch(const ProcessKey& key);
+
+		// scans the watched process again if its list is older than maxAge and publishes the outcome
+		void Refresh(std::chrono::steady_clock::duration maxAge = std::chrono::seconds(1));
+
+		// the outcome of the last refresh, null until there has been one, the key may be of a process watched before
+		std::shared_ptr<const Published> Latest() const noexcept;
+
+	private:
+		std::mutex mutex; // guards watched only, not held while scanning
+		ProcessKey watched;
+		std::atomic<std::shared_ptr<const Published>> latest;
+	};
+}
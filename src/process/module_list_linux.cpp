@@ -0,0 +1,231 @@
+/**
+ * @file module_list_linux.cpp
+ * @brief Linux implementation of the module scan, a zero allocation /proc/<pid>/maps scanner.
+ */
+
+#ifdef __linux__
+
+#include "module_list.h"
+#include "process_details.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+namespace
+{
+	/**
+	* @brief Reads a hexadecimal number and the character that ends it.
+	* @return False if there are no digits.
+	*/
+	bool ParseHex(const char*& cursor, const char* end, std::uint64_t& value) noexcept
+	{
+		const char* start = cursor;
+		value = 0;
+		for (; cursor < end; ++cursor) {
+			const char c = *cursor;
+			unsigned digit;
+			if (c >= '0' && c <= '9')
+				digit = static_cast<unsigned>(c - '0');
+			else if (c >= 'a' && c <= 'f')
+				digit = static_cast<unsigned>(c - 'a' + 10);
+			else
+				break;
+			value = value << 4 | digit;
+		}
+		return cursor != start;
+	}
+
+	std::uint64_t ParseDecimal(const char*& cursor, const char* end) noexcept
+	{
+		std::uint64_t value = 0;
+		for (; cursor < end && *cursor >= '0' && *cursor <= '9'; ++cursor)
+			value = value * 10 + static_cast<std::uint64_t>(*cursor - '0');
+		return value;
+	}
+
+	bool Skip(const char*& cursor, const char* end, char expected) noexcept
+	{
+		if (cursor >= end || *cursor != expected)
+			return false;
+		++cursor;
+		return true;
+	}
+
+	/**
+	* @brief One line of the maps file, the path points into the read buffer.
+	*/
+	struct Mapping
+	{
+		std::uint64_t begin = 0;
+		std::uint64_t end = 0;
+		std::uint64_t offset = 0;
+		std::uint64_t device = 0;
+		std::uint64_t inode = 0;
+		std::string_view path;
+	};
+
+	/**
+	* @brief Parses "begin-end perms offset major:minor inode   path" without copying anything.
+	* @param cursor Start of the line, moved past its newline.
+	* @return False if the line is malformed, it is skipped then.
+	*/
+	bool ParseMapping(const char*& cursor, const char* end, Mapping& mapping) noexcept
+	{
+		const char* line = cursor;
+		const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', static_cast<std::size_t>(end - line)));
+		if (!lineEnd)
+			lineEnd = end;
+		cursor = lineEnd < end ? lineEnd + 1 : end;
+
+		const char* field = line;
+		std::uint64_t major = 0, minor = 0;
+		if (!ParseHex(field, lineEnd, mapping.begin) || !Skip(field, lineEnd, '-') ||
+			!ParseHex(field, lineEnd, mapping.end) || !Skip(field, lineEnd, ' '))
+			return false;
+
+		// the permissions are always four characters
+		field += 5;
+		if (field >= lineEnd || !ParseHex(field, lineEnd, mapping.offset) || !Skip(field, lineEnd, ' ') ||
+			!ParseHex(field, lineEnd, major) || !Skip(field, lineEnd, ':') ||
+			!ParseHex(field, lineEnd, minor) || !Skip(field, lineEnd, ' '))
+			return false;
+
+		mapping.device = makedev(static_cast<unsigned>(major), static_cast<unsigned>(minor));
+		mapping.inode = ParseDecimal(field, lineEnd);
+
+		// the path is padded to a column, and may contain spaces itself
+		while (field < lineEnd && *field == ' ')
+			++field;
+		mapping.path = std::string_view(field, static_cast<std::size_t>(lineEnd - field));
+		return true;
+	}
+
+	/**
+	* @brief Turns the maps text into modules.
+	* @param text The whole maps file.
+	* @param previous The modules of the previous scan, sorted by base like the maps file.
+	* @param modules Receives the modules.
+	* @remarks A module starts at the mapping of a file's offset 0 and takes in the mappings of
+	*  the same file that follow it (the other segments and the gaps ld.so reserves between
+	*  them). Anonymous mappings, [heap], [vdso] and the like have no inode and are no module.
+	*  A module found at the same base and from the same file as before keeps its path handle,
+	*  the text is only interned for modules that are new.
+	*/
+	void ParseModules(std::string_view text, const std::vector<process::ModuleInfo>& previous, std::vector<process::ModuleInfo>& modules)
+	{
+		modules.clear();
+		std::size_t next = 0;
+
+		const char* cursor = text.data();
+		const char* end = cursor + text.size();
+		Mapping mapping;
+		while (cursor < end) {
+			if (!ParseMapping(cursor, end, mapping) || mapping.inode == 0)
+				continue;
+
+			if (mapping.offset != 0) {
+				process::ModuleInfo* last = modules.empty() ? nullptr : &modules.back();
+				if (last && last->inode == mapping.inode && last->device == mapping.device)
+					last->size = mapping.end - last->base;
+				continue;
+			}
+
+			process::ModuleInfo& module = modules.emplace_back();
+			module.base = mapping.begin;
+			module.size = mapping.end - mapping.begin;
+			module.device = mapping.device;
+			module.inode = mapping.inode;
+
+			while (next < previous.size() && previous[next].base < module.base)
+				++next;
+			if (next < previous.size() && previous[next].base == module.base && previous[next].inode == module.inode && previous[next].device == module.device)
+				module.path = previous[next].path;
+			else
+				module.path = process::NamePool::Shared().Intern(mapping.path);
+		}
+	}
+}
+
+/**
+* @brief Opens the maps file of a process.
+* @param key The process.
+* @return False if it cannot be read (ptrace read access is needed) or is not the one of the key.
+* @remarks The open file stays bound to the process it was opened for, reads return nothing
+*  once that process has exited, even if its PID is reused.
+*/
+bool process::ModuleSource::Open(const ProcessKey& key)
+{
+	Close();
+
+	char path[40];
+	std::snprintf(path, sizeof(path), "/proc/%u/maps", key.pid);
+	maps = open(path, O_RDONLY | O_CLOEXEC);
+	if (maps < 0)
+		return false;
+
+	// checked after opening: the process that passes the check is the one the file belongs to
+	ProcessDetails details;
+	if (!QueryProcessDetails(key, details)) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void process::ModuleSource::Close() noexcept
+{
+	if (maps >= 0)
+		close(maps);
+	maps = -1;
+	listing.clear();
+}
+
+/**
+* @brief Reads the maps file and parses it if it differs from the previous one.
+* @param previous The modules of the previous scan.
+* @param modules Receives the modules, only if they changed.
+* @return Whether the modules changed.
+* @remarks The file is read from offset 0 into a buffer that is kept and doubled when the
+*  file does not fit, the kernel generates the text anew for every read from the start and
+*  may return it in parts, so reading goes on until the end of the file.
+*  Changes to mappings that are no module (the heap growing, a thread stack being mapped)
+*  cause a parse as well, which then finds the modules unchanged.
+*/
+process::ModuleScan process::ModuleSource::Scan(const std::vector<ModuleInfo>& previous, std::vector<ModuleInfo>& modules)
+{
+	if (maps < 0)
+		return ModuleScan::Failed;
+
+	if (buffer.empty())
+		buffer.resize(64 * 1024);
+
+	std::size_t length = 0;
+	for (;;) {
+		const ssize_t read = pread(maps, buffer.data() + length, buffer.size() - length, static_cast<off_t>(length));
+		if (read < 0)
+			return ModuleScan::Failed;
+		if (read == 0)
+			break;
+		length += static_cast<std::size_t>(read);
+		if (length == buffer.size())
+			buffer.resize(buffer.size() * 2);
+	}
+
+	// a process that has exited has no mappings left to list
+	if (length == 0)
+		return ModuleScan::Failed;
+
+	if (length == listing.size() && std::memcmp(buffer.data(), listing.data(), length) == 0)
+		return ModuleScan::Unchanged;
+
+	ParseModules(std::string_view(reinterpret_cast<const char*>(buffer.data()), length), previous, modules);
+
+	// the buffer keeps its capacity, the listing only needs the text
+	listing.assign(buffer.begin(), buffer.begin() + static_cast<std::ptrdiff_t>(length));
+	return modules == previous ? ModuleScan::Unchanged : ModuleScan::Changed;
+}
+
+#endif // __linux__
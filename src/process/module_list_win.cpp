@@ -0,0 +1,117 @@
+/**
+ * @file module_list_win.cpp
+ * @brief Windows implementation of the module scan through the PSAPI module list.
+ */
+
+#ifdef _WIN32
+
+#include "module_list.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <windows.h>
+#include <psapi.h>
+
+/**
+* @brief Opens the process for reading its loader data.
+* @param key The process.
+* @return False if it cannot be opened or its PID has been reused.
+*/
+bool process::ModuleSource::Open(const ProcessKey& key)
+{
+	Close();
+
+	HANDLE handle = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, key.pid);
+	if (!handle)
+		return false;
+
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(handle, &creation, &exit, &kernel, &user) ||
+		(static_cast<std::uint64_t>(creation.dwHighDateTime) << 32 | creation.dwLowDateTime) != key.startTime) {
+		CloseHandle(handle);
+		return false;
+	}
+
+	process = handle;
+	return true;
+}
+
+void process::ModuleSource::Close() noexcept
+{
+	if (process)
+		CloseHandle(process);
+	process = nullptr;
+	listing.clear();
+}
+
+/**
+* @brief Lists the module handles and resolves the ones that are new.
+* @param previous The modules of the previous scan.
+* @param modules Receives the modules, only if they changed.
+* @return Whether the modules changed.
+* @remarks Listing the handles walks the loader list in the target (a few ReadProcessMemory
+*  calls per module), the size and path of a module cost several more each, so they are
+*  only asked for modules whose base was not in the previous scan. The 32-bit modules of a
+*  WOW64 process are listed as well. A module that is unloaded and another one that is
+*  loaded at the same base in between two scans are taken for the same module.
+*/
+process::ModuleScan process::ModuleSource::Scan(const std::vector<ModuleInfo>& previous, std::vector<ModuleInfo>& modules)
+{
+	if (!process)
+		return ModuleScan::Failed;
+
+	if (buffer.empty())
+		buffer.resize(512 * sizeof(HMODULE));
+
+	DWORD needed = 0;
+	for (;;) {
+		const DWORD size = static_cast<DWORD>(buffer.size());
+		if (!EnumProcessModulesEx(process, reinterpret_cast<HMODULE*>(buffer.data()), size, &needed, LIST_MODULES_ALL))
+			return ModuleScan::Failed;
+		if (needed <= size)
+			break;
+		buffer.resize(needed);
+	}
+
+	if (needed == listing.size() && std::memcmp(buffer.data(), listing.data(), needed) == 0)
+		return ModuleScan::Unchanged;
+
+	const HMODULE* handles = reinterpret_cast<const HMODULE*>(buffer.data());
+	modules.clear();
+	for (std::size_t i = 0; i < needed / sizeof(HMODULE); i++) {
+		const std::uint64_t base = reinterpret_cast<std::uint64_t>(handles[i]);
+
+		const auto known = std::lower_bound(previous.begin(), previous.end(), base, [](const ModuleInfo& module, std::uint64_t base) {
+			return module.base < base;
+		});
+		if (known != previous.end() && known->base == base) {
+			modules.push_back(*known);
+			continue;
+		}
+
+		// a module unloaded since the handles were listed is left out
+		MODULEINFO information;
+		char path[MAX_PATH * 4];
+		if (!GetModuleInformation(process, handles[i], &information, sizeof(information)))
+			continue;
+		const DWORD length = GetModuleFileNameExA(process, handles[i], path, sizeof(path));
+		if (length == 0)
+			continue;
+
+		ModuleInfo& module = modules.emplace_back();
+		module.base = base;
+		module.size = information.SizeOfImage;
+		module.path = NamePool::Shared().Intern(std::string_view(path, length));
+	}
+
+	// the loader lists modules in load order
+	std::sort(modules.begin(), modules.end(), [](const ModuleInfo& left, const ModuleInfo& right) {
+		return left.base < right.base;
+	});
+
+	listing.assign(buffer.begin(), buffer.begin() + static_cast<std::ptrdiff_t>(needed));
+	return modules == previous ? ModuleScan::Unchanged : ModuleScan::Changed;
+}
+
+#endif // _WIN32
@@ -0,0 +1,154 @@
+/**
+ * @file name_pool.cpp
+ * @brief Implements the name interning pool.
+ */
+
+#include "name_pool.h"
+#include "sort_keys.h"
+
+#include <cstring>
+#include <functional>
+
+/**
+* @brief Creates a pool that only knows the empty name.
+*/
+process::NamePool::NamePool()
+{
+	chunks[0] = std::make_unique<Entry[]>(ChunkSize);
+	count = 1;
+	slots.resize(1024);
+}
+
+/**
+* @brief Gets the pool used throughout the application.
+* @return The shared pool.
+*/
+process::NamePool& process::NamePool::Shared()
+{
+	static NamePool pool;
+	return pool;
+}
+
+/**
+* @brief Interns a name.
+* @param text The name to be interned.
+* @return The handle of the name, 0 for the empty name or if the pool is full.
+* @remarks A known name costs a hash and one compare, only new names are copied.
+*/
+process::NameId process::NamePool::Intern(std::string_view text)
+{
+	if (text.empty())
+		return 0;
+
+	const auto hash = static_cast<std::uint32_t>(std::hash<std::string_view>{}(text));
+
+	std::lock_guard lock(mutex);
+
+	std::size_t mask = slots.size() - 1;
+	std::size_t slot = hash & mask;
+	for (; slots[slot] != 0; slot = (slot + 1) & mask) {
+		const Entry& entry = Get(slots[slot]);
+		if (entry.hash == hash && std::string_view(entry.text, entry.length) == text)
+			return slots[slot];
+	}
+
+	if (count == ChunkSize * MaxChunks)
+		return 0;
+
+	const NameId id = count;
+	if (!chunks[id >> ChunkBits])
+		chunks[id >> ChunkBits] = std::make_unique<Entry[]>(ChunkSize);
+
+	char* destination = storage.Reserve(text.size() * 2 + 1);
+	std::memcpy(destination, text.data(), text.size());
+	destination[text.size()] = '\0';
+	FoldAsciiCase(text, destination + text.size() + 1);
+	storage.Commit(text.size() * 2 + 1);
+
+	Entry& entry = chunks[id >> ChunkBits][id & (ChunkSize - 1)];
+	entry.text = destination;
+	entry.length = static_cast<std::uint32_t>(text.size());
+	entry.hash = hash;
+
+	slots[slot] = id;
+	++count;
+
+	// keep the table at most half full
+	if (count * 2 > slots.size())
+		Grow();
+
+	return id;
+}
+
+/**
+* @brief Resolves a handle to its name.
+* @param id A handle returned by Intern().
+* @return The name.
+*/
+std::string_view process::NamePool::View(NameId id) const noexcept
+{
+	const Entry& entry = Get(id);
+	return { entry.text, entry.length };
+}
+
+/**
+* @brief Resolves a handle to its case-folded name.
+* @param id A handle returned by Intern().
+* @return The name with ASCII letters lowercased.
+*/
+std::string_view process::NamePool::Folded(NameId id) const noexcept
+{
+	const Entry& entry = Get(id);
+	if (entry.length == 0)
+		return { };
+	return { entry.text + entry.length + 1, entry.length };
+}
+
+/**
+* @brief Gets the number of distinct names.
+* @return The name count, the empty name included.
+*/
+std::size_t process::NamePool::Size() const noexcept
+{
+	std::lock_guard lock(mutex);
+	return count;
+}
+
+/**
+* @brief Gets the string storage in use.
+* @return The number of bytes, terminators and folded copies included.
+*/
+std::size_t process::NamePool::BytesUsed() const noexcept
+{
+	std::lock_guard lock(mutex);
+	return storage.BytesUsed();
+}
+
+/**
+* @brief Looks up the entry of a handle.
+*/
+const process::NamePool::Entry& process::NamePool::Get(NameId id) const noexcept
+{
+	return chunks[id >> ChunkBits][id & (ChunkSize - 1)];
+}
+
+/**
+* @brief Doubles the hash table and reinserts every handle.
+*/
+void process::NamePool::Grow()
+{
+	std::vector<NameId> grown(slots.size() * 2);
+	const std::size_t mask = grown.size() - 1;
+
+	for (NameId id : slots) {
+		if (id == 0)
+			continue;
+
+		std::size_t slot = Get(id).hash & mask;
+		while (grown[slot] != 0)
+			slot = (slot + 1) & mask;
+		grown[slot] = id;
+	}
+
+	slots.swap(grown);
+}
@@ -0,0 +1,87 @@
+/**
+
+@file name_pool.h
+@brief Interning pool that stores every distinct process or module name once.
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include "string_arena.h"
+
+namespace process
+{
+	/**
+	* @brief Handle of an interned name, equal handles mean equal names.
+	* @remarks 0 always stands for the empty name.
+	*/
+	using NameId = std::uint32_t;
+
+	/**
+	* @brief Stores each distinct name once and hands out 32-bit handles for it.
+	* @remarks Names are never removed, the pool only grows with the number of distinct
+	*  image names and paths, which is small compared to the number of processes. Interning
+	*  takes a lock, resolving a handle does not: entries never move once written, so a handle
+	*  received from another thread (for example through a published snapshot) can be resolved
+	*  without any synchronization. Next to every name the pool keeps its case-folded form,
+	*  which is what the process list sorts and searches on.
+	*/
+	class NamePool
+	{
+	public:
+		NamePool();
+
+		NamePool(const NamePool&) = delete;
+		NamePool& operator=(const NamePool&) = delete;
+
+		// the pool shared by the snapshots, the caches and the UI
+		static NamePool& Shared();
+
+		// returns the handle of text, storing it first if it is new
+		NameId Intern(std::string_view text);
+
+		// the interned name, NUL terminated and valid for the lifetime of the pool
+		std::string_view View(NameId id) const noexcept;
+
+		// the interned name with ASCII letters lowercased, NUL terminated
+		std::string_view Folded(NameId id) const noexcept;
+
+		// number of distinct names, including the empty one
+		std::size_t Size() const noexcept;
+
+		// bytes of string storage in use
+		std::size_t BytesUsed() const noexcept;
+
+	private:
+		struct Entry
+		{
+			const char* text = "";
+			std::uint32_t length = 0;
+			std::uint32_t hash = 0;
+		};
+
+		static constexpr std::uint32_t ChunkBits = 12;
+		static constexpr std::uint32_t ChunkSize = 1u << ChunkBits;
+		static constexpr std::uint32_t MaxChunks = 1024; // 4M distinct names
+
+		const Entry& Get(NameId id) const noexcept;
+		void Grow();
+
+		mutable std::mutex mutex;
+
+		// fixed chunk table, so resolving a handle never races with the table growing
+		std::unique_ptr<Entry[]> chunks[MaxChunks];
+		std::uint32_t count = 0;
+
+		// open addressing table of handles, 0 marks a free slot
+		std::vector<NameId> slots;
+
+		// name and folded name back to back
+		StringArena storage;
+	};
+}
@@ -0,0 +1,96 @@
+/**
+ * @file process_cache.cpp
+ * @brief Implements the process details cache.
+ */
+
+#include "process_cache.h"
+
+/**
+* @brief Attaches cached details to every process of a snapshot that is being built.
+* @param snapshot The snapshot being built.
+* @remarks Known processes cost a hash lookup, only processes that were not part of the
+*  previous update are queried from the OS.
+*/
+void process::ProcessDetailsCache::Update(ProcessSnapshot& snapshot)
+{
+	std::uint64_t updateHits = 0;
+	std::uint64_t updateMisses = 0;
+
+	for (ProcessInfo& info : snapshot.processes) {
+		const ProcessKey key = info.Key();
+
+		auto found = entries.find(key);
+		if (found != entries.end()) {
+			++updateHits;
+		}
+		else {
+			++updateMisses;
+
+			ProcessDetails details;
+			if (!QueryProcessDetails(key, details)) {
+				// the PID was reused between enumeration and query, try again next refresh
+				continue;
+			}
+			found = entries.emplace(key, std::move(details)).first;
+		}
+
+		const ProcessDetails& details = found->second;
+		info.accessible = details.accessible;
+		info.architecture = details.architecture;
+		info.SetPath(details.imagePath);
+	}
+
+	hits.fetch_add(updateHits, std::memory_order_relaxed);
+	misses.fetch_add(updateMisses, std::memory_order_relaxed);
+	size.store(entries.size(), std::memory_order_relaxed);
+
+	lastHits.store(updateHits, std::memory_order_relaxed);
+	lastMisses.store(updateMisses, std::memory_order_relaxed);
+}
+
+/**
+* @brief Drops every process that has exited since the previous snapshot.
+* @param previous The snapshot the events refer to with their previous index.
+* @param events The diff between the previous and the current snapshot.
+*/
+void process::ProcessDetailsCache::Evict(const ProcessSnapshot& previous, const std::vector<ProcessEvent>& events)
+{
+	std::uint64_t updateEvictions = 0;
+
+	for (const ProcessEvent& event : events) {
+		if (event.type == ProcessEventType::Removed)
+			updateEvictions += entries.erase(previous.processes[event.previousIndex].Key());
+	}
+
+	evictions.fetch_add(updateEvictions, std::memory_order_relaxed);
+	size.store(entries.size(), std::memory_order_relaxed);
+	lastEvictions.store(updateEvictions, std::memory_order_relaxed);
+}
+
+/**
+* @brief Gets the counters accumulated over all updates.
+* @return The cumulative statistics.
+*/
+process::CacheStats process::ProcessDetailsCache::GetStats() const noexcept
+{
+	CacheStats stats;
+	stats.hits = hits.load(std::memory_order_relaxed);
+	stats.misses = misses.load(std::memory_order_relaxed);
+	stats.evictions = evictions.load(std::memory_order_relaxed);
+	stats.entries = size.load(std::memory_order_relaxed);
+	return stats;
+}
+
+/**
+* @brief Gets the counters of the most recent update.
+* @return The statistics of the last refresh. In steady state misses should be close to zero.
+*/
+process::CacheStats process::ProcessDetailsCache::GetLastUpdateStats() const noexcept
+{
+	CacheStats stats;
+	stats.hits = lastHits.load(std::memory_order_relaxed);
+	stats.misses = lastMisses.load(std::memory_order_relaxed);
+	stats.evictions = lastEvictions.load(std::memory_order_relaxed);
+	stats.entries = size.load(std::memory_order_relaxed);
+	return stats;
+}
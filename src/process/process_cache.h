@@ -0,0 +1,69 @@
+/**
+
+@file process_cache.h
+@brief Cache of process details keyed by process identity.
+*/
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "process_details.h"
+#include "process_snapshot.h"
+
+namespace process
+{
+	/**
+	* @brief Hit and miss counters of a ProcessDetailsCache.
+	*/
+	struct CacheStats
+	{
+		std::uint64_t hits = 0;
+		std::uint64_t misses = 0;
+		std::uint64_t evictions = 0;
+		std::size_t entries = 0;
+
+		double HitRate() const noexcept
+		{
+			const std::uint64_t lookups = hits + misses;
+			return lookups ? static_cast<double>(hits) / static_cast<double>(lookups) : 0.0;
+		}
+	};
+
+	/**
+	* @brief Remembers the details of every live process so only new processes are queried.
+	* @remarks Entries are keyed by (pid, start time), a recycled PID is therefore a miss and
+	*  never returns stale data. Exited processes are evicted from the snapshot diff instead of
+	*  sweeping the whole cache. Update() and Evict() are meant to be called by the snapshot
+	*  worker only, the statistics may be read from any thread.
+	*/
+	class ProcessDetailsCache
+	{
+	public:
+		// fills path, architecture and accessible for every entry of a snapshot being built
+		void Update(ProcessSnapshot& snapshot);
+
+		// drops the processes reported as removed by the diff between two snapshots
+		void Evict(const ProcessSnapshot& previous, const std::vector<ProcessEvent>& events);
+
+		// cumulative counters since construction
+		CacheStats GetStats() const noexcept;
+
+		// counters of the most recent Update() only
+		CacheStats GetLastUpdateStats() const noexcept;
+
+	private:
+		std::unordered_map<ProcessKey, ProcessDetails, ProcessKeyHash> entries;
+
+		std::atomic<std::uint64_t> hits = 0;
+		std::atomic<std::uint64_t> misses = 0;
+		std::atomic<std::uint64_t> evictions = 0;
+		std::atomic<std::size_t> size = 0;
+
+		std::atomic<std::uint64_t> lastHits = 0;
+		std::atomic<std::uint64_t> lastMisses = 0;
+		std::atomic<std::uint64_t> lastEvictions = 0;
+	};
+}
@@ -0,0 +1,37 @@
+/**
+
+@file process_details.h
+@brief Per process information that needs a process handle to be retrieved.
+*/
+
+#pragma once
+#include <cstdint>
+
+#include "process_snapshot.h"
+
+namespace process
+{
+	/**
+	* @brief Information that does not change during the lifetime of a process.
+	*/
+	struct ProcessDetails
+	{
+		// full path of the main executable interned in NamePool::Shared(), 0 if the process could not be opened
+		NameId imagePath = 0;
+
+		Architecture architecture = Architecture::Unknown;
+
+		// whether we are allowed to read the process memory, processes we cannot open are not injectable
+		bool accessible = false;
+	};
+
+	/**
+	* @brief Queries the details of one process from the OS.
+	* @param key The process to be queried.
+	* @param details Receives the result.
+	* @return False if the PID now belongs to a different process than key describes,
+	*  in which case the result must not be cached.
+	* @remarks This opens the process and is the expensive part of a refresh, use ProcessDetailsCache.
+	*/
+	bool QueryProcessDetails(const ProcessKey& key, ProcessDetails& details);
+}
@@ -0,0 +1,123 @@
+/**
+ * @file process_details_linux.cpp
+ * @brief Linux implementation of the process details query.
+ */
+
+#ifdef __linux__
+
+#include "process_details.h"
+
+#include <cstdio>
+#include <cstring>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+	/**
+	* @brief Closes a file descriptor when leaving the scope.
+	*/
+	struct FileDescriptor
+	{
+		int fd = -1;
+		~FileDescriptor() { if (fd >= 0) close(fd); }
+	};
+
+	/**
+	* @brief Reads field 22 (starttime) of /proc/<pid>/stat.
+	* @return The start time, or 0 if the file could not be parsed.
+	*/
+	std::uint64_t ReadStartTime(int processDirectory) noexcept
+	{
+		FileDescriptor file{ openat(processDirectory, "stat", O_RDONLY | O_CLOEXEC) };
+		if (file.fd < 0)
+			return 0;
+
+		char line[1024];
+		const ssize_t length = pread(file.fd, line, sizeof(line), 0);
+		if (length <= 0)
+			return 0;
+
+		const char* end = line + length;
+		const char* cursor = end;
+		while (cursor > line && cursor[-1] != ')')
+			--cursor;
+		if (cursor == line)
+			return 0;
+
+		// every space after the name starts the next field, field 22 starts after the 20th
+		for (int spaces = 0; cursor < end && spaces < 20; ++cursor) {
+			if (*cursor == ' ')
+				++spaces;
+		}
+
+		std::uint64_t value = 0;
+		for (; cursor < end && *cursor >= '0' && *cursor <= '9'; ++cursor)
+			value = value * 10 + static_cast<std::uint64_t>(*cursor - '0');
+		return value;
+	}
+
+	/**
+	* @brief Reads the architecture out of the ELF header of the main executable.
+	*/
+	process::Architecture ReadArchitecture(int processDirectory) noexcept
+	{
+		FileDescriptor file{ openat(processDirectory, "exe", O_RDONLY | O_CLOEXEC) };
+		if (file.fd < 0)
+			return process::Architecture::Unknown;
+
+		unsigned char header[EI_NIDENT + 4];
+		if (pread(file.fd, header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+			std::memcmp(header, ELFMAG, SELFMAG) != 0)
+			return process::Architecture::Unknown;
+
+		// e_type (2 bytes) follows e_ident, e_machine follows e_type, both little endian on our targets
+		const unsigned machine = header[EI_NIDENT + 2] | header[EI_NIDENT + 3] << 8;
+		switch (machine) {
+		case EM_386: return process::Architecture::X86;
+		case EM_X86_64: return process::Architecture::X64;
+		case EM_AARCH64: return process::Architecture::Arm64;
+		default: return process::Architecture::Unknown;
+		}
+	}
+}
+
+/**
+* @brief Reads image path, architecture and ptrace accessibility of a process.
+* @param key The process to be queried.
+* @param details Receives the result.
+* @return False if the PID has been reused since the snapshot was taken.
+* @remarks Opening /proc/<pid>/mem performs the same access check as ptrace attach, so it
+*  tells whether we could inject into the process.
+*/
+bool process::QueryProcessDetails(const ProcessKey& key, ProcessDetails& details)
+{
+	details = { };
+
+	char path[32];
+	std::snprintf(path, sizeof(path), "/proc/%u", key.pid);
+
+	FileDescriptor directory{ open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC) };
+	if (directory.fd < 0)
+		return false;
+
+	if (ReadStartTime(directory.fd) != key.startTime)
+		return false;
+
+	FileDescriptor memory{ openat(directory.fd, "mem", O_RDONLY | O_CLOEXEC) };
+	if (memory.fd < 0)
+		return true;
+
+	details.accessible = true;
+	details.architecture = ReadArchitecture(directory.fd);
+
+	char image[4096];
+	const ssize_t length = readlinkat(directory.fd, "exe", image, sizeof(image));
+	if (length > 0)
+		details.imagePath = NamePool::Shared().Intern(std::string_view(image, static_cast<std::size_t>(length)));
+
+	return true;
+}
+
+#endif // __linux__
@@ -0,0 +1,76 @@
+/**
+ * @file process_details_win.cpp
+ * @brief Windows implementation of the process details query.
+ */
+
+#ifdef _WIN32
+
+#include "process_details.h"
+
+#include <windows.h>
+
+namespace
+{
+	/**
+	* @brief Maps an IMAGE_FILE_MACHINE_* value to our architecture enum.
+	*/
+	process::Architecture ToArchitecture(USHORT machine) noexcept
+	{
+		switch (machine) {
+		case IMAGE_FILE_MACHINE_I386: return process::Architecture::X86;
+		case IMAGE_FILE_MACHINE_AMD64: return process::Architecture::X64;
+		case IMAGE_FILE_MACHINE_ARM64: return process::Architecture::Arm64;
+		default: return process::Architecture::Unknown;
+		}
+	}
+}
+
+/**
+* @brief Opens the process once and reads its image path and architecture.
+* @param key The process to be queried.
+* @param details Receives the result.
+* @return False if the PID has been reused since the snapshot was taken.
+* @remarks A process that cannot be opened is reported (and cached) as inaccessible, the
+*  access rights we get for a process do not change during its lifetime.
+*/
+bool process::QueryProcessDetails(const ProcessKey& key, ProcessDetails& details)
+{
+	details = { };
+
+	HANDLE handle = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, key.pid);
+	if (!handle)
+		return true;
+
+	FILETIME creation, exit, kernel, user;
+	if (GetProcessTimes(handle, &creation, &exit, &kernel, &user)) {
+		const std::uint64_t created = static_cast<std::uint64_t>(creation.dwHighDateTime) << 32 | creation.dwLowDateTime;
+		if (created != key.startTime) {
+			CloseHandle(handle);
+			return false;
+		}
+	}
+
+	details.accessible = true;
+
+	USHORT processMachine = IMAGE_FILE_MACHINE_UNKNOWN;
+	USHORT nativeMachine = IMAGE_FILE_MACHINE_UNKNOWN;
+	if (IsWow64Process2(handle, &processMachine, &nativeMachine)) {
+		// IMAGE_FILE_MACHINE_UNKNOWN means the process is not running under WOW64
+		details.architecture = ToArchitecture(processMachine != IMAGE_FILE_MACHINE_UNKNOWN ? processMachine : nativeMachine);
+	}
+
+	WCHAR path[MAX_PATH * 4];
+	DWORD length = sizeof(path) / sizeof(WCHAR);
+	if (QueryFullProcessImageNameW(handle, 0, path, &length)) {
+		// UTF-16 to UTF-8 needs at most three bytes per code unit
+		char utf8[MAX_PATH * 4 * 3];
+		const int size = WideCharToMultiByte(CP_UTF8, 0, path, static_cast<int>(length), utf8, sizeof(utf8), nullptr, nullptr);
+		if (size > 0)
+			details.imagePath = NamePool::Shared().Intern(std::string_view(utf8, static_cast<std::size_t>(size)));
+	}
+
+	CloseHandle(handle);
+	return true;
+}
+
+#endif // _WIN32
@@ -0,0 +1,71 @@
+/**
+ * @file process_snapshot.cpp
+ * @brief Platform independent parts of the process snapshot.
+ */
+
+#include "process_snapshot.h"
+
+#include <bit>
+
+/**
+* @brief Builds the key lookup table of the snapshot.
+* @remarks The table is a flat array of slots holding index + 1 (0 marks an empty slot), sized
+*  to the next power of two above twice the process count, and probed linearly. It costs a
+*  single allocation regardless of the number of processes.
+*/
+void process::ProcessSnapshot::BuildLookup()
+{
+	const std::size_t capacity = std::bit_ceil(processes.size() * 2 + 2);
+	const std::size_t mask = capacity - 1;
+
+	lookup.assign(capacity, 0);
+
+	for (std::uint32_t i = 0; i < processes.size(); i++) {
+		std::size_t slot = ProcessKeyHash{}(processes[i].Key()) & mask;
+		while (lookup[slot] != 0)
+			slot = (slot + 1) & mask;
+		lookup[slot] = i + 1;
+	}
+}
+
+/**
+* @brief Finds a process instance in the snapshot.
+* @param key The pid and start time of the process.
+* @return The entry, or nullptr if the process is not part of this snapshot (it exited or the
+*  pid now belongs to another process).
+*/
+const process::ProcessInfo* process::ProcessSnapshot::Find(const ProcessKey& key) const noexcept
+{
+	if (lookup.empty())
+		return nullptr;
+
+	const std::size_t mask = lookup.size() - 1;
+	for (std::size_t slot = ProcessKeyHash{}(key) & mask; lookup[slot] != 0; slot = (slot + 1) & mask) {
+		const ProcessInfo& info = processes[lookup[slot] - 1];
+		if (info.Key() == key)
+			return &info;
+	}
+	return nullptr;
+}
+
+/**
+* @brief Sets the interned executable name.
+* @param id A handle of NamePool::Shared().
+*/
+void process::ProcessInfo::SetName(NameId id) noexcept
+{
+	const NamePool& pool = NamePool::Shared();
+	nameId = id;
+	name = pool.View(id);
+	sortKey = pool.Folded(id);
+}
+
+/**
+* @brief Sets the interned executable path.
+* @param id A handle of NamePool::Shared().
+*/
+void process::ProcessInfo::SetPath(NameId id) noexcept
+{
+	pathId = id;
+	path = NamePool::Shared().View(id);
+}
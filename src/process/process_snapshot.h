@@ -0,0 +1,159 @@
+/**
+
+@file process_snapshot.h
+@brief Single pass enumeration of all running processes into a structured snapshot.
+*/
+
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "name_pool.h"
+
+namespace process
+{
+	/**
+	* @brief Instruction set a process image was built for.
+	*/
+	enum class Architecture : std::uint8_t
+	{
+		Unknown,
+		X86,
+		X64,
+		Arm64,
+	};
+
+	/**
+	* @brief Identifies one process instance.
+	* @remarks PIDs are recycled by the OS, the creation time tells two processes with the same PID apart.
+	*/
+	struct ProcessKey
+	{
+		std::uint32_t pid = 0;
+		std::uint64_t startTime = 0;
+
+		bool operator==(const ProcessKey&) const noexcept = default;
+	};
+
+	/**
+	* @brief Hash for ProcessKey, usable with std::unordered_map.
+	*/
+	struct ProcessKeyHash
+	{
+		std::size_t operator()(const ProcessKey& key) const noexcept
+		{
+			std::uint64_t value = (key.startTime ^ (static_cast<std::uint64_t>(key.pid) << 32 | key.pid)) * 0x9E3779B97F4A7C15ull;
+			return static_cast<std::size_t>(value ^ (value >> 29));
+		}
+	};
+
+	/**
+	* @brief A single process as seen by one snapshot.
+	*/
+	struct ProcessInfo
+	{
+		std::uint32_t pid = 0;
+		std::uint32_t parentPid = 0;
+		std::uint32_t threadCount = 0;
+
+		// platform specific creation timestamp (FILETIME ticks on Windows, clock ticks since boot on Linux),
+		// only meaningful for comparisons between processes of the same host
+		std::uint64_t startTime = 0;
+
+		// resident memory (working set) in bytes, changes between snapshots without a Changed event
+		std::uint64_t workingSet = 0;
+
+		// executable file name, interned in NamePool::Shared(), compare handles rather than text
+		NameId nameId = 0;
+
+		// resolved views of nameId, NUL terminated and valid for the lifetime of the pool
+		std::string_view name;
+		std::string_view sortKey; // name with ASCII letters lowercased
+
+		// filled from the process details cache, empty/unknown when the process could not be opened
+		NameId pathId = 0;
+		std::string_view path;
+		Architecture architecture = Architecture::Unknown;
+		bool accessible = false;
+
+		ProcessKey Key() const noexcept { return { pid, startTime }; }
+
+		// set a handle together with its resolved views
+		void SetName(NameId id) noexcept;
+		void SetPath(NameId id) noexcept;
+	};
+
+	/**
+	* @brief What happened to one process between two consecutive snapshots.
+	*/
+	enum class ProcessEventType : std::uint8_t
+	{
+		Added,
+		Removed,
+		Changed, // same process, but name, parent, thread count or details differ
+	};
+
+	/**
+	* @brief One entry of the difference between two snapshots.
+	*/
+	struct ProcessEvent
+	{
+		static constexpr std::uint32_t npos = ~0u;
+
+		ProcessEventType type = ProcessEventType::Added;
+
+		// index into the previous snapshot, npos for Added
+		std::uint32_t previousIndex = npos;
+
+		// index into the current snapshot, npos for Removed
+		std::uint32_t currentIndex = npos;
+	};
+
+	/**
+	* @brief An immutable list of processes taken at one point in time.
+	* @remarks Snapshots are never modified after being published, so readers may keep
+	*  a reference to one across frames without any locking. Names are interned in the shared
+	*  NamePool, a snapshot owns no string memory of its own.
+	*/
+	struct ProcessSnapshot
+	{
+		// monotonically increasing, 0 means "no snapshot taken yet"
+		std::uint64_t generation = 0;
+
+		// when the enumeration for this snapshot finished
+		std::chrono::steady_clock::time_point takenAt = { };
+
+		// sorted by pid once published by the snapshot service
+		std::vector<ProcessInfo> processes;
+
+		// difference to the snapshot with generation - 1, in pid order
+		std::vector<ProcessEvent> changes;
+
+		// open addressing table over processes, built by BuildLookup()
+		std::vector<std::uint32_t> lookup;
+
+		// indexes all entries by key, must be called again after processes changed
+		void BuildLookup();
+
+		// O(1) lookup of a process instance, nullptr if it is not part of this snapshot
+		const ProcessInfo* Find(const ProcessKey& key) const noexcept;
+	};
+
+	/**
+	* @brief Enumerates processes, reusing its scratch memory between calls.
+	* @remarks One enumerator must not be used by several threads at once.
+	*/
+	class ProcessEnumerator
+	{
+	public:
+		// fills out.processes in one pass, returns false if the OS query failed
+		bool Enumerate(ProcessSnapshot& out);
+
+	private:
+		std::vector<unsigned char> buffer;
+		std::size_t lastCount = 0;
+	};
+}
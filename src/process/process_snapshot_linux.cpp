@@ -0,0 +1,214 @@
+/**
+ * @file process_snapshot_linux.cpp
+ * @brief Linux process enumeration backed by /proc.
+ */
+
+#ifdef __linux__
+
+#include "process_snapshot.h"
+
+#include <cstring>
+#include <dirent.h> // DT_DIR
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+	/**
+	* @brief Directory entry layout returned by getdents64.
+	*/
+	struct LinuxDirent64
+	{
+		std::uint64_t d_ino;
+		std::int64_t d_off;
+		unsigned short d_reclen;
+		unsigned char d_type;
+		char d_name[1];
+	};
+
+	/**
+	* @brief Closes a file descriptor when leaving the scope.
+	*/
+	struct FileDescriptor
+	{
+		int fd = -1;
+		~FileDescriptor() { if (fd >= 0) close(fd); }
+	};
+
+	/**
+	* @brief Parses a decimal process directory name.
+	* @param name The directory name.
+	* @param pid Receives the parsed value.
+	* @return False if the name is not a positive decimal number.
+	*/
+	bool ParsePid(const char* name, std::uint32_t& pid) noexcept
+	{
+		if (*name < '1' || *name > '9')
+			return false;
+
+		std::uint32_t value = 0;
+		for (; *name; ++name) {
+			if (*name < '0' || *name > '9')
+				return false;
+			value = value * 10 + static_cast<std::uint32_t>(*name - '0');
+		}
+		pid = value;
+		return true;
+	}
+
+	/**
+	* @brief Skips count space separated fields.
+	* @return A pointer to the start of the next field, or nullptr if the line ended.
+	*/
+	const char* SkipFields(const char* cursor, const char* end, int count) noexcept
+	{
+		while (count > 0) {
+			while (cursor < end && *cursor != ' ')
+				++cursor;
+			if (cursor >= end)
+				return nullptr;
+			++cursor;
+			--count;
+		}
+		return cursor;
+	}
+
+	/**
+	* @brief Reads an unsigned decimal field.
+	* @return A pointer past the parsed digits.
+	*/
+	const char* ParseNumber(const char* cursor, const char* end, std::uint64_t& value) noexcept
+	{
+		value = 0;
+		while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+			value = value * 10 + static_cast<std::uint64_t>(*cursor - '0');
+			++cursor;
+		}
+		return cursor;
+	}
+
+	/**
+	* @brief Parses the fields we need out of /proc/<pid>/stat.
+	* @param line The file content.
+	* @param length The number of valid bytes in line.
+	* @param info Receives parent pid, thread count, start time and resident size.
+	* @param comm Receives the process name, which may contain spaces and parentheses.
+	* @return False if the content is malformed.
+	* @remarks The name is the only field that is not space free, so it is delimited by the
+	*  first '(' and the last ')'. Field numbers below follow proc(5).
+	*/
+	bool ParseStat(const char* line, std::size_t length, process::ProcessInfo& info, std::string_view& comm) noexcept
+	{
+		static const std::uint64_t pageSize = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+
+		const char* end = line + length;
+
+		const char* open = static_cast<const char*>(std::memchr(line, '(', length));
+		const char* close = nullptr;
+		for (const char* cursor = end; cursor > line; --cursor) {
+			if (cursor[-1] == ')') {
+				close = cursor - 1;
+				break;
+			}
+		}
+		if (!open || !close || close < open || close + 2 >= end)
+			return false;
+
+		comm = std::string_view(open + 1, static_cast<std::size_t>(close - open - 1));
+
+		// close + 2 is field 3 (state)
+		const char* cursor = SkipFields(close + 2, end, 1);
+		if (!cursor)
+			return false;
+
+		std::uint64_t value;
+		cursor = ParseNumber(cursor, end, value); // 4: ppid
+		info.parentPid = static_cast<std::uint32_t>(value);
+
+		cursor = SkipFields(cursor, end, 16); // to 20: num_threads
+		if (!cursor)
+			return false;
+		cursor = ParseNumber(cursor, end, value);
+		info.threadCount = static_cast<std::uint32_t>(value);
+
+		cursor = SkipFields(cursor, end, 2); // to 22: starttime
+		if (!cursor)
+			return false;
+		cursor = ParseNumber(cursor, end, value);
+		info.startTime = value;
+
+		cursor = SkipFields(cursor, end, 2); // to 24: rss in pages
+		if (!cursor)
+			return false;
+		ParseNumber(cursor, end, value);
+		info.workingSet = value * pageSize;
+
+		return true;
+	}
+}
+
+/**
+* @brief Enumerates all processes by walking /proc.
+* @param out The snapshot to be filled. Existing entries are discarded.
+* @return True on success, false if /proc could not be opened.
+* @remarks Directory entries are read with large getdents64 batches into the reusable buffer,
+*  and every /proc/<pid>/stat is read with a single pread into a stack buffer. Processes that
+*  exit while being walked are skipped. Nothing is allocated per process.
+*/
+bool process::ProcessEnumerator::Enumerate(ProcessSnapshot& out)
+{
+	FileDescriptor proc{ open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC) };
+	if (proc.fd < 0)
+		return false;
+
+	if (buffer.empty())
+		buffer.resize(256 * 1024);
+
+	out.processes.clear();
+	out.processes.reserve(lastCount + lastCount / 8 + 16);
+
+	char path[32];
+	char stat[1024];
+
+	for (;;) {
+		const long read = syscall(SYS_getdents64, proc.fd, buffer.data(), buffer.size());
+		if (read < 0)
+			return false;
+		if (read == 0)
+			break;
+
+		for (long offset = 0; offset < read;) {
+			const auto* entry = reinterpret_cast<const LinuxDirent64*>(buffer.data() + offset);
+			offset += entry->d_reclen;
+
+			ProcessInfo info;
+			if (entry->d_type != DT_DIR || !ParsePid(entry->d_name, info.pid))
+				continue;
+
+			const std::size_t nameLength = std::strlen(entry->d_name);
+			std::memcpy(path, entry->d_name, nameLength);
+			std::memcpy(path + nameLength, "/stat", sizeof("/stat"));
+
+			FileDescriptor file{ openat(proc.fd, path, O_RDONLY | O_CLOEXEC) };
+			if (file.fd < 0)
+				continue;
+
+			const ssize_t length = pread(file.fd, stat, sizeof(stat), 0);
+			if (length <= 0)
+				continue;
+
+			std::string_view comm;
+			if (!ParseStat(stat, static_cast<std::size_t>(length), info, comm))
+				continue;
+
+			info.SetName(NamePool::Shared().Intern(comm));
+			out.processes.push_back(info);
+		}
+	}
+
+	lastCount = out.processes.size();
+	return true;
+}
+
+#endif // __linux__
@@ -0,0 +1,242 @@
+/**
+ * @file search_index.cpp
+ * @brief Implements the trigram name search.
+ */
+
+#include "search_index.h"
+#include "simd.h"
+#include "snapshot_diff.h"
+#include "sort_keys.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace
+{
+	/**
+	* @brief Packs three bytes into a trigram id.
+	*/
+	std::uint32_t Trigram(const char* text) noexcept
+	{
+		return static_cast<std::uint32_t>(static_cast<unsigned char>(text[0])) << 16 |
+			static_cast<std::uint32_t>(static_cast<unsigned char>(text[1])) << 8 |
+			static_cast<std::uint32_t>(static_cast<unsigned char>(text[2]));
+	}
+}
+
+/**
+* @brief Checks whether a folded name contains a folded query.
+* @param haystack The folded name.
+* @param needle The folded query.
+* @return True if needle occurs in haystack.
+*/
+bool process::ContainsFolded(std::string_view haystack, std::string_view needle) noexcept
+{
+	if (needle.empty())
+		return true;
+	if (needle.size() > haystack.size())
+		return false;
+
+	const char* text = haystack.data();
+	const char first = needle[0];
+	const std::size_t starts = haystack.size() - needle.size() + 1; // number of possible match positions
+	std::size_t i = 0;
+
+#ifdef INJECTIFY_SSE2
+	// compare 16 candidate positions with the first query byte at once, only hits are verified
+	const __m128i pattern = _mm_set1_epi8(first);
+	for (; i + 16 <= starts; i += 16) {
+		const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+		unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pattern)));
+		while (mask) {
+			const std::size_t position = i + static_cast<std::size_t>(std::countr_zero(mask));
+			if (std::memcmp(text + position + 1, needle.data() + 1, needle.size() - 1) == 0)
+				return true;
+			mask &= mask - 1;
+		}
+	}
+#endif
+
+	for (; i < starts; ++i) {
+		if (text[i] == first && std::memcmp(text + i + 1, needle.data() + 1, needle.size() - 1) == 0)
+			return true;
+	}
+	return false;
+}
+
+/**
+* @brief Brings the index up to date with a snapshot.
+* @param latest The snapshot to be indexed.
+*/
+void process::NameSearchIndex::Update(std::shared_ptr<const ProcessSnapshot> latest)
+{
+	if (latest == snapshot)
+		return;
+
+	const auto previous = std::move(snapshot);
+	snapshot = std::move(latest);
+	lastValid = false;
+
+	if (previous && snapshot->generation == previous->generation + 1 && ApplyChanges(*previous))
+		return;
+
+	Rebuild();
+}
+
+/**
+* @brief Finds the processes whose name contains a query.
+* @param query The text to search for, case is ignored.
+* @param out Receives the indices of the matching processes in the indexed snapshot.
+*/
+void process::NameSearchIndex::Search(std::string_view query, std::vector<std::uint32_t>& out)
+{
+	out.clear();
+	if (!snapshot)
+		return;
+
+	folded.resize(query.size());
+	FoldAsciiCase(query, folded.data());
+
+	candidates.clear();
+	if (lastValid && !lastQuery.empty() && folded.find(lastQuery) != std::string::npos) {
+		// everything that contains the new query contained the previous one
+		candidates.swap(lastSlots);
+	}
+	else if (folded.size() >= 3) {
+		// intersect the posting lists, starting with the shortest
+		std::vector<const std::vector<std::uint32_t>*> lists;
+		for (std::size_t i = 0; i + 3 <= folded.size(); i++) {
+			const auto found = postings.find(Trigram(folded.data() + i));
+			if (found == postings.end()) {
+				lists.clear();
+				break;
+			}
+			lists.push_back(&found->second);
+		}
+
+		if (!lists.empty()) {
+			std::sort(lists.begin(), lists.end(), [](const auto* a, const auto* b) { return a->size() < b->size(); });
+
+			candidates = *lists[0];
+			for (std::size_t i = 1; i < lists.size() && !candidates.empty(); i++) {
+				intersection.clear();
+				std::set_intersection(candidates.begin(), candidates.end(), lists[i]->begin(), lists[i]->end(), std::back_inserter(intersection));
+				candidates.swap(intersection);
+			}
+		}
+	}
+	else {
+		// too short for a trigram, check every live process
+		for (std::uint32_t slot = 0; slot < slotIndex.size(); slot++) {
+			if (slotIndex[slot] != ProcessEvent::npos)
+				candidates.push_back(slot);
+		}
+	}
+
+	lastSlots.clear();
+	for (std::uint32_t slot : candidates) {
+		const std::uint32_t index = slotIndex[slot];
+		if (index != ProcessEvent::npos && ContainsFolded(snapshot->processes[index].sortKey, folded)) {
+			lastSlots.push_back(slot);
+			out.push_back(index);
+		}
+	}
+
+	lastQuery = folded;
+	lastValid = true;
+}
+
+/**
+* @brief Indexes every process of the snapshot from scratch.
+*/
+void process::NameSearchIndex::Rebuild()
+{
+	postings.clear();
+	slotIndex.clear();
+	retired = 0;
+
+	const auto count = static_cast<std::uint32_t>(snapshot->processes.size());
+	indexSlot.resize(count);
+	for (std::uint32_t i = 0; i < count; i++)
+		indexSlot[i] = Insert(i, snapshot->processes[i].sortKey);
+}
+
+/**
+* @brief Applies the diff of the current snapshot to an index of the previous one.
+* @param previous The snapshot the index currently describes.
+* @return False if a rebuild is cheaper, the index is untouched in that case.
+*/
+bool process::NameSearchIndex::ApplyChanges(const ProcessSnapshot& previous)
+{
+	const auto& events = snapshot->changes;
+	if (events.size() > previous.processes.size() / 4 + 16)
+		return false;
+
+	// too many dead entries in the posting lists, compact them
+	if (retired > slotIndex.size() / 2 + 1024)
+		return false;
+
+	BuildIndexRemap(previous.processes.size(), events, remap);
+
+	nextIndexSlot.assign(snapshot->processes.size(), ProcessEvent::npos);
+	for (std::uint32_t i = 0; i < remap.size(); i++) {
+		if (remap[i] != ProcessEvent::npos)
+			nextIndexSlot[remap[i]] = indexSlot[i];
+	}
+
+	for (const ProcessEvent& event : events) {
+		switch (event.type) {
+		case ProcessEventType::Removed:
+			Retire(indexSlot[event.previousIndex]);
+			break;
+
+		case ProcessEventType::Added:
+			nextIndexSlot[event.currentIndex] = Insert(event.currentIndex, snapshot->processes[event.currentIndex].sortKey);
+			break;
+
+		case ProcessEventType::Changed: {
+			// a renamed process (exec on Linux) gets a fresh slot for its new trigrams
+			const ProcessInfo& after = snapshot->processes[event.currentIndex];
+			if (previous.processes[event.previousIndex].nameId != after.nameId) {
+				Retire(indexSlot[event.previousIndex]);
+				nextIndexSlot[event.currentIndex] = Insert(event.currentIndex, after.sortKey);
+			}
+		} break;
+		}
+	}
+
+	indexSlot.swap(nextIndexSlot);
+	for (std::uint32_t i = 0; i < indexSlot.size(); i++)
+		slotIndex[indexSlot[i]] = i;
+
+	return true;
+}
+
+/**
+* @brief Gives a name a new slot and adds it to the posting list of every trigram.
+* @param index The index of the process in the current snapshot.
+* @param key The folded name.
+* @return The new slot, which is larger than every slot already in the lists.
+*/
+std::uint32_t process::NameSearchIndex::Insert(std::uint32_t index, std::string_view key)
+{
+	const auto slot = static_cast<std::uint32_t>(slotIndex.size());
+	slotIndex.push_back(index);
+
+	for (std::size_t i = 0; i + 3 <= key.size(); i++) {
+		std::vector<std::uint32_t>& list = postings[Trigram(key.data() + i)];
+		if (list.empty() || list.back() != slot)
+			list.push_back(slot);
+	}
+	return slot;
+}
+
+/**
+* @brief Marks a slot as dead, its posting list entries are skipped until the next rebuild.
+*/
+void process::NameSearchIndex::Retire(std::uint32_t slot)
+{
+	slotIndex[slot] = ProcessEvent::npos;
+	++retired;
+}
@@ -0,0 +1,74 @@
+/**
+
+@file search_index.h
+@brief Trigram index for case-insensitive substring search over process names.
+*/
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "process_snapshot.h"
+
+namespace process
+{
+	/**
+	* @brief Checks whether a folded name contains a folded query.
+	* @remarks Scans for the first query byte 16 bytes at a time with SSE2 where available.
+	*/
+	bool ContainsFolded(std::string_view haystack, std::string_view needle) noexcept;
+
+	/**
+	* @brief Finds the processes whose name contains a query, ignoring case.
+	* @remarks Every indexed name gets a slot. For each trigram of the folded name the slot is
+	*  appended to a posting list, slots only ever grow so the lists stay sorted without moving
+	*  anything. Exited or renamed processes just retire their slot, dead slots are skipped at
+	*  query time and dropped by the next rebuild. A query intersects the posting lists of its
+	*  own trigrams and verifies the few remaining candidates. The index follows snapshots
+	*  through their diffs, and a query that extends the previous one only re-checks the
+	*  previous results.
+	*/
+	class NameSearchIndex
+	{
+	public:
+		// follows the snapshot, incrementally if it directly succeeds the indexed one
+		void Update(std::shared_ptr<const ProcessSnapshot> latest);
+
+		// receives the indices (into the indexed snapshot) of all matching processes, in no particular order
+		void Search(std::string_view query, std::vector<std::uint32_t>& out);
+
+	private:
+		void Rebuild();
+		bool ApplyChanges(const ProcessSnapshot& previous);
+		std::uint32_t Insert(std::uint32_t index, std::string_view key);
+		void Retire(std::uint32_t slot);
+
+		std::shared_ptr<const ProcessSnapshot> snapshot;
+
+		// trigram (three folded bytes) -> sorted slots, may contain retired slots
+		std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> postings;
+
+		// slot -> index into snapshot->processes, npos for retired slots
+		std::vector<std::uint32_t> slotIndex;
+		std::size_t retired = 0;
+
+		// index into snapshot->processes -> slot
+		std::vector<std::uint32_t> indexSlot;
+
+		// result of the previous query, reused when the next query extends it
+		std::string lastQuery;
+		std::vector<std::uint32_t> lastSlots;
+		bool lastValid = false;
+
+		// scratch buffers kept between calls
+		std::string folded;
+		std::vector<std::uint32_t> remap;
+		std::vector<std::uint32_t> nextIndexSlot;
+		std::vector<std::uint32_t> candidates;
+		std::vector<std::uint32_t> intersection;
+	};
+}
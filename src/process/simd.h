@@ -0,0 +1,13 @@
+/**
+
+@file simd.h
+@brief Detects whether the SSE2 code paths can be compiled.
+*/
+
+#pragma once
+
+// SSE2 is part of every x64 target, define INJECTIFY_NO_SIMD to force the scalar code paths
+#if !defined(INJECTIFY_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define INJECTIFY_SSE2
+#include <emmintrin.h>
+#endif
@@ -0,0 +1,128 @@
+/**
+ * @file snapshot_diff.cpp
+ * @brief Implements the snapshot merge diff.
+ */
+
+#include "snapshot_diff.h"
+
+#include <algorithm>
+
+namespace
+{
+	/**
+	* @brief Checks whether anything we display or filter on differs between two entries of the same process.
+	*/
+	bool HasChanged(const process::ProcessInfo& before, const process::ProcessInfo& after) noexcept
+	{
+		return before.parentPid != after.parentPid ||
+			before.threadCount != after.threadCount ||
+			before.accessible != after.accessible ||
+			before.architecture != after.architecture ||
+			before.nameId != after.nameId ||
+			before.pathId != after.pathId;
+	}
+}
+
+/**
+* @brief Sorts the entries of a snapshot by pid.
+* @param snapshot The snapshot to be sorted.
+* @remarks /proc is usually already in pid order, in which case this is a single linear check.
+*/
+void process::SortByPid(ProcessSnapshot& snapshot)
+{
+	const auto byPid = [](const ProcessInfo& a, const ProcessInfo& b) { return a.pid < b.pid; };
+
+	if (!std::is_sorted(snapshot.processes.begin(), snapshot.processes.end(), byPid))
+		std::sort(snapshot.processes.begin(), snapshot.processes.end(), byPid);
+}
+
+/**
+* @brief Merges two pid sorted snapshots into a list of events.
+* @param previous The older snapshot.
+* @param current The newer snapshot.
+* @param events Receives the events in pid order.
+*/
+void process::DiffSnapshots(const ProcessSnapshot& previous, const ProcessSnapshot& current, std::vector<ProcessEvent>& events)
+{
+	events.clear();
+
+	const auto& before = previous.processes;
+	const auto& after = current.processes;
+
+	std::uint32_t i = 0;
+	std::uint32_t j = 0;
+	while (i < before.size() && j < after.size()) {
+		if (before[i].pid < after[j].pid) {
+			events.push_back({ ProcessEventType::Removed, i, ProcessEvent::npos });
+			++i;
+		}
+		else if (after[j].pid < before[i].pid) {
+			events.push_back({ ProcessEventType::Added, ProcessEvent::npos, j });
+			++j;
+		}
+		else {
+			if (before[i].startTime != after[j].startTime) {
+				// the PID has been recycled by a new process
+				events.push_back({ ProcessEventType::Removed, i, ProcessEvent::npos });
+				events.push_back({ ProcessEventType::Added, ProcessEvent::npos, j });
+			}
+			else if (HasChanged(before[i], after[j])) {
+				events.push_back({ ProcessEventType::Changed, i, j });
+			}
+			++i;
+			++j;
+		}
+	}
+
+	for (; i < before.size(); ++i)
+		events.push_back({ ProcessEventType::Removed, i, ProcessEvent::npos });
+	for (; j < after.size(); ++j)
+		events.push_back({ ProcessEventType::Added, ProcessEvent::npos, j });
+}
+
+/**
+* @brief Translates indices of the previous snapshot into indices of the current one.
+* @param previousCount The number of entries in the previous snapshot.
+* @param events The events between the two snapshots.
+* @param remap Receives the new index of every previous entry.
+* @remarks Unchanged entries keep their relative order, so their new index is the old one shifted
+*  by the number of additions minus removals in front of them.
+*/
+void process::BuildIndexRemap(std::size_t previousCount, const std::vector<ProcessEvent>& events, std::vector<std::uint32_t>& remap)
+{
+	remap.resize(previousCount);
+
+	std::uint32_t next = 0;
+	std::int64_t shift = 0;
+
+	const auto assignUntil = [&](std::uint32_t end) {
+		for (; next < end; ++next)
+			remap[next] = static_cast<std::uint32_t>(next + shift);
+	};
+
+	for (const ProcessEvent& event : events) {
+		switch (event.type) {
+		case ProcessEventType::Added:
+			// previous entries that end up in front of the new one
+			while (next < previousCount && next + shift < event.currentIndex) {
+				remap[next] = static_cast<std::uint32_t>(next + shift);
+				++next;
+			}
+			++shift;
+			break;
+
+		case ProcessEventType::Removed:
+			assignUntil(event.previousIndex);
+			remap[next++] = ProcessEvent::npos;
+			--shift;
+			break;
+
+		case ProcessEventType::Changed:
+			assignUntil(event.previousIndex);
+			remap[next++] = event.currentIndex;
+			break;
+		}
+	}
+
+	assignUntil(static_cast<std::uint32_t>(previousCount));
+}
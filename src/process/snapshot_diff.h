@@ -0,0 +1,40 @@
+/**
+
+@file snapshot_diff.h
+@brief Computes the added, removed and changed processes between two snapshots.
+*/
+
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "process_snapshot.h"
+
+namespace process
+{
+	/**
+	* @brief Sorts the entries of a snapshot by pid, which DiffSnapshots() relies on.
+	* @param snapshot The snapshot to be sorted, usually straight from ProcessEnumerator.
+	*/
+	void SortByPid(ProcessSnapshot& snapshot);
+
+	/**
+	* @brief Merges two pid sorted snapshots into a list of events.
+	* @param previous The older snapshot.
+	* @param current The newer snapshot.
+	* @param events Receives the events in pid order, existing content is discarded.
+	* @remarks Runs in O(n + m). A recycled PID (same pid, different start time) is reported
+	*  as Removed followed by Added.
+	*/
+	void DiffSnapshots(const ProcessSnapshot& previous, const ProcessSnapshot& current, std::vector<ProcessEvent>& events);
+
+	/**
+	* @brief Translates indices of the previous snapshot into indices of the current one.
+	* @param previousCount The number of entries in the previous snapshot.
+	* @param events The events between the two snapshots, as produced by DiffSnapshots().
+	* @param remap Receives one entry per previous index, ProcessEvent::npos for removed processes.
+	* @remarks Lets consumers holding indices into the previous snapshot catch up in O(n)
+	*  without looking every process up again.
+	*/
+	void BuildIndexRemap(std::size_t previousCount, const std::vector<ProcessEvent>& events, std::vector<std::uint32_t>& remap);
+}
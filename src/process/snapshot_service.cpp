@@ -0,0 +1,215 @@
+/**
+ * @file snapshot_service.cpp
+ * @brief Implements the background process snapshot worker.
+ */
+
+#include "snapshot_service.h"
+#include "snapshot_diff.h"
+
+#include <algorithm>
+
+/**
+* @brief Creates a stopped service with an empty snapshot published.
+* @param interval The delay between two refreshes.
+*/
+process::SnapshotService::SnapshotService(std::chrono::milliseconds interval)
+	: latest(std::make_shared<const ProcessSnapshot>()),
+	intervalMs(interval.count())
+{
+}
+
+/**
+* @brief Stops the worker thread if it is still running.
+*/
+process::SnapshotService::~SnapshotService()
+{
+	Stop();
+}
+
+/**
+* @brief Starts the worker thread.
+* @remarks The first snapshot is taken immediately, so the UI has data after the first refresh.
+*/
+void process::SnapshotService::Start()
+{
+	if (worker.joinable())
+		return;
+
+	{
+		std::lock_guard lock(mutex);
+		stopping = false;
+		refreshRequested = true;
+	}
+
+	worker = std::thread(&SnapshotService::Run, this);
+}
+
+/**
+* @brief Signals the worker thread to exit and waits for it.
+*/
+void process::SnapshotService::Stop() noexcept
+{
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	if (worker.joinable())
+		worker.join();
+}
+
+/**
+* @brief Sets the delay between two refreshes.
+* @param interval The new delay.
+*/
+void process::SnapshotService::SetInterval(std::chrono::milliseconds interval) noexcept
+{
+	intervalMs.store(interval.count(), std::memory_order_relaxed);
+	wake.notify_all();
+}
+
+/**
+* @brief Gets the delay between two refreshes.
+* @return The current delay.
+*/
+std::chrono::milliseconds process::SnapshotService::GetInterval() const noexcept
+{
+	return std::chrono::milliseconds(intervalMs.load(std::memory_order_relaxed));
+}
+
+/**
+* @brief Asks the worker to refresh as soon as possible.
+*/
+void process::SnapshotService::RequestRefresh() noexcept
+{
+	{
+		std::lock_guard lock(mutex);
+		refreshRequested = true;
+	}
+	wake.notify_all();
+}
+
+/**
+* @brief Gets the most recently published snapshot.
+* @return The latest snapshot. Never null, but may be empty (generation 0) before the first refresh.
+*/
+std::shared_ptr<const process::ProcessSnapshot> process::SnapshotService::Latest() const noexcept
+{
+	return latest.load(std::memory_order_acquire);
+}
+
+/**
+* @brief Gets the hit rate of the process details cache since the service was created.
+* @return The cumulative cache statistics.
+*/
+process::CacheStats process::SnapshotService::GetCacheStats() const noexcept
+{
+	return detailsCache.GetStats();
+}
+
+/**
+* @brief Gets the hit rate of the process details cache during the last refresh.
+* @return The cache statistics of the last refresh, misses should be close to zero in steady state.
+*/
+process::CacheStats process::SnapshotService::GetLastRefreshCacheStats() const noexcept
+{
+	return detailsCache.GetLastUpdateStats();
+}
+
+/**
+* @brief Registers a consumer of the snapshot diffs.
+* @param listener Called on the worker thread after every published refresh.
+* @return An id that can be passed to RemoveListener().
+* @remarks Listeners must be quick, the next refresh waits for them. They are called without
+*  any lock held and may add or remove listeners, the change applies from the next refresh on.
+*/
+std::size_t process::SnapshotService::AddListener(Listener listener)
+{
+	std::lock_guard lock(listenersMutex);
+	auto changed = std::make_shared<ListenerList>(*listeners);
+	changed->emplace_back(nextListenerId, std::move(listener));
+	listeners = std::move(changed);
+	return nextListenerId++;
+}
+
+/**
+* @brief Unregisters a consumer added with AddListener().
+* @param id The id returned by AddListener().
+* @remarks Waits for listeners that are being called, so the caller may destroy what the
+*  listener refers to once this returns. A listener that removes itself (or another one)
+*  does not wait for itself.
+*/
+void process::SnapshotService::RemoveListener(std::size_t id)
+{
+	std::unique_lock lock(listenersMutex);
+	auto changed = std::make_shared<ListenerList>(*listeners);
+	std::erase_if(*changed, [id](const auto& entry) { return entry.first == id; });
+	listeners = std::move(changed);
+
+	const std::thread::id self = std::this_thread::get_id();
+	listenersIdle.wait(lock, [&] { return dispatcher == std::thread::id() || dispatcher == self; });
+}
+
+/**
+* @brief Worker loop, refreshes until Stop() is called.
+*/
+void process::SnapshotService::Run()
+{
+	std::unique_lock lock(mutex);
+	while (!stopping)
+	{
+		if (!refreshRequested)
+		{
+			wake.wait_for(lock, GetInterval(), [this] { return stopping || refreshRequested; });
+			if (stopping)
+				break;
+		}
+		refreshRequested = false;
+
+		lock.unlock();
+		Refresh();
+		lock.lock();
+	}
+}
+
+/**
+* @brief Enumerates all processes and publishes the result as a new snapshot.
+* @remarks If the enumeration fails the previous snapshot stays published. Details that need a
+*  process handle come from the cache, so only processes started since the last refresh are opened.
+*/
+void process::SnapshotService::Refresh()
+{
+	auto snapshot = std::make_shared<ProcessSnapshot>();
+	if (!enumerator.Enumerate(*snapshot))
+		return;
+
+	SortByPid(*snapshot);
+	snapshot->BuildLookup();
+	detailsCache.Update(*snapshot);
+
+	const auto previous = Latest();
+	DiffSnapshots(*previous, *snapshot, snapshot->changes);
+	detailsCache.Evict(*previous, snapshot->changes);
+
+	snapshot->generation = ++generation;
+	snapshot->takenAt = std::chrono::steady_clock::now();
+
+	latest.store(snapshot, std::memory_order_release);
+
+	std::shared_ptr<const ListenerList> current;
+	{
+		std::lock_guard lock(listenersMutex);
+		current = listeners;
+		dispatcher = std::this_thread::get_id();
+	}
+
+	for (const auto& [id, listener] : *current)
+		listener(*previous, *snapshot);
+
+	{
+		std::lock_guard lock(listenersMutex);
+		dispatcher = std::thread::id();
+	}
+	listenersIdle.notify_all();
+}
@@ -0,0 +1,92 @@
+/**
+
+@file snapshot_service.h
+@brief Background worker that enumerates running processes and publishes immutable snapshots.
+*/
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "process_cache.h"
+#include "process_snapshot.h"
+
+namespace process
+{
+	/**
+	* @brief Periodically enumerates processes on a dedicated thread.
+	* @remarks The render thread only ever calls Latest(), which is a lock-free load of the
+	*  most recently published snapshot. All enumeration happens on the worker thread.
+	*  Every snapshot carries its diff against the previous generation, consumers that are
+	*  exactly one generation behind can catch up incrementally.
+	*/
+	class SnapshotService
+	{
+	public:
+		// called on the worker thread after every publish, current.changes holds the events
+		using Listener = std::function<void(const ProcessSnapshot& previous, const ProcessSnapshot& current)>;
+
+		explicit SnapshotService(std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+		~SnapshotService();
+
+		SnapshotService(const SnapshotService&) = delete;
+		SnapshotService& operator=(const SnapshotService&) = delete;
+
+		// starts the worker thread, does nothing if it is already running
+		void Start();
+
+		// stops and joins the worker thread
+		void Stop() noexcept;
+
+		// changes the delay between two refreshes, takes effect after the current wait
+		void SetInterval(std::chrono::milliseconds interval) noexcept;
+		std::chrono::milliseconds GetInterval() const noexcept;
+
+		// wakes the worker up to refresh immediately instead of waiting for the interval
+		void RequestRefresh() noexcept;
+
+		// returns the latest published snapshot, never null
+		std::shared_ptr<const ProcessSnapshot> Latest() const noexcept;
+
+		// hit rate of the process details cache, cumulative and for the last refresh
+		CacheStats GetCacheStats() const noexcept;
+		CacheStats GetLastRefreshCacheStats() const noexcept;
+
+		// registers a consumer of the snapshot diffs, returns an id for RemoveListener()
+		std::size_t AddListener(Listener listener);
+
+		// once it returns the listener is not called any more, except when it removes itself
+		void RemoveListener(std::size_t id);
+
+	private:
+		void Run();
+		void Refresh();
+
+		std::atomic<std::shared_ptr<const ProcessSnapshot>> latest;
+		std::atomic<std::chrono::milliseconds::rep> intervalMs;
+		std::uint64_t generation = 0;
+		ProcessEnumerator enumerator;
+		ProcessDetailsCache detailsCache;
+
+		// replaced on every change, a refresh calls the list it copied without holding the mutex
+		using ListenerList = std::vector<std::pair<std::size_t, Listener>>;
+		std::mutex listenersMutex;
+		std::condition_variable listenersIdle;
+		std::shared_ptr<const ListenerList> listeners = std::make_shared<ListenerList>();
+		std::size_t nextListenerId = 1;
+		std::thread::id dispatcher; // thread calling the listeners, empty while none is
+
+		std::thread worker;
+		std::mutex mutex;
+		std::condition_variable wake;
+		bool stopping = false;
+		bool refreshRequested = false;
+	};
+}
@@ -0,0 +1,36 @@
+/**
+ * @file sort_keys.cpp
+ * @brief Implements the ASCII case folding.
+ */
+
+#include "sort_keys.h"
+#include "simd.h"
+
+/**
+* @brief Lowercases the ASCII letters of a string.
+* @param text The string to be folded.
+* @param out Receives the folded bytes.
+*/
+void process::FoldAsciiCase(std::string_view text, char* out) noexcept
+{
+	const char* in = text.data();
+	std::size_t size = text.size();
+
+#ifdef INJECTIFY_SSE2
+	// shift 'A'..'Z' to the bottom of the signed range, a single compare then finds all upper case letters
+	const __m128i shift = _mm_set1_epi8(static_cast<char>(128 - 'A'));
+	const __m128i limit = _mm_set1_epi8(static_cast<char>(-128 + 26));
+	const __m128i bit = _mm_set1_epi8(0x20);
+
+	for (; size >= 16; size -= 16, in += 16, out += 16) {
+		const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+		const __m128i upper = _mm_cmplt_epi8(_mm_add_epi8(chars, shift), limit);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_or_si128(chars, _mm_and_si128(upper, bit)));
+	}
+#endif
+
+	for (; size > 0; --size, ++in, ++out) {
+		const char c = *in;
+		*out = (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : c;
+	}
+}
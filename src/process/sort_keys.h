@@ -0,0 +1,21 @@
+/**
+
+@file sort_keys.h
+@brief ASCII case folding for process name sort keys and searches.
+*/
+
+#pragma once
+#include <cstddef>
+#include <string_view>
+
+namespace process
+{
+	/**
+	* @brief Lowercases the ASCII letters of a string, other bytes (UTF-8 sequences) are copied as is.
+	* @param text The string to be folded.
+	* @param out Receives text.size() bytes, may be the same buffer as text.
+	* @remarks Uses SSE2 for 16 bytes at a time where available, define INJECTIFY_NO_SIMD to
+	*  force the scalar version.
+	*/
+	void FoldAsciiCase(std::string_view text, char* out) noexcept;
+}
@@ -0,0 +1,26 @@
+/**
+ * @file spawn_monitor.cpp
+ * @brief Platform independent parts of the spawn monitor.
+ */
+
+#include "spawn_monitor.h"
+
+/**
+* @brief Gets the name of an event source.
+*/
+const char* process::SpawnSourceName(SpawnSource source) noexcept
+{
+	switch (source) {
+	case SpawnSource::ProcConnector: return "proc connector";
+	case SpawnSource::ProcPoll: return "/proc poll";
+	default: return "none";
+	}
+}
+
+/**
+* @brief Stops the worker thread if it is still running.
+*/
+process::SpawnMonitor::~SpawnMonitor()
+{
+	Stop();
+}
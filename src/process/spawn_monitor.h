@@ -0,0 +1,78 @@
+/**
+
+@file spawn_monitor.h
+@brief Low latency notification about processes that start or run a new program.
+*/
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+namespace process
+{
+	/**
+	* @brief Where a SpawnMonitor gets its events from.
+	*/
+	enum class SpawnSource : std::uint8_t
+	{
+		None,          // not running, or the platform has no monitor
+		ProcConnector, // Linux netlink proc connector, pushed by the kernel
+		ProcPoll,      // Linux /proc listing every poll interval
+	};
+
+	// short lower case name of a source, for the UI
+	const char* SpawnSourceName(SpawnSource source) noexcept;
+
+	/**
+	* @brief Reports new processes on a dedicated thread as soon as they appear.
+	* @remarks Only tells that something happened, the snapshot service still does the actual
+	*  enumeration: consumers typically answer with SnapshotService::RequestRefresh(). On Linux
+	*  the netlink proc connector is used when we may subscribe to it (CAP_NET_ADMIN), it reports
+	*  fork and exec with the kernel's timestamp. Otherwise /proc is listed every poll interval
+	*  and new pids are reported with the time they were first seen.
+	*/
+	class SpawnMonitor
+	{
+	public:
+		// pid of a process that was created or ran exec and when that happened; pid 0 means events
+		// may have been missed and a full refresh is due
+		using Callback = std::function<void(std::uint32_t pid, std::chrono::steady_clock::time_point at)>;
+
+		explicit SpawnMonitor(std::chrono::milliseconds pollInterval = std::chrono::milliseconds(2)) noexcept : pollInterval(pollInterval) { }
+		~SpawnMonitor();
+
+		SpawnMonitor(const SpawnMonitor&) = delete;
+		SpawnMonitor& operator=(const SpawnMonitor&) = delete;
+
+		// starts the worker thread, false where the platform has no monitor
+		bool Start(Callback callback);
+
+		// stops and joins the worker thread
+		void Stop() noexcept;
+
+		SpawnSource Source() const noexcept { return source.load(std::memory_order_relaxed); }
+
+	private:
+		void Run();
+
+		Callback callback;
+		const std::chrono::milliseconds pollInterval;
+		std::atomic<SpawnSource> source = SpawnSource::None;
+		std::thread worker;
+
+#ifdef __linux__
+		bool OpenConnector();
+		void RunConnector();
+		void RunPoll();
+
+		// eventfd that wakes the worker up to exit
+		int stopEvent = -1;
+
+		// netlink socket subscribed to the proc connector, -1 when polling
+		int connector = -1;
+#endif
+	};
+}
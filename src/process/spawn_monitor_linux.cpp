@@ -0,0 +1,307 @@
+/**
+ * @file spawn_monitor_linux.cpp
+ * @brief Linux spawn monitor through the netlink proc connector or a /proc poll.
+ */
+
+#ifdef __linux__
+
+#include "spawn_monitor.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <dirent.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+	// how long to wait for the kernel to confirm the subscription
+	constexpr int SubscribeTimeoutMs = 250;
+
+	// values of proc_event::what, spelled out as newer kernel headers moved the enum out of the struct
+	constexpr std::uint32_t EventAcknowledge = 0x00000000;
+	constexpr std::uint32_t EventFork = 0x00000001;
+	constexpr std::uint32_t EventExec = 0x00000002;
+
+	/**
+	* @brief Converts a proc connector timestamp into a steady clock time.
+	* @remarks The kernel stamps events with CLOCK_MONOTONIC, which is what steady_clock reads
+	*  on Linux. Anything implausible is replaced by the time of arrival.
+	*/
+	std::chrono::steady_clock::time_point EventTime(std::uint64_t timestampNs) noexcept
+	{
+		const auto now = std::chrono::steady_clock::now();
+		const std::chrono::steady_clock::time_point at{ std::chrono::nanoseconds(timestampNs) };
+		return at <= now && now - at < std::chrono::seconds(10) ? at : now;
+	}
+
+	/**
+	* @brief Sends a subscription request for the proc connector.
+	*/
+	bool SendListen(int socket, proc_cn_mcast_op operation)
+	{
+		alignas(nlmsghdr) char buffer[NLMSG_SPACE(sizeof(cn_msg) + sizeof(proc_cn_mcast_op))] = { };
+
+		nlmsghdr* header = reinterpret_cast<nlmsghdr*>(buffer);
+		header->nlmsg_len = NLMSG_LENGTH(sizeof(cn_msg) + sizeof(proc_cn_mcast_op));
+		header->nlmsg_type = NLMSG_DONE;
+		header->nlmsg_pid = static_cast<__u32>(getpid());
+
+		cn_msg* message = static_cast<cn_msg*>(NLMSG_DATA(header));
+		message->id.idx = CN_IDX_PROC;
+		message->id.val = CN_VAL_PROC;
+		message->len = sizeof(proc_cn_mcast_op);
+		std::memcpy(message->data, &operation, sizeof(operation));
+
+		return send(socket, buffer, header->nlmsg_len, 0) == static_cast<ssize_t>(header->nlmsg_len);
+	}
+
+	/**
+	* @brief Calls a function for every proc connector event in a datagram.
+	* @remarks Events sit at an odd offset behind the connector header, they are copied out
+	*  rather than accessed in place.
+	*/
+	template <typename Handler>
+	void ForEachEvent(const char* buffer, std::size_t length, Handler&& handler)
+	{
+		int remaining = static_cast<int>(length);
+		for (const nlmsghdr* header = reinterpret_cast<const nlmsghdr*>(buffer); NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining)) {
+			if (header->nlmsg_type == NLMSG_ERROR || header->nlmsg_type == NLMSG_NOOP)
+				continue;
+
+			const cn_msg* message = static_cast<const cn_msg*>(NLMSG_DATA(header));
+			if (message->id.idx != CN_IDX_PROC || message->id.val != CN_VAL_PROC)
+				continue;
+
+			proc_event event = { };
+			std::memcpy(&event, message->data, (std::min<std::size_t>)(message->len, sizeof(event)));
+			handler(event);
+		}
+	}
+
+	/**
+	* @brief Lists the pids of all processes, sorted.
+	* @param proc /proc, kept open between calls.
+	*/
+	void ListPids(DIR* proc, std::vector<std::uint32_t>& out)
+	{
+		out.clear();
+		rewinddir(proc);
+		while (const dirent* entry = readdir(proc)) {
+			if (entry->d_name[0] < '1' || entry->d_name[0] > '9')
+				continue;
+			out.push_back(static_cast<std::uint32_t>(std::strtoul(entry->d_name, nullptr, 10)));
+		}
+		std::sort(out.begin(), out.end());
+	}
+}
+
+/**
+* @brief Starts watching for new processes.
+* @param onSpawn Called on the worker thread for every event, must be quick.
+* @return False if the worker could not be set up.
+*/
+bool process::SpawnMonitor::Start(Callback onSpawn)
+{
+	if (worker.joinable())
+		return true;
+
+	stopEvent = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (stopEvent < 0)
+		return false;
+
+	callback = std::move(onSpawn);
+	source.store(OpenConnector() ? SpawnSource::ProcConnector : SpawnSource::ProcPoll, std::memory_order_relaxed);
+	worker = std::thread(&SpawnMonitor::Run, this);
+	return true;
+}
+
+/**
+* @brief Wakes the worker up, waits for it and closes its descriptors.
+*/
+void process::SpawnMonitor::Stop() noexcept
+{
+	if (!worker.joinable())
+		return;
+
+	const std::uint64_t one = 1;
+	(void)!write(stopEvent, &one, sizeof(one));
+	worker.join();
+
+	if (connector >= 0) {
+		SendListen(connector, PROC_CN_MCAST_IGNORE);
+		close(connector);
+		connector = -1;
+	}
+	close(stopEvent);
+	stopEvent = -1;
+	source.store(SpawnSource::None, std::memory_order_relaxed);
+}
+
+/**
+* @brief Subscribes to the proc connector.
+* @return False if the kernel lacks it or refuses us, the monitor polls /proc then.
+* @remarks Joining the multicast group needs CAP_NET_ADMIN. The kernel acknowledges the
+*  subscription with an event of its own, which is waited for so a kernel built without
+*  the connector is not mistaken for a quiet system.
+*/
+bool process::SpawnMonitor::OpenConnector()
+{
+	const int socket = ::socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+	if (socket < 0)
+		return false;
+
+	// bursts of forks must not overflow the queue while the worker is busy in a callback
+	const int bufferSize = 1024 * 1024;
+	setsockopt(socket, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+
+	sockaddr_nl address = { };
+	address.nl_family = AF_NETLINK;
+	address.nl_groups = CN_IDX_PROC;
+	if (bind(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || !SendListen(socket, PROC_CN_MCAST_LISTEN)) {
+		close(socket);
+		return false;
+	}
+
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SubscribeTimeoutMs);
+	alignas(nlmsghdr) char buffer[4096];
+	for (;;) {
+		const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+		pollfd descriptor = { socket, POLLIN, 0 };
+		if (left <= 0 || poll(&descriptor, 1, static_cast<int>(left)) <= 0)
+			break;
+
+		const ssize_t length = recv(socket, buffer, sizeof(buffer), 0);
+		if (length <= 0)
+			continue;
+
+		int acknowledged = -1;
+		ForEachEvent(buffer, static_cast<std::size_t>(length), [&](const proc_event& event) {
+			if (static_cast<std::uint32_t>(event.what) == EventAcknowledge)
+				acknowledged = static_cast<int>(event.event_data.ack.err);
+		});
+
+		if (acknowledged == 0) {
+			connector = socket;
+			return true;
+		}
+		if (acknowledged > 0)
+			break;
+	}
+
+	close(socket);
+	return false;
+}
+
+/**
+* @brief Worker loop, runs until Stop().
+*/
+void process::SpawnMonitor::Run()
+{
+	if (connector >= 0)
+		RunConnector();
+	else
+		RunPoll();
+}
+
+/**
+* @brief Forwards fork and exec events of the proc connector.
+* @remarks Forks of threads are skipped, only new thread groups are processes. A process is
+*  reported at fork and again at exec, the second report is what catches its final name.
+*/
+void process::SpawnMonitor::RunConnector()
+{
+	pollfd descriptors[2] = { { connector, POLLIN, 0 }, { stopEvent, POLLIN, 0 } };
+	alignas(nlmsghdr) char buffer[16 * 1024];
+
+	for (;;) {
+		if (poll(descriptors, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (descriptors[1].revents)
+			break;
+
+		const ssize_t length = recv(connector, buffer, sizeof(buffer), MSG_DONTWAIT);
+		if (length < 0) {
+			// the kernel dropped events, only a full refresh knows what they were
+			if (errno == ENOBUFS)
+				callback(0, std::chrono::steady_clock::now());
+			continue;
+		}
+
+		ForEachEvent(buffer, static_cast<std::size_t>(length), [this](const proc_event& event) {
+			switch (static_cast<std::uint32_t>(event.what)) {
+			case EventFork:
+				if (event.event_data.fork.child_pid == event.event_data.fork.child_tgid)
+					callback(static_cast<std::uint32_t>(event.event_data.fork.child_tgid), EventTime(event.timestamp_ns));
+				break;
+
+			case EventExec:
+				callback(static_cast<std::uint32_t>(event.event_data.exec.process_tgid), EventTime(event.timestamp_ns));
+				break;
+
+			default:
+				break;
+			}
+		});
+	}
+}
+
+/**
+* @brief Lists /proc every poll interval and reports pids that were not there before.
+* @remarks A process may still carry its parent's name when first seen, so after a poll that
+*  found new pids the next one asks for another refresh, which sees the name after exec.
+*/
+void process::SpawnMonitor::RunPoll()
+{
+	DIR* proc = opendir("/proc");
+	if (!proc)
+		return;
+
+	std::vector<std::uint32_t> known, current;
+	ListPids(proc, known);
+
+	bool recheck = false;
+	pollfd descriptor = { stopEvent, POLLIN, 0 };
+	for (;;) {
+		const int ready = poll(&descriptor, 1, static_cast<int>(pollInterval.count()));
+		if (ready < 0 && errno != EINTR)
+			break;
+		if (ready > 0)
+			break;
+
+		ListPids(proc, current);
+		const auto now = std::chrono::steady_clock::now();
+
+		bool added = false;
+		std::size_t k = 0;
+		for (std::uint32_t pid : current) {
+			while (k < known.size() && known[k] < pid)
+				++k;
+			if (k == known.size() || known[k] != pid) {
+				callback(pid, now);
+				added = true;
+			}
+		}
+
+		if (!added && recheck)
+			callback(0, now);
+		recheck = added;
+		known.swap(current);
+	}
+
+	closedir(proc);
+}
+
+#endif // __linux__
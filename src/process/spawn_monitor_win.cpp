@@ -0,0 +1,33 @@
+/**
+ * @file spawn_monitor_win.cpp
+ * @brief Windows has no spawn monitor, watchers fall back to a short snapshot interval.
+ */
+
+#ifdef _WIN32
+
+#include "spawn_monitor.h"
+
+/**
+* @brief Does nothing, process creation notifications need a driver or an ETW session.
+* @return Always false.
+*/
+bool process::SpawnMonitor::Start(Callback)
+{
+	return false;
+}
+
+/**
+* @brief Does nothing.
+*/
+void process::SpawnMonitor::Stop() noexcept
+{
+}
+
+/**
+* @brief Never started.
+*/
+void process::SpawnMonitor::Run()
+{
+}
+
+#endif // _WIN32
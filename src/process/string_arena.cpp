@@ -0,0 +1,87 @@
+/**
+ * @file string_arena.cpp
+ * @brief Implements the snapshot string arena.
+ */
+
+#include "string_arena.h"
+
+#include <algorithm>
+#include <cstring>
+
+/**
+* @brief Creates an empty arena, no memory is allocated until the first string is stored.
+* @param blockSize The size of every regular block. Larger strings get a block of their own.
+*/
+process::StringArena::StringArena(std::size_t blockSize) noexcept
+	: blockSize(blockSize)
+{
+}
+
+/**
+* @brief Reserves space for one string at the end of the current block.
+* @param size The maximum number of characters that will be written, without terminator.
+* @return A pointer to at least size + 1 writable bytes.
+*/
+char* process::StringArena::Reserve(std::size_t size)
+{
+	const std::size_t needed = size + 1;
+
+	if (blocks.empty() || blocks.back().size - offset < needed) {
+		Block block;
+		block.size = std::max(blockSize, needed);
+		block.data = std::make_unique_for_overwrite<char[]>(block.size);
+		blocks.push_back(std::move(block));
+		offset = 0;
+	}
+
+	return blocks.back().data.get() + offset;
+}
+
+/**
+* @brief Finishes the string started by the last call to Reserve().
+* @param size The number of characters actually written, must not exceed the reserved size.
+* @return A view of the stored string.
+*/
+std::string_view process::StringArena::Commit(std::size_t size) noexcept
+{
+	char* begin = blocks.back().data.get() + offset;
+	begin[size] = '\0';
+
+	offset += size + 1;
+	used += size + 1;
+
+	return { begin, size };
+}
+
+/**
+* @brief Copies a string into the arena.
+* @param text The string to be copied.
+* @return A view of the copy, valid as long as the arena is neither cleared nor destroyed.
+*/
+std::string_view process::StringArena::Store(std::string_view text)
+{
+	char* destination = Reserve(text.size());
+	std::memcpy(destination, text.data(), text.size());
+	return Commit(text.size());
+}
+
+/**
+* @brief Drops all strings. The first block is kept so a refill does not allocate.
+*/
+void process::StringArena::Clear() noexcept
+{
+	if (blocks.size() > 1)
+		blocks.resize(1);
+
+	offset = 0;
+	used = 0;
+}
+
+/**
+* @brief Gets the number of bytes currently handed out.
+* @return The used size, including one terminator per string.
+*/
+std::size_t process::StringArena::BytesUsed() const noexcept
+{
+	return used;
+}
@@ -0,0 +1,58 @@
+/**
+
+@file string_arena.h
+@brief Bump allocator for strings that share the lifetime of one snapshot.
+*/
+
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace process
+{
+	/**
+	* @brief Stores many short strings in a few large blocks.
+	* @remarks Strings are never freed individually, the whole arena is released at once.
+	*  Every stored string is followed by a NUL byte, so views handed out by the arena can
+	*  be passed to C APIs (ImGui labels, printf) through data().
+	*/
+	class StringArena
+	{
+	public:
+		explicit StringArena(std::size_t blockSize = 64 * 1024) noexcept;
+
+		StringArena(StringArena&&) noexcept = default;
+		StringArena& operator=(StringArena&&) noexcept = default;
+		StringArena(const StringArena&) = delete;
+		StringArena& operator=(const StringArena&) = delete;
+
+		// returns room for at least size bytes plus the terminator, valid until the next call
+		char* Reserve(std::size_t size);
+
+		// keeps the first size bytes of the last Reserve() and terminates them
+		std::string_view Commit(std::size_t size) noexcept;
+
+		// copies text into the arena
+		std::string_view Store(std::string_view text);
+
+		// forgets all strings but keeps the first block for reuse
+		void Clear() noexcept;
+
+		// number of bytes handed out, including terminators
+		std::size_t BytesUsed() const noexcept;
+
+	private:
+		struct Block
+		{
+			std::unique_ptr<char[]> data;
+			std::size_t size = 0;
+		};
+
+		std::vector<Block> blocks;
+		std::size_t blockSize;
+		std::size_t offset = 0; // write position in blocks.back()
+		std::size_t used = 0;
+	};
+}